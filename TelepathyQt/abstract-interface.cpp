@@ -25,6 +25,8 @@
 #include "TelepathyQt/_gen/abstract-interface.moc.hpp"
 
 #include "TelepathyQt/debug-internal.h"
+#include "TelepathyQt/properties-changed-dispatcher-internal.h"
+#include "TelepathyQt/properties-prefetcher-internal.h"
 
 #include <TelepathyQt/Constants>
 #include <TelepathyQt/DBusProxy>
@@ -80,6 +82,9 @@ AbstractInterface::AbstractInterface(DBusProxy *parent, const QLatin1String &int
 
 AbstractInterface::~AbstractInterface()
 {
+    if (mPriv->monitorProperties) {
+        PropertiesChangedDispatcher::forBus(connection())->removeInterface(this);
+    }
     delete mPriv;
 }
 
@@ -132,11 +137,18 @@ PendingOperation *AbstractInterface::internalSetProperty(const QString &name,
 
 PendingVariantMap *AbstractInterface::internalRequestAllProperties() const
 {
+    DBusProxy *proxy = qobject_cast<DBusProxy*>(parent());
+    if (proxy) {
+        // The properties might have been prefetched already when the proxy was constructed
+        QDBusPendingCall pendingCall =
+            PropertiesPrefetcher::forBus(connection())->getAll(proxy, interface());
+        return new PendingVariantMap(pendingCall, DBusProxyPtr(proxy));
+    }
+
     QDBusMessage msg = QDBusMessage::createMethodCall(service(), path(),
             TP_QT_IFACE_PROPERTIES, QLatin1String("GetAll"));
     msg << interface();
     QDBusPendingCall pendingCall = connection().asyncCall(msg);
-    DBusProxy *proxy = qobject_cast<DBusProxy*>(parent());
     return new PendingVariantMap(pendingCall, DBusProxyPtr(proxy));
 }
 
@@ -148,6 +160,10 @@ PendingVariantMap *AbstractInterface::internalRequestAllProperties() const
  * By default, AbstractInterface does not monitor properties: you need to call this method
  * for this to happen.
  *
+ * All the interfaces monitoring properties on the same remote object share a single
+ * subscription to the PropertiesChanged signal. Changes to this interface received within the
+ * same mainloop iteration are merged and reported by a single propertiesChanged() emission.
+ *
  * \param monitorProperties Whether this interface should monitor property changes or not.
  * \sa isMonitoringProperties
  *     propertiesChanged()
@@ -158,27 +174,22 @@ void AbstractInterface::setMonitorProperties(bool monitorProperties)
         return;
     }
 
-    QStringList argumentMatch;
-    argumentMatch << interface();
-
+    PropertiesChangedDispatcher *dispatcher = PropertiesChangedDispatcher::forBus(connection());
     bool success;
 
     if (monitorProperties) {
-        success = connection().connect(service(), path(), TP_QT_IFACE_PROPERTIES,
-                QLatin1String("PropertiesChanged"), argumentMatch,
-                QString(), this,
-                SLOT(onPropertiesChanged(QString,QVariantMap,QStringList)));
+        success = dispatcher->addInterface(this);
     } else {
-        success = connection().disconnect(service(), path(), TP_QT_IFACE_PROPERTIES,
-                QLatin1String("PropertiesChanged"), argumentMatch,
-                QString(), this,
-                SLOT(onPropertiesChanged(QString,QVariantMap,QStringList)));
+        success = dispatcher->removeInterface(this);
     }
 
     if (!success) {
         warning() << "Connection or disconnection to " << TP_QT_IFACE_PROPERTIES <<
                 ".PropertiesChanged failed.";
+        return;
     }
+
+    mPriv->monitorProperties = monitorProperties;
 }
 
 /**
@@ -38,6 +38,7 @@ class DBusProxy;
 class PendingVariant;
 class PendingOperation;
 class PendingVariantMap;
+class PropertiesChangedDispatcher;
 
 class TP_QT_EXPORT AbstractInterface : public QDBusAbstractInterface
 {
@@ -78,6 +79,8 @@ private Q_SLOTS:
             const QStringList &invalidatedProperties);
 
 private:
+    friend class PropertiesChangedDispatcher;
+
     struct Private;
     friend struct Private;
     Private *mPriv;
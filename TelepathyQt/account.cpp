@@ -588,7 +588,79 @@ struct TP_QT_NO_EXPORT Account::Private
     static void introspectProtocolInfo(Private *self);
     static void introspectCapabilities(Private *self);
 
+    enum PropertyIndex {
+        PropertyInterfaces,
+        PropertyService,
+        PropertyDisplayName,
+        PropertyIcon,
+        PropertyNickname,
+        PropertyNormalizedName,
+        PropertyValid,
+        PropertyEnabled,
+        PropertyConnectAutomatically,
+        PropertyHasBeenOnline,
+        PropertyParameters,
+        PropertyAutomaticPresence,
+        PropertyCurrentPresence,
+        PropertyRequestedPresence,
+        PropertyChangingPresence,
+        PropertyConnection,
+        PropertyConnectionStatus,
+        PropertyConnectionStatusReason,
+        PropertyConnectionError,
+        PropertyConnectionErrorDetails,
+        PropertyCount
+    };
+
+    struct PropertyUpdate
+    {
+        PropertyUpdate()
+            : oldConnectionStatus(ConnectionStatusDisconnected),
+              serviceNameChanged(false),
+              profileChanged(false),
+              connectionStatusOrReasonChanged(false),
+              connectionStatusChanged(false)
+        {
+        }
+
+        QString oldIconName;
+        ConnectionStatus oldConnectionStatus;
+        bool serviceNameChanged;
+        bool profileChanged;
+        bool connectionStatusOrReasonChanged;
+        bool connectionStatusChanged;
+    };
+
+    struct PropertyHandler
+    {
+        const char *name;
+        void (Private::*update)(const QVariant &value, PropertyUpdate &update);
+    };
+
+    static const PropertyHandler propertyHandlers[PropertyCount];
+    static int propertyIndex(const QString &name);
+
     void updateProperties(const QVariantMap &props);
+    void updateInterfaces(const QVariant &value, PropertyUpdate &update);
+    void updateServiceName(const QVariant &value, PropertyUpdate &update);
+    void updateDisplayName(const QVariant &value, PropertyUpdate &update);
+    void updateIconName(const QVariant &value, PropertyUpdate &update);
+    void updateNickname(const QVariant &value, PropertyUpdate &update);
+    void updateNormalizedName(const QVariant &value, PropertyUpdate &update);
+    void updateValid(const QVariant &value, PropertyUpdate &update);
+    void updateEnabled(const QVariant &value, PropertyUpdate &update);
+    void updateConnectsAutomatically(const QVariant &value, PropertyUpdate &update);
+    void updateHasBeenOnline(const QVariant &value, PropertyUpdate &update);
+    void updateParameters(const QVariant &value, PropertyUpdate &update);
+    void updateAutomaticPresence(const QVariant &value, PropertyUpdate &update);
+    void updateCurrentPresence(const QVariant &value, PropertyUpdate &update);
+    void updateRequestedPresence(const QVariant &value, PropertyUpdate &update);
+    void updateChangingPresence(const QVariant &value, PropertyUpdate &update);
+    void updateConnection(const QVariant &value, PropertyUpdate &update);
+    void updateConnectionStatus(const QVariant &value, PropertyUpdate &update);
+    void updateConnectionStatusReason(const QVariant &value, PropertyUpdate &update);
+    void updateConnectionError(const QVariant &value, PropertyUpdate &update);
+    void updateConnectionErrorDetails(const QVariant &value, PropertyUpdate &update);
     void retrieveAvatar();
     bool processConnQueue();
 
@@ -4317,272 +4389,422 @@ void Account::Private::introspectCapabilities(Account::Private *self)
             SLOT(onConnectionReady(Tp::PendingOperation*)));
 }
 
+const Account::Private::PropertyHandler Account::Private::propertyHandlers[PropertyCount] = {
+    { "Interfaces", &Account::Private::updateInterfaces },
+    { "Service", &Account::Private::updateServiceName },
+    { "DisplayName", &Account::Private::updateDisplayName },
+    { "Icon", &Account::Private::updateIconName },
+    { "Nickname", &Account::Private::updateNickname },
+    { "NormalizedName", &Account::Private::updateNormalizedName },
+    { "Valid", &Account::Private::updateValid },
+    { "Enabled", &Account::Private::updateEnabled },
+    { "ConnectAutomatically", &Account::Private::updateConnectsAutomatically },
+    { "HasBeenOnline", &Account::Private::updateHasBeenOnline },
+    { "Parameters", &Account::Private::updateParameters },
+    { "AutomaticPresence", &Account::Private::updateAutomaticPresence },
+    { "CurrentPresence", &Account::Private::updateCurrentPresence },
+    { "RequestedPresence", &Account::Private::updateRequestedPresence },
+    { "ChangingPresence", &Account::Private::updateChangingPresence },
+    { "Connection", &Account::Private::updateConnection },
+    { "ConnectionStatus", &Account::Private::updateConnectionStatus },
+    { "ConnectionStatusReason", &Account::Private::updateConnectionStatusReason },
+    { "ConnectionError", &Account::Private::updateConnectionError },
+    { "ConnectionErrorDetails", &Account::Private::updateConnectionErrorDetails }
+};
+
+int Account::Private::propertyIndex(const QString &name)
+{
+    // The table is short enough for a linear scan, which unlike a lazily built hash is safe to do
+    // from any thread
+    for (int i = 0; i < PropertyCount; ++i) {
+        if (name == QLatin1String(propertyHandlers[i].name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 void Account::Private::updateProperties(const QVariantMap &props)
 {
     debug() << "Account::updateProperties: changed:";
 
-    if (props.contains(QLatin1String("Interfaces"))) {
-        parent->setInterfaces(qdbus_cast<QStringList>(props[QLatin1String("Interfaces")]));
-        debug() << " Interfaces:" << parent->interfaces();
+    // Look every changed property up once, then process them in the order the handlers are
+    // declared in, as some of them depend on the outcome of others
+    const QVariant *values[PropertyCount] = { 0 };
+    for (QVariantMap::const_iterator i = props.constBegin(); i != props.constEnd(); ++i) {
+        int index = propertyIndex(i.key());
+        if (index >= 0) {
+            values[index] = &i.value();
+        }
     }
 
-    QString oldIconName = parent->iconName();
-    bool serviceNameChanged = false;
-    bool profileChanged = false;
-    if (props.contains(QLatin1String("Service")) &&
-        serviceName != qdbus_cast<QString>(props[QLatin1String("Service")])) {
-        serviceNameChanged = true;
-        serviceName = qdbus_cast<QString>(props[QLatin1String("Service")]);
-        debug() << " Service Name:" << parent->serviceName();
-        /* use parent->serviceName() here as if the service name is empty we are going to use the
-         * protocol name */
-        emit parent->serviceNameChanged(parent->serviceName());
-        parent->notify("serviceName");
-
-        /* if we had a profile and the service changed, it means the profile also changed */
-        if (parent->isReady(Account::FeatureProfile)) {
-            /* service name changed, let's recreate profile */
-            profileChanged = true;
-            profile.reset();
-            emit parent->profileChanged(parent->profile());
-            parent->notify("profile");
+    PropertyUpdate update;
+    update.oldIconName = parent->iconName();
+    update.oldConnectionStatus = connectionStatus;
+
+    for (int i = 0; i < PropertyCount; ++i) {
+        if (values[i]) {
+            (this->*propertyHandlers[i].update)(*values[i], update);
+        } else if (i == PropertyIcon && update.serviceNameChanged) {
+            // the icon name falls back to one derived from the service name
+            updateIconName(QVariant(), update);
         }
-    }
 
-    if (props.contains(QLatin1String("DisplayName")) &&
-        displayName != qdbus_cast<QString>(props[QLatin1String("DisplayName")])) {
-        displayName = qdbus_cast<QString>(props[QLatin1String("DisplayName")]);
-        debug() << " Display Name:" << displayName;
-        emit parent->displayNameChanged(displayName);
-        parent->notify("displayName");
+        if (i == PropertyConnectionStatusReason && update.connectionStatusOrReasonChanged) {
+            parent->notify("connectionStatus");
+            parent->notify("connectionStatusReason");
+        }
     }
 
-    if ((props.contains(QLatin1String("Icon")) &&
-         oldIconName != qdbus_cast<QString>(props[QLatin1String("Icon")])) ||
-        serviceNameChanged) {
+    if (update.connectionStatusChanged) {
+        /* Something other than status changed, let's not emit connectionStatusChanged
+         * and keep the error/errorDetails, for the next interaction.
+         * It may happen if ConnectionError changes and in another property
+         * change the status changes to Disconnected, so we use the error
+         * previously signalled. If the status changes to something other
+         * than Disconnected later, the error is cleared. */
+        if (update.oldConnectionStatus != connectionStatus) {
+            /* We don't signal error for status other than Disconnected */
+            if (connectionStatus != ConnectionStatusDisconnected) {
+                connectionError = QString();
+                connectionErrorDetails = Connection::ErrorDetails();
+            } else if (connectionError.isEmpty()) {
+                connectionError = ConnectionHelper::statusReasonToErrorName(
+                        connectionStatusReason, update.oldConnectionStatus);
+            }
+
+            checkCapabilitiesChanged(update.profileChanged);
 
-        if (props.contains(QLatin1String("Icon"))) {
-            iconName = qdbus_cast<QString>(props[QLatin1String("Icon")]);
+            emit parent->connectionStatusChanged(connectionStatus);
+            parent->notify("connectionError");
+            parent->notify("connectionErrorDetails");
+        } else {
+            update.connectionStatusChanged = false;
         }
+    }
 
-        QString newIconName = parent->iconName();
-        if (oldIconName != newIconName) {
-            debug() << " Icon:" << newIconName;
-            emit parent->iconNameChanged(newIconName);
-            parent->notify("iconName");
+    if (!update.connectionStatusChanged && update.profileChanged) {
+        checkCapabilitiesChanged(update.profileChanged);
+    }
+}
+
+void Account::Private::updateInterfaces(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
+
+    parent->setInterfaces(qdbus_cast<QStringList>(value));
+    debug() << " Interfaces:" << parent->interfaces();
+}
+
+void Account::Private::updateServiceName(const QVariant &value, PropertyUpdate &update)
+{
+    QString newServiceName = qdbus_cast<QString>(value);
+    if (serviceName == newServiceName) {
+        return;
+    }
+
+    update.serviceNameChanged = true;
+    serviceName = newServiceName;
+    debug() << " Service Name:" << parent->serviceName();
+    /* use parent->serviceName() here as if the service name is empty we are going to use the
+     * protocol name */
+    emit parent->serviceNameChanged(parent->serviceName());
+    parent->notify("serviceName");
+
+    /* if we had a profile and the service changed, it means the profile also changed */
+    if (parent->isReady(Account::FeatureProfile)) {
+        /* service name changed, let's recreate profile */
+        update.profileChanged = true;
+        profile.reset();
+        emit parent->profileChanged(parent->profile());
+        parent->notify("profile");
+    }
+}
+
+void Account::Private::updateDisplayName(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
+
+    QString newDisplayName = qdbus_cast<QString>(value);
+    if (displayName == newDisplayName) {
+        return;
+    }
+
+    displayName = newDisplayName;
+    debug() << " Display Name:" << displayName;
+    emit parent->displayNameChanged(displayName);
+    parent->notify("displayName");
+}
+
+void Account::Private::updateIconName(const QVariant &value, PropertyUpdate &update)
+{
+    if (value.isValid()) {
+        QString newIconName = qdbus_cast<QString>(value);
+        if (update.oldIconName == newIconName && !update.serviceNameChanged) {
+            return;
         }
+        iconName = newIconName;
     }
 
-    if (props.contains(QLatin1String("Nickname")) &&
-        nickname != qdbus_cast<QString>(props[QLatin1String("Nickname")])) {
-        nickname = qdbus_cast<QString>(props[QLatin1String("Nickname")]);
-        debug() << " Nickname:" << nickname;
-        emit parent->nicknameChanged(nickname);
-        parent->notify("nickname");
+    QString newIconName = parent->iconName();
+    if (update.oldIconName != newIconName) {
+        debug() << " Icon:" << newIconName;
+        emit parent->iconNameChanged(newIconName);
+        parent->notify("iconName");
     }
+}
+
+void Account::Private::updateNickname(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
 
-    if (props.contains(QLatin1String("NormalizedName")) &&
-        normalizedName != qdbus_cast<QString>(props[QLatin1String("NormalizedName")])) {
-        normalizedName = qdbus_cast<QString>(props[QLatin1String("NormalizedName")]);
-        debug() << " Normalized Name:" << normalizedName;
-        emit parent->normalizedNameChanged(normalizedName);
-        parent->notify("normalizedName");
+    QString newNickname = qdbus_cast<QString>(value);
+    if (nickname == newNickname) {
+        return;
     }
 
-    if (props.contains(QLatin1String("Valid")) &&
-        valid != qdbus_cast<bool>(props[QLatin1String("Valid")])) {
-        valid = qdbus_cast<bool>(props[QLatin1String("Valid")]);
-        debug() << " Valid:" << (valid ? "true" : "false");
-        emit parent->validityChanged(valid);
-        parent->notify("valid");
+    nickname = newNickname;
+    debug() << " Nickname:" << nickname;
+    emit parent->nicknameChanged(nickname);
+    parent->notify("nickname");
+}
+
+void Account::Private::updateNormalizedName(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
+
+    QString newNormalizedName = qdbus_cast<QString>(value);
+    if (normalizedName == newNormalizedName) {
+        return;
     }
 
-    if (props.contains(QLatin1String("Enabled")) &&
-        enabled != qdbus_cast<bool>(props[QLatin1String("Enabled")])) {
-        enabled = qdbus_cast<bool>(props[QLatin1String("Enabled")]);
-        debug() << " Enabled:" << (enabled ? "true" : "false");
-        emit parent->stateChanged(enabled);
-        parent->notify("enabled");
+    normalizedName = newNormalizedName;
+    debug() << " Normalized Name:" << normalizedName;
+    emit parent->normalizedNameChanged(normalizedName);
+    parent->notify("normalizedName");
+}
+
+void Account::Private::updateValid(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
+
+    bool newValid = qdbus_cast<bool>(value);
+    if (valid == newValid) {
+        return;
     }
 
-    if (props.contains(QLatin1String("ConnectAutomatically")) &&
-        connectsAutomatically !=
-                qdbus_cast<bool>(props[QLatin1String("ConnectAutomatically")])) {
-        connectsAutomatically =
-                qdbus_cast<bool>(props[QLatin1String("ConnectAutomatically")]);
-        debug() << " Connects Automatically:" << (connectsAutomatically ? "true" : "false");
-        emit parent->connectsAutomaticallyPropertyChanged(connectsAutomatically);
-        parent->notify("connectsAutomatically");
+    valid = newValid;
+    debug() << " Valid:" << (valid ? "true" : "false");
+    emit parent->validityChanged(valid);
+    parent->notify("valid");
+}
+
+void Account::Private::updateEnabled(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
+
+    bool newEnabled = qdbus_cast<bool>(value);
+    if (enabled == newEnabled) {
+        return;
     }
 
-    if (props.contains(QLatin1String("HasBeenOnline")) &&
-        !hasBeenOnline &&
-        qdbus_cast<bool>(props[QLatin1String("HasBeenOnline")])) {
-        hasBeenOnline = true;
-        debug() << " HasBeenOnline changed to true";
-        // don't emit firstOnline unless we're already ready, that would be
-        // misleading - we'd emit it just before any already-used account
-        // became ready
-        if (parent->isReady(Account::FeatureCore)) {
-            emit parent->firstOnline();
-        }
-        parent->notify("hasBeenOnline");
+    enabled = newEnabled;
+    debug() << " Enabled:" << (enabled ? "true" : "false");
+    emit parent->stateChanged(enabled);
+    parent->notify("enabled");
+}
+
+void Account::Private::updateConnectsAutomatically(const QVariant &value,
+        PropertyUpdate &update)
+{
+    Q_UNUSED(update);
+
+    bool newConnectsAutomatically = qdbus_cast<bool>(value);
+    if (connectsAutomatically == newConnectsAutomatically) {
+        return;
     }
 
-    if (props.contains(QLatin1String("Parameters")) &&
-        parameters != qdbus_cast<QVariantMap>(props[QLatin1String("Parameters")])) {
-        parameters = qdbus_cast<QVariantMap>(props[QLatin1String("Parameters")]);
-        emit parent->parametersChanged(parameters);
-        parent->notify("parameters");
+    connectsAutomatically = newConnectsAutomatically;
+    debug() << " Connects Automatically:" << (connectsAutomatically ? "true" : "false");
+    emit parent->connectsAutomaticallyPropertyChanged(connectsAutomatically);
+    parent->notify("connectsAutomatically");
+}
+
+void Account::Private::updateHasBeenOnline(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
+
+    if (hasBeenOnline || !qdbus_cast<bool>(value)) {
+        return;
     }
 
-    if (props.contains(QLatin1String("AutomaticPresence")) &&
-        automaticPresence.barePresence() != qdbus_cast<SimplePresence>(
-                props[QLatin1String("AutomaticPresence")])) {
-        automaticPresence = Presence(qdbus_cast<SimplePresence>(
-                props[QLatin1String("AutomaticPresence")]));
-        debug() << " Automatic Presence:" << automaticPresence.type() <<
-            "-" << automaticPresence.status();
-        emit parent->automaticPresenceChanged(automaticPresence);
-        parent->notify("automaticPresence");
+    hasBeenOnline = true;
+    debug() << " HasBeenOnline changed to true";
+    // don't emit firstOnline unless we're already ready, that would be
+    // misleading - we'd emit it just before any already-used account
+    // became ready
+    if (parent->isReady(Account::FeatureCore)) {
+        emit parent->firstOnline();
     }
+    parent->notify("hasBeenOnline");
+}
+
+void Account::Private::updateParameters(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
 
-    if (props.contains(QLatin1String("CurrentPresence")) &&
-        currentPresence.barePresence() != qdbus_cast<SimplePresence>(
-                props[QLatin1String("CurrentPresence")])) {
-        currentPresence = Presence(qdbus_cast<SimplePresence>(
-                props[QLatin1String("CurrentPresence")]));
-        debug() << " Current Presence:" << currentPresence.type() <<
-            "-" << currentPresence.status();
-        emit parent->currentPresenceChanged(currentPresence);
-        parent->notify("currentPresence");
-        emit parent->onlinenessChanged(parent->isOnline());
-        parent->notify("online");
+    QVariantMap newParameters = qdbus_cast<QVariantMap>(value);
+    if (parameters == newParameters) {
+        return;
     }
 
-    if (props.contains(QLatin1String("RequestedPresence")) &&
-        requestedPresence.barePresence() != qdbus_cast<SimplePresence>(
-                props[QLatin1String("RequestedPresence")])) {
-        requestedPresence = Presence(qdbus_cast<SimplePresence>(
-                props[QLatin1String("RequestedPresence")]));
-        debug() << " Requested Presence:" << requestedPresence.type() <<
-            "-" << requestedPresence.status();
-        emit parent->requestedPresenceChanged(requestedPresence);
-        parent->notify("requestedPresence");
+    parameters = newParameters;
+    emit parent->parametersChanged(parameters);
+    parent->notify("parameters");
+}
+
+void Account::Private::updateAutomaticPresence(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
+
+    SimplePresence newPresence = qdbus_cast<SimplePresence>(value);
+    if (automaticPresence.barePresence() == newPresence) {
+        return;
     }
 
-    if (props.contains(QLatin1String("ChangingPresence")) &&
-        changingPresence != qdbus_cast<bool>(
-                props[QLatin1String("ChangingPresence")])) {
-        changingPresence = qdbus_cast<bool>(
-                props[QLatin1String("ChangingPresence")]);
-        debug() << " Changing Presence:" << changingPresence;
-        emit parent->changingPresence(changingPresence);
-        parent->notify("changingPresence");
+    automaticPresence = Presence(newPresence);
+    debug() << " Automatic Presence:" << automaticPresence.type() <<
+        "-" << automaticPresence.status();
+    emit parent->automaticPresenceChanged(automaticPresence);
+    parent->notify("automaticPresence");
+}
+
+void Account::Private::updateCurrentPresence(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
+
+    SimplePresence newPresence = qdbus_cast<SimplePresence>(value);
+    if (currentPresence.barePresence() == newPresence) {
+        return;
     }
 
-    if (props.contains(QLatin1String("Connection"))) {
-        QString path = qdbus_cast<QDBusObjectPath>(props[QLatin1String("Connection")]).path();
-        if (path.isEmpty()) {
-            debug() << " The map contains \"Connection\" but it's empty as a QDBusObjectPath!";
-            debug() << " Trying QString (known bug in some MC/dbus-glib versions)";
-            path = qdbus_cast<QString>(props[QLatin1String("Connection")]);
-        }
+    currentPresence = Presence(newPresence);
+    debug() << " Current Presence:" << currentPresence.type() <<
+        "-" << currentPresence.status();
+    emit parent->currentPresenceChanged(currentPresence);
+    parent->notify("currentPresence");
+    emit parent->onlinenessChanged(parent->isOnline());
+    parent->notify("online");
+}
 
-        debug() << " Connection Object Path:" << path;
-        if (path == QLatin1String("/")) {
-            path = QString();
-        }
+void Account::Private::updateRequestedPresence(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
 
-        connObjPathQueue.enqueue(path);
+    SimplePresence newPresence = qdbus_cast<SimplePresence>(value);
+    if (requestedPresence.barePresence() == newPresence) {
+        return;
+    }
 
-        if (connObjPathQueue.size() == 1) {
-            processConnQueue();
-        }
+    requestedPresence = Presence(newPresence);
+    debug() << " Requested Presence:" << requestedPresence.type() <<
+        "-" << requestedPresence.status();
+    emit parent->requestedPresenceChanged(requestedPresence);
+    parent->notify("requestedPresence");
+}
 
-        // onConnectionBuilt for a previous path will make sure the path we enqueued is processed if
-        // the queue wasn't empty (so is now size() > 1)
+void Account::Private::updateChangingPresence(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
+
+    bool newChangingPresence = qdbus_cast<bool>(value);
+    if (changingPresence == newChangingPresence) {
+        return;
     }
 
-    bool connectionStatusChanged = false;
-    if (props.contains(QLatin1String("ConnectionStatus")) ||
-        props.contains(QLatin1String("ConnectionStatusReason")) ||
-        props.contains(QLatin1String("ConnectionError")) ||
-        props.contains(QLatin1String("ConnectionErrorDetails"))) {
-        ConnectionStatus oldConnectionStatus = connectionStatus;
-
-        if (props.contains(QLatin1String("ConnectionStatus")) &&
-            connectionStatus != ConnectionStatus(
-                    qdbus_cast<uint>(props[QLatin1String("ConnectionStatus")]))) {
-            connectionStatus = ConnectionStatus(
-                    qdbus_cast<uint>(props[QLatin1String("ConnectionStatus")]));
-            debug() << " Connection Status:" << connectionStatus;
-            connectionStatusChanged = true;
-        }
+    changingPresence = newChangingPresence;
+    debug() << " Changing Presence:" << changingPresence;
+    emit parent->changingPresence(changingPresence);
+    parent->notify("changingPresence");
+}
 
-        if (props.contains(QLatin1String("ConnectionStatusReason")) &&
-            connectionStatusReason != ConnectionStatusReason(
-                    qdbus_cast<uint>(props[QLatin1String("ConnectionStatusReason")]))) {
-            connectionStatusReason = ConnectionStatusReason(
-                    qdbus_cast<uint>(props[QLatin1String("ConnectionStatusReason")]));
-            debug() << " Connection StatusReason:" << connectionStatusReason;
-            connectionStatusChanged = true;
-        }
+void Account::Private::updateConnection(const QVariant &value, PropertyUpdate &update)
+{
+    Q_UNUSED(update);
 
-        if (connectionStatusChanged) {
-            parent->notify("connectionStatus");
-            parent->notify("connectionStatusReason");
-        }
+    QString path = qdbus_cast<QDBusObjectPath>(value).path();
+    if (path.isEmpty()) {
+        debug() << " The map contains \"Connection\" but it's empty as a QDBusObjectPath!";
+        debug() << " Trying QString (known bug in some MC/dbus-glib versions)";
+        path = qdbus_cast<QString>(value);
+    }
 
-        if (props.contains(QLatin1String("ConnectionError")) &&
-            connectionError != qdbus_cast<QString>(
-                props[QLatin1String("ConnectionError")])) {
-            connectionError = qdbus_cast<QString>(
-                    props[QLatin1String("ConnectionError")]);
-            debug() << " Connection Error:" << connectionError;
-            connectionStatusChanged = true;
-        }
+    debug() << " Connection Object Path:" << path;
+    if (path == QLatin1String("/")) {
+        path = QString();
+    }
 
-        if (props.contains(QLatin1String("ConnectionErrorDetails")) &&
-            connectionErrorDetails.allDetails() != qdbus_cast<QVariantMap>(
-                props[QLatin1String("ConnectionErrorDetails")])) {
-            connectionErrorDetails = Connection::ErrorDetails(qdbus_cast<QVariantMap>(
-                    props[QLatin1String("ConnectionErrorDetails")]));
-            debug() << " Connection Error Details:" << connectionErrorDetails.allDetails();
-            connectionStatusChanged = true;
-        }
+    connObjPathQueue.enqueue(path);
 
-        if (connectionStatusChanged) {
-            /* Something other than status changed, let's not emit connectionStatusChanged
-             * and keep the error/errorDetails, for the next interaction.
-             * It may happen if ConnectionError changes and in another property
-             * change the status changes to Disconnected, so we use the error
-             * previously signalled. If the status changes to something other
-             * than Disconnected later, the error is cleared. */
-            if (oldConnectionStatus != connectionStatus) {
-                /* We don't signal error for status other than Disconnected */
-                if (connectionStatus != ConnectionStatusDisconnected) {
-                    connectionError = QString();
-                    connectionErrorDetails = Connection::ErrorDetails();
-                } else if (connectionError.isEmpty()) {
-                    connectionError = ConnectionHelper::statusReasonToErrorName(
-                            connectionStatusReason, oldConnectionStatus);
-                }
+    if (connObjPathQueue.size() == 1) {
+        processConnQueue();
+    }
 
-                checkCapabilitiesChanged(profileChanged);
+    // onConnectionBuilt for a previous path will make sure the path we enqueued is processed if
+    // the queue wasn't empty (so is now size() > 1)
+}
 
-                emit parent->connectionStatusChanged(connectionStatus);
-                parent->notify("connectionError");
-                parent->notify("connectionErrorDetails");
-            } else {
-                connectionStatusChanged = false;
-            }
-        }
+void Account::Private::updateConnectionStatus(const QVariant &value, PropertyUpdate &update)
+{
+    ConnectionStatus newConnectionStatus = ConnectionStatus(qdbus_cast<uint>(value));
+    if (connectionStatus == newConnectionStatus) {
+        return;
     }
 
-    if (!connectionStatusChanged && profileChanged) {
-        checkCapabilitiesChanged(profileChanged);
+    connectionStatus = newConnectionStatus;
+    debug() << " Connection Status:" << connectionStatus;
+    update.connectionStatusOrReasonChanged = true;
+    update.connectionStatusChanged = true;
+}
+
+void Account::Private::updateConnectionStatusReason(const QVariant &value,
+        PropertyUpdate &update)
+{
+    ConnectionStatusReason newConnectionStatusReason =
+        ConnectionStatusReason(qdbus_cast<uint>(value));
+    if (connectionStatusReason == newConnectionStatusReason) {
+        return;
     }
+
+    connectionStatusReason = newConnectionStatusReason;
+    debug() << " Connection StatusReason:" << connectionStatusReason;
+    update.connectionStatusOrReasonChanged = true;
+    update.connectionStatusChanged = true;
+}
+
+void Account::Private::updateConnectionError(const QVariant &value, PropertyUpdate &update)
+{
+    QString newConnectionError = qdbus_cast<QString>(value);
+    if (connectionError == newConnectionError) {
+        return;
+    }
+
+    connectionError = newConnectionError;
+    debug() << " Connection Error:" << connectionError;
+    update.connectionStatusChanged = true;
+}
+
+void Account::Private::updateConnectionErrorDetails(const QVariant &value,
+        PropertyUpdate &update)
+{
+    QVariantMap newConnectionErrorDetails = qdbus_cast<QVariantMap>(value);
+    if (connectionErrorDetails.allDetails() == newConnectionErrorDetails) {
+        return;
+    }
+
+    connectionErrorDetails = Connection::ErrorDetails(newConnectionErrorDetails);
+    debug() << " Connection Error Details:" << connectionErrorDetails.allDetails();
+    update.connectionStatusChanged = true;
 }
 
 void Account::Private::retrieveAvatar()
@@ -29,10 +29,15 @@
 #include "TelepathyQt/debug-internal.h"
 
 #include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/BaseHandleRepository>
 #include <TelepathyQt/DBusObject>
 #include <TelepathyQt/Utils>
 #include <TelepathyQt/AbstractProtocolInterface>
+#include <QHash>
+#include <QPointer>
+#include <QSet>
 #include <QString>
+#include <QTimer>
 #include <QVariantMap>
 
 namespace Tp
@@ -48,16 +53,68 @@ struct TP_QT_NO_EXPORT BaseConnection::Private {
           parameters(parameters),
           selfHandle(0),
           status(Tp::ConnectionStatusDisconnected),
+          exactTargetMatching(false),
           adaptee(new BaseConnection::Adaptee(dbusConnection, connection))
     {
     }
 
+    struct ChannelTarget
+    {
+        ChannelTarget(const QString &channelType, uint handleType, uint handle,
+                const QString &id = QString())
+            : channelType(channelType),
+              handleType(handleType),
+              handle(handle),
+              id(id)
+        {
+        }
+
+        bool operator==(const ChannelTarget &other) const
+        {
+            return handleType == other.handleType && handle == other.handle &&
+                channelType == other.channelType && id == other.id;
+        }
+
+        friend uint qHash(const ChannelTarget &target)
+        {
+            return qHash(target.channelType) ^ (target.handleType << 24) ^
+                target.handle ^ qHash(target.id);
+        }
+
+        QString channelType;
+        uint handleType;
+        uint handle;
+        QString id;
+    };
+
+    void indexChannel(const BaseChannelPtr &channel);
+    void unindexChannel(const BaseChannelPtr &channel);
+    QList<BaseChannelPtr> candidateChannels(const QString &channelType,
+            const QVariantMap &request) const;
+    void appendToChannelList(const BaseChannelPtr &channel);
+    void removeFromChannelList(const BaseChannelPtr &channel);
+
+    static const QString keyChannelType;
+    static const QString keyTargetHandleType;
+    static const QString keyTargetHandle;
+    static const QString keyTargetID;
+
     BaseConnection *connection;
     QString cmName;
     QString protocolName;
     QVariantMap parameters;
     QHash<QString, AbstractConnectionInterfacePtr> interfaces;
     QSet<BaseChannelPtr> channels;
+    // Indexes for ensureChannel(), keyed by channel type and target handle or target ID
+    QMultiHash<QString, BaseChannelPtr> channelsByType;
+    QMultiHash<ChannelTarget, BaseChannelPtr> channelsByTargetHandle;
+    QMultiHash<ChannelTarget, BaseChannelPtr> channelsByTargetID;
+    bool exactTargetMatching;
+    // The channels in the order of the Channels properties, whose details are read when the
+    // properties are, as they may change after the channel is added. channelListPositions maps
+    // channels to their entry.
+    QList<BaseChannel *> channelList;
+    QHash<BaseChannel *, int> channelListPositions;
     uint selfHandle;
     QString selfID;
     uint status;
@@ -65,9 +122,93 @@ struct TP_QT_NO_EXPORT BaseConnection::Private {
     ConnectCallback connectCB;
     InspectHandlesCallback inspectHandlesCB;
     RequestHandlesCallback requestHandlesCB;
+    QHash<uint, BaseHandleRepository *> handleRepositories;
     BaseConnection::Adaptee *adaptee;
 };
 
+const QString BaseConnection::Private::keyChannelType(
+        TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"));
+const QString BaseConnection::Private::keyTargetHandleType(
+        TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"));
+const QString BaseConnection::Private::keyTargetHandle(
+        TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"));
+const QString BaseConnection::Private::keyTargetID(
+        TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"));
+
+void BaseConnection::Private::indexChannel(const BaseChannelPtr &channel)
+{
+    channelsByType.insert(channel->channelType(), channel);
+    channelsByTargetHandle.insert(ChannelTarget(channel->channelType(),
+                channel->targetHandleType(), channel->targetHandle()), channel);
+    if (!channel->targetID().isEmpty()) {
+        channelsByTargetID.insert(ChannelTarget(channel->channelType(),
+                    channel->targetHandleType(), 0, channel->targetID()), channel);
+    }
+}
+
+void BaseConnection::Private::unindexChannel(const BaseChannelPtr &channel)
+{
+    channelsByType.remove(channel->channelType(), channel);
+    channelsByTargetHandle.remove(ChannelTarget(channel->channelType(),
+                channel->targetHandleType(), channel->targetHandle()), channel);
+    if (!channel->targetID().isEmpty()) {
+        channelsByTargetID.remove(ChannelTarget(channel->channelType(),
+                    channel->targetHandleType(), 0, channel->targetID()), channel);
+    }
+}
+
+QList<BaseChannelPtr> BaseConnection::Private::candidateChannels(const QString &channelType,
+        const QVariantMap &request) const
+{
+    // A subclass might match targets more loosely than by equality (e.g. normalizing IDs), in
+    // which case matchChannel() needs to see every channel of the requested type
+    if (!exactTargetMatching) {
+        return channelsByType.values(channelType);
+    }
+
+    QVariantMap::const_iterator handleTypeIt = request.constFind(keyTargetHandleType);
+    if (handleTypeIt == request.constEnd()) {
+        return channelsByType.values(channelType);
+    }
+
+    uint targetHandleType = handleTypeIt.value().toUInt();
+
+    QVariantMap::const_iterator targetIt = request.constFind(keyTargetHandle);
+    if (targetIt != request.constEnd()) {
+        return channelsByTargetHandle.values(
+                ChannelTarget(channelType, targetHandleType, targetIt.value().toUInt()));
+    }
+
+    targetIt = request.constFind(keyTargetID);
+    if (targetIt != request.constEnd()) {
+        return channelsByTargetID.values(
+                ChannelTarget(channelType, targetHandleType, 0, targetIt.value().toString()));
+    }
+
+    return channelsByType.values(channelType);
+}
+
+void BaseConnection::Private::appendToChannelList(const BaseChannelPtr &channel)
+{
+    channelListPositions.insert(channel.data(), channelList.size());
+    channelList << channel.data();
+}
+
+void BaseConnection::Private::removeFromChannelList(const BaseChannelPtr &channel)
+{
+    int position = channelListPositions.take(channel.data());
+    int last = channelList.size() - 1;
+
+    // The Channels properties are unordered, so fill the hole with the last entry rather than
+    // shifting everything after it
+    if (position != last) {
+        channelList[position] = channelList.at(last);
+        channelListPositions.insert(channelList.at(position), position);
+    }
+
+    channelList.removeLast();
+}
+
 BaseConnection::Adaptee::Adaptee(const QDBusConnection &dbusConnection,
                                  BaseConnection *connection)
     : QObject(connection),
@@ -255,6 +396,7 @@ BaseConnection::~BaseConnection()
         channel->close();
     }
 
+    qDeleteAll(mPriv->handleRepositories);
     delete mPriv;
 }
 
@@ -444,8 +586,14 @@ void BaseConnection::setInspectHandlesCallback(const InspectHandlesCallback &cb)
 QStringList BaseConnection::inspectHandles(uint handleType, const Tp::UIntList &handles, DBusError *error)
 {
     if (!mPriv->inspectHandlesCB.isValid()) {
-        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Not implemented"));
-        return QStringList();
+        // Handles made up by the callback of one of the pair would mean nothing to the repository
+        BaseHandleRepository *repository = mPriv->requestHandlesCB.isValid() ?
+            0 : handleRepository(handleType);
+        if (!repository) {
+            error->set(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Not implemented"));
+            return QStringList();
+        }
+        return repository->identifiers(handles, error);
     }
     return mPriv->inspectHandlesCB(handleType, handles, error);
 }
@@ -458,23 +606,55 @@ void BaseConnection::setRequestHandlesCallback(const RequestHandlesCallback &cb)
 Tp::UIntList BaseConnection::requestHandles(uint handleType, const QStringList &identifiers, DBusError *error)
 {
     if (!mPriv->requestHandlesCB.isValid()) {
-        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Not implemented"));
-        return Tp::UIntList();
+        BaseHandleRepository *repository = mPriv->inspectHandlesCB.isValid() ?
+            0 : handleRepository(handleType);
+        if (!repository) {
+            error->set(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Not implemented"));
+            return Tp::UIntList();
+        }
+        return repository->ensureHandles(identifiers, error);
     }
     return mPriv->requestHandlesCB(handleType, identifiers, error);
 }
 
+/**
+ * Return the built-in repository for handles of the given type.
+ *
+ * The repository is created the first time it is requested. It is used by
+ * requestHandles() and inspectHandles() when neither setRequestHandlesCallback() nor
+ * setInspectHandlesCallback() was called, as the handles given out by one have to be
+ * understood by the other. The contact identifiers of the contacts in the repository are
+ * also filled in for the attributes returned by BaseConnectionContactsInterface.
+ *
+ * \param handleType The handle type, as a member of #HandleType.
+ * \return A pointer to the repository, or a null pointer if \a handleType is
+ *         HandleTypeNone or not a valid handle type.
+ */
+BaseHandleRepository *BaseConnection::handleRepository(uint handleType) const
+{
+    if (handleType == HandleTypeNone || handleType >= NUM_HANDLE_TYPES) {
+        return 0;
+    }
+
+    BaseHandleRepository *repository = mPriv->handleRepositories.value(handleType);
+    if (!repository) {
+        repository = new BaseHandleRepository(handleType);
+        mPriv->handleRepositories.insert(handleType, repository);
+    }
+    return repository;
+}
+
 Tp::ChannelInfoList BaseConnection::channelsInfo()
 {
-    debug() << "BaseConnection::channelsInfo:";
+    debug() << "BaseConnection::channelsInfo:" << mPriv->channelList.size() << "channels";
     Tp::ChannelInfoList list;
-    foreach(const BaseChannelPtr & c, mPriv->channels) {
+    list.reserve(mPriv->channelList.size());
+    foreach (BaseChannel *channel, mPriv->channelList) {
         Tp::ChannelInfo info;
-        info.channel = QDBusObjectPath(c->objectPath());
-        info.channelType = c->channelType();
-        info.handle = c->targetHandle();
-        info.handleType = c->targetHandleType();
-        debug() << "BaseConnection::channelsInfo " << info.channel.path();
+        info.channel = QDBusObjectPath(channel->objectPath());
+        info.channelType = channel->channelType();
+        info.handle = channel->targetHandle();
+        info.handleType = channel->targetHandleType();
         list << info;
     }
     return list;
@@ -483,8 +663,10 @@ Tp::ChannelInfoList BaseConnection::channelsInfo()
 Tp::ChannelDetailsList BaseConnection::channelsDetails()
 {
     Tp::ChannelDetailsList list;
-    foreach(const BaseChannelPtr & c, mPriv->channels)
-    list << c->details();
+    list.reserve(mPriv->channelList.size());
+    foreach (BaseChannel *channel, mPriv->channelList) {
+        list << channel->details();
+    }
     return list;
 }
 
@@ -496,6 +678,9 @@ Tp::ChannelDetailsList BaseConnection::channelsDetails()
  * This method iterate over exist channels to find the one satisfying the \a request. If there is no
  * suitable channel, then new channel with given request details will be created.
  * This method uses the matchChannel() method to check whether there exists a channel which confirms with the \a request.
+ * Only the channels of the requested type are checked. If exact target matching was enabled
+ * with setExactTargetMatchingEnabled() and the \a request specifies a TargetHandleType and a
+ * TargetHandle or TargetID, only the channels with that target are checked.
  *
  * If \a error is passed, any error that may occur will be stored there.
  *
@@ -508,18 +693,15 @@ Tp::ChannelDetailsList BaseConnection::channelsDetails()
  */
 Tp::BaseChannelPtr BaseConnection::ensureChannel(const QVariantMap &request, bool &yours, bool suppressHandler, DBusError *error)
 {
-    if (!request.contains(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"))) {
+    QVariantMap::const_iterator channelTypeIt = request.constFind(Private::keyChannelType);
+    if (channelTypeIt == request.constEnd()) {
         error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("Missing parameters"));
         return Tp::BaseChannelPtr();
     }
 
-    const QString channelType = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")).toString();
-
-    foreach(const BaseChannelPtr &channel, mPriv->channels) {
-        if (channel->channelType() != channelType) {
-            continue;
-        }
+    const QString channelType = channelTypeIt.value().toString();
 
+    foreach(const BaseChannelPtr &channel, mPriv->candidateChannels(channelType, request)) {
         bool match = matchChannel(channel, request, error);
 
         if (error->isValid()) {
@@ -544,6 +726,9 @@ void BaseConnection::addChannel(BaseChannelPtr channel, bool suppressHandler)
     }
 
     mPriv->channels.insert(channel);
+    mPriv->indexChannel(channel);
+
+    mPriv->appendToChannelList(channel);
 
     BaseConnectionRequestsInterfacePtr reqIface =
         BaseConnectionRequestsInterfacePtr::dynamicCast(interface(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS));
@@ -584,6 +769,41 @@ void BaseConnection::removeChannel()
     }
 
     mPriv->channels.remove(channel);
+    mPriv->unindexChannel(channel);
+    mPriv->removeFromChannelList(channel);
+}
+
+/**
+ * Return whether matchChannel() is only ever given the channels whose target is the requested
+ * one.
+ *
+ * \return \c true if exact target matching is enabled, \c false otherwise.
+ * \sa setExactTargetMatchingEnabled()
+ */
+bool BaseConnection::isExactTargetMatchingEnabled() const
+{
+    return mPriv->exactTargetMatching;
+}
+
+/**
+ * Set whether matchChannel() is only ever given the channels whose target is the requested
+ * one.
+ *
+ * When enabled, ensureChannel() looks up existing channels by their target, and only offers
+ * matchChannel() the channels with exactly the TargetHandle or TargetID in the request, instead
+ * of every channel of the requested type. This makes ensureChannel() independent of the number
+ * of channels, but must only be enabled if matchChannel() never matches a channel with a
+ * different target, which is the case for the default implementation.
+ *
+ * Exact target matching is disabled by default, as a subclass may reimplement matchChannel()
+ * to match targets more loosely, for instance by normalizing IDs.
+ *
+ * \param enabled Whether to enable exact target matching.
+ * \sa isExactTargetMatchingEnabled(), matchChannel()
+ */
+void BaseConnection::setExactTargetMatchingEnabled(bool enabled)
+{
+    mPriv->exactTargetMatching = enabled;
 }
 
 /**
@@ -649,6 +869,13 @@ bool BaseConnection::plugInterface(const AbstractConnectionInterfacePtr &interfa
 
     debug() << "Interface" << interface->interfaceName() << "plugged";
     mPriv->interfaces.insert(interface->interfaceName(), interface);
+
+    BaseConnectionSimplePresenceInterfacePtr presenceIface =
+        BaseConnectionSimplePresenceInterfacePtr::dynamicCast(interface);
+    if (presenceIface) {
+        // So that presence changes can be reflected in the contact attribute cache
+        presenceIface->setBaseConnection(this);
+    }
     return true;
 }
 
@@ -730,7 +957,10 @@ bool BaseConnection::registerObject(const QString &busName,
  * Check \a channel on conformity with \a request.
  *
  * This virtual method is used to check if a \a channel satisfying the given request.
- * It is warranted, that the type of the channel meets the requested type.
+ * It is warranted, that the type of the channel meets the requested type. If exact target
+ * matching was enabled with setExactTargetMatchingEnabled(), it is also warranted that its
+ * target meets the requested TargetHandleType and TargetHandle or TargetID if the request
+ * has them.
  *
  * The default implementation compares TargetHandleType and TargetHandle/TargetID.
  * If \a error is passed, any error that may occur will be stored there.
@@ -936,17 +1166,31 @@ void BaseConnectionRequestsInterface::createChannel(const QVariantMap &request,
 // The BaseConnectionContactsInterface code is fully or partially generated by the TelepathyQt-Generator.
 struct TP_QT_NO_EXPORT BaseConnectionContactsInterface::Private {
     Private(BaseConnectionContactsInterface *parent, BaseConnection *connection)
-        : connection(connection),
+        : cacheEnabled(false),
+          connection(connection),
           adaptee(new BaseConnectionContactsInterface::Adaptee(parent))
     {
     }
 
+    Tp::ContactAttributesMap fetchContactAttributes(const Tp::UIntList &handles,
+            const QStringList &interfaces, DBusError *error);
+
+    typedef QHash<uint, QHash<QString, QVariantMap> > ContactAttributeCache;
+
     QStringList contactAttributeInterfaces;
     GetContactAttributesCallback getContactAttributesCB;
+    bool cacheEnabled;
+    // Cached attributes, per contact and per interface
+    ContactAttributeCache cache;
     BaseConnection *connection;
     BaseConnectionContactsInterface::Adaptee *adaptee;
+
+    static const QString keyContactId;
 };
 
+const QString BaseConnectionContactsInterface::Private::keyContactId(
+        TP_QT_IFACE_CONNECTION + QLatin1String("/contact-id"));
+
 BaseConnectionContactsInterface::Adaptee::Adaptee(BaseConnectionContactsInterface *interface)
     : QObject(interface),
       mInterface(interface)
@@ -1052,13 +1296,214 @@ void BaseConnectionContactsInterface::setGetContactAttributesCallback(const GetC
     mPriv->getContactAttributesCB = cb;
 }
 
-Tp::ContactAttributesMap BaseConnectionContactsInterface::getContactAttributes(const Tp::UIntList &handles, const QStringList &interfaces, DBusError *error)
+Tp::ContactAttributesMap BaseConnectionContactsInterface::Private::fetchContactAttributes(
+        const Tp::UIntList &handles, const QStringList &interfaces, DBusError *error)
 {
-    if (!mPriv->getContactAttributesCB.isValid()) {
+    if (!getContactAttributesCB.isValid()) {
         error->set(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Not implemented"));
         return Tp::ContactAttributesMap();
     }
-    return mPriv->getContactAttributesCB(handles, interfaces, error);
+
+    // The mandatory contact-id attribute is filled in for the contacts known to the built-in
+    // handle repository, if the connection uses it
+    BaseHandleRepository *repository = connection->handleRepository(HandleTypeContact);
+    Tp::ContactAttributesMap attributes = getContactAttributesCB(handles, interfaces, error);
+    if (error->isValid() || repository->count() == 0) {
+        return attributes;
+    }
+
+    for (Tp::ContactAttributesMap::iterator i = attributes.begin(); i != attributes.end(); ++i) {
+        if (!i.value().contains(keyContactId) && repository->isValid(i.key())) {
+            i.value().insert(keyContactId, repository->identifier(i.key()));
+        }
+    }
+    return attributes;
+}
+
+/**
+ * Return the attributes of the contacts with the given \a handles for the given \a interfaces.
+ *
+ * The attributes are obtained from the callback set with setGetContactAttributesCallback().
+ * If the contact attribute cache is enabled, the attributes already cached are used instead
+ * and the callback is only called for the contacts and interfaces missing from the cache,
+ * with the result being added to the cache.
+ *
+ * \param handles The contact handles.
+ * \param interfaces The interfaces the attributes are requested for.
+ * \param error A pointer to an empty DBusError where any possible error will be stored.
+ * \return The attributes of the contacts, keyed by handle.
+ * \sa setContactAttributeCacheEnabled()
+ */
+Tp::ContactAttributesMap BaseConnectionContactsInterface::getContactAttributes(const Tp::UIntList &handles, const QStringList &interfaces, DBusError *error)
+{
+    if (!mPriv->cacheEnabled) {
+        return mPriv->fetchContactAttributes(handles, interfaces, error);
+    }
+
+    // The contact-id attribute is always included
+    QStringList requestedInterfaces = interfaces;
+    if (!requestedInterfaces.contains(TP_QT_IFACE_CONNECTION)) {
+        requestedInterfaces.append(TP_QT_IFACE_CONNECTION);
+    }
+
+    // Contacts missing the same interfaces are fetched together, so that the callback is only
+    // asked for the attributes which are not cached yet
+    QList<QStringList> missingInterfaces;
+    QList<Tp::UIntList> missingHandles;
+    QSet<uint> seen;
+    foreach (uint handle, handles) {
+        if (seen.contains(handle)) {
+            continue;
+        }
+        seen.insert(handle);
+
+        Private::ContactAttributeCache::const_iterator cached = mPriv->cache.constFind(handle);
+        QStringList missing;
+        foreach (const QString &interface, requestedInterfaces) {
+            if (cached == mPriv->cache.constEnd() || !cached.value().contains(interface)) {
+                missing.append(interface);
+            }
+        }
+        if (missing.isEmpty()) {
+            continue;
+        }
+
+        int group = missingInterfaces.indexOf(missing);
+        if (group < 0) {
+            missingInterfaces.append(missing);
+            missingHandles.append(Tp::UIntList());
+            group = missingInterfaces.size() - 1;
+        }
+        missingHandles[group].append(handle);
+    }
+
+    for (int group = 0; group < missingInterfaces.size(); ++group) {
+        QStringList fetchedInterfaces = missingInterfaces.at(group);
+        fetchedInterfaces.removeAll(TP_QT_IFACE_CONNECTION);
+        Tp::ContactAttributesMap fetched = mPriv->fetchContactAttributes(
+                missingHandles.at(group), fetchedInterfaces, error);
+        if (error->isValid()) {
+            return Tp::ContactAttributesMap();
+        }
+
+        for (Tp::ContactAttributesMap::const_iterator i = fetched.constBegin();
+                i != fetched.constEnd(); ++i) {
+            QHash<QString, QVariantMap> &entry = mPriv->cache[i.key()];
+            // Interfaces without any attribute for this contact are cached as such too
+            foreach (const QString &interface, missingInterfaces.at(group)) {
+                entry.insert(interface, QVariantMap());
+            }
+            for (QVariantMap::const_iterator j = i.value().constBegin();
+                    j != i.value().constEnd(); ++j) {
+                entry[j.key().section(QLatin1Char('/'), 0, 0)].insert(j.key(), j.value());
+            }
+        }
+    }
+
+    Tp::ContactAttributesMap attributes;
+    foreach (uint handle, handles) {
+        Private::ContactAttributeCache::const_iterator cached = mPriv->cache.constFind(handle);
+        if (cached == mPriv->cache.constEnd()) {
+            // Invalid handle, omitted from the reply as the callback did
+            continue;
+        }
+
+        QVariantMap &contactAttributes = attributes[handle];
+        foreach (const QString &interface, requestedInterfaces) {
+            contactAttributes.unite(cached.value().value(interface));
+        }
+    }
+    return attributes;
+}
+
+/**
+ * Return whether the contact attributes returned by getContactAttributes() are cached.
+ *
+ * \return \c true if the cache is enabled, \c false otherwise.
+ * \sa setContactAttributeCacheEnabled()
+ */
+bool BaseConnectionContactsInterface::isContactAttributeCacheEnabled() const
+{
+    return mPriv->cacheEnabled;
+}
+
+/**
+ * Set whether the contact attributes returned by getContactAttributes() are cached, per
+ * contact and per interface.
+ *
+ * When enabled, the callback set with setGetContactAttributesCallback() is only called for
+ * the contacts and interfaces which are not cached yet. The connection manager is then
+ * responsible for keeping the cache up to date, using updateCachedContactAttributes() or
+ * invalidateCachedContactAttributes() whenever e.g. a contact's alias or avatar changes.
+ * Presences set with BaseConnectionSimplePresenceInterface::setPresences() on an interface
+ * plugged into the same connection are reflected in the cache automatically.
+ *
+ * The cache is disabled by default. Disabling it clears it.
+ *
+ * \param enabled Whether to cache the contact attributes.
+ */
+void BaseConnectionContactsInterface::setContactAttributeCacheEnabled(bool enabled)
+{
+    mPriv->cacheEnabled = enabled;
+    if (!enabled) {
+        mPriv->cache.clear();
+    }
+}
+
+/**
+ * Replace the cached attributes of the contact with the given \a handle for the given
+ * \a interface.
+ *
+ * This has no effect if the cache is disabled.
+ *
+ * \param handle The contact handle.
+ * \param interface The interface the attributes belong to.
+ * \param attributes The attributes, with their fully qualified name as key,
+ *                   e.g. "org.freedesktop.Telepathy.Connection.Interface.Aliasing/alias".
+ * \sa invalidateCachedContactAttributes()
+ */
+void BaseConnectionContactsInterface::updateCachedContactAttributes(uint handle,
+        const QString &interface, const QVariantMap &attributes)
+{
+    if (!mPriv->cacheEnabled) {
+        return;
+    }
+
+    mPriv->cache[handle].insert(interface, attributes);
+}
+
+/**
+ * Remove the cached attributes of the contacts with the given \a handles for the given
+ * \a interface, or for all interfaces if \a interface is empty.
+ *
+ * They will be obtained from the callback the next time they are requested.
+ *
+ * \param handles The contact handles.
+ * \param interface The interface the attributes belong to, or an empty string.
+ * \sa updateCachedContactAttributes()
+ */
+void BaseConnectionContactsInterface::invalidateCachedContactAttributes(
+        const Tp::UIntList &handles, const QString &interface)
+{
+    foreach (uint handle, handles) {
+        if (interface.isEmpty()) {
+            mPriv->cache.remove(handle);
+            continue;
+        }
+
+        Private::ContactAttributeCache::iterator cached = mPriv->cache.find(handle);
+        if (cached != mPriv->cache.end()) {
+            cached.value().remove(interface);
+        }
+    }
+}
+
+/**
+ * Remove all the cached contact attributes.
+ */
+void BaseConnectionContactsInterface::clearContactAttributeCache()
+{
+    mPriv->cache.clear();
 }
 
 void BaseConnectionContactsInterface::getContactByID(const QString &identifier, const QStringList &interfaces, uint &handle, QVariantMap &attributes, DBusError *error)
@@ -1092,17 +1537,66 @@ BaseConnectionSimplePresenceInterface::Adaptee::~Adaptee()
 
 struct TP_QT_NO_EXPORT BaseConnectionSimplePresenceInterface::Private {
     Private(BaseConnectionSimplePresenceInterface *parent)
-        : maximumStatusMessageLength(0),
+        : connection(0),
+          maximumStatusMessageLength(0),
+          coalescingTimer(0),
+          maximumBatchSize(0),
+          emittedUpdates(0),
+          suppressedUpdates(0),
           adaptee(new BaseConnectionSimplePresenceInterface::Adaptee(parent)) {
     }
+
+    void emitPresencesChanged(const SimpleContactPresences &presences);
+    void updateContactAttributeCache(const SimpleContactPresences &presences);
+
+    QPointer<BaseConnection> connection;
     SetPresenceCallback setPresenceCB;
     SimpleStatusSpecMap statuses;
     uint maximumStatusMessageLength;
     /* The current presences */
     SimpleContactPresences presences;
+    /* Changes not signalled yet while coalescing, and the presences signalled before them */
+    SimpleContactPresences pendingPresences;
+    SimpleContactPresences presencesBeforePending;
+    QTimer *coalescingTimer;
+    int maximumBatchSize;
+    quint64 emittedUpdates;
+    quint64 suppressedUpdates;
     BaseConnectionSimplePresenceInterface::Adaptee *adaptee;
 };
 
+void BaseConnectionSimplePresenceInterface::Private::emitPresencesChanged(
+        const SimpleContactPresences &changed)
+{
+    emittedUpdates += changed.size();
+    QMetaObject::invokeMethod(adaptee, "presencesChanged", Q_ARG(Tp::SimpleContactPresences, changed)); //Can simply use emit in Qt5
+}
+
+void BaseConnectionSimplePresenceInterface::Private::updateContactAttributeCache(
+        const SimpleContactPresences &changed)
+{
+    if (!connection) {
+        return;
+    }
+
+    BaseConnectionContactsInterfacePtr contactsIface =
+        BaseConnectionContactsInterfacePtr::dynamicCast(
+                connection->interface(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS));
+    if (!contactsIface || !contactsIface->isContactAttributeCacheEnabled()) {
+        return;
+    }
+
+    static const QString keyPresence(TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE +
+            QLatin1String("/presence"));
+    for (SimpleContactPresences::const_iterator i = changed.constBegin();
+            i != changed.constEnd(); ++i) {
+        QVariantMap attributes;
+        attributes.insert(keyPresence, QVariant::fromValue(i.value()));
+        contactsIface->updateCachedContactAttributes(i.key(),
+                TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE, attributes);
+    }
+}
+
 /**
  * \class BaseConnectionSimplePresenceInterface
  * \ingroup servicecm
@@ -1151,12 +1645,200 @@ void BaseConnectionSimplePresenceInterface::createAdaptor()
 
 
 
+/**
+ * Update the presences of the given contacts and signal the ones which changed.
+ *
+ * Presences identical to the current ones are ignored. If a coalescing interval is set with
+ * setPresenceCoalescingInterval(), the changes are accumulated per contact and signalled
+ * together once the interval expires or maximumPresenceBatchSize() contacts have changed,
+ * whichever comes first. getPresences() always returns the latest presences, and so does
+ * the contact attribute cache of the connection's BaseConnectionContactsInterface, if enabled.
+ *
+ * \param presences The new presences of the contacts, keyed by handle.
+ * \sa flushPresences()
+ */
 void BaseConnectionSimplePresenceInterface::setPresences(const Tp::SimpleContactPresences &presences)
 {
-    foreach(uint handle, presences.keys()) {
-        mPriv->presences[handle] = presences[handle];
+    bool coalescing = mPriv->coalescingTimer != 0;
+    SimpleContactPresences changed;
+    SimpleContactPresences updated;
+
+    for (SimpleContactPresences::const_iterator i = presences.constBegin();
+            i != presences.constEnd(); ++i) {
+        uint handle = i.key();
+        SimpleContactPresences::iterator current = mPriv->presences.find(handle);
+        if (current != mPriv->presences.end() && current.value() == i.value()) {
+            mPriv->suppressedUpdates++;
+            continue;
+        }
+
+        if (!coalescing) {
+            changed.insert(handle, i.value());
+        } else if (mPriv->pendingPresences.contains(handle)) {
+            // The pending change is superseded by this one, or even reverted, so it will never
+            // be signalled. A revert isn't signalled either, but it only cancels the pending
+            // change rather than being a change of its own.
+            mPriv->suppressedUpdates++;
+            SimpleContactPresences::const_iterator before =
+                mPriv->presencesBeforePending.constFind(handle);
+            if (before != mPriv->presencesBeforePending.constEnd() &&
+                    before.value() == i.value()) {
+                mPriv->pendingPresences.remove(handle);
+                mPriv->presencesBeforePending.remove(handle);
+            } else {
+                mPriv->pendingPresences.insert(handle, i.value());
+            }
+        } else {
+            if (current != mPriv->presences.end()) {
+                mPriv->presencesBeforePending.insert(handle, current.value());
+            }
+            mPriv->pendingPresences.insert(handle, i.value());
+        }
+
+        mPriv->presences.insert(handle, i.value());
+        updated.insert(handle, i.value());
+    }
+
+    // getPresences() and GetContactAttributes need to agree, even while coalescing
+    mPriv->updateContactAttributeCache(updated);
+
+    if (!changed.isEmpty()) {
+        mPriv->emitPresencesChanged(changed);
+    }
+
+    if (!coalescing || mPriv->pendingPresences.isEmpty()) {
+        return;
+    }
+
+    if (mPriv->maximumBatchSize > 0 &&
+            mPriv->pendingPresences.size() >= mPriv->maximumBatchSize) {
+        flushPresences();
+    } else if (!mPriv->coalescingTimer->isActive()) {
+        mPriv->coalescingTimer->start();
     }
-    QMetaObject::invokeMethod(mPriv->adaptee, "presencesChanged", Q_ARG(Tp::SimpleContactPresences, presences)); //Can simply use emit in Qt5
+}
+
+/**
+ * Return the interval during which presence changes are accumulated before being signalled.
+ *
+ * \return The interval in milliseconds, or 0 if changes are signalled immediately.
+ * \sa setPresenceCoalescingInterval()
+ */
+int BaseConnectionSimplePresenceInterface::presenceCoalescingInterval() const
+{
+    return mPriv->coalescingTimer ? mPriv->coalescingTimer->interval() : 0;
+}
+
+/**
+ * Set the interval during which presence changes passed to setPresences() are accumulated
+ * before being signalled with a single PresencesChanged.
+ *
+ * Only the latest presence of each contact is signalled, and changes which are reverted
+ * within the interval are not signalled at all. This is useful when the protocol reports
+ * the presences of the contacts one by one, e.g. right after connecting.
+ *
+ * The default is 0, meaning that changes are signalled immediately. Setting 0 signals any
+ * change still pending.
+ *
+ * \param msecs The interval in milliseconds.
+ * \sa setMaximumPresenceBatchSize()
+ */
+void BaseConnectionSimplePresenceInterface::setPresenceCoalescingInterval(int msecs)
+{
+    if (msecs <= 0) {
+        flushPresences();
+        delete mPriv->coalescingTimer;
+        mPriv->coalescingTimer = 0;
+        return;
+    }
+
+    if (!mPriv->coalescingTimer) {
+        mPriv->coalescingTimer = new QTimer(this);
+        mPriv->coalescingTimer->setSingleShot(true);
+        connect(mPriv->coalescingTimer, SIGNAL(timeout()), SLOT(onPresenceCoalescingTimeout()));
+    }
+    mPriv->coalescingTimer->setInterval(msecs);
+}
+
+/**
+ * Return the maximum number of contacts whose presence changes are accumulated before
+ * being signalled.
+ *
+ * \return The maximum batch size, or 0 if it is unlimited.
+ * \sa setMaximumPresenceBatchSize()
+ */
+int BaseConnectionSimplePresenceInterface::maximumPresenceBatchSize() const
+{
+    return mPriv->maximumBatchSize;
+}
+
+/**
+ * Set the maximum number of contacts whose presence changes are accumulated while
+ * coalescing. Once this many contacts have changed, the changes are signalled without
+ * waiting for presenceCoalescingInterval() to expire.
+ *
+ * The default is 0, meaning that there is no limit.
+ *
+ * \param size The maximum batch size.
+ * \sa setPresenceCoalescingInterval()
+ */
+void BaseConnectionSimplePresenceInterface::setMaximumPresenceBatchSize(int size)
+{
+    mPriv->maximumBatchSize = qMax(0, size);
+}
+
+/**
+ * Signal the presence changes accumulated while coalescing right away.
+ *
+ * \sa setPresenceCoalescingInterval()
+ */
+void BaseConnectionSimplePresenceInterface::flushPresences()
+{
+    if (mPriv->coalescingTimer) {
+        mPriv->coalescingTimer->stop();
+    }
+
+    if (mPriv->pendingPresences.isEmpty()) {
+        return;
+    }
+
+    SimpleContactPresences pending = mPriv->pendingPresences;
+    mPriv->pendingPresences.clear();
+    mPriv->presencesBeforePending.clear();
+    mPriv->emitPresencesChanged(pending);
+}
+
+/**
+ * Return the number of contact presence changes signalled so far with PresencesChanged.
+ *
+ * \return The number of presence changes signalled.
+ */
+quint64 BaseConnectionSimplePresenceInterface::emittedPresenceUpdates() const
+{
+    return mPriv->emittedUpdates;
+}
+
+/**
+ * Return the number of contact presence changes passed to setPresences() which were not
+ * signalled, either because they didn't change anything or because they were superseded by
+ * a later change while coalescing. A change which is reverted while coalescing counts once,
+ * its revert doesn't count again.
+ *
+ * \return The number of presence changes suppressed.
+ */
+quint64 BaseConnectionSimplePresenceInterface::suppressedPresenceUpdates() const
+{
+    return mPriv->suppressedUpdates;
+}
+
+void BaseConnectionSimplePresenceInterface::onPresenceCoalescingTimeout()
+{
+    flushPresences();
+}
+
+void BaseConnectionSimplePresenceInterface::setBaseConnection(BaseConnection *connection)
+{
+    mPriv->connection = connection;
 }
 
 void BaseConnectionSimplePresenceInterface::setSetPresenceCallback(const SetPresenceCallback &cb)
@@ -1263,16 +1945,58 @@ struct TP_QT_NO_EXPORT BaseConnectionContactListInterface::Private {
           canChangeContactList(true),
           requestUsesMessage(false),
           downloadAtConnection(false),
+          pageSize(500),
+          contactsChangedBatchSize(0),
+          contactsChangedScheduled(false),
+          parent(parent),
           adaptee(new BaseConnectionContactListInterface::Adaptee(parent))
     {
     }
 
+    struct AttributesRequest {
+        QStringList interfaces;
+        Tp::UIntList contacts;
+        int offset;
+        Tp::ContactAttributesMap attributes;
+        QList<Tp::Service::ConnectionInterfaceContactListAdaptor::GetContactListAttributesContextPtr> contexts;
+    };
+
+    struct ContactsChangedBatch {
+        Tp::ContactSubscriptionMap changes;
+        Tp::HandleIdentifierMap identifiers;
+        Tp::HandleIdentifierMap removals;
+    };
+
+    bool canPageContactListAttributes() const
+    {
+        return listContactsCB.isValid() && getContactListAttributesPageCB.isValid();
+    }
+
+    void requestContactListAttributes(const QStringList &interfaces,
+            const Tp::Service::ConnectionInterfaceContactListAdaptor::GetContactListAttributesContextPtr &context);
+    QList<ContactsChangedBatch> splitContactsChanged(const Tp::ContactSubscriptionMap &changes,
+            const Tp::HandleIdentifierMap &identifiers, const Tp::HandleIdentifierMap &removals) const;
+    void emitContactsChanged(const ContactsChangedBatch &batch);
+    void scheduleContactsChanged();
+    void finishAttributesRequest(AttributesRequest *request, const DBusError &error);
+
     uint contactListState;
     bool contactListPersists;
     bool canChangeContactList;
     bool requestUsesMessage;
     bool downloadAtConnection;
+    uint pageSize;
+    uint contactsChangedBatchSize;
+    bool contactsChangedScheduled;
+    // Pending paged GetContactListAttributes replies, built one at a time. ContactsChangedWithID
+    // is held back in pendingContactsChanged until they have all been sent, so that no reply
+    // contradicts a signal its caller has already received.
+    QList<AttributesRequest*> pendingAttributesRequests;
+    QList<ContactsChangedBatch> pendingContactsChanged;
+    BaseConnectionContactListInterface *parent;
     GetContactListAttributesCallback getContactListAttributesCB;
+    ListContactsCallback listContactsCB;
+    GetContactListAttributesPageCallback getContactListAttributesPageCB;
     RequestSubscriptionCallback requestSubscriptionCB;
     AuthorizePublicationCallback authorizePublicationCB;
     RemoveContactsCallback removeContactsCB;
@@ -1282,6 +2006,124 @@ struct TP_QT_NO_EXPORT BaseConnectionContactListInterface::Private {
     BaseConnectionContactListInterface::Adaptee *adaptee;
 };
 
+void BaseConnectionContactListInterface::Private::requestContactListAttributes(
+        const QStringList &interfaces,
+        const Tp::Service::ConnectionInterfaceContactListAdaptor::GetContactListAttributesContextPtr &context)
+{
+    QStringList sortedInterfaces = interfaces;
+    sortedInterfaces.sort();
+    sortedInterfaces.removeDuplicates();
+
+    // The roster cannot have been signalled as changed since a pending request took its snapshot,
+    // so a request for the same interfaces can share its reply instead of building another one
+    foreach (AttributesRequest *request, pendingAttributesRequests) {
+        if (request->interfaces == sortedInterfaces) {
+            request->contexts.append(context);
+            return;
+        }
+    }
+
+    DBusError error;
+    Tp::UIntList contacts = listContactsCB(&error);
+    if (error.isValid()) {
+        context->setFinishedWithError(error.name(), error.message());
+        return;
+    }
+
+    if (contacts.isEmpty()) {
+        context->setFinished(Tp::ContactAttributesMap());
+        return;
+    }
+
+    AttributesRequest *request = new AttributesRequest;
+    request->interfaces = sortedInterfaces;
+    request->contacts = contacts;
+    request->offset = 0;
+    request->contexts.append(context);
+    pendingAttributesRequests.append(request);
+    if (pendingAttributesRequests.size() == 1) {
+        QTimer::singleShot(0, parent, SLOT(processContactListAttributesPage()));
+    }
+}
+
+QList<BaseConnectionContactListInterface::Private::ContactsChangedBatch>
+BaseConnectionContactListInterface::Private::splitContactsChanged(
+        const Tp::ContactSubscriptionMap &changes, const Tp::HandleIdentifierMap &identifiers,
+        const Tp::HandleIdentifierMap &removals) const
+{
+    QList<ContactsChangedBatch> batches;
+    ContactsChangedBatch batch;
+    uint size = 0;
+
+    for (Tp::ContactSubscriptionMap::const_iterator i = changes.constBegin();
+            i != changes.constEnd(); ++i) {
+        batch.changes.insert(i.key(), i.value());
+        Tp::HandleIdentifierMap::const_iterator identifier = identifiers.constFind(i.key());
+        if (identifier != identifiers.constEnd()) {
+            batch.identifiers.insert(identifier.key(), identifier.value());
+        }
+        if (++size == contactsChangedBatchSize) {
+            batches.append(batch);
+            batch = ContactsChangedBatch();
+            size = 0;
+        }
+    }
+
+    for (Tp::HandleIdentifierMap::const_iterator i = removals.constBegin();
+            i != removals.constEnd(); ++i) {
+        batch.removals.insert(i.key(), i.value());
+        if (++size == contactsChangedBatchSize) {
+            batches.append(batch);
+            batch = ContactsChangedBatch();
+            size = 0;
+        }
+    }
+
+    if (size > 0 || batches.isEmpty()) {
+        batches.append(batch);
+    }
+    return batches;
+}
+
+void BaseConnectionContactListInterface::Private::emitContactsChanged(const ContactsChangedBatch &batch)
+{
+    QMetaObject::invokeMethod(adaptee, "contactsChangedWithID",
+            Q_ARG(Tp::ContactSubscriptionMap, batch.changes),
+            Q_ARG(Tp::HandleIdentifierMap, batch.identifiers),
+            Q_ARG(Tp::HandleIdentifierMap, batch.removals)); //Can simply use emit in Qt5
+}
+
+void BaseConnectionContactListInterface::Private::scheduleContactsChanged()
+{
+    if (!contactsChangedScheduled) {
+        contactsChangedScheduled = true;
+        QTimer::singleShot(0, parent, SLOT(emitContactsChangedBatch()));
+    }
+}
+
+void BaseConnectionContactListInterface::Private::finishAttributesRequest(
+        AttributesRequest *request, const DBusError &error)
+{
+    foreach (const Tp::Service::ConnectionInterfaceContactListAdaptor::GetContactListAttributesContextPtr &context,
+            request->contexts) {
+        if (error.isValid()) {
+            context->setFinishedWithError(error.name(), error.message());
+        } else {
+            context->setFinished(request->attributes);
+        }
+    }
+    pendingAttributesRequests.removeOne(request);
+    delete request;
+
+    // The changes held back while the reply was built follow it on the bus
+    if (pendingAttributesRequests.isEmpty() && !pendingContactsChanged.isEmpty()) {
+        emitContactsChanged(pendingContactsChanged.takeFirst());
+        if (!pendingContactsChanged.isEmpty()) {
+            scheduleContactsChanged();
+        }
+    }
+}
+
 BaseConnectionContactListInterface::Adaptee::Adaptee(BaseConnectionContactListInterface *interface)
     : QObject(interface),
       mInterface(interface)
@@ -1321,6 +2163,12 @@ void BaseConnectionContactListInterface::Adaptee::getContactListAttributes(const
         const Tp::Service::ConnectionInterfaceContactListAdaptor::GetContactListAttributesContextPtr &context)
 {
     debug() << "BaseConnectionContactListInterface::Adaptee::getContactListAttributes";
+    if (!mInterface->mPriv->getContactListAttributesCB.isValid() &&
+            mInterface->mPriv->canPageContactListAttributes()) {
+        mInterface->mPriv->requestContactListAttributes(interfaces, context);
+        return;
+    }
+
     DBusError error;
     Tp::ContactAttributesMap attributes = mInterface->getContactListAttributes(interfaces, hold, &error);
     if (error.isValid()) {
@@ -1414,6 +2262,13 @@ void BaseConnectionContactListInterface::Adaptee::download(
  * \headerfile TelepathyQt/base-connection.h <TelepathyQt/BaseConnection>
  *
  * \brief Base class for implementations of Connection.Interface.ContactList
+ *
+ * GetContactListAttributes can be served either by the callback set with
+ * setGetContactListAttributesCallback(), which builds the whole reply at once, or one page at a
+ * time with the callbacks set with setListContactsCallback() and
+ * setGetContactListAttributesPageCallback(). Paging only keeps the event loop running while a
+ * reply for a large roster is built: the pages are merged into a single map, and the reply is sent
+ * as a single D-Bus message, so the attributes of the whole roster are held in memory either way.
  */
 
 /**
@@ -1430,6 +2285,14 @@ BaseConnectionContactListInterface::BaseConnectionContactListInterface()
  */
 BaseConnectionContactListInterface::~BaseConnectionContactListInterface()
 {
+    foreach (Private::AttributesRequest *request, mPriv->pendingAttributesRequests) {
+        foreach (const Tp::Service::ConnectionInterfaceContactListAdaptor::GetContactListAttributesContextPtr &context,
+                request->contexts) {
+            context->setFinishedWithError(TP_QT_ERROR_DISCONNECTED,
+                    QLatin1String("Contact list is no longer available"));
+        }
+        delete request;
+    }
     delete mPriv;
 }
 
@@ -1513,13 +2376,129 @@ void BaseConnectionContactListInterface::setGetContactListAttributesCallback(con
     mPriv->getContactListAttributesCB = cb;
 }
 
+/**
+ * Return the attributes of all the contacts on the contact list.
+ *
+ * The callback set with setGetContactListAttributesCallback() is used if any. Otherwise, the
+ * roster is obtained from the callback set with setListContactsCallback() and its attributes
+ * are fetched one page at a time with the callback set with
+ * setGetContactListAttributesPageCallback(), without returning to the event loop in between.
+ *
+ * \param interfaces The interfaces the attributes are requested for.
+ * \param hold Whether to hold the handles, ignored as handles are always held.
+ * \param error A pointer to an empty DBusError where any possible error will be stored.
+ * \return The attributes of the contacts, keyed by handle.
+ */
 Tp::ContactAttributesMap BaseConnectionContactListInterface::getContactListAttributes(const QStringList &interfaces, bool hold, DBusError *error)
 {
-    if (!mPriv->getContactListAttributesCB.isValid()) {
+    if (mPriv->getContactListAttributesCB.isValid()) {
+        return mPriv->getContactListAttributesCB(interfaces, hold, error);
+    }
+
+    if (!mPriv->canPageContactListAttributes()) {
         error->set(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Not implemented"));
         return Tp::ContactAttributesMap();
     }
-    return mPriv->getContactListAttributesCB(interfaces, hold, error);
+
+    Tp::UIntList contacts = mPriv->listContactsCB(error);
+    Tp::ContactAttributesMap attributes;
+    int pageSize = mPriv->pageSize > 0 ? mPriv->pageSize : contacts.size();
+    for (int offset = 0; offset < contacts.size() && !error->isValid(); offset += pageSize) {
+        Tp::ContactAttributesMap page = mPriv->getContactListAttributesPageCB(
+                contacts.mid(offset, pageSize), interfaces, error);
+        for (Tp::ContactAttributesMap::const_iterator i = page.constBegin(); i != page.constEnd(); ++i) {
+            attributes.insert(i.key(), i.value());
+        }
+    }
+    return error->isValid() ? Tp::ContactAttributesMap() : attributes;
+}
+
+/**
+ * Set a callback that will be called to list the handles of all the contacts on the
+ * contact list.
+ *
+ * Together with setGetContactListAttributesPageCallback(), this allows the library to serve
+ * GetContactListAttributes for large rosters one page at a time, returning to the event loop
+ * between pages, instead of requiring the connection manager to build the whole reply at once
+ * in the callback set with setGetContactListAttributesCallback(), which takes precedence if set.
+ *
+ * The roster is listed once when a request arrives, and the reply describes the contacts listed
+ * then. ContactsChangedWithID signals emitted with contactsChangedWithID() while replies are
+ * being built are held back until they have been sent. Replies are built one at a time, and
+ * concurrent requests for the same interfaces share the same reply.
+ *
+ * \param cb The callback to set.
+ * \sa setContactListPageSize()
+ */
+void BaseConnectionContactListInterface::setListContactsCallback(const ListContactsCallback &cb)
+{
+    mPriv->listContactsCB = cb;
+}
+
+/**
+ * Set a callback that will be called to get the attributes of one page of contacts
+ * from the contact list, for the given interfaces.
+ *
+ * \param cb The callback to set.
+ * \sa setListContactsCallback()
+ */
+void BaseConnectionContactListInterface::setGetContactListAttributesPageCallback(const GetContactListAttributesPageCallback &cb)
+{
+    mPriv->getContactListAttributesPageCB = cb;
+}
+
+/**
+ * Return the maximum number of contacts whose attributes are requested at once from the
+ * callback set with setGetContactListAttributesPageCallback().
+ *
+ * \return The page size, or 0 if the whole contact list is requested at once.
+ */
+uint BaseConnectionContactListInterface::contactListPageSize() const
+{
+    return mPriv->pageSize;
+}
+
+/**
+ * Set the maximum number of contacts whose attributes are requested at once from the
+ * callback set with setGetContactListAttributesPageCallback().
+ *
+ * The default is 500.
+ *
+ * \param pageSize The page size, or 0 to request the whole contact list at once.
+ */
+void BaseConnectionContactListInterface::setContactListPageSize(uint pageSize)
+{
+    mPriv->pageSize = pageSize;
+}
+
+void BaseConnectionContactListInterface::processContactListAttributesPage()
+{
+    if (mPriv->pendingAttributesRequests.isEmpty()) {
+        return;
+    }
+
+    // Requests are built one after the other rather than interleaved, so that the first caller
+    // gets its reply as soon as possible
+    Private::AttributesRequest *request = mPriv->pendingAttributesRequests.first();
+    int pageSize = mPriv->pageSize > 0 ? mPriv->pageSize : request->contacts.size();
+
+    DBusError error;
+    Tp::ContactAttributesMap page = mPriv->getContactListAttributesPageCB(
+            request->contacts.mid(request->offset, pageSize), request->interfaces, &error);
+    if (!error.isValid()) {
+        for (Tp::ContactAttributesMap::const_iterator i = page.constBegin(); i != page.constEnd(); ++i) {
+            request->attributes.insert(i.key(), i.value());
+        }
+        request->offset += pageSize;
+    }
+
+    if (error.isValid() || request->offset >= request->contacts.size()) {
+        mPriv->finishAttributesRequest(request, error);
+    }
+
+    if (!mPriv->pendingAttributesRequests.isEmpty()) {
+        QTimer::singleShot(0, this, SLOT(processContactListAttributesPage()));
+    }
 }
 
 void BaseConnectionContactListInterface::setRequestSubscriptionCallback(const BaseConnectionContactListInterface::RequestSubscriptionCallback &cb)
@@ -1606,9 +2585,77 @@ void BaseConnectionContactListInterface::download(DBusError *error)
     return mPriv->downloadCB(error);
 }
 
+/**
+ * Emit the ContactsChangedWithID signal.
+ *
+ * If a batch size was set with setContactsChangedBatchSize(), large changes, e.g. during the
+ * initial contact list download, are split into several signals of at most that many
+ * contacts, the first being emitted immediately and the others from the event loop.
+ *
+ * While GetContactListAttributes replies are being built one page at a time, changes are held
+ * back and only emitted once the replies have been sent, so that clients never receive a reply
+ * describing the contact list as it was before a change they have already been told about.
+ * Changes are always emitted in the order they were made.
+ *
+ * \param changes The new subscription states of the changed contacts.
+ * \param identifiers The identifiers of the changed contacts.
+ * \param removals The contacts removed from the contact list, with their identifiers.
+ */
 void BaseConnectionContactListInterface::contactsChangedWithID(const Tp::ContactSubscriptionMap &changes, const Tp::HandleIdentifierMap &identifiers, const Tp::HandleIdentifierMap &removals)
 {
-    QMetaObject::invokeMethod(mPriv->adaptee, "contactsChangedWithID", Q_ARG(Tp::ContactSubscriptionMap, changes), Q_ARG(Tp::HandleIdentifierMap, identifiers), Q_ARG(Tp::HandleIdentifierMap, removals)); //Can simply use emit in Qt5
+    bool held = !mPriv->pendingAttributesRequests.isEmpty();
+    if (mPriv->contactsChangedBatchSize == 0 && mPriv->pendingContactsChanged.isEmpty() && !held) {
+        QMetaObject::invokeMethod(mPriv->adaptee, "contactsChangedWithID", Q_ARG(Tp::ContactSubscriptionMap, changes), Q_ARG(Tp::HandleIdentifierMap, identifiers), Q_ARG(Tp::HandleIdentifierMap, removals)); //Can simply use emit in Qt5
+        return;
+    }
+
+    QList<Private::ContactsChangedBatch> batches = mPriv->splitContactsChanged(changes,
+            identifiers, removals);
+    if (mPriv->pendingContactsChanged.isEmpty() && !held) {
+        mPriv->emitContactsChanged(batches.takeFirst());
+        if (batches.isEmpty()) {
+            return;
+        }
+        mPriv->scheduleContactsChanged();
+    }
+    mPriv->pendingContactsChanged.append(batches);
+}
+
+/**
+ * Return the maximum number of contacts in a single ContactsChangedWithID signal.
+ *
+ * \return The batch size, or 0 if changes are never split.
+ * \sa contactsChangedWithID()
+ */
+uint BaseConnectionContactListInterface::contactsChangedBatchSize() const
+{
+    return mPriv->contactsChangedBatchSize;
+}
+
+/**
+ * Set the maximum number of contacts in a single ContactsChangedWithID signal.
+ *
+ * The default is 0, meaning changes are never split.
+ *
+ * \param batchSize The batch size, or 0 to never split changes.
+ * \sa contactsChangedWithID()
+ */
+void BaseConnectionContactListInterface::setContactsChangedBatchSize(uint batchSize)
+{
+    mPriv->contactsChangedBatchSize = batchSize;
+}
+
+void BaseConnectionContactListInterface::emitContactsChangedBatch()
+{
+    mPriv->contactsChangedScheduled = false;
+    if (mPriv->pendingContactsChanged.isEmpty() || !mPriv->pendingAttributesRequests.isEmpty()) {
+        return;
+    }
+
+    mPriv->emitContactsChanged(mPriv->pendingContactsChanged.takeFirst());
+    if (!mPriv->pendingContactsChanged.isEmpty()) {
+        mPriv->scheduleContactsChanged();
+    }
 }
 
 // Conn.I.ContactInfo
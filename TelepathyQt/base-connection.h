@@ -41,6 +41,8 @@ class QString;
 namespace Tp
 {
 
+class BaseHandleRepository;
+
 class TP_QT_EXPORT BaseConnection : public DBusService
 {
     Q_OBJECT
@@ -96,6 +98,8 @@ public:
     void setRequestHandlesCallback(const RequestHandlesCallback &cb);
     Tp::UIntList requestHandles(uint handleType, const QStringList &identifiers, DBusError *error);
 
+    BaseHandleRepository *handleRepository(uint handleType) const;
+
     Tp::ChannelInfoList channelsInfo();
     Tp::ChannelDetailsList channelsDetails();
 
@@ -103,6 +107,9 @@ public:
 
     void addChannel(BaseChannelPtr channel, bool suppressHandler = false);
 
+    bool isExactTargetMatchingEnabled() const;
+    void setExactTargetMatchingEnabled(bool enabled);
+
     QList<AbstractConnectionInterfacePtr> interfaces() const;
     AbstractConnectionInterfacePtr interface(const QString  &interfaceName) const;
     bool plugInterface(const AbstractConnectionInterfacePtr &interface);
@@ -223,6 +230,12 @@ public:
 
     void getContactByID(const QString &identifier, const QStringList &interfaces, uint &handle, QVariantMap &attributes, DBusError *error);
 
+    bool isContactAttributeCacheEnabled() const;
+    void setContactAttributeCacheEnabled(bool enabled);
+    void updateCachedContactAttributes(uint handle, const QString &interface, const QVariantMap &attributes);
+    void invalidateCachedContactAttributes(const Tp::UIntList &handles, const QString &interface = QString());
+    void clearContactAttributeCache();
+
 protected:
     BaseConnectionContactsInterface(BaseConnection *connection);
 
@@ -270,10 +283,25 @@ public:
 
     Tp::SimpleContactPresences getPresences(const Tp::UIntList &contacts);
 
+    int presenceCoalescingInterval() const;
+    void setPresenceCoalescingInterval(int msecs);
+    int maximumPresenceBatchSize() const;
+    void setMaximumPresenceBatchSize(int size);
+    void flushPresences();
+
+    quint64 emittedPresenceUpdates() const;
+    quint64 suppressedPresenceUpdates() const;
+
 protected:
     BaseConnectionSimplePresenceInterface();
 
+private Q_SLOTS:
+    TP_QT_NO_EXPORT void onPresenceCoalescingTimeout();
+
 private:
+    friend class BaseConnection;
+
+    TP_QT_NO_EXPORT void setBaseConnection(BaseConnection *connection);
     void createAdaptor();
 
     class Adaptee;
@@ -323,6 +351,15 @@ public:
     void setGetContactListAttributesCallback(const GetContactListAttributesCallback &cb);
     Tp::ContactAttributesMap getContactListAttributes(const QStringList &interfaces, bool hold, DBusError *error);
 
+    typedef Callback1<Tp::UIntList, DBusError*> ListContactsCallback;
+    void setListContactsCallback(const ListContactsCallback &cb);
+
+    typedef Callback3<Tp::ContactAttributesMap, const Tp::UIntList &, const QStringList &, DBusError*> GetContactListAttributesPageCallback;
+    void setGetContactListAttributesPageCallback(const GetContactListAttributesPageCallback &cb);
+
+    uint contactListPageSize() const;
+    void setContactListPageSize(uint pageSize);
+
     typedef Callback3<void, const Tp::UIntList &, const QString &, DBusError*> RequestSubscriptionCallback;
     void setRequestSubscriptionCallback(const RequestSubscriptionCallback &cb);
     void requestSubscription(const Tp::UIntList &contacts, const QString &message, DBusError *error);
@@ -349,9 +386,16 @@ public:
 
     void contactsChangedWithID(const Tp::ContactSubscriptionMap &changes, const Tp::HandleIdentifierMap &identifiers, const Tp::HandleIdentifierMap &removals);
 
+    uint contactsChangedBatchSize() const;
+    void setContactsChangedBatchSize(uint batchSize);
+
 protected:
     BaseConnectionContactListInterface();
 
+private Q_SLOTS:
+    TP_QT_NO_EXPORT void processContactListAttributesPage();
+    TP_QT_NO_EXPORT void emitContactsChangedBatch();
+
 private:
     void createAdaptor();
 
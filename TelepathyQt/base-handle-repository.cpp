@@ -0,0 +1,354 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <TelepathyQt/BaseHandleRepository>
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusError>
+
+#include <QHash>
+#include <QVector>
+
+namespace Tp
+{
+
+struct TP_QT_NO_EXPORT BaseHandleRepository::Private
+{
+    Private(uint handleType)
+        : handleType(handleType),
+          mask(0)
+    {
+    }
+
+    int findSlot(const QString &identifier, uint hash) const;
+    void rehash(int tableSize);
+    uint insert(const QString &identifier);
+
+    uint handleType;
+    NormalizeCallback normalizeCB;
+
+    // Handles are never released, so handle N is simply stored at index N - 1
+    QVector<QString> identifiers;
+    QVector<uint> hashes;
+
+    // Open addressing index of the handles above by identifier, 0 marking an empty slot.
+    // Its size is always a power of two and it is never more than half full.
+    QVector<uint> table;
+    uint mask;
+};
+
+int BaseHandleRepository::Private::findSlot(const QString &identifier, uint hash) const
+{
+    const uint *entries = table.constData();
+    uint i = hash & mask;
+    forever {
+        uint h = entries[i];
+        if (h == 0 || (hashes.at(h - 1) == hash && identifiers.at(h - 1) == identifier)) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+void BaseHandleRepository::Private::rehash(int tableSize)
+{
+    table = QVector<uint>(tableSize, 0);
+    mask = tableSize - 1;
+
+    uint *entries = table.data();
+    const uint *hashData = hashes.constData();
+    for (int i = 0; i < hashes.size(); ++i) {
+        uint slot = hashData[i] & mask;
+        while (entries[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        entries[slot] = i + 1;
+    }
+}
+
+uint BaseHandleRepository::Private::insert(const QString &identifier)
+{
+    if ((identifiers.size() + 1) * 2 > table.size()) {
+        rehash(qMax(64, table.size() * 2));
+    }
+
+    uint hash = qHash(identifier);
+    int slot = findSlot(identifier, hash);
+    if (table.at(slot) != 0) {
+        return table.at(slot);
+    }
+
+    identifiers.append(identifier);
+    hashes.append(hash);
+    uint handle = identifiers.size();
+    table[slot] = handle;
+    return handle;
+}
+
+/**
+ * \class BaseHandleRepository
+ * \ingroup servicecm
+ * \headerfile TelepathyQt/base-handle-repository.h <TelepathyQt/BaseHandleRepository>
+ *
+ * \brief The BaseHandleRepository class stores the handles of one type used by a
+ * BaseConnection.
+ *
+ * Identifiers are normalized using the callback set with setNormalizeCallback() and then
+ * interned: the first identifier gets handle 1, the next new one handle 2 and so on.
+ * As handles last for the whole lifetime of the connection, identifiers are stored
+ * in a flat array indexed by handle, with a compact open addressing hash table
+ * mapping identifiers back to their handle.
+ *
+ * BaseConnection::requestHandles() and BaseConnection::inspectHandles() use the
+ * repository returned by BaseConnection::handleRepository() when no callback was
+ * set for them.
+ */
+
+/**
+ * Construct a new BaseHandleRepository object for handles of the given type.
+ *
+ * \param handleType The handle type, as a member of #HandleType.
+ */
+BaseHandleRepository::BaseHandleRepository(uint handleType)
+    : mPriv(new Private(handleType))
+{
+}
+
+/**
+ * Class destructor.
+ */
+BaseHandleRepository::~BaseHandleRepository()
+{
+    delete mPriv;
+}
+
+/**
+ * Return the type of the handles stored in this repository.
+ *
+ * \return The handle type, as a member of #HandleType.
+ */
+uint BaseHandleRepository::handleType() const
+{
+    return mPriv->handleType;
+}
+
+/**
+ * Set the callback used to normalize identifiers before they are interned.
+ *
+ * The callback returns the normalized form of the given identifier, or sets the
+ * given error if it is not valid. Without a callback, identifiers are used as
+ * they are and only empty identifiers are rejected.
+ *
+ * \param cb The normalization callback.
+ */
+void BaseHandleRepository::setNormalizeCallback(const NormalizeCallback &cb)
+{
+    mPriv->normalizeCB = cb;
+}
+
+/**
+ * Return the normalized form of \a identifier.
+ *
+ * \param identifier The identifier to normalize.
+ * \param error A pointer to an empty DBusError where any possible error will be stored.
+ * \return The normalized identifier, or an empty string on error.
+ * \sa setNormalizeCallback()
+ */
+QString BaseHandleRepository::normalize(const QString &identifier, DBusError *error) const
+{
+    if (mPriv->normalizeCB.isValid()) {
+        QString normalized = mPriv->normalizeCB(identifier, error);
+        if (error->isValid()) {
+            return QString();
+        }
+        if (!normalized.isEmpty()) {
+            return normalized;
+        }
+    } else if (!identifier.isEmpty()) {
+        return identifier;
+    }
+
+    error->set(TP_QT_ERROR_INVALID_HANDLE,
+            QString(QLatin1String("Invalid identifier: '%1'")).arg(identifier));
+    return QString();
+}
+
+/**
+ * Return the number of handles stored in this repository.
+ *
+ * \return The number of handles.
+ */
+int BaseHandleRepository::count() const
+{
+    return mPriv->identifiers.size();
+}
+
+/**
+ * Preallocate memory for at least \a size handles.
+ *
+ * \param size The number of handles to reserve memory for.
+ */
+void BaseHandleRepository::reserve(int size)
+{
+    if (size <= mPriv->identifiers.size()) {
+        return;
+    }
+
+    mPriv->identifiers.reserve(size);
+    mPriv->hashes.reserve(size);
+
+    int tableSize = qMax(64, mPriv->table.size());
+    while (size * 2 > tableSize) {
+        tableSize *= 2;
+    }
+    if (tableSize != mPriv->table.size()) {
+        mPriv->rehash(tableSize);
+    }
+}
+
+/**
+ * Return the handle for \a identifier, interning it if needed.
+ *
+ * \param identifier The identifier, which will be normalized first.
+ * \param error A pointer to an empty DBusError where any possible error will be stored.
+ * \return The handle, or 0 on error.
+ */
+uint BaseHandleRepository::ensureHandle(const QString &identifier, DBusError *error)
+{
+    QString normalized = normalize(identifier, error);
+    if (error->isValid()) {
+        return 0;
+    }
+
+    return mPriv->insert(normalized);
+}
+
+/**
+ * Return the handles for \a identifiers, interning them if needed.
+ *
+ * Either all the identifiers are valid and their handles are returned in the same
+ * order, or none of them is interned and \a error is set.
+ *
+ * \param identifiers The identifiers, which will be normalized first.
+ * \param error A pointer to an empty DBusError where any possible error will be stored.
+ * \return The handles, or an empty list on error.
+ */
+Tp::UIntList BaseHandleRepository::ensureHandles(const QStringList &identifiers,
+        DBusError *error)
+{
+    QStringList normalized;
+    foreach (const QString &identifier, identifiers) {
+        normalized.append(normalize(identifier, error));
+        if (error->isValid()) {
+            return Tp::UIntList();
+        }
+    }
+
+    Tp::UIntList handles;
+    foreach (const QString &identifier, normalized) {
+        handles.append(mPriv->insert(identifier));
+    }
+    return handles;
+}
+
+/**
+ * Return the handle for \a normalizedIdentifier if it has already been interned.
+ *
+ * \param normalizedIdentifier An identifier, already normalized.
+ * \return The handle, or 0 if the identifier is not known.
+ */
+uint BaseHandleRepository::handle(const QString &normalizedIdentifier) const
+{
+    if (mPriv->table.isEmpty()) {
+        return 0;
+    }
+
+    int slot = mPriv->findSlot(normalizedIdentifier, qHash(normalizedIdentifier));
+    return mPriv->table.at(slot);
+}
+
+/**
+ * Return whether \a handle is a handle from this repository.
+ *
+ * \param handle The handle.
+ * \return \c true if the handle is valid, \c false otherwise.
+ */
+bool BaseHandleRepository::isValid(uint handle) const
+{
+    return handle != 0 && handle <= (uint) mPriv->identifiers.size();
+}
+
+/**
+ * Return whether all of \a handles are handles from this repository.
+ *
+ * \param handles The handles.
+ * \return \c true if all the handles are valid, \c false otherwise.
+ */
+bool BaseHandleRepository::areValid(const Tp::UIntList &handles) const
+{
+    foreach (uint handle, handles) {
+        if (!isValid(handle)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Return the normalized identifier for \a handle.
+ *
+ * \param handle The handle.
+ * \return The identifier, or an empty string if the handle is not valid.
+ */
+QString BaseHandleRepository::identifier(uint handle) const
+{
+    if (!isValid(handle)) {
+        return QString();
+    }
+
+    return mPriv->identifiers.at(handle - 1);
+}
+
+/**
+ * Return the normalized identifiers for \a handles.
+ *
+ * \param handles The handles.
+ * \param error A pointer to an empty DBusError where any possible error will be stored.
+ * \return The identifiers in the same order as \a handles, or an empty list if any of
+ *         the handles is not valid.
+ */
+QStringList BaseHandleRepository::identifiers(const Tp::UIntList &handles,
+        DBusError *error) const
+{
+    QStringList ret;
+    foreach (uint handle, handles) {
+        if (!isValid(handle)) {
+            error->set(TP_QT_ERROR_INVALID_HANDLE,
+                    QString(QLatin1String("Invalid handle: %1")).arg(handle));
+            return QStringList();
+        }
+        ret.append(mPriv->identifiers.at(handle - 1));
+    }
+    return ret;
+}
+
+} // Tp
@@ -0,0 +1,77 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_base_handle_repository_h_HEADER_GUARD_
+#define _TelepathyQt_base_handle_repository_h_HEADER_GUARD_
+
+#ifndef IN_TP_QT_HEADER
+#error IN_TP_QT_HEADER
+#endif
+
+#include <TelepathyQt/Callbacks>
+#include <TelepathyQt/Global>
+#include <TelepathyQt/Types>
+
+#include <QStringList>
+
+namespace Tp
+{
+
+class DBusError;
+
+class TP_QT_EXPORT BaseHandleRepository
+{
+    Q_DISABLE_COPY(BaseHandleRepository)
+
+public:
+    BaseHandleRepository(uint handleType);
+    ~BaseHandleRepository();
+
+    uint handleType() const;
+
+    typedef Callback2<QString, const QString &, DBusError*> NormalizeCallback;
+    void setNormalizeCallback(const NormalizeCallback &cb);
+    QString normalize(const QString &identifier, DBusError *error) const;
+
+    int count() const;
+    void reserve(int size);
+
+    uint ensureHandle(const QString &identifier, DBusError *error);
+    Tp::UIntList ensureHandles(const QStringList &identifiers, DBusError *error);
+
+    uint handle(const QString &normalizedIdentifier) const;
+
+    bool isValid(uint handle) const;
+    bool areValid(const Tp::UIntList &handles) const;
+
+    QString identifier(uint handle) const;
+    QStringList identifiers(const Tp::UIntList &handles, DBusError *error) const;
+
+private:
+    struct Private;
+    friend struct Private;
+    Private *mPriv;
+};
+
+} // Tp
+
+#endif
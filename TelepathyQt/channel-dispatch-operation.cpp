@@ -30,6 +30,7 @@
 
 #include "TelepathyQt/debug-internal.h"
 #include "TelepathyQt/fake-handler-manager-internal.h"
+#include "TelepathyQt/pending-ready-internal.h"
 
 #include <TelepathyQt/Account>
 #include <TelepathyQt/AccountFactory>
@@ -52,8 +53,11 @@ struct TP_QT_NO_EXPORT ChannelDispatchOperation::Private
 
     static void introspectMain(Private *self);
 
-    void extractMainProps(const QVariantMap &props,
+    bool immutableMainProps(QVariantMap &mainProps) const;
+    void satisfyFromImmutableProperties();
+    QList<PendingOperation *> extractMainProps(const QVariantMap &props,
             bool immutableProperties);
+    void prepareProxies(const QList<PendingOperation *> &readyOps);
 
     // Public object
     ChannelDispatchOperation *parent;
@@ -119,22 +123,10 @@ ChannelDispatchOperation::Private::~Private()
 void ChannelDispatchOperation::Private::introspectMain(ChannelDispatchOperation::Private *self)
 {
     QVariantMap mainProps;
-    foreach (QString key, self->immutableProperties.keys()) {
-        if (key.startsWith(TP_QT_IFACE_CHANNEL_DISPATCH_OPERATION + QLatin1String("."))) {
-            QVariant value = self->immutableProperties.value(key);
-            mainProps.insert(
-                    key.remove(TP_QT_IFACE_CHANNEL_DISPATCH_OPERATION + QLatin1String(".")),
-                    value);
-        }
-    }
-
-    if (!self->channels.isEmpty() && mainProps.contains(QLatin1String("Account"))
-            && mainProps.contains(QLatin1String("Connection"))
-            && mainProps.contains(QLatin1String("Interfaces"))
-            && mainProps.contains(QLatin1String("PossibleHandlers"))) {
+    if (self->immutableMainProps(mainProps)) {
         debug() << "Supplied properties were sufficient, not introspecting"
             << self->parent->objectPath();
-        self->extractMainProps(mainProps, true);
+        self->prepareProxies(self->extractMainProps(mainProps, true));
         return;
     }
 
@@ -148,8 +140,44 @@ void ChannelDispatchOperation::Private::introspectMain(ChannelDispatchOperation:
             SLOT(gotMainProperties(QDBusPendingCallWatcher*)));
 }
 
-void ChannelDispatchOperation::Private::extractMainProps(const QVariantMap &props,
-        bool immutableProperties)
+bool ChannelDispatchOperation::Private::immutableMainProps(QVariantMap &mainProps) const
+{
+    foreach (QString key, immutableProperties.keys()) {
+        if (key.startsWith(TP_QT_IFACE_CHANNEL_DISPATCH_OPERATION + QLatin1String("."))) {
+            QVariant value = immutableProperties.value(key);
+            mainProps.insert(
+                    key.remove(TP_QT_IFACE_CHANNEL_DISPATCH_OPERATION + QLatin1String(".")),
+                    value);
+        }
+    }
+
+    return !channels.isEmpty() && mainProps.contains(QLatin1String("Account"))
+        && mainProps.contains(QLatin1String("Connection"))
+        && mainProps.contains(QLatin1String("Interfaces"))
+        && mainProps.contains(QLatin1String("PossibleHandlers"));
+}
+
+void ChannelDispatchOperation::Private::satisfyFromImmutableProperties()
+{
+    QVariantMap mainProps;
+    if (!immutableMainProps(mainProps)) {
+        return;
+    }
+
+    if (!readyOpsSatisfied(extractMainProps(mainProps, true))) {
+        // Let the introspection wait for them to become ready
+        connection.reset();
+        account.reset();
+        return;
+    }
+
+    debug() << "Supplied properties were sufficient and proxies were ready, CDO"
+        << parent->objectPath() << "is ready without introspection";
+    readinessHelper->forceFeatureSatisfied(FeatureCore);
+}
+
+QList<PendingOperation *> ChannelDispatchOperation::Private::extractMainProps(
+        const QVariantMap &props, bool immutableProperties)
 {
     parent->setInterfaces(qdbus_cast<QStringList>(props.value(QLatin1String("Interfaces"))));
 
@@ -209,6 +237,11 @@ void ChannelDispatchOperation::Private::extractMainProps(const QVariantMap &prop
         gotPossibleHandlers = true;
     }
 
+    return readyOps;
+}
+
+void ChannelDispatchOperation::Private::prepareProxies(const QList<PendingOperation *> &readyOps)
+{
     if (readyOps.isEmpty()) {
         debug() << "No proxies to prepare for CDO" << parent->objectPath();
         readinessHelper->setIntrospectCompleted(FeatureCore, true);
@@ -571,6 +604,14 @@ Client::ChannelDispatchOperationInterface *ChannelDispatchOperation::baseInterfa
     return mPriv->baseInterface;
 }
 
+// Used by ClientRegistrar when immediate dispatch is enabled, before becomeReady() is called: if the
+// immutable properties cover everything FeatureCore would introspect, and the account and
+// connection are ready already, the CDO is made ready straight away
+void ChannelDispatchOperation::satisfyFromImmutableProperties()
+{
+    mPriv->satisfyFromImmutableProperties();
+}
+
 void ChannelDispatchOperation::onFinished()
 {
     debug() << "ChannelDispatchOperation finished and was removed";
@@ -585,7 +626,7 @@ void ChannelDispatchOperation::gotMainProperties(QDBusPendingCallWatcher *watche
     // Watcher is NULL if we didn't have to introspect at all
     if (!reply.isError()) {
         debug() << "Got reply to Properties::GetAll(ChannelDispatchOperation)";
-        mPriv->extractMainProps(reply.value(), false);
+        mPriv->prepareProxies(mPriv->extractMainProps(reply.value(), false));
     } else {
         mPriv->readinessHelper->setIntrospectCompleted(FeatureCore,
                 false, reply.error());
@@ -103,6 +103,9 @@ private Q_SLOTS:
 private:
     class PendingClaim;
     friend class PendingClaim;
+    friend class ClientApproverAdaptor;
+
+    TP_QT_NO_EXPORT void satisfyFromImmutableProperties();
 
     struct Private;
     friend struct Private;
@@ -27,6 +27,7 @@
 #include "TelepathyQt/_gen/future-constants.h"
 
 #include "TelepathyQt/debug-internal.h"
+#include "TelepathyQt/properties-prefetcher-internal.h"
 
 #include <TelepathyQt/CallChannel>
 #include <TelepathyQt/Channel>
@@ -55,6 +56,8 @@ struct TP_QT_NO_EXPORT ChannelFactory::Private
 {
     Private();
 
+    static QStringList interfacesToPrefetch(const QVariantMap &immutableProperties);
+
     QList<ChannelClassFeatures> features;
 
     typedef QPair<ChannelClassSpec, ConstructorConstPtr> CtorPair;
@@ -65,6 +68,74 @@ ChannelFactory::Private::Private()
 {
 }
 
+/*
+ * Return the interfaces whose properties are going to be asked for by the core features of a
+ * channel with the given immutable properties, by the base Channel and the stock subclasses listed
+ * here. Where whether they are asked for depends on what the immutable properties have in them,
+ * the same checks as the introspection code are made.
+ */
+QStringList ChannelFactory::Private::interfacesToPrefetch(const QVariantMap &immutableProperties)
+{
+    QStringList interfaces;
+
+    static const char *mainProperties[] = {
+        ".ChannelType", ".Interfaces", ".TargetHandleType", ".TargetHandle", ".TargetID",
+        ".Requested", ".InitiatorHandle", ".InitiatorID", 0
+    };
+    for (const char **property = mainProperties; *property; ++property) {
+        if (!immutableProperties.contains(TP_QT_IFACE_CHANNEL + QLatin1String(*property))) {
+            interfaces << TP_QT_IFACE_CHANNEL;
+            break;
+        }
+    }
+
+    QStringList channelInterfaces = qdbus_cast<QStringList>(immutableProperties.value(
+                TP_QT_IFACE_CHANNEL + QLatin1String(".Interfaces")));
+    if (channelInterfaces.contains(TP_QT_IFACE_CHANNEL_INTERFACE_GROUP)) {
+        interfaces << TP_QT_IFACE_CHANNEL_INTERFACE_GROUP;
+    }
+    if (channelInterfaces.contains(TP_QT_IFACE_CHANNEL_INTERFACE_CONFERENCE)) {
+        interfaces << TP_QT_IFACE_CHANNEL_INTERFACE_CONFERENCE;
+    }
+
+    QString channelType = qdbus_cast<QString>(immutableProperties.value(
+                TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")));
+    if (channelType == TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER ||
+            channelType == TP_QT_IFACE_CHANNEL_TYPE_SERVER_AUTHENTICATION ||
+            channelType == TP_QT_IFACE_CHANNEL_TYPE_STREAM_TUBE) {
+        interfaces << channelType;
+    }
+    if ((channelType == TP_QT_IFACE_CHANNEL_TYPE_STREAM_TUBE ||
+                channelType == TP_QT_IFACE_CHANNEL_TYPE_DBUS_TUBE) &&
+            channelInterfaces.contains(TP_QT_IFACE_CHANNEL_INTERFACE_TUBE)) {
+        interfaces << TP_QT_IFACE_CHANNEL_INTERFACE_TUBE;
+    }
+
+    // DBusTubeChannel and CallChannel only ask for the properties of their type when the immutable
+    // properties don't already have the ones they need, so check for the same ones they do
+    static const char *dbusTubeProperties[] = {
+        ".ServiceName", ".SupportedAccessControls", 0
+    };
+    static const char *callProperties[] = {
+        ".HardwareStreaming", ".InitialTransport", ".InitialAudio", ".InitialVideo",
+        ".InitialAudioName", ".InitialVideoName", ".MutableContents", 0
+    };
+    const char **typeProperties = 0;
+    if (channelType == TP_QT_IFACE_CHANNEL_TYPE_DBUS_TUBE) {
+        typeProperties = dbusTubeProperties;
+    } else if (channelType == TP_QT_IFACE_CHANNEL_TYPE_CALL) {
+        typeProperties = callProperties;
+    }
+    for (const char **property = typeProperties; property && *property; ++property) {
+        if (!immutableProperties.contains(channelType + QLatin1String(*property))) {
+            interfaces << channelType;
+            break;
+        }
+    }
+
+    return interfaces;
+}
+
 /**
  * \class ChannelFactory
  * \ingroup utils
@@ -634,11 +705,31 @@ void ChannelFactory::setConstructorFor(const ChannelClassSpec &channelClass,
  */
 PendingReady *ChannelFactory::proxy(const ConnectionPtr &connection, const QString &channelPath,
         const QVariantMap &immutableProperties) const
+{
+    return proxy(connection, channelPath, immutableProperties, false);
+}
+
+// Used by ClientRegistrar when immediate dispatch is enabled: a new channel whose immutable
+// properties cover everything its core would introspect is made ready straight away, when its
+// connection and the contacts involved already are
+PendingReady *ChannelFactory::proxy(const ConnectionPtr &connection, const QString &channelPath,
+        const QVariantMap &immutableProperties, bool satisfyFromImmutableProperties) const
 {
     DBusProxyPtr proxy = cachedProxy(connection->busName(), channelPath);
     if (proxy.isNull()) {
-        proxy = constructorFor(ChannelClassSpec(immutableProperties))->construct(connection,
+        ChannelClassSpec channelClass(immutableProperties);
+        ChannelPtr channel = constructorFor(channelClass)->construct(connection,
                 channelPath, immutableProperties);
+        if (satisfyFromImmutableProperties) {
+            channel->satisfyFromImmutableProperties();
+        }
+        proxy = channel;
+
+        // Channels not made ready by the factory might never need their properties at all
+        if (proxy->isValid() && !featuresFor(channelClass).isEmpty()) {
+            PropertiesPrefetcher::forBus(dbusConnection())->prefetch(proxy.data(),
+                    Private::interfacesToPrefetch(immutableProperties));
+        }
     }
 
     return nowHaveProxy(proxy);
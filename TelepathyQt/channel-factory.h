@@ -389,6 +389,14 @@ protected:
     virtual Features featuresFor(const DBusProxyPtr &proxy) const;
 
 private:
+    friend class ClientApproverAdaptor;
+    friend class ClientHandlerAdaptor;
+    friend class ClientObserverAdaptor;
+
+    TP_QT_NO_EXPORT PendingReady *proxy(const ConnectionPtr &connection,
+            const QString &channelPath, const QVariantMap &immutableProperties,
+            bool satisfyFromImmutableProperties) const;
+
     struct Private;
     Private *mPriv;
 };
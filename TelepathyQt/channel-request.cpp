@@ -49,6 +49,9 @@ struct TP_QT_NO_EXPORT ChannelRequest::Private
 
     static void introspectMain(Private *self);
 
+    bool immutableMainProps(QVariantMap &props) const;
+    void satisfyFromImmutableProperties();
+
     // \param lastCall Is this the last call to extractMainProps ie. should actions that only must
     // be done once be done in this call
     void extractMainProps(const QVariantMap &props, bool lastCall);
@@ -149,23 +152,7 @@ ChannelRequest::Private::~Private()
 void ChannelRequest::Private::introspectMain(ChannelRequest::Private *self)
 {
     QVariantMap props;
-    QString key;
-    bool needIntrospectMainProps = false;
-    const char *propertiesNames[] = { "Account", "UserActionTime",
-        "PreferredHandler", "Requests", "Interfaces",
-        NULL };
-    for (unsigned i = 0; propertiesNames[i] != NULL; ++i) {
-        key = TP_QT_IFACE_CHANNEL_REQUEST + QLatin1String(".");
-        key += QLatin1String(propertiesNames[i]);
-        if (!self->immutableProperties.contains(key)) {
-            needIntrospectMainProps = true;
-            break;
-        }
-        props.insert(QLatin1String(propertiesNames[i]),
-                self->immutableProperties[key]);
-    }
-
-    if (needIntrospectMainProps) {
+    if (!self->immutableMainProps(props)) {
         debug() << "Calling Properties::GetAll(ChannelRequest)";
         QDBusPendingCallWatcher *watcher =
             new QDBusPendingCallWatcher(
@@ -186,6 +173,46 @@ void ChannelRequest::Private::introspectMain(ChannelRequest::Private *self)
     }
 }
 
+bool ChannelRequest::Private::immutableMainProps(QVariantMap &props) const
+{
+    QString key;
+    const char *propertiesNames[] = { "Account", "UserActionTime",
+        "PreferredHandler", "Requests", "Interfaces",
+        NULL };
+    for (unsigned i = 0; propertiesNames[i] != NULL; ++i) {
+        key = TP_QT_IFACE_CHANNEL_REQUEST + QLatin1String(".");
+        key += QLatin1String(propertiesNames[i]);
+        if (!immutableProperties.contains(key)) {
+            return false;
+        }
+        props.insert(QLatin1String(propertiesNames[i]),
+                immutableProperties[key]);
+    }
+
+    return true;
+}
+
+void ChannelRequest::Private::satisfyFromImmutableProperties()
+{
+    QVariantMap props;
+    if (!immutableMainProps(props) || account.isNull() || !account->isReady()) {
+        return;
+    }
+
+    QDBusObjectPath accountObjectPath =
+        qdbus_cast<QDBusObjectPath>(props.value(QLatin1String("Account")));
+    if (accountObjectPath.path() != account->objectPath()) {
+        return;
+    }
+
+    // The properties have all been extracted at construction already, and the account is ready, so
+    // there's nothing the introspection would add
+    debug() << "Supplied properties were sufficient and account was ready, CR"
+        << parent->objectPath() << "is ready without introspection";
+    propertiesDone = true;
+    readinessHelper->forceFeatureSatisfied(FeatureCore);
+}
+
 void ChannelRequest::Private::extractMainProps(const QVariantMap &props, bool lastCall)
 {
     PendingReady *readyOp = 0;
@@ -585,6 +612,14 @@ Client::ChannelRequestInterface *ChannelRequest::baseInterface() const
     return mPriv->baseInterface;
 }
 
+// Used by ClientRegistrar when immediate dispatch is enabled, before becomeReady() is called: if the
+// immutable properties cover everything FeatureCore would introspect, and the account is ready
+// already, the request is made ready straight away
+void ChannelRequest::satisfyFromImmutableProperties()
+{
+    mPriv->satisfyFromImmutableProperties();
+}
+
 void ChannelRequest::gotMainProperties(QDBusPendingCallWatcher *watcher)
 {
     QDBusPendingReply<QVariantMap> reply = *watcher;
@@ -110,8 +110,11 @@ private Q_SLOTS:
 
 private:
     friend class PendingChannelRequest;
+    friend class ClientObserverAdaptor;
+    friend class ClientHandlerAdaptor;
 
     PendingOperation *proceed();
+    TP_QT_NO_EXPORT void satisfyFromImmutableProperties();
 
     struct Private;
     friend struct Private;
@@ -28,9 +28,11 @@
 #include "TelepathyQt/_gen/channel.moc.hpp"
 #include "TelepathyQt/_gen/channel-internal.moc.hpp"
 
+#include "TelepathyQt/dbus-name-owner-cache-internal.h"
 #include "TelepathyQt/debug-internal.h"
 
 #include "TelepathyQt/future-internal.h"
+#include "TelepathyQt/properties-prefetcher-internal.h"
 
 #include <TelepathyQt/ChannelFactory>
 #include <TelepathyQt/Connection>
@@ -59,11 +61,18 @@ using TpFuture::Client::ChannelInterfaceSplittableInterface;
 
 struct TP_QT_NO_EXPORT Channel::Private
 {
+    struct GroupMembersChangedInfo;
+    struct ConferenceChannelRemovedInfo;
+
     Private(Channel *parent, const ConnectionPtr &connection,
             const QVariantMap &immutableProperties);
     ~Private();
 
+    bool isUniqueNameKnown() const;
+    void createInterfaces();
+
     static void introspectMain(Private *self);
+    bool immutableMainProps(QVariantMap &props) const;
     void introspectMainProperties();
     void introspectMainFallbackChannelType();
     void introspectMainFallbackHandle();
@@ -79,6 +88,9 @@ struct TP_QT_NO_EXPORT Channel::Private
 
     void continueIntrospection();
 
+    bool contactsCached(const UIntList &handles) const;
+    void satisfyFromImmutableProperties();
+
     void extractMainProps(const QVariantMap &props);
     void extract0176GroupProps(const QVariantMap &props);
 
@@ -91,6 +103,7 @@ struct TP_QT_NO_EXPORT Channel::Private
     void doMembersChangedDetailed(const UIntList &, const UIntList &, const UIntList &,
             const UIntList &, const QVariantMap &);
     void processMembersChanged();
+    GroupMembersChangedInfo *takeCoalescedMembersChanged();
     void updateContacts(const QList<ContactPtr> &contacts =
             QList<ContactPtr>());
     bool fakeGroupInterfaceIfNeeded();
@@ -113,9 +126,6 @@ struct TP_QT_NO_EXPORT Channel::Private
 
     void processConferenceChannelRemoved();
 
-    struct GroupMembersChangedInfo;
-    struct ConferenceChannelRemovedInfo;
-
     // Public object
     Channel *parent;
 
@@ -139,6 +149,7 @@ struct TP_QT_NO_EXPORT Channel::Private
 
     // Introspection
     QQueue<void (Private::*)()> introspectQueue;
+    bool satisfyingFromImmutableProperties;
 
     // Introspected properties
 
@@ -163,6 +174,7 @@ struct TP_QT_NO_EXPORT Channel::Private
     // Queue of received MCD signals to process
     QQueue<GroupMembersChangedInfo *> groupMembersChangedQueue;
     GroupMembersChangedInfo *currentGroupMembersChangedInfo;
+    bool coalesceGroupMembersChanged;
 
     // Pending from the MCD signal currently processed, but contacts not yet built
     QSet<uint> pendingGroupMembers;
@@ -262,13 +274,14 @@ const QString Channel::Private::GroupMembersChangedInfo::keyContactIds(QLatin1St
 Channel::Private::Private(Channel *parent, const ConnectionPtr &connection,
         const QVariantMap &immutableProperties)
     : parent(parent),
-      baseInterface(new Client::ChannelInterface(parent)),
-      properties(parent->interface<Client::DBus::PropertiesInterface>()),
+      baseInterface(0),
+      properties(0),
       connection(connection),
       immutableProperties(immutableProperties),
       group(0),
       conference(0),
       readinessHelper(parent->readinessHelper()),
+      satisfyingFromImmutableProperties(false),
       targetHandleType(0),
       targetHandle(0),
       requested(false),
@@ -278,6 +291,7 @@ Channel::Private::Private(Channel *parent, const ConnectionPtr &connection,
       groupHaveMembers(false),
       buildingContacts(false),
       currentGroupMembersChangedInfo(0),
+      coalesceGroupMembersChanged(false),
       groupAreHandleOwnersAvailable(false),
       pendingRetrieveGroupSelfContact(false),
       groupIsSelfHandleTracked(false),
@@ -288,11 +302,6 @@ Channel::Private::Private(Channel *parent, const ConnectionPtr &connection,
     debug() << "Creating new Channel:" << parent->objectPath();
 
     if (connection->isValid()) {
-        debug() << " Connecting to Channel::Closed() signal";
-        parent->connect(baseInterface,
-                        SIGNAL(Closed()),
-                        SLOT(onClosed()));
-
         debug() << " Connection to owning connection's lifetime signals";
         parent->connect(connection.data(),
                         SIGNAL(invalidated(Tp::DBusProxy*,QString,QString)),
@@ -305,6 +314,16 @@ Channel::Private::Private(Channel *parent, const ConnectionPtr &connection,
                 QLatin1String("Connection given as the owner of this channel was invalid"));
     }
 
+    // Interfaces bound to a well-known name make QtDBus block on a GetNameOwner call, so if
+    // StatefulDBusProxy is still looking up our unique name, wait for it to be done
+    if (isUniqueNameKnown()) {
+        createInterfaces();
+    } else {
+        parent->connect(DBusNameOwnerCache::forBus(parent->dbusConnection()),
+                SIGNAL(ownerResolved(QString,QString,QString,QString)),
+                SLOT(onUniqueNameResolved()));
+    }
+
     ReadinessHelper::Introspectables introspectables;
 
     // As Channel does not have predefined statuses let's simulate one (0)
@@ -340,6 +359,29 @@ Channel::Private::~Private()
     }
 }
 
+bool Channel::Private::isUniqueNameKnown() const
+{
+    // If the lookup failed, we've been invalidated, and there's nothing more to wait for
+    return parent->busName().startsWith(QLatin1Char(':')) || !parent->isValid();
+}
+
+void Channel::Private::createInterfaces()
+{
+    if (baseInterface) {
+        return;
+    }
+
+    baseInterface = new Client::ChannelInterface(parent);
+    properties = parent->interface<Client::DBus::PropertiesInterface>();
+
+    if (parent->isValid()) {
+        debug() << " Connecting to Channel::Closed() signal";
+        parent->connect(baseInterface,
+                        SIGNAL(Closed()),
+                        SLOT(onClosed()));
+    }
+}
+
 void Channel::Private::introspectMain(Channel::Private *self)
 {
     // Make sure connection object is ready, as we need to use some methods that
@@ -350,11 +392,8 @@ void Channel::Private::introspectMain(Channel::Private *self)
             SLOT(onConnectionReady(Tp::PendingOperation*)));
 }
 
-void Channel::Private::introspectMainProperties()
+bool Channel::Private::immutableMainProps(QVariantMap &props) const
 {
-    QVariantMap props;
-    QString key;
-    bool needIntrospectMainProps = false;
     const unsigned numNames = 8;
     const static QString names[numNames] = {
         QLatin1String("ChannelType"),
@@ -379,12 +418,19 @@ void Channel::Private::introspectMainProperties()
     for (unsigned i = 0; i < numNames; ++i) {
         const QString &qualified = qualifiedNames[i];
         if (!immutableProperties.contains(qualified)) {
-            needIntrospectMainProps = true;
-            break;
+            return false;
         }
         props.insert(names[i], immutableProperties.value(qualified));
     }
 
+    return true;
+}
+
+void Channel::Private::introspectMainProperties()
+{
+    QVariantMap props;
+    bool needIntrospectMainProps = !immutableMainProps(props);
+
     // Save Requested and InitiatorHandle here, so even if the GetAll return doesn't have them but
     // the given immutable props do (eg. due to the PendingChannel fallback guesses) we use them
     requested = qdbus_cast<bool>(props[QLatin1String("Requested")]);
@@ -399,7 +445,8 @@ void Channel::Private::introspectMainProperties()
         debug() << "Calling Properties::GetAll(Channel)";
         QDBusPendingCallWatcher *watcher =
             new QDBusPendingCallWatcher(
-                    properties->GetAll(TP_QT_IFACE_CHANNEL),
+                    PropertiesPrefetcher::forBus(parent->dbusConnection())->getAll(
+                        parent, TP_QT_IFACE_CHANNEL),
                     parent);
         parent->connect(watcher,
                 SIGNAL(finished(QDBusPendingCallWatcher*)),
@@ -483,7 +530,8 @@ void Channel::Private::introspectGroup()
     debug() << "Calling Properties::GetAll(Channel.Interface.Group)";
     QDBusPendingCallWatcher *watcher =
         new QDBusPendingCallWatcher(
-                properties->GetAll(TP_QT_IFACE_CHANNEL_INTERFACE_GROUP),
+                PropertiesPrefetcher::forBus(parent->dbusConnection())->getAll(
+                    parent, TP_QT_IFACE_CHANNEL_INTERFACE_GROUP),
                 parent);
     parent->connect(watcher,
                     SIGNAL(finished(QDBusPendingCallWatcher*)),
@@ -560,7 +608,8 @@ void Channel::Private::introspectConference()
 
     debug() << "Calling Properties::GetAll(Channel.Interface.Conference)";
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
-            properties->GetAll(TP_QT_IFACE_CHANNEL_INTERFACE_CONFERENCE),
+            PropertiesPrefetcher::forBus(parent->dbusConnection())->getAll(
+                parent, TP_QT_IFACE_CHANNEL_INTERFACE_CONFERENCE),
             parent);
     parent->connect(watcher,
             SIGNAL(finished(QDBusPendingCallWatcher*)),
@@ -600,6 +649,67 @@ void Channel::Private::continueIntrospection()
     }
 }
 
+bool Channel::Private::contactsCached(const UIntList &handles) const
+{
+    ContactManagerPtr manager = connection->contactManager();
+    Features features = connection->contactFactory()->features();
+    foreach (uint handle, handles) {
+        ContactPtr contact = manager->lookupContactByHandle(handle);
+        if (!contact || !(features - contact->requestedFeatures()).isEmpty()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Channel::Private::satisfyFromImmutableProperties()
+{
+    QVariantMap props;
+    if (readinessHelper->requestedFeatures().contains(FeatureCore) || !parent->isValid() ||
+            !connection->isReady(Connection::FeatureCore) || !immutableMainProps(props) ||
+            qdbus_cast<QString>(props.value(QLatin1String("ChannelType"))).isEmpty()) {
+        return;
+    }
+
+    // The state of these is only known by asking the channel
+    QStringList interfaces = qdbus_cast<QStringList>(props.value(QLatin1String("Interfaces")));
+    if (interfaces.contains(TP_QT_IFACE_CHANNEL_INTERFACE_GROUP) ||
+            interfaces.contains(TP_QT_IFACE_CHANNEL_INTERFACE_CONFERENCE)) {
+        return;
+    }
+
+    // Work out which contacts buildContacts() would ask for: the faked group members of a 1-1
+    // channel, or the initiator otherwise, together with the self contact. They all need to be
+    // around already, with the features the factory would build them with.
+    uint selfHandle = connection->selfHandle();
+    uint handleType = qdbus_cast<uint>(props.value(QLatin1String("TargetHandleType")));
+    uint target = qdbus_cast<uint>(props.value(QLatin1String("TargetHandle")));
+    uint initiator = qdbus_cast<uint>(props.value(QLatin1String("InitiatorHandle")));
+    UIntList handles;
+    if (handleType == HandleTypeContact ? (selfHandle && target) : initiator != 0) {
+        handles << selfHandle;
+        if (handleType == HandleTypeContact) {
+            handles << target;
+        }
+        if (initiator) {
+            handles << initiator;
+        }
+    }
+    if (!contactsCached(handles)) {
+        return;
+    }
+
+    // Run the same steps as the introspection would, which now all complete synchronously
+    debug() << "Supplied properties were sufficient and connection and contacts were ready,"
+        << "Channel" << parent->objectPath() << "is ready without introspection";
+    satisfyingFromImmutableProperties = true;
+    groupSelfHandle = selfHandle;
+    introspectMainProperties();
+    satisfyingFromImmutableProperties = false;
+    Q_ASSERT(parent->isReady(FeatureCore));
+}
+
 void Channel::Private::extractMainProps(const QVariantMap &props)
 {
     const static QString keyChannelType(QLatin1String("ChannelType"));
@@ -872,6 +982,17 @@ void Channel::Private::buildContacts()
         return;
     }
 
+    if (satisfyingFromImmutableProperties) {
+        // satisfyFromImmutableProperties() made sure they are all there already
+        QList<ContactPtr> contacts;
+        foreach (uint handle, toBuild) {
+            contacts.append(manager->lookupContactByHandle(handle));
+        }
+        buildingContacts = false;
+        updateContacts(contacts);
+        return;
+    }
+
     PendingContacts *pendingContacts = manager->contactsForHandles(
             toBuild);
     parent->connect(pendingContacts,
@@ -928,7 +1049,11 @@ void Channel::Private::processMembersChanged()
     // contact is the same as the current contact.
     pendingRetrieveGroupSelfContact = false;
 
-    currentGroupMembersChangedInfo = groupMembersChangedQueue.dequeue();
+    if (coalesceGroupMembersChanged) {
+        currentGroupMembersChangedInfo = takeCoalescedMembersChanged();
+    } else {
+        currentGroupMembersChangedInfo = groupMembersChangedQueue.dequeue();
+    }
 
     foreach (uint handle, currentGroupMembersChangedInfo->added) {
         if (!groupContacts.contains(handle)) {
@@ -964,6 +1089,131 @@ void Channel::Private::processMembersChanged()
     buildContacts();
 }
 
+Channel::Private::GroupMembersChangedInfo *Channel::Private::takeCoalescedMembersChanged()
+{
+    Q_ASSERT(!groupMembersChangedQueue.isEmpty());
+
+    GroupMembersChangedInfo *first = groupMembersChangedQueue.dequeue();
+    if (groupMembersChangedQueue.isEmpty()) {
+        return first;
+    }
+
+    // Only fold changes carrying the same details (actor, reason, message, ...) so that
+    // every emitted groupMembersChanged still has the details of the changes it reports, in
+    // the order the CM signalled them. The contact-ids are only hints and are merged instead.
+    QVariantMap firstDetails = first->details;
+    HandleIdentifierMap contactIds = qdbus_cast<HandleIdentifierMap>(
+            firstDetails.take(GroupMembersChangedInfo::keyContactIds));
+
+    enum MemberState {
+        StateRemoved,
+        StateMember,
+        StateLocalPending,
+        StateRemotePending
+    };
+    QHash<uint, MemberState> states;
+    UIntList order;
+
+    GroupMembersChangedInfo *info = first;
+    int coalesced = 0;
+    forever {
+        foreach (uint handle, info->removed) {
+            if (!states.contains(handle)) {
+                order.append(handle);
+            }
+            states.insert(handle, StateRemoved);
+        }
+        foreach (uint handle, info->added) {
+            if (!states.contains(handle)) {
+                order.append(handle);
+            }
+            states.insert(handle, StateMember);
+        }
+        foreach (uint handle, info->localPending) {
+            if (!states.contains(handle)) {
+                order.append(handle);
+            }
+            states.insert(handle, StateLocalPending);
+        }
+        foreach (uint handle, info->remotePending) {
+            if (!states.contains(handle)) {
+                order.append(handle);
+            }
+            states.insert(handle, StateRemotePending);
+        }
+
+        if (info != first) {
+            delete info;
+        }
+        ++coalesced;
+
+        if (groupMembersChangedQueue.isEmpty()) {
+            break;
+        }
+
+        QVariantMap nextDetails = groupMembersChangedQueue.head()->details;
+        HandleIdentifierMap nextContactIds = qdbus_cast<HandleIdentifierMap>(
+                nextDetails.take(GroupMembersChangedInfo::keyContactIds));
+        if (nextDetails != firstDetails) {
+            break;
+        }
+
+        contactIds.unite(nextContactIds);
+        info = groupMembersChangedQueue.dequeue();
+    }
+
+    if (coalesced == 1) {
+        return first;
+    }
+
+    debug() << "Coalesced" << coalesced << "MembersChanged events into one";
+
+    // Report each member's final state against the one it had before the folded changes, so
+    // that a member who left and came back, or joined and left, isn't reported at all
+    UIntList added;
+    UIntList removed;
+    UIntList localPending;
+    UIntList remotePending;
+    foreach (uint handle, order) {
+        MemberState previous = StateRemoved;
+        if (groupContacts.contains(handle)) {
+            previous = StateMember;
+        } else if (groupLocalPendingContacts.contains(handle)) {
+            previous = StateLocalPending;
+        } else if (groupRemotePendingContacts.contains(handle)) {
+            previous = StateRemotePending;
+        }
+
+        MemberState current = states.value(handle);
+        if (current == previous && !(current == StateRemoved && handle == groupSelfHandle)) {
+            continue;
+        }
+
+        switch (current) {
+            case StateRemoved:
+                removed.append(handle);
+                break;
+            case StateMember:
+                added.append(handle);
+                break;
+            case StateLocalPending:
+                localPending.append(handle);
+                break;
+            case StateRemotePending:
+                remotePending.append(handle);
+                break;
+        }
+    }
+
+    QVariantMap details = first->details;
+    if (!contactIds.isEmpty()) {
+        details.insert(GroupMembersChangedInfo::keyContactIds, QVariant::fromValue(contactIds));
+    }
+    delete first;
+
+    return new GroupMembersChangedInfo(added, removed, localPending, remotePending, details);
+}
+
 void Channel::Private::updateContacts(const QList<ContactPtr> &contacts)
 {
     Contacts groupContactsAdded;
@@ -1164,7 +1414,11 @@ void Channel::Private::setReady()
             "tracked:" << (groupIsSelfHandleTracked ? "yes" : "no");
     }
 
-    readinessHelper->setIntrospectCompleted(FeatureCore, true);
+    if (satisfyingFromImmutableProperties) {
+        readinessHelper->forceFeatureSatisfied(FeatureCore);
+    } else {
+        readinessHelper->setIntrospectCompleted(FeatureCore, true);
+    }
 }
 
 QString Channel::Private::groupMemberChangeDetailsTelepathyError(
@@ -1829,7 +2083,7 @@ PendingOperation *Channel::requestClose()
         return new PendingSuccess(ChannelPtr(this));
     }
 
-    return new PendingVoid(mPriv->baseInterface->Close(), ChannelPtr(this));
+    return new PendingVoid(baseInterface()->Close(), ChannelPtr(this));
 }
 
 Channel::PendingLeave::PendingLeave(const ChannelPtr &chan, const QString &message,
@@ -2615,6 +2869,40 @@ ContactPtr Channel::groupSelfContact() const
     return mPriv->groupSelfContact;
 }
 
+/**
+ * Return whether queued group membership changes are coalesced before being signalled.
+ *
+ * \return \c true if coalescing is enabled, \c false otherwise.
+ * \sa setGroupCoalescesMembersChanged()
+ */
+bool Channel::groupCoalescesMembersChanged() const
+{
+    return mPriv->coalesceGroupMembersChanged;
+}
+
+/**
+ * Set whether queued group membership changes should be coalesced before being signalled.
+ *
+ * By default each MembersChanged event received from the service is processed on its own: the
+ * Contact objects for the handles it mentions are built and groupMembersChanged() is emitted
+ * before the next event is looked at. When coalescing is enabled, all the consecutive events
+ * queued while contacts are being built which carry the same details (actor, reason, message,
+ * etc.) are folded into their net effect, the contacts for all of them are built in one go and a
+ * single groupMembersChanged() is emitted. Events with different details are never folded
+ * together, so the details passed to groupMembersChanged() always match the changes being
+ * reported and are signalled in the order the service emitted them.
+ *
+ * This is useful for channels with a large number of members, such as chat rooms, where joining
+ * would otherwise result in a contact building round-trip for each batch of members announced.
+ *
+ * \param coalesce Whether to coalesce membership changes.
+ * \sa groupCoalescesMembersChanged()
+ */
+void Channel::setGroupCoalescesMembersChanged(bool coalesce)
+{
+    mPriv->coalesceGroupMembersChanged = coalesce;
+}
+
 /**
  * Return whether the local user is in the "local pending" state. This
  * indicates that the local user needs to take action to accept an invitation,
@@ -2857,9 +3145,25 @@ PendingOperation *Channel::conferenceSplitChannel()
  */
 Client::ChannelInterface *Channel::baseInterface() const
 {
+    // If this is needed before our unique name is known, there's no way around binding to the
+    // well-known name
+    mPriv->createInterfaces();
     return mPriv->baseInterface;
 }
 
+void Channel::onUniqueNameResolved()
+{
+    if (!mPriv->isUniqueNameKnown()) {
+        return;
+    }
+
+    disconnect(DBusNameOwnerCache::forBus(dbusConnection()),
+            SIGNAL(ownerResolved(QString,QString,QString,QString)),
+            this,
+            SLOT(onUniqueNameResolved()));
+    mPriv->createInterfaces();
+}
+
 void Channel::gotMainProperties(QDBusPendingCallWatcher *watcher)
 {
     QDBusPendingReply<QVariantMap> reply = *watcher;
@@ -2954,6 +3258,28 @@ void Channel::onClosed()
     invalidate(error, message);
 }
 
+// Used by ChannelFactory for ClientRegistrar when immediate dispatch is enabled, before
+// becomeReady() is called: if the immutable properties cover everything FeatureCore would
+// introspect, and the connection and the contacts involved are ready already, the channel is made
+// ready straight away
+void Channel::satisfyFromImmutableProperties()
+{
+    mPriv->satisfyFromImmutableProperties();
+}
+
+// Used by subclasses to reuse the Contact object the connection already has for \a handle, if it
+// was built with at least the features the contact factory would build it with; otherwise they
+// fall back to ContactManager::contactsForHandles()
+ContactPtr Channel::cachedContact(uint handle) const
+{
+    ConnectionPtr conn = connection();
+    ContactPtr contact = conn->contactManager()->lookupContactByHandle(handle);
+    if (contact && contact->requestedFeatures().contains(conn->contactFactory()->features())) {
+        return contact;
+    }
+    return ContactPtr();
+}
+
 void Channel::onConnectionReady(PendingOperation *op)
 {
     if (op->isError()) {
@@ -151,6 +151,9 @@ public:
     bool groupIsSelfContactTracked() const;
     ContactPtr groupSelfContact() const;
 
+    bool groupCoalescesMembersChanged() const;
+    void setGroupCoalescesMembersChanged(bool coalesce);
+
     bool isConference() const;
     Contacts conferenceInitialInviteeContacts() const;
     QList<ChannelPtr> conferenceChannels() const;
@@ -195,10 +198,13 @@ protected:
 
     bool groupSelfHandleIsLocalPending() const;
 
+    TP_QT_NO_EXPORT ContactPtr cachedContact(uint handle) const;
+
 protected Q_SLOTS:
     PendingOperation *groupAddSelfHandle();
 
 private Q_SLOTS:
+    TP_QT_NO_EXPORT void onUniqueNameResolved();
     TP_QT_NO_EXPORT void gotMainProperties(QDBusPendingCallWatcher *watcher);
     TP_QT_NO_EXPORT void gotChannelType(QDBusPendingCallWatcher *watcher);
     TP_QT_NO_EXPORT void gotHandle(QDBusPendingCallWatcher *watcher);
@@ -238,8 +244,11 @@ private Q_SLOTS:
 
 private:
     class PendingLeave;
+    friend class ChannelFactory;
     friend class PendingLeave;
 
+    TP_QT_NO_EXPORT void satisfyFromImmutableProperties();
+
     struct Private;
     friend struct Private;
     Private *mPriv;
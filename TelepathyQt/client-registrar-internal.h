@@ -23,7 +23,11 @@
 #ifndef _TelepathyQt_client_registrar_internal_h_HEADER_GUARD_
 #define _TelepathyQt_client_registrar_internal_h_HEADER_GUARD_
 
+#include <QtCore/QHash>
 #include <QtCore/QObject>
+#include <QtCore/QQueue>
+#include <QtCore/QTime>
+#include <QtCore/QVector>
 #include <QtDBus/QtDBus>
 
 #include <TelepathyQt/AbstractClientHandler>
@@ -38,6 +42,99 @@ namespace Tp
 
 class PendingOperation;
 
+class TP_QT_NO_EXPORT ClientInvocationMetrics
+{
+public:
+    ClientInvocationMetrics();
+
+    void invocationQueued(int queueDepth);
+    void invocationReady(int msecs, bool failed);
+    void invocationDequeued(int queueDepth);
+
+    int queueDepth() const { return mQueueDepth; }
+    int peakQueueDepth() const { return mPeakQueueDepth; }
+    uint completedInvocations() const { return mCompleted; }
+    uint failedInvocations() const { return mFailed; }
+    QVector<int> timeToReadySamples() const;
+
+private:
+    // Only the most recent samples are kept, so percentiles reflect the current load
+    enum { MaxSamples = 512 };
+
+    int mQueueDepth;
+    int mPeakQueueDepth;
+    uint mCompleted;
+    uint mFailed;
+    QVector<int> mSamples;
+    int mNextSample;
+};
+
+struct TP_QT_NO_EXPORT ClientInvocationData : RefCounted
+{
+    ClientInvocationData() : readyOp(0) {}
+
+    PendingOperation *readyOp;
+    QString error, message;
+    QTime queuedTime;
+};
+
+/*
+ * Invocations have to be released to the client in the order they arrived, but their proxies may
+ * become ready in any order. The queue keeps the arrival order and indexes the pending invocations
+ * by their ready operation, so finding the one that finished doesn't require a scan.
+ */
+template <class Invocation>
+class ClientInvocationQueue
+{
+public:
+    void enqueue(const SharedPtr<Invocation> &invocation)
+    {
+        Q_ASSERT(invocation->readyOp);
+        invocation->queuedTime.start();
+        mPending.insert(invocation->readyOp, invocation);
+        mQueue.enqueue(invocation);
+        mMetrics.invocationQueued(mQueue.size());
+    }
+
+    // For invocations whose proxies were all ready by the time they arrived, so that they don't
+    // have a ready operation to wait for
+    void enqueueReady(const SharedPtr<Invocation> &invocation)
+    {
+        Q_ASSERT(!invocation->readyOp);
+        mQueue.enqueue(invocation);
+        mMetrics.invocationQueued(mQueue.size());
+        mMetrics.invocationReady(0, false);
+    }
+
+    SharedPtr<Invocation> markReady(PendingOperation *op)
+    {
+        SharedPtr<Invocation> invocation = mPending.take(op);
+        if (invocation) {
+            invocation->readyOp = 0;
+            mMetrics.invocationReady(invocation->queuedTime.elapsed(), op->isError());
+        }
+        return invocation;
+    }
+
+    bool isEmpty() const { return mQueue.isEmpty(); }
+    bool hasReady() const { return !mQueue.isEmpty() && !mQueue.head()->readyOp; }
+
+    SharedPtr<Invocation> takeReady()
+    {
+        Q_ASSERT(hasReady());
+        SharedPtr<Invocation> invocation = mQueue.dequeue();
+        mMetrics.invocationDequeued(mQueue.size());
+        return invocation;
+    }
+
+    const ClientInvocationMetrics &metrics() const { return mMetrics; }
+
+private:
+    QQueue<SharedPtr<Invocation> > mQueue;
+    QHash<PendingOperation *, SharedPtr<Invocation> > mPending;
+    ClientInvocationMetrics mMetrics;
+};
+
 class TP_QT_NO_EXPORT ClientAdaptor : public QDBusAbstractAdaptor
 {
     Q_OBJECT
@@ -103,6 +200,11 @@ public:
         return mRegistrar;
     }
 
+    inline const ClientInvocationMetrics &invocationMetrics() const
+    {
+        return mInvocations.metrics();
+    }
+
 public: // Properties
     inline Tp::ChannelClassList ObserverChannelFilter() const
     {
@@ -127,13 +229,10 @@ private Q_SLOTS:
     void onReadyOpFinished(Tp::PendingOperation *);
 
 private:
-    struct InvocationData : RefCounted
-    {
-        InvocationData() : readyOp(0) {}
-
-        PendingOperation *readyOp;
-        QString error, message;
+    void invokeReady();
 
+    struct InvocationData : ClientInvocationData
+    {
         MethodInvocationContextPtr<> ctx;
         AccountPtr acc;
         ConnectionPtr conn;
@@ -142,7 +241,7 @@ private:
         QList<ChannelRequestPtr> chanReqs;
         AbstractClientObserver::ObserverInfo observerInfo;
     };
-    QLinkedList<SharedPtr<InvocationData> > mInvocations;
+    ClientInvocationQueue<InvocationData> mInvocations;
 
     ClientRegistrar *mRegistrar;
     QDBusConnection mBus;
@@ -177,6 +276,11 @@ public:
         return mRegistrar;
     }
 
+    inline const ClientInvocationMetrics &invocationMetrics() const
+    {
+        return mInvocations.metrics();
+    }
+
 public: // Properties
     inline Tp::ChannelClassList ApproverChannelFilter() const
     {
@@ -193,18 +297,15 @@ private Q_SLOTS:
     void onReadyOpFinished(Tp::PendingOperation *);
 
 private:
-    struct InvocationData : RefCounted
-    {
-        InvocationData() : readyOp(0) {}
-
-        PendingOperation *readyOp;
-        QString error, message;
+    void invokeReady();
 
+    struct InvocationData : ClientInvocationData
+    {
         MethodInvocationContextPtr<> ctx;
         QList<ChannelPtr> chans;
         ChannelDispatchOperationPtr dispatchOp;
     };
-    QLinkedList<SharedPtr<InvocationData> > mInvocations;
+    ClientInvocationQueue<InvocationData> mInvocations;
 
 private:
     ClientRegistrar *mRegistrar;
@@ -249,6 +350,11 @@ public:
         return mRegistrar;
     }
 
+    inline const ClientInvocationMetrics &invocationMetrics() const
+    {
+        return mInvocations.metrics();
+    }
+
 public: // Properties
     inline Tp::ChannelClassList HandlerChannelFilter() const
     {
@@ -283,13 +389,10 @@ private Q_SLOTS:
     void onReadyOpFinished(Tp::PendingOperation *);
 
 private:
-    struct InvocationData : RefCounted
-    {
-        InvocationData() : readyOp(0) {}
-
-        PendingOperation *readyOp;
-        QString error, message;
+    void invokeReady();
 
+    struct InvocationData : ClientInvocationData
+    {
         MethodInvocationContextPtr<> ctx;
         AccountPtr acc;
         ConnectionPtr conn;
@@ -298,7 +401,7 @@ private:
         QDateTime time;
         AbstractClientHandler::HandlerInfo handlerInfo;
     };
-    QLinkedList<SharedPtr<InvocationData> > mInvocations;
+    ClientInvocationQueue<InvocationData> mInvocations;
 
 private:
     static void onContextFinished(const MethodInvocationContextPtr<> &context,
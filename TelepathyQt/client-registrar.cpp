@@ -28,6 +28,7 @@
 
 #include "TelepathyQt/channel-factory.h"
 #include "TelepathyQt/debug-internal.h"
+#include "TelepathyQt/pending-ready-internal.h"
 #include "TelepathyQt/request-temporary-handler-internal.h"
 
 #include <TelepathyQt/Account>
@@ -40,6 +41,8 @@
 #include <TelepathyQt/PendingComposite>
 #include <TelepathyQt/PendingReady>
 
+#include <QtAlgorithms>
+
 namespace Tp
 {
 
@@ -84,6 +87,47 @@ private:
     void *mFinishedCbData;
 };
 
+ClientInvocationMetrics::ClientInvocationMetrics()
+    : mQueueDepth(0),
+      mPeakQueueDepth(0),
+      mCompleted(0),
+      mFailed(0),
+      mNextSample(0)
+{
+}
+
+void ClientInvocationMetrics::invocationQueued(int queueDepth)
+{
+    mQueueDepth = queueDepth;
+    mPeakQueueDepth = qMax(mPeakQueueDepth, queueDepth);
+}
+
+void ClientInvocationMetrics::invocationReady(int msecs, bool failed)
+{
+    if (failed) {
+        ++mFailed;
+    } else {
+        ++mCompleted;
+    }
+
+    if (mSamples.size() < MaxSamples) {
+        mSamples.append(msecs);
+    } else {
+        mSamples[mNextSample] = msecs;
+        mNextSample = (mNextSample + 1) % MaxSamples;
+    }
+}
+
+void ClientInvocationMetrics::invocationDequeued(int queueDepth)
+{
+    mQueueDepth = queueDepth;
+}
+
+QVector<int> ClientInvocationMetrics::timeToReadySamples() const
+{
+    return mSamples;
+}
+
 ClientAdaptor::ClientAdaptor(ClientRegistrar *registrar, const QStringList &interfaces,
         QObject *parent)
     : QDBusAbstractAdaptor(parent),
@@ -147,7 +191,8 @@ void ClientObserverAdaptor::ObserveChannels(const QDBusObjectPath &accountPath,
 
     foreach (const ChannelDetails &channelDetails, channelDetailsList) {
         PendingReady *chanReady = chanFactory->proxy(invocation->conn,
-                channelDetails.channel.path(), channelDetails.properties);
+                channelDetails.channel.path(), channelDetails.properties,
+                mRegistrar->isImmediateDispatchEnabled());
         ChannelPtr channel = ChannelPtr::qObjectCast(chanReady->proxy());
         invocation->chans.append(channel);
         readyOps.append(chanReady);
@@ -201,18 +246,29 @@ void ClientObserverAdaptor::ObserveChannels(const QDBusObjectPath &accountPath,
         }
         ChannelRequestPtr channelRequest = ChannelRequest::create(invocation->acc,
                 reqPath.path(), reqPropsMap.value(reqPath));
+        if (mRegistrar->isImmediateDispatchEnabled()) {
+            channelRequest->satisfyFromImmutableProperties();
+        }
         invocation->chanReqs.append(channelRequest);
         readyOps.append(channelRequest->becomeReady());
     }
 
     invocation->ctx = MethodInvocationContextPtr<>(new MethodInvocationContext<>(mBus, message));
 
+    if (mRegistrar->isImmediateDispatchEnabled() && readyOpsSatisfied(readyOps)) {
+        debug() << "Proxies for ObserveChannels of" << channelDetailsList.size() << "channels"
+            << "already ready for client" << mClient;
+        mInvocations.enqueueReady(invocation);
+        invokeReady();
+        return;
+    }
+
     invocation->readyOp = new PendingComposite(readyOps, invocation->ctx);
     connect(invocation->readyOp,
             SIGNAL(finished(Tp::PendingOperation*)),
             SLOT(onReadyOpFinished(Tp::PendingOperation*)));
 
-    mInvocations.append(invocation);
+    mInvocations.enqueue(invocation);
 
     debug() << "Preparing proxies for ObserveChannels of" << channelDetailsList.size() << "channels"
         << "for client" << mClient;
@@ -223,26 +279,21 @@ void ClientObserverAdaptor::onReadyOpFinished(Tp::PendingOperation *op)
     Q_ASSERT(!mInvocations.isEmpty());
     Q_ASSERT(op->isFinished());
 
-    for (QLinkedList<SharedPtr<InvocationData> >::iterator i = mInvocations.begin();
-            i != mInvocations.end(); ++i) {
-        if ((*i)->readyOp != op) {
-            continue;
-        }
-
-        (*i)->readyOp = 0;
-
-        if (op->isError()) {
-            warning() << "Preparing proxies for ObserveChannels failed with" << op->errorName()
-                << op->errorMessage();
-            (*i)->error = op->errorName();
-            (*i)->message = op->errorMessage();
-        }
-
-        break;
+    SharedPtr<InvocationData> finished = mInvocations.markReady(op);
+    if (finished && op->isError()) {
+        warning() << "Preparing proxies for ObserveChannels failed with" << op->errorName()
+            << op->errorMessage();
+        finished->error = op->errorName();
+        finished->message = op->errorMessage();
     }
 
-    while (!mInvocations.isEmpty() && !mInvocations.first()->readyOp) {
-        SharedPtr<InvocationData> invocation = mInvocations.takeFirst();
+    invokeReady();
+}
+
+void ClientObserverAdaptor::invokeReady()
+{
+    while (mInvocations.hasReady()) {
+        SharedPtr<InvocationData> invocation = mInvocations.takeReady();
 
         if (!invocation->error.isEmpty()) {
             // We guarantee that the proxies were ready - so we can't invoke the client if they
@@ -301,7 +352,7 @@ void ClientApproverAdaptor::AddDispatchOperation(const Tp::ChannelDetailsList &c
 
     foreach (const ChannelDetails &channelDetails, channelDetailsList) {
         PendingReady *chanReady = chanFactory->proxy(connection, channelDetails.channel.path(),
-                channelDetails.properties);
+                channelDetails.properties, mRegistrar->isImmediateDispatchEnabled());
         invocation->chans.append(ChannelPtr::qObjectCast(chanReady->proxy()));
         readyOps.append(chanReady);
     }
@@ -309,16 +360,26 @@ void ClientApproverAdaptor::AddDispatchOperation(const Tp::ChannelDetailsList &c
     invocation->dispatchOp = ChannelDispatchOperation::create(mBus,
             dispatchOperationPath.path(), properties, invocation->chans, accFactory, connFactory,
             chanFactory, contactFactory);
+    if (mRegistrar->isImmediateDispatchEnabled()) {
+        invocation->dispatchOp->satisfyFromImmutableProperties();
+    }
     readyOps.append(invocation->dispatchOp->becomeReady());
 
     invocation->ctx = MethodInvocationContextPtr<>(new MethodInvocationContext<>(mBus, message));
 
+    if (mRegistrar->isImmediateDispatchEnabled() && readyOpsSatisfied(readyOps)) {
+        debug() << "Proxies for AddDispatchOperation already ready for client" << mClient;
+        mInvocations.enqueueReady(invocation);
+        invokeReady();
+        return;
+    }
+
     invocation->readyOp = new PendingComposite(readyOps, invocation->ctx);
     connect(invocation->readyOp,
             SIGNAL(finished(Tp::PendingOperation*)),
             SLOT(onReadyOpFinished(Tp::PendingOperation*)));
 
-    mInvocations.append(invocation);
+    mInvocations.enqueue(invocation);
 }
 
 void ClientApproverAdaptor::onReadyOpFinished(Tp::PendingOperation *op)
@@ -326,26 +387,21 @@ void ClientApproverAdaptor::onReadyOpFinished(Tp::PendingOperation *op)
     Q_ASSERT(!mInvocations.isEmpty());
     Q_ASSERT(op->isFinished());
 
-    for (QLinkedList<SharedPtr<InvocationData> >::iterator i = mInvocations.begin();
-            i != mInvocations.end(); ++i) {
-        if ((*i)->readyOp != op) {
-            continue;
-        }
-
-        (*i)->readyOp = 0;
-
-        if (op->isError()) {
-            warning() << "Preparing proxies for AddDispatchOperation failed with" << op->errorName()
-                << op->errorMessage();
-            (*i)->error = op->errorName();
-            (*i)->message = op->errorMessage();
-        }
-
-        break;
+    SharedPtr<InvocationData> finished = mInvocations.markReady(op);
+    if (finished && op->isError()) {
+        warning() << "Preparing proxies for AddDispatchOperation failed with" << op->errorName()
+            << op->errorMessage();
+        finished->error = op->errorName();
+        finished->message = op->errorMessage();
     }
 
-    while (!mInvocations.isEmpty() && !mInvocations.first()->readyOp) {
-        SharedPtr<InvocationData> invocation = mInvocations.takeFirst();
+    invokeReady();
+}
+
+void ClientApproverAdaptor::invokeReady()
+{
+    while (mInvocations.hasReady()) {
+        SharedPtr<InvocationData> invocation = mInvocations.takeReady();
 
         if (!invocation->error.isEmpty()) {
             // We guarantee that the proxies were ready - so we can't invoke the client if they
@@ -430,7 +486,8 @@ void ClientHandlerAdaptor::HandleChannels(const QDBusObjectPath &accountPath,
 
     foreach (const ChannelDetails &channelDetails, channelDetailsList) {
         PendingReady *chanReady = chanFactory->proxy(invocation->conn,
-                channelDetails.channel.path(), channelDetails.properties);
+                channelDetails.channel.path(), channelDetails.properties,
+                mRegistrar->isImmediateDispatchEnabled());
         ChannelPtr channel = ChannelPtr::qObjectCast(chanReady->proxy());
         invocation->chans.append(channel);
         readyOps.append(chanReady);
@@ -449,6 +506,9 @@ void ClientHandlerAdaptor::HandleChannels(const QDBusObjectPath &accountPath,
         }
         ChannelRequestPtr channelRequest = ChannelRequest::create(invocation->acc,
                 reqPath.path(), reqPropsMap.value(reqPath));
+        if (mRegistrar->isImmediateDispatchEnabled()) {
+            channelRequest->satisfyFromImmutableProperties();
+        }
         invocation->chanReqs.append(channelRequest);
         readyOps.append(channelRequest->becomeReady());
     }
@@ -464,12 +524,20 @@ void ClientHandlerAdaptor::HandleChannels(const QDBusObjectPath &accountPath,
                     &ClientHandlerAdaptor::onContextFinished),
                 this);
 
+    if (mRegistrar->isImmediateDispatchEnabled() && readyOpsSatisfied(readyOps)) {
+        debug() << "Proxies for HandleChannels of" << channelDetailsList.size() << "channels"
+            << "already ready for client" << mClient;
+        mInvocations.enqueueReady(invocation);
+        invokeReady();
+        return;
+    }
+
     invocation->readyOp = new PendingComposite(readyOps, invocation->ctx);
     connect(invocation->readyOp,
             SIGNAL(finished(Tp::PendingOperation*)),
             SLOT(onReadyOpFinished(Tp::PendingOperation*)));
 
-    mInvocations.append(invocation);
+    mInvocations.enqueue(invocation);
 
     debug() << "Preparing proxies for HandleChannels of" << channelDetailsList.size() << "channels"
         << "for client" << mClient;
@@ -480,26 +548,21 @@ void ClientHandlerAdaptor::onReadyOpFinished(Tp::PendingOperation *op)
     Q_ASSERT(!mInvocations.isEmpty());
     Q_ASSERT(op->isFinished());
 
-    for (QLinkedList<SharedPtr<InvocationData> >::iterator i = mInvocations.begin();
-            i != mInvocations.end(); ++i) {
-        if ((*i)->readyOp != op) {
-            continue;
-        }
-
-        (*i)->readyOp = 0;
-
-        if (op->isError()) {
-            warning() << "Preparing proxies for HandleChannels failed with" << op->errorName()
-                << op->errorMessage();
-            (*i)->error = op->errorName();
-            (*i)->message = op->errorMessage();
-        }
-
-        break;
+    SharedPtr<InvocationData> finished = mInvocations.markReady(op);
+    if (finished && op->isError()) {
+        warning() << "Preparing proxies for HandleChannels failed with" << op->errorName()
+            << op->errorMessage();
+        finished->error = op->errorName();
+        finished->message = op->errorMessage();
     }
 
-    while (!mInvocations.isEmpty() && !mInvocations.first()->readyOp) {
-        SharedPtr<InvocationData> invocation = mInvocations.takeFirst();
+    invokeReady();
+}
+
+void ClientHandlerAdaptor::invokeReady()
+{
+    while (mInvocations.hasReady()) {
+        SharedPtr<InvocationData> invocation = mInvocations.takeReady();
 
         if (!invocation->error.isEmpty()) {
             RequestTemporaryHandler *tempHandler = dynamic_cast<RequestTemporaryHandler *>(mClient);
@@ -589,7 +652,7 @@ struct TP_QT_NO_EXPORT ClientRegistrar::Private
             const ConnectionFactoryConstPtr &connFactory, const ChannelFactoryConstPtr &chanFactory,
             const ContactFactoryConstPtr &contactFactory)
         : bus(bus), accFactory(accFactory), connFactory(connFactory), chanFactory(chanFactory),
-        contactFactory(contactFactory)
+        contactFactory(contactFactory), immediateDispatch(false)
     {
         if (accFactory->dbusConnection().name() != bus.name()) {
             warning() << "  The D-Bus connection in the account factory is not the proxy connection";
@@ -611,11 +674,153 @@ struct TP_QT_NO_EXPORT ClientRegistrar::Private
     ChannelFactoryConstPtr chanFactory;
     ContactFactoryConstPtr contactFactory;
 
+    bool immediateDispatch;
+
     QHash<AbstractClientPtr, QString> clients;
     QHash<AbstractClientPtr, QObject*> clientObjects;
     QSet<QString> services;
 };
 
+struct TP_QT_NO_EXPORT ClientRegistrar::InvocationStatistics::Private : public QSharedData
+{
+    Private(const ClientInvocationMetrics &metrics)
+        : queueDepth(metrics.queueDepth()),
+          peakQueueDepth(metrics.peakQueueDepth()),
+          completedInvocations(metrics.completedInvocations()),
+          failedInvocations(metrics.failedInvocations()),
+          timeToReady(metrics.timeToReadySamples())
+    {
+        qSort(timeToReady);
+    }
+
+    int queueDepth;
+    int peakQueueDepth;
+    uint completedInvocations;
+    uint failedInvocations;
+    QVector<int> timeToReady;
+};
+
+/**
+ * \class ClientRegistrar::InvocationStatistics
+ * \ingroup serverclient
+ * \headerfile TelepathyQt/client-registrar.h <TelepathyQt/ClientRegistrar>
+ *
+ * \brief The ClientRegistrar::InvocationStatistics class provides a snapshot of the
+ * invocation queue of one of the D-Bus interfaces exported for a registered client.
+ *
+ * Each time an Observer, Approver or Handler method is invoked on a client, the
+ * proxies passed to it are made ready before the client is called, and the
+ * invocations are released to the client in the order they arrived. This class
+ * reports how many invocations are waiting for that and how long preparing the
+ * proxies took.
+ *
+ * \sa ClientRegistrar::invocationStatistics()
+ */
+
+/**
+ * Construct a new invalid InvocationStatistics object.
+ */
+ClientRegistrar::InvocationStatistics::InvocationStatistics()
+{
+}
+
+ClientRegistrar::InvocationStatistics::InvocationStatistics(const ClientInvocationMetrics &metrics)
+    : mPriv(new Private(metrics))
+{
+}
+
+/**
+ * Copy constructor.
+ */
+ClientRegistrar::InvocationStatistics::InvocationStatistics(const InvocationStatistics &other)
+    : mPriv(other.mPriv)
+{
+}
+
+/**
+ * Class destructor.
+ */
+ClientRegistrar::InvocationStatistics::~InvocationStatistics()
+{
+}
+
+ClientRegistrar::InvocationStatistics &ClientRegistrar::InvocationStatistics::operator=(
+        const InvocationStatistics &other)
+{
+    mPriv = other.mPriv;
+    return *this;
+}
+
+/**
+ * \fn bool ClientRegistrar::InvocationStatistics::isValid() const
+ *
+ * Return whether this object contains statistics for an exported client interface.
+ *
+ * \return \c true if valid, \c false otherwise.
+ */
+
+/**
+ * Return the number of invocations currently waiting for their proxies to become
+ * ready or for an earlier invocation to be released to the client.
+ *
+ * \return The queue depth.
+ */
+int ClientRegistrar::InvocationStatistics::queueDepth() const
+{
+    return isValid() ? mPriv->queueDepth : 0;
+}
+
+/**
+ * Return the largest number of invocations that have been queued at the same time.
+ *
+ * \return The peak queue depth.
+ */
+int ClientRegistrar::InvocationStatistics::peakQueueDepth() const
+{
+    return isValid() ? mPriv->peakQueueDepth : 0;
+}
+
+/**
+ * Return the number of invocations for which the proxies were successfully made ready.
+ *
+ * \return The number of completed invocations.
+ */
+uint ClientRegistrar::InvocationStatistics::completedInvocations() const
+{
+    return isValid() ? mPriv->completedInvocations : 0;
+}
+
+/**
+ * Return the number of invocations which failed because their proxies couldn't be
+ * made ready.
+ *
+ * \return The number of failed invocations.
+ */
+uint ClientRegistrar::InvocationStatistics::failedInvocations() const
+{
+    return isValid() ? mPriv->failedInvocations : 0;
+}
+
+/**
+ * Return the time it took to make the proxies of an invocation ready, in milliseconds,
+ * at the given \a percentile.
+ *
+ * Only the most recent invocations are taken into account.
+ *
+ * \param percentile The percentile, in the range 0 to 100.
+ * \return The time to ready in milliseconds, or -1 if no invocation has become ready yet.
+ */
+int ClientRegistrar::InvocationStatistics::timeToReadyPercentile(int percentile) const
+{
+    if (!isValid() || mPriv->timeToReady.isEmpty()) {
+        return -1;
+    }
+
+    percentile = qBound(0, percentile, 100);
+    int index = ((mPriv->timeToReady.size() - 1) * percentile + 50) / 100;
+    return mPriv->timeToReady.at(index);
+}
+
 /**
  * \class ClientRegistrar
  * \ingroup serverclient
@@ -841,6 +1046,55 @@ ContactFactoryConstPtr ClientRegistrar::contactFactory() const
     return mPriv->contactFactory;
 }
 
+/**
+ * Return whether immediate dispatch is enabled on this client registrar.
+ *
+ * \return \c true if immediate dispatch is enabled, \c false otherwise.
+ * \sa setImmediateDispatchEnabled()
+ */
+bool ClientRegistrar::isImmediateDispatchEnabled() const
+{
+    return mPriv->immediateDispatch;
+}
+
+/**
+ * Set whether immediate dispatch is enabled on this client registrar.
+ *
+ * The proxies passed to the registered clients are always made ready before the
+ * clients are invoked. By default, the clients are invoked from the mainloop once
+ * that has been found out, even if there was nothing to wait for.
+ *
+ * With immediate dispatch enabled, a client is instead invoked while the D-Bus method
+ * call is being processed if all of the proxies for it are ready already. That is
+ * the case when the features the factories make ready on them are satisfied, either
+ * because the proxies were made ready before, or because the immutable properties
+ * supplied with the call cover them. For instance, with the default channel factory,
+ * which doesn't make any channel feature ready, AbstractClientHandler::handleChannels()
+ * is called without any D-Bus round trip or mainloop iteration once the Account
+ * objects are ready.
+ *
+ * Only in this mode are the ChannelRequest and ChannelDispatchOperation objects
+ * passed to the clients marked ready as soon as they are constructed, when the
+ * immutable properties supplied with the call are complete and the Account and
+ * Connection objects they refer to are ready. Likewise, Channel::FeatureCore is
+ * marked ready on a new channel when its immutable properties are complete, its
+ * Connection is ready, it has neither the Group nor the Conference interface, and
+ * the Contact objects for the initiator, target and self handles already exist
+ * with the features the contact factory makes ready. Otherwise, they become ready
+ * from the mainloop like any other proxy.
+ *
+ * Invocations are still released to the clients in the order they arrived, so an
+ * invocation whose proxies are all ready waits for any earlier one that is still
+ * being prepared.
+ *
+ * \param enabled Whether to enable immediate dispatch.
+ * \sa isImmediateDispatchEnabled()
+ */
+void ClientRegistrar::setImmediateDispatchEnabled(bool enabled)
+{
+    mPriv->immediateDispatch = enabled;
+}
+
 /**
  * Return the list of clients registered using registerClient() on this client
  * registrar.
@@ -853,6 +1107,46 @@ QList<AbstractClientPtr> ClientRegistrar::registeredClients() const
     return mPriv->clients.keys();
 }
 
+/**
+ * Return statistics about the invocations of the given D-Bus \a interface exported for
+ * \a client.
+ *
+ * \a interface should be one of #TP_QT_IFACE_CLIENT_OBSERVER, #TP_QT_IFACE_CLIENT_APPROVER or
+ * #TP_QT_IFACE_CLIENT_HANDLER.
+ *
+ * \param client The registered client.
+ * \param interface The D-Bus interface of the client.
+ * \return The statistics, or an invalid InvocationStatistics object if \a client is not
+ *         registered on this client registrar or doesn't implement \a interface.
+ */
+ClientRegistrar::InvocationStatistics ClientRegistrar::invocationStatistics(
+        const AbstractClientPtr &client, const QString &interface) const
+{
+    QObject *object = mPriv->clientObjects.value(client);
+    if (!object) {
+        return InvocationStatistics();
+    }
+
+    if (interface == TP_QT_IFACE_CLIENT_OBSERVER) {
+        ClientObserverAdaptor *adaptor = object->findChild<ClientObserverAdaptor *>();
+        if (adaptor) {
+            return InvocationStatistics(adaptor->invocationMetrics());
+        }
+    } else if (interface == TP_QT_IFACE_CLIENT_APPROVER) {
+        ClientApproverAdaptor *adaptor = object->findChild<ClientApproverAdaptor *>();
+        if (adaptor) {
+            return InvocationStatistics(adaptor->invocationMetrics());
+        }
+    } else if (interface == TP_QT_IFACE_CLIENT_HANDLER) {
+        ClientHandlerAdaptor *adaptor = object->findChild<ClientHandlerAdaptor *>();
+        if (adaptor) {
+            return InvocationStatistics(adaptor->invocationMetrics());
+        }
+    }
+
+    return InvocationStatistics();
+}
+
 /**
  * Register a client on D-Bus.
  *
@@ -35,17 +35,47 @@
 #include <TelepathyQt/Types>
 
 #include <QDBusConnection>
+#include <QSharedDataPointer>
 #include <QString>
 
 namespace Tp
 {
 
+class ClientInvocationMetrics;
+
 class TP_QT_EXPORT ClientRegistrar : public Object
 {
     Q_OBJECT
     Q_DISABLE_COPY(ClientRegistrar)
 
 public:
+    class InvocationStatistics
+    {
+    public:
+        InvocationStatistics();
+        InvocationStatistics(const InvocationStatistics &other);
+        ~InvocationStatistics();
+
+        InvocationStatistics &operator=(const InvocationStatistics &other);
+
+        bool isValid() const { return mPriv.constData() != 0; }
+
+        int queueDepth() const;
+        int peakQueueDepth() const;
+        uint completedInvocations() const;
+        uint failedInvocations() const;
+        int timeToReadyPercentile(int percentile) const;
+
+    private:
+        friend class ClientRegistrar;
+
+        InvocationStatistics(const ClientInvocationMetrics &metrics);
+
+        struct Private;
+        friend struct Private;
+        QSharedDataPointer<Private> mPriv;
+    };
+
     static ClientRegistrarPtr create(const QDBusConnection &bus);
     static ClientRegistrarPtr create(
             const AccountFactoryConstPtr &accountFactory =
@@ -72,12 +102,18 @@ public:
     ChannelFactoryConstPtr channelFactory() const;
     ContactFactoryConstPtr contactFactory() const;
 
+    bool isImmediateDispatchEnabled() const;
+    void setImmediateDispatchEnabled(bool enabled);
+
     QList<AbstractClientPtr> registeredClients() const;
     bool registerClient(const AbstractClientPtr &client,
             const QString &clientName, bool unique = false);
     bool unregisterClient(const AbstractClientPtr &client);
     void unregisterClients();
 
+    InvocationStatistics invocationStatistics(const AbstractClientPtr &client,
+            const QString &interface) const;
+
 private:
     ClientRegistrar(const QDBusConnection &bus,
             const AccountFactoryConstPtr &accountFactory,
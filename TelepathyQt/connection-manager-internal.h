@@ -26,10 +26,12 @@
 #include <TelepathyQt/PendingStringList>
 
 #include <QDBusConnection>
+#include <QDataStream>
 #include <QLatin1String>
 #include <QQueue>
 #include <QSet>
 #include <QString>
+#include <QStringList>
 
 namespace Tp
 {
@@ -47,7 +49,18 @@ struct TP_QT_NO_EXPORT ConnectionManager::Private
 
     bool parseConfigFile();
 
+    QString executableCacheStamp() const;
+    void introspectWithCache();
+    bool loadIntrospectionCache();
+    void saveIntrospectionCache(const QStringList &interfaces, const ProtocolInfoList &protocols);
+    bool readCachedProtocol(QDataStream &in, ProtocolInfo &info);
+    static bool writeCachedProtocol(QDataStream &out, const ProtocolInfo &info);
+    static QString introspectionCacheFileName(const QString &name);
+    void introspectionFinished(bool success, const QString &errorName = QString(),
+            const QString &errorMessage = QString());
+
     static void introspectMain(Private *self);
+    void introspectMainProperties();
     void introspectProtocolsLegacy();
     void introspectParametersLegacy();
 
@@ -79,6 +92,16 @@ struct TP_QT_NO_EXPORT ConnectionManager::Private
     QQueue<QString> parametersQueue;
     ProtocolInfoList protocols;
     QSet<SharedPtr<ProtocolWrapper> > wrappers;
+
+    // Results of the D-Bus introspection in progress, only made public once it has finished so
+    // that a background revalidation of cached data doesn't disturb what is already exposed
+    QStringList introspectedInterfaces;
+    ProtocolInfoList introspectedProtocols;
+    bool revalidatingCache;
+    // What identifies the build of the CM introspected, see introspectMain()
+    QString cacheStamp;
+
+    static bool introspectionCacheEnabled;
 };
 
 struct TP_QT_NO_EXPORT ConnectionManagerLowlevel::Private
@@ -30,6 +30,7 @@
 #include "TelepathyQt/_gen/connection-manager-internal.moc.hpp"
 #include "TelepathyQt/_gen/connection-manager-lowlevel.moc.hpp"
 
+#include "TelepathyQt/dbus-name-owner-cache-internal.h"
 #include "TelepathyQt/debug-internal.h"
 #include "TelepathyQt/manager-file.h"
 
@@ -43,13 +44,75 @@
 #include <TelepathyQt/Utils>
 
 #include <QDBusConnectionInterface>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QQueue>
 #include <QStringList>
+#include <QTextStream>
 #include <QTimer>
 
 namespace Tp
 {
 
+namespace
+{
+
+// Bump the version whenever the layout written by saveIntrospectionCache() changes
+const quint32 introspectionCacheMagic = 0x54504d43; // "TPMC"
+const quint32 introspectionCacheVersion = 1;
+
+bool isCacheable(const QVariant &value)
+{
+    if (value.type() == QVariant::List) {
+        foreach (const QVariant &item, value.toList()) {
+            if (!isCacheable(item)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (value.type() == QVariant::Map) {
+        foreach (const QVariant &item, value.toMap()) {
+            if (!isCacheable(item)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // D-Bus specific types such as object paths and nested structs have no stream operators
+    return value.userType() < QMetaType::User;
+}
+
+QStringList dataDirs()
+{
+    QStringList dirs;
+
+    QString xdgDataHome = QString::fromLocal8Bit(qgetenv("XDG_DATA_HOME"));
+    if (xdgDataHome.isEmpty()) {
+        dirs << QDir::homePath() + QLatin1String("/.local/share");
+    } else {
+        dirs << xdgDataHome;
+    }
+
+    QString xdgDataDirsEnv = QString::fromLocal8Bit(qgetenv("XDG_DATA_DIRS"));
+    if (xdgDataDirsEnv.isEmpty()) {
+        dirs << QLatin1String("/usr/local/share");
+        dirs << QLatin1String("/usr/share");
+    } else {
+        dirs << xdgDataDirsEnv.split(QLatin1Char(':'), QString::SkipEmptyParts);
+    }
+
+    return dirs;
+}
+
+}
+
+bool ConnectionManager::Private::introspectionCacheEnabled = false;
+
 ConnectionManager::Private::PendingNames::PendingNames(const QDBusConnection &bus)
     : PendingStringList(SharedPtr<RefCounted>()),
       mBus(bus)
@@ -530,7 +593,8 @@ ConnectionManager::Private::Private(ConnectionManager *parent, const QString &na
       readinessHelper(parent->readinessHelper()),
       connFactory(connFactory),
       chanFactory(chanFactory),
-      contactFactory(contactFactory)
+      contactFactory(contactFactory),
+      revalidatingCache(false)
 {
     debug() << "Creating new ConnectionManager:" << parent->busName();
 
@@ -590,6 +654,292 @@ bool ConnectionManager::Private::parseConfigFile()
     return true;
 }
 
+/*
+ * Return what identifies the build of the CM from the modification time of the executable named in
+ * its D-Bus service file, so that cached introspection data survives restarts of the CM but not
+ * upgrades. An empty stamp is returned for CMs which can't be activated, such as the ones run from
+ * a build tree, see introspectMain().
+ */
+QString ConnectionManager::Private::executableCacheStamp() const
+{
+    QString serviceFileName = QString(QLatin1String("/dbus-1/services/%1.service"))
+        .arg(parent->busName());
+    foreach (const QString &dataDir, dataDirs()) {
+        QFile serviceFile(dataDir + serviceFileName);
+        if (!serviceFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            continue;
+        }
+
+        QTextStream stream(&serviceFile);
+        while (!stream.atEnd()) {
+            QString line = stream.readLine().trimmed();
+            if (!line.startsWith(QLatin1String("Exec="))) {
+                continue;
+            }
+
+            QString executable = line.mid(5).trimmed().section(QLatin1Char(' '), 0, 0);
+            QFileInfo executableInfo(executable);
+            if (executableInfo.exists()) {
+                return QString(QLatin1String("exec:%1:%2"))
+                    .arg(executableInfo.absoluteFilePath())
+                    .arg(executableInfo.lastModified().toTime_t());
+            }
+            break;
+        }
+    }
+
+    return QString();
+}
+
+QString ConnectionManager::Private::introspectionCacheFileName(const QString &name)
+{
+    QString cacheHome = QString::fromLocal8Bit(qgetenv("XDG_CACHE_HOME"));
+    if (cacheHome.isEmpty()) {
+        cacheHome = QDir::homePath() + QLatin1String("/.cache");
+    }
+
+    return QString(QLatin1String("%1/telepathy/qt/managers/%2.cache")).arg(cacheHome).arg(name);
+}
+
+bool ConnectionManager::Private::loadIntrospectionCache()
+{
+    if (cacheStamp.isEmpty()) {
+        return false;
+    }
+
+    QFile file(introspectionCacheFileName(name));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_6);
+
+    quint32 magic, version;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != introspectionCacheMagic ||
+            version != introspectionCacheVersion) {
+        debug() << "Ignoring introspection cache of unknown format for" << name;
+        return false;
+    }
+
+    QString cachedStamp;
+    in >> cachedStamp;
+    if (cachedStamp != cacheStamp) {
+        debug() << "Introspection cache for" << name << "is stale";
+        return false;
+    }
+
+    QStringList cachedInterfaces;
+    quint32 count;
+    in >> cachedInterfaces >> count;
+
+    ProtocolInfoList cachedProtocols;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        ProtocolInfo info;
+        if (!readCachedProtocol(in, info)) {
+            break;
+        }
+        cachedProtocols.append(info);
+    }
+
+    if (in.status() != QDataStream::Ok || (quint32) cachedProtocols.size() != count) {
+        warning() << "Introspection cache for" << name << "is corrupt - ignoring";
+        return false;
+    }
+
+    parent->setInterfaces(cachedInterfaces);
+    readinessHelper->setInterfaces(cachedInterfaces);
+    protocols = cachedProtocols;
+    return true;
+}
+
+void ConnectionManager::Private::saveIntrospectionCache(const QStringList &interfaces,
+        const ProtocolInfoList &protocols)
+{
+    if (cacheStamp.isEmpty()) {
+        debug() << "Not caching the introspection data for" << name <<
+            "as its version can't be told";
+        return;
+    }
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_6);
+
+    out << introspectionCacheMagic << introspectionCacheVersion << cacheStamp << interfaces <<
+        (quint32) protocols.size();
+    foreach (const ProtocolInfo &info, protocols) {
+        if (!writeCachedProtocol(out, info)) {
+            debug() << "Not caching the introspection data for" << name <<
+                "as protocol" << info.name() << "has values which can't be stored";
+            return;
+        }
+    }
+
+    // Write to a temporary file first so that readers never see a partially written cache
+    QString fileName = introspectionCacheFileName(name);
+    QString tmpFileName = fileName + QLatin1String(".tmp");
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QFile file(tmpFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+            file.write(data) != data.size()) {
+        warning() << "Unable to write introspection cache" << tmpFileName;
+        file.close();
+        QFile::remove(tmpFileName);
+        return;
+    }
+    file.close();
+
+    QFile::remove(fileName);
+    if (!QFile::rename(tmpFileName, fileName)) {
+        warning() << "Unable to move introspection cache into place at" << fileName;
+        QFile::remove(tmpFileName);
+        return;
+    }
+
+    debug() << "Cached the introspection data for" << name << "at" << fileName;
+}
+
+bool ConnectionManager::Private::readCachedProtocol(QDataStream &in, ProtocolInfo &info)
+{
+    QString protocolName, vcardField, englishName, iconName;
+    in >> protocolName >> vcardField >> englishName >> iconName;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    info = ProtocolInfo(ConnectionManagerPtr(parent), protocolName);
+    info.setVCardField(vcardField);
+    info.setEnglishName(englishName);
+    info.setIconName(iconName);
+
+    quint32 count;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        ParamSpec spec;
+        QVariant defaultValue;
+        in >> spec.name >> spec.flags >> spec.signature >> defaultValue;
+        spec.defaultValue = QDBusVariant(defaultValue);
+        info.addParameter(spec);
+    }
+
+    RequestableChannelClassList rccs;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        RequestableChannelClass rcc;
+        in >> rcc.fixedProperties >> rcc.allowedProperties;
+        rccs.append(rcc);
+    }
+    info.setRequestableChannelClasses(rccs);
+
+    SimpleStatusSpecMap statuses;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString status;
+        SimpleStatusSpec spec;
+        in >> status >> spec.type >> spec.maySetOnSelf >> spec.canHaveMessage;
+        statuses.insert(status, spec);
+    }
+    info.setAllowedPresenceStatuses(PresenceSpecList(statuses));
+
+    QStringList supportedMimeTypes;
+    uint minHeight, maxHeight, recommendedHeight, minWidth, maxWidth, recommendedWidth, maxBytes;
+    in >> supportedMimeTypes >> minHeight >> maxHeight >> recommendedHeight >>
+        minWidth >> maxWidth >> recommendedWidth >> maxBytes;
+    info.setAvatarRequirements(AvatarSpec(supportedMimeTypes,
+                minHeight, maxHeight, recommendedHeight,
+                minWidth, maxWidth, recommendedWidth,
+                maxBytes));
+
+    QStringList vcardFields, uriSchemes;
+    in >> vcardFields >> uriSchemes;
+    info.setAddressableVCardFields(vcardFields);
+    info.setAddressableUriSchemes(uriSchemes);
+
+    return in.status() == QDataStream::Ok;
+}
+
+bool ConnectionManager::Private::writeCachedProtocol(QDataStream &out, const ProtocolInfo &info)
+{
+    out << info.name() << info.vcardField() << info.englishName() << info.iconName();
+
+    ProtocolParameterList params = info.parameters();
+    out << (quint32) params.size();
+    foreach (const ProtocolParameter &param, params) {
+        ParamSpec spec = param.bareParameter();
+        QVariant defaultValue = spec.defaultValue.variant();
+        if (!isCacheable(defaultValue)) {
+            return false;
+        }
+        out << spec.name << spec.flags << spec.signature << defaultValue;
+    }
+
+    RequestableChannelClassList rccs = info.capabilities().allClassSpecs().bareClasses();
+    out << (quint32) rccs.size();
+    foreach (const RequestableChannelClass &rcc, rccs) {
+        if (!isCacheable(rcc.fixedProperties)) {
+            return false;
+        }
+        out << rcc.fixedProperties << rcc.allowedProperties;
+    }
+
+    SimpleStatusSpecMap statuses = info.allowedPresenceStatuses().bareSpecs();
+    out << (quint32) statuses.size();
+    for (SimpleStatusSpecMap::const_iterator i = statuses.constBegin();
+            i != statuses.constEnd(); ++i) {
+        out << i.key() << i->type << i->maySetOnSelf << i->canHaveMessage;
+    }
+
+    AvatarSpec avatarSpec = info.avatarRequirements();
+    out << avatarSpec.supportedMimeTypes() <<
+        avatarSpec.minimumHeight() << avatarSpec.maximumHeight() <<
+        avatarSpec.recommendedHeight() << avatarSpec.minimumWidth() <<
+        avatarSpec.maximumWidth() << avatarSpec.recommendedWidth() <<
+        avatarSpec.maximumBytes();
+
+    out << info.addressableVCardFields() << info.addressableUriSchemes();
+
+    return out.status() == QDataStream::Ok;
+}
+
+/*
+ * Called once the D-Bus introspection started by introspectMain() is over, successfully or not.
+ */
+void ConnectionManager::Private::introspectionFinished(bool success, const QString &errorName,
+        const QString &errorMessage)
+{
+    QStringList interfaces = introspectedInterfaces;
+    ProtocolInfoList protocolsFound = introspectedProtocols;
+    introspectedInterfaces.clear();
+    introspectedProtocols.clear();
+
+    if (revalidatingCache) {
+        // FeatureCore has already been completed from the cache, only the cache is updated here
+        revalidatingCache = false;
+        if (success) {
+            saveIntrospectionCache(interfaces, protocolsFound);
+        } else {
+            warning().nospace() << "Revalidating the introspection cache for " << name <<
+                " failed: " << errorName << ": " << errorMessage;
+        }
+        return;
+    }
+
+    if (success) {
+        parent->setInterfaces(interfaces);
+        readinessHelper->setInterfaces(interfaces);
+        protocols = protocolsFound;
+
+        if (introspectionCacheEnabled) {
+            saveIntrospectionCache(interfaces, protocols);
+        }
+    }
+
+    readinessHelper->setIntrospectCompleted(FeatureCore, success, errorName, errorMessage);
+}
+
 void ConnectionManager::Private::introspectMain(ConnectionManager::Private *self)
 {
     if (self->parseConfigFile()) {
@@ -597,12 +947,49 @@ void ConnectionManager::Private::introspectMain(ConnectionManager::Private *self
         return;
     }
 
-    warning() << "Error parsing config file for connection manager"
-        << self->name << "- introspecting";
+    if (!introspectionCacheEnabled) {
+        warning() << "Error parsing config file for connection manager"
+            << self->name << "- introspecting";
+        self->introspectMainProperties();
+        return;
+    }
+
+    self->cacheStamp = self->executableCacheStamp();
+    if (!self->cacheStamp.isEmpty()) {
+        self->introspectWithCache();
+        return;
+    }
 
+    // The CM can't be activated, so the cached data is only valid for as long as the process
+    // currently owning its bus name is running
+    DBusNameOwnerCache *owners = DBusNameOwnerCache::forBus(self->parent->dbusConnection());
+    self->parent->connect(owners,
+            SIGNAL(ownerResolved(QString,QString,QString,QString)),
+            SLOT(gotIntrospectionCacheOwner(QString,QString,QString,QString)));
+    owners->resolveOwner(self->parent->busName());
+}
+
+void ConnectionManager::Private::introspectWithCache()
+{
+    if (loadIntrospectionCache()) {
+        debug() << "Got the introspection data for" << name << "from the cache";
+        readinessHelper->setIntrospectCompleted(FeatureCore, true);
+
+        // Introspect anyway, so that the cache is fresh the next time around
+        revalidatingCache = true;
+    } else {
+        warning() << "Error parsing config file for connection manager"
+            << name << "- introspecting";
+    }
+
+    introspectMainProperties();
+}
+
+void ConnectionManager::Private::introspectMainProperties()
+{
     debug() << "Calling Properties::GetAll(ConnectionManager)";
-    PendingVariantMap *pvm = self->baseInterface->requestAllProperties();
-    self->parent->connect(pvm,
+    PendingVariantMap *pvm = baseInterface->requestAllProperties();
+    parent->connect(pvm,
             SIGNAL(finished(Tp::PendingOperation*)),
             SLOT(gotMainProperties(Tp::PendingOperation*)));
 }
@@ -959,6 +1346,45 @@ PendingStringList *ConnectionManager::listNames(const QDBusConnection &bus)
     return new ConnectionManager::Private::PendingNames(bus);
 }
 
+/**
+ * Return whether the introspection data of connection managers is cached on disk.
+ *
+ * \return \c true if the introspection cache is used, \c false otherwise.
+ * \sa setIntrospectionCacheEnabled()
+ */
+bool ConnectionManager::isIntrospectionCacheEnabled()
+{
+    return Private::introspectionCacheEnabled;
+}
+
+/**
+ * Set whether the introspection data of connection managers should be cached on disk.
+ *
+ * Connection managers installing a .manager file are described by it and don't need
+ * introspecting. For the others, making FeatureCore ready means asking the connection manager
+ * about each of its protocols over D-Bus, which in turn might mean activating it.
+ *
+ * With the cache enabled, the result of that introspection is stored under
+ * <tt>$XDG_CACHE_HOME/telepathy/qt/managers/</tt>, and later ConnectionManager objects have
+ * FeatureCore ready from there without waiting for the connection manager. The connection manager
+ * is still introspected in the background afterwards, and the cache updated, so that changes
+ * are picked up the next time around.
+ *
+ * The cached data is only used for the same connection manager build it was taken from, as
+ * told by the modification time of the executable named in its D-Bus service file or, failing
+ * that, for as long as the same connection manager process is running.
+ *
+ * The cache is disabled by default. This setting only affects ConnectionManager objects
+ * becoming ready after it has been changed.
+ *
+ * \param enabled Whether to use the introspection cache.
+ * \sa isIntrospectionCacheEnabled()
+ */
+void ConnectionManager::setIntrospectionCacheEnabled(bool enabled)
+{
+    Private::introspectionCacheEnabled = enabled;
+}
+
 ConnectionManagerLowlevelPtr ConnectionManager::lowlevel()
 {
     return mPriv->lowlevel;
@@ -984,6 +1410,28 @@ Client::ConnectionManagerInterface *ConnectionManager::baseInterface() const
 }
 
 /**** Private ****/
+void ConnectionManager::gotIntrospectionCacheOwner(const QString &name, const QString &owner,
+        const QString &errorName, const QString &errorMessage)
+{
+    if (name != busName()) {
+        return;
+    }
+
+    disconnect(DBusNameOwnerCache::forBus(dbusConnection()),
+            SIGNAL(ownerResolved(QString,QString,QString,QString)),
+            this,
+            SLOT(gotIntrospectionCacheOwner(QString,QString,QString,QString)));
+
+    if (!owner.isEmpty()) {
+        mPriv->cacheStamp = QString(QLatin1String("owner:%1")).arg(owner);
+    } else {
+        debug().nospace() << "Unable to get the owner of " << name << " to check the "
+            "introspection cache: " << errorName << ": " << errorMessage;
+    }
+
+    mPriv->introspectWithCache();
+}
+
 void ConnectionManager::gotMainProperties(Tp::PendingOperation *op)
 {
     QVariantMap props;
@@ -997,16 +1445,15 @@ void ConnectionManager::gotMainProperties(Tp::PendingOperation *op)
         // If Interfaces is not supported, the spec says to assume it's
         // empty, so keep the empty list mPriv was initialized with
         if (props.contains(QLatin1String("Interfaces"))) {
-            setInterfaces(qdbus_cast<QStringList>(props[QLatin1String("Interfaces")]));
-            mPriv->readinessHelper->setInterfaces(interfaces());
+            mPriv->introspectedInterfaces =
+                qdbus_cast<QStringList>(props[QLatin1String("Interfaces")]);
         }
     } else {
         warning().nospace() <<
             "Properties.GetAll(ConnectionManager) failed: " <<
             op->errorName() << ": " << op->errorMessage();
 
-        mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false,
-                op->errorName(), op->errorMessage());
+        mPriv->introspectionFinished(false, op->errorName(), op->errorMessage());
         return;
     }
 
@@ -1051,17 +1498,18 @@ void ConnectionManager::gotProtocolsLegacy(QDBusPendingCallWatcher *watcher)
 
         if (!protocolsNames.isEmpty()) {
             foreach (const QString &protocolName, protocolsNames) {
-                mPriv->protocols.append(ProtocolInfo(ConnectionManagerPtr(this), protocolName));
+                mPriv->introspectedProtocols.append(
+                        ProtocolInfo(ConnectionManagerPtr(this), protocolName));
                 mPriv->parametersQueue.enqueue(protocolName);
             }
 
             mPriv->introspectParametersLegacy();
         } else {
             //no protocols - introspection finished
-            mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, true);
+            mPriv->introspectionFinished(true);
         }
     } else {
-        mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false, reply.error());
+        mPriv->introspectionFinished(false, reply.error().name(), reply.error().message());
 
         warning().nospace() <<
             "ConnectionManager.ListProtocols failed: " <<
@@ -1079,7 +1527,7 @@ void ConnectionManager::gotParametersLegacy(QDBusPendingCallWatcher *watcher)
     QString protocolName = mPriv->parametersQueue.dequeue();
     bool found = false;
     int pos = 0;
-    foreach (const ProtocolInfo &info, mPriv->protocols) {
+    foreach (const ProtocolInfo &info, mPriv->introspectedProtocols) {
         if (info.name() == protocolName) {
             found = true;
             break;
@@ -1092,7 +1540,7 @@ void ConnectionManager::gotParametersLegacy(QDBusPendingCallWatcher *watcher)
     if (!reply.isError()) {
         debug() << QString(QLatin1String("Got reply to ConnectionManager.GetParameters(%1)")).arg(protocolName);
         ParamSpecList parameters = reply.value();
-        ProtocolInfo &info = mPriv->protocols[pos];
+        ProtocolInfo &info = mPriv->introspectedProtocols[pos];
         foreach (const ParamSpec &spec, parameters) {
             debug() << "Parameter" << spec.name << "has flags" << spec.flags
                 << "and signature" << spec.signature;
@@ -1101,7 +1549,7 @@ void ConnectionManager::gotParametersLegacy(QDBusPendingCallWatcher *watcher)
         }
     } else {
         // let's remove this protocol as we can't get the params
-        mPriv->protocols.removeAt(pos);
+        mPriv->introspectedProtocols.removeAt(pos);
 
         warning().nospace() <<
             QString(QLatin1String("ConnectionManager.GetParameters(%1) failed: ")).arg(protocolName) <<
@@ -1109,11 +1557,11 @@ void ConnectionManager::gotParametersLegacy(QDBusPendingCallWatcher *watcher)
     }
 
     if (mPriv->parametersQueue.isEmpty()) {
-        if (!mPriv->protocols.isEmpty()) {
-            mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, true);
+        if (!mPriv->introspectedProtocols.isEmpty()) {
+            mPriv->introspectionFinished(true);
         } else {
             // we could not retrieve the params for any protocol, fail core.
-            mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false, reply.error());
+            mPriv->introspectionFinished(false, reply.error().name(), reply.error().message());
         }
     }
 
@@ -1130,19 +1578,18 @@ void ConnectionManager::onProtocolReady(Tp::PendingOperation *op)
     mPriv->wrappers.remove(wrapper);
 
     if (!op->isError()) {
-        mPriv->protocols.append(info);
+        mPriv->introspectedProtocols.append(info);
     } else {
         warning().nospace() << "Protocol(" << info.name() << ")::becomeReady "
             "failed: " << op->errorName() << ": " << op->errorMessage();
     }
 
     if (mPriv->wrappers.isEmpty()) {
-        if (!mPriv->protocols.isEmpty()) {
-            mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, true);
+        if (!mPriv->introspectedProtocols.isEmpty()) {
+            mPriv->introspectionFinished(true);
         } else {
             // we could not make any Protocol objects ready, fail core.
-            mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false,
-                    op->errorName(), op->errorMessage());
+            mPriv->introspectionFinished(false, op->errorName(), op->errorMessage());
         }
     }
 }
@@ -93,6 +93,9 @@ public:
     static PendingStringList *listNames(
             const QDBusConnection &bus = QDBusConnection::sessionBus());
 
+    static bool isIntrospectionCacheEnabled();
+    static void setIntrospectionCacheEnabled(bool enabled);
+
 #if defined(BUILDING_TP_QT) || defined(TP_QT_ENABLE_LOWLEVEL_API)
     ConnectionManagerLowlevelPtr lowlevel();
     ConnectionManagerLowlevelConstPtr lowlevel() const;
@@ -111,6 +114,8 @@ private Q_SLOTS:
     TP_QT_NO_EXPORT void gotProtocolsLegacy(QDBusPendingCallWatcher *watcher);
     TP_QT_NO_EXPORT void gotParametersLegacy(QDBusPendingCallWatcher *watcher);
     TP_QT_NO_EXPORT void onProtocolReady(Tp::PendingOperation *watcher);
+    TP_QT_NO_EXPORT void gotIntrospectionCacheOwner(const QString &name, const QString &owner,
+            const QString &errorName, const QString &errorMessage);
 
 private:
     friend class PendingConnection;
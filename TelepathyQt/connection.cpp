@@ -30,7 +30,10 @@
 #include "TelepathyQt/_gen/connection-internal.moc.hpp"
 #include "TelepathyQt/_gen/connection-lowlevel.moc.hpp"
 
+#include "TelepathyQt/dbus-call-queue-internal.h"
+#include "TelepathyQt/dbus-name-owner-cache-internal.h"
 #include "TelepathyQt/debug-internal.h"
+#include "TelepathyQt/properties-prefetcher-internal.h"
 
 #include <TelepathyQt/ChannelFactory>
 #include <TelepathyQt/ConnectionCapabilities>
@@ -46,6 +49,7 @@
 #include <TelepathyQt/PendingVoid>
 #include <TelepathyQt/ReferencedHandles>
 
+#include <QDBusMessage>
 #include <QMetaObject>
 #include <QMutex>
 #include <QMutexLocker>
@@ -66,6 +70,8 @@ struct TP_QT_NO_EXPORT Connection::Private
     ~Private();
 
     void init();
+    bool isUniqueNameKnown() const;
+    void createInterfaces();
 
     static void introspectMain(Private *self);
     void introspectMainFallbackStatus();
@@ -199,8 +205,8 @@ Connection::Private::Private(Connection *parent,
       lowlevel(ConnectionLowlevelPtr(new ConnectionLowlevel(parent))),
       chanFactory(chanFactory),
       contactFactory(contactFactory),
-      baseInterface(new Client::ConnectionInterface(parent)),
-      properties(parent->interface<Client::DBus::PropertiesInterface>()),
+      baseInterface(0),
+      properties(0),
       simplePresence(0),
       readinessHelper(parent->readinessHelper()),
       introspectingConnected(false),
@@ -219,8 +225,6 @@ Connection::Private::Private(Connection *parent,
     accountBalance.amount = 0;
     accountBalance.scale = 0;
 
-    Q_ASSERT(properties != 0);
-
     if (chanFactory->dbusConnection().name() != parent->dbusConnection().name()) {
         warning() << "  The D-Bus connection in the channel factory is not the proxy connection";
     }
@@ -347,19 +351,19 @@ Connection::Private::~Private()
                 if (!type.refcounts.empty()) {
                     debug() << " Still had references to" <<
                         type.refcounts.size() << "handles, releasing now";
-                    baseInterface->ReleaseHandles(handleType, type.refcounts.keys());
+                    parent->baseInterface()->ReleaseHandles(handleType, type.refcounts.keys());
                 }
 
                 if (!type.toRelease.empty()) {
                     debug() << " Was going to release" <<
                         type.toRelease.size() << "handles, doing that now";
-                    baseInterface->ReleaseHandles(handleType, type.toRelease.toList());
+                    parent->baseInterface()->ReleaseHandles(handleType, type.toRelease.toList());
                 }
             }
 
         }
 
-        handleContexts.remove(qMakePair(baseInterface->connection().name(),
+        handleContexts.remove(qMakePair(parent->dbusConnection().name(),
                     parent->objectPath()));
         delete handleContext;
     } else {
@@ -369,21 +373,18 @@ Connection::Private::~Private()
 
 void Connection::Private::init()
 {
-    debug() << "Connecting to ConnectionError()";
-    parent->connect(baseInterface,
-            SIGNAL(ConnectionError(QString,QVariantMap)),
-            SLOT(onConnectionError(QString,QVariantMap)));
-    debug() << "Connecting to StatusChanged()";
-    parent->connect(baseInterface,
-            SIGNAL(StatusChanged(uint,uint)),
-            SLOT(onStatusChanged(uint,uint)));
-    debug() << "Connecting to SelfHandleChanged()";
-    parent->connect(baseInterface,
-            SIGNAL(SelfHandleChanged(uint)),
-            SLOT(onSelfHandleChanged(uint)));
+    // Interfaces bound to a well-known name make QtDBus block on a GetNameOwner call, so if
+    // StatefulDBusProxy is still looking up our unique name, wait for it to be done
+    if (isUniqueNameKnown()) {
+        createInterfaces();
+    } else {
+        parent->connect(DBusNameOwnerCache::forBus(parent->dbusConnection()),
+                SIGNAL(ownerResolved(QString,QString,QString,QString)),
+                SLOT(onUniqueNameResolved()));
+    }
 
     QMutexLocker locker(&handleContextsLock);
-    QString busConnectionName = baseInterface->connection().name();
+    QString busConnectionName = parent->dbusConnection().name();
 
     if (handleContexts.contains(qMakePair(busConnectionName, parent->objectPath()))) {
         debug() << "Reusing existing HandleContext for" << parent->objectPath();
@@ -400,12 +401,43 @@ void Connection::Private::init()
     ++handleContext->refcount;
 }
 
+bool Connection::Private::isUniqueNameKnown() const
+{
+    // If the lookup failed, we've been invalidated, and there's nothing more to wait for
+    return parent->busName().startsWith(QLatin1Char(':')) || !parent->isValid();
+}
+
+void Connection::Private::createInterfaces()
+{
+    if (baseInterface) {
+        return;
+    }
+
+    baseInterface = new Client::ConnectionInterface(parent);
+    properties = parent->interface<Client::DBus::PropertiesInterface>();
+    Q_ASSERT(properties != 0);
+
+    debug() << "Connecting to ConnectionError()";
+    parent->connect(baseInterface,
+            SIGNAL(ConnectionError(QString,QVariantMap)),
+            SLOT(onConnectionError(QString,QVariantMap)));
+    debug() << "Connecting to StatusChanged()";
+    parent->connect(baseInterface,
+            SIGNAL(StatusChanged(uint,uint)),
+            SLOT(onStatusChanged(uint,uint)));
+    debug() << "Connecting to SelfHandleChanged()";
+    parent->connect(baseInterface,
+            SIGNAL(SelfHandleChanged(uint)),
+            SLOT(onSelfHandleChanged(uint)));
+}
+
 void Connection::Private::introspectMain(Connection::Private *self)
 {
     debug() << "Calling Properties::GetAll(Connection)";
     QDBusPendingCallWatcher *watcher =
         new QDBusPendingCallWatcher(
-                self->properties->GetAll(TP_QT_IFACE_CONNECTION),
+                PropertiesPrefetcher::forBus(self->parent->dbusConnection())->getAll(
+                    self->parent, TP_QT_IFACE_CONNECTION),
                 self->parent);
     self->parent->connect(watcher,
             SIGNAL(finished(QDBusPendingCallWatcher*)),
@@ -494,8 +526,8 @@ void Connection::Private::introspectSimplePresence(Connection::Private *self)
     debug() << "Calling Properties::Get("
         "Connection.I.SimplePresence.Statuses)";
     QDBusPendingCall call =
-        self->properties->GetAll(
-                TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE);
+        PropertiesPrefetcher::forBus(self->parent->dbusConnection())->getAll(
+                self->parent, TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE);
     QDBusPendingCallWatcher *watcher =
         new QDBusPendingCallWatcher(call, self->parent);
     self->parent->connect(watcher,
@@ -1447,6 +1479,19 @@ ConnectionCapabilities Connection::capabilities() const
     return mPriv->caps;
 }
 
+void Connection::onUniqueNameResolved()
+{
+    if (!mPriv->isUniqueNameKnown()) {
+        return;
+    }
+
+    disconnect(DBusNameOwnerCache::forBus(dbusConnection()),
+            SIGNAL(ownerResolved(QString,QString,QString,QString)),
+            this,
+            SLOT(onUniqueNameResolved()));
+    mPriv->createInterfaces();
+}
+
 void Connection::onStatusReady(uint status)
 {
     Q_ASSERT(status == mPriv->pendingStatus);
@@ -1803,6 +1848,9 @@ void Connection::gotBalance(QDBusPendingCallWatcher *watcher)
  */
 Client::ConnectionInterface *Connection::baseInterface() const
 {
+    // If this is needed before our unique name is known, there's no way around binding to the
+    // well-known name
+    mPriv->createInterfaces();
     return mPriv->baseInterface;
 }
 
@@ -2198,11 +2246,12 @@ PendingContactAttributes *ConnectionLowlevel::contactAttributes(const UIntList &
         handleContext->types[HandleTypeContact].requestsInFlight++;
     }
 
-    Client::ConnectionInterfaceContactsInterface *contactsInterface =
-        conn->interface<Client::ConnectionInterfaceContactsInterface>();
+    QDBusMessage message = QDBusMessage::createMethodCall(conn->busName(), conn->objectPath(),
+            TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS, QLatin1String("GetContactAttributes"));
+    message << QVariant::fromValue(handles) << interfaces << reference;
     QDBusPendingCallWatcher *watcher =
-        new QDBusPendingCallWatcher(contactsInterface->GetContactAttributes(handles, interfaces,
-                    reference));
+        new QDBusPendingCallWatcher(
+                DBusCallQueue::forBus(conn->dbusConnection())->callNow(message));
     pending->connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
                               SLOT(onCallFinished(QDBusPendingCallWatcher*)));
     return pending;
@@ -2373,7 +2422,7 @@ void Connection::doReleaseSweep(uint handleType)
 
     debug() << " Releasing" << handleContext->types[handleType].toRelease.size() << "handles";
 
-    mPriv->baseInterface->ReleaseHandles(handleType, handleContext->types[handleType].toRelease.toList());
+    baseInterface()->ReleaseHandles(handleType, handleContext->types[handleType].toRelease.toList());
     handleContext->types[handleType].toRelease.clear();
 }
 
@@ -201,6 +201,7 @@ protected:
     Client::ConnectionInterface *baseInterface() const;
 
 private Q_SLOTS:
+    TP_QT_NO_EXPORT void onUniqueNameResolved();
     TP_QT_NO_EXPORT void onStatusReady(uint status);
     TP_QT_NO_EXPORT void onStatusChanged(uint status, uint reason);
     TP_QT_NO_EXPORT void onConnectionError(const QString &error, const QVariantMap &details);
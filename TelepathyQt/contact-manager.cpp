@@ -25,6 +25,7 @@
 
 #include "TelepathyQt/_gen/contact-manager.moc.hpp"
 
+#include "TelepathyQt/dbus-call-queue-internal.h"
 #include "TelepathyQt/debug-internal.h"
 #include "TelepathyQt/future-internal.h"
 
@@ -170,12 +171,12 @@ void ContactManager::PendingRefreshContactInfo::refreshInfo()
     }
 
     debug() << "Calling ContactInfo.RefreshContactInfo for" << mToRequest.size() << "handles";
-    Client::ConnectionInterfaceContactInfoInterface *contactInfoInterface =
-        mConn->interface<Client::ConnectionInterfaceContactInfoInterface>();
-    Q_ASSERT(contactInfoInterface);
-    PendingVoid *nested = new PendingVoid(
-            contactInfoInterface->RefreshContactInfo(mToRequest.toList()),
-            mConn);
+    // Nobody is waiting on the refreshed information, so let other calls go first
+    QDBusMessage message = QDBusMessage::createMethodCall(mConn->busName(), mConn->objectPath(),
+            TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_INFO, QLatin1String("RefreshContactInfo"));
+    message << QVariant::fromValue(UIntList(mToRequest.toList()));
+    PendingOperation *nested = DBusCallQueue::forBus(mConn->dbusConnection())->call(message,
+            DBusCallScheduler::PriorityBulk, mConn->objectPath(), mConn);
     connect(nested,
             SIGNAL(finished(Tp::PendingOperation*)),
             SLOT(onRefreshInfoFinished(Tp::PendingOperation*)));
@@ -1306,13 +1307,13 @@ void ContactManager::doRequestAvatars()
 
     debug() << "Requesting avatar(s) for" << contacts.size() - found << "contact(s)";
 
-    Client::ConnectionInterfaceAvatarsInterface *avatarsInterface =
-        connection()->interface<Client::ConnectionInterfaceAvatarsInterface>();
-    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
-        avatarsInterface->RequestAvatars(notFound),
-        this);
-    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), watcher,
-        SLOT(deleteLater()));
+    // The avatars arrive through AvatarRetrieved, so the reply itself doesn't matter
+    ConnectionPtr conn(connection());
+    QDBusMessage message = QDBusMessage::createMethodCall(conn->busName(), conn->objectPath(),
+            TP_QT_IFACE_CONNECTION_INTERFACE_AVATARS, QLatin1String("RequestAvatars"));
+    message << QVariant::fromValue(notFound);
+    DBusCallQueue::forBus(conn->dbusConnection())->call(message, DBusCallScheduler::PriorityBulk,
+            conn->objectPath(), conn);
 }
 
 void ContactManager::onAvatarUpdated(uint handle, const QString &token)
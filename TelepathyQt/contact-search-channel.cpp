@@ -50,6 +50,7 @@ struct TP_QT_NO_EXPORT ContactSearchChannel::Private
     void processSignalsQueue();
     void processSearchStateChangeQueue();
     void processSearchResultQueue();
+    void startContactLookups();
 
     struct SearchStateChangeInfo
     {
@@ -64,6 +65,23 @@ struct TP_QT_NO_EXPORT ContactSearchChannel::Private
         ContactSearchChannel::SearchStateChangeDetails details;
     };
 
+    struct SearchResultInfo
+    {
+        SearchResultInfo(const ContactSearchResultMap &result, bool resolveContacts)
+            : result(result), resolveContacts(resolveContacts), lookupStarted(false),
+              lookupFinished(false)
+        {
+        }
+
+        ContactSearchResultMap result;
+        bool resolveContacts;
+        bool lookupStarted;
+        bool lookupFinished;
+        QList<ContactPtr> contacts;
+        QString errorName;
+        QString errorMessage;
+    };
+
     // Public object
     ContactSearchChannel *parent;
 
@@ -82,8 +100,16 @@ struct TP_QT_NO_EXPORT ContactSearchChannel::Private
 
     QQueue<void (Private::*)()> signalsQueue;
     QQueue<SearchStateChangeInfo> searchStateChangeQueue;
-    QQueue<ContactSearchResultMap> searchResultQueue;
     bool processingSignalsQueue;
+
+    // Result pages are delivered in order, but the contacts for up to maxContactLookups of them
+    // are looked up concurrently rather than one page at a time
+    bool contactResolutionEnabled;
+    QQueue<SearchResultInfo *> searchResultQueue;
+    // Index in searchResultQueue of the first page startContactLookups() hasn't considered yet
+    int nextContactLookup;
+    QHash<PendingOperation *, SearchResultInfo *> contactLookups;
+    static const int maxContactLookups = 4;
 };
 
 ContactSearchChannel::Private::Private(ContactSearchChannel *parent,
@@ -95,7 +121,9 @@ ContactSearchChannel::Private::Private(ContactSearchChannel *parent,
       readinessHelper(parent->readinessHelper()),
       searchState(ChannelContactSearchStateNotStarted),
       limit(0),
-      processingSignalsQueue(false)
+      processingSignalsQueue(false),
+      contactResolutionEnabled(true),
+      nextContactLookup(0)
 {
     ReadinessHelper::Introspectables introspectables;
 
@@ -112,6 +140,7 @@ ContactSearchChannel::Private::Private(ContactSearchChannel *parent,
 
 ContactSearchChannel::Private::~Private()
 {
+    qDeleteAll(searchResultQueue);
 }
 
 void ContactSearchChannel::Private::introspectMain(ContactSearchChannel::Private *self)
@@ -202,21 +231,64 @@ void ContactSearchChannel::Private::processSearchStateChangeQueue()
 
 void ContactSearchChannel::Private::processSearchResultQueue()
 {
-    const ContactSearchResultMap &result = searchResultQueue.first();
-    if (!result.isEmpty()) {
-        ContactManagerPtr manager = parent->connection()->contactManager();
-        PendingContacts *pendingContacts = manager->contactsForIdentifiers(
-                result.keys());
-        parent->connect(pendingContacts,
-                SIGNAL(finished(Tp::PendingOperation*)),
-                SLOT(gotSearchResultContacts(Tp::PendingOperation*)));
-    } else {
-        searchResultQueue.dequeue();
+    // Normally already started when the page arrived, unless too many lookups were in flight
+    startContactLookups();
+
+    SearchResultInfo *info = searchResultQueue.first();
+    if (info->lookupStarted && !info->lookupFinished) {
+        // Resumed by gotSearchResultContacts()
+        return;
+    }
 
+    searchResultQueue.dequeue();
+    if (nextContactLookup > 0) {
+        --nextContactLookup;
+    }
+
+    if (!info->resolveContacts) {
+        emit parent->rawSearchResultReceived(info->result);
+    } else if (!info->lookupStarted) {
         emit parent->searchResultReceived(SearchResult());
+    } else if (!info->errorName.isEmpty()) {
+        warning().nospace() << "Getting search result contacts "
+            "failed with " << info->errorName << ":" <<
+            info->errorMessage << ". Ignoring search result";
+    } else {
+        const QList<ContactPtr> &contacts = info->contacts;
+        Q_ASSERT(info->result.count() == contacts.count());
+
+        SearchResult ret;
+        uint i = 0;
+        for (ContactSearchResultMap::const_iterator it = info->result.constBegin();
+                                                    it != info->result.constEnd();
+                                                    ++it, ++i) {
+            ret.insert(contacts.at(i), Contact::InfoFields(it.value()));
+        }
+        emit parent->searchResultReceived(ret);
+    }
+
+    delete info;
+
+    processingSignalsQueue = false;
+    processSignalsQueue();
+}
+
+void ContactSearchChannel::Private::startContactLookups()
+{
+    while (contactLookups.size() < maxContactLookups &&
+            nextContactLookup < searchResultQueue.size()) {
+        SearchResultInfo *info = searchResultQueue.at(nextContactLookup++);
+        if (!info->resolveContacts || info->result.isEmpty()) {
+            continue;
+        }
 
-        processingSignalsQueue = false;
-        processSignalsQueue();
+        PendingContacts *pendingContacts =
+            parent->connection()->contactManager()->contactsForIdentifiers(info->result.keys());
+        info->lookupStarted = true;
+        contactLookups.insert(pendingContacts, info);
+        parent->connect(pendingContacts,
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(gotSearchResultContacts(Tp::PendingOperation*)));
     }
 }
 
@@ -561,6 +633,38 @@ void ContactSearchChannel::stopSearch()
             ContactSearchChannelPtr(this));
 }
 
+/**
+ * Return whether the contacts in search results are looked up before the results are signalled.
+ *
+ * \return \c true if results are signalled by searchResultReceived(), \c false if they are
+ *         signalled by rawSearchResultReceived().
+ * \sa setContactResolutionEnabled()
+ */
+bool ContactSearchChannel::isContactResolutionEnabled() const
+{
+    return mPriv->contactResolutionEnabled;
+}
+
+/**
+ * Set whether the contacts in search results should be looked up before the results are
+ * signalled.
+ *
+ * By default, a Contact object is built for each result and the results are signalled by
+ * searchResultReceived(). This requires the contacts to be looked up on the connection, which
+ * is wasted work if the results are only going to be displayed. When disabled, the results are
+ * instead signalled as received by rawSearchResultReceived(), keyed by contact identifier.
+ *
+ * The setting applies to the results received after it is changed; either way, the results are
+ * signalled in the order they were received.
+ *
+ * \param enabled Whether to look up the contacts in search results.
+ * \sa isContactResolutionEnabled()
+ */
+void ContactSearchChannel::setContactResolutionEnabled(bool enabled)
+{
+    mPriv->contactResolutionEnabled = enabled;
+}
+
 void ContactSearchChannel::gotProperties(QDBusPendingCallWatcher *watcher)
 {
     QDBusPendingReply<QVariantMap> reply = *watcher;
@@ -612,8 +716,10 @@ void ContactSearchChannel::onSearchStateChanged(uint state, const QString &error
 
 void ContactSearchChannel::onSearchResultReceived(const ContactSearchResultMap &result)
 {
-    mPriv->searchResultQueue.enqueue(result);
+    mPriv->searchResultQueue.enqueue(new Private::SearchResultInfo(result,
+                mPriv->contactResolutionEnabled));
     mPriv->signalsQueue.enqueue(&Private::processSearchResultQueue);
+    mPriv->startContactLookups();
     mPriv->processSignalsQueue();
 }
 
@@ -621,31 +727,26 @@ void ContactSearchChannel::gotSearchResultContacts(PendingOperation *op)
 {
     PendingContacts *pc = qobject_cast<PendingContacts *>(op);
 
-    const ContactSearchResultMap &result = mPriv->searchResultQueue.dequeue();
-
-    if (!pc->isValid()) {
-        warning().nospace() << "Getting search result contacts "
-            "failed with " << pc->errorName() << ":" <<
-            pc->errorMessage() << ". Ignoring search result";
-        mPriv->processingSignalsQueue = false;
-        mPriv->processSignalsQueue();
+    Private::SearchResultInfo *info = mPriv->contactLookups.take(op);
+    if (!info) {
         return;
     }
 
-    const QList<ContactPtr> &contacts = pc->contacts();
-    Q_ASSERT(result.count() == contacts.count());
-
-    SearchResult ret;
-    uint i = 0;
-    for (ContactSearchResultMap::const_iterator it = result.constBegin();
-                                                it != result.constEnd();
-                                                ++it, ++i) {
-        ret.insert(contacts.at(i), Contact::InfoFields(it.value()));
+    info->lookupFinished = true;
+    if (pc->isValid()) {
+        info->contacts = pc->contacts();
+    } else {
+        info->errorName = pc->errorName();
+        info->errorMessage = pc->errorMessage();
     }
-    emit searchResultReceived(ret);
 
-    mPriv->processingSignalsQueue = false;
-    mPriv->processSignalsQueue();
+    mPriv->startContactLookups();
+
+    // Later pages may finish first; they are kept until the ones before them are delivered
+    if (mPriv->processingSignalsQueue && !mPriv->searchResultQueue.isEmpty() &&
+            mPriv->searchResultQueue.first() == info) {
+        mPriv->processSearchResultQueue();
+    }
 }
 
 /**
@@ -673,4 +774,14 @@ void ContactSearchChannel::gotSearchResultContacts(PendingOperation *op)
  * \sa searchState()
  */
 
+/**
+ * \fn void ContactSearchChannel::rawSearchResultReceived(const Tp::ContactSearchResultMap &result)
+ *
+ * Emitted instead of searchResultReceived() when a result for a search is received while
+ * isContactResolutionEnabled() is \c false.
+ *
+ * \param result The search result, mapping contact identifiers to their information.
+ * \sa setContactResolutionEnabled()
+ */
+
 } // Tp
@@ -85,10 +85,14 @@ public:
     void continueSearch();
     void stopSearch();
 
+    bool isContactResolutionEnabled() const;
+    void setContactResolutionEnabled(bool enabled);
+
 Q_SIGNALS:
     void searchStateChanged(Tp::ChannelContactSearchState state, const QString &errorName,
             const Tp::ContactSearchChannel::SearchStateChangeDetails &details);
     void searchResultReceived(const Tp::ContactSearchChannel::SearchResult &result);
+    void rawSearchResultReceived(const Tp::ContactSearchResultMap &result);
 
 protected:
     ContactSearchChannel(const ConnectionPtr &connection, const QString &objectPath,
@@ -0,0 +1,383 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TelepathyQt/dbus-call-queue-internal.h"
+
+#include "TelepathyQt/_gen/dbus-call-queue-internal.moc.hpp"
+
+#include "TelepathyQt/debug-internal.h"
+
+#include <TelepathyQt/Constants>
+
+#include <QDBusPendingCallWatcher>
+
+namespace Tp
+{
+
+/*
+ * DBusCallQueue holds back the D-Bus calls which nobody is waiting on yet, so that they don't get
+ * in the way of the ones somebody is. Interactive calls are issued right away, but count towards
+ * the number of calls in flight to their destination, and background and bulk calls are only
+ * issued while that number is below the limit.
+ *
+ * Calls waiting for the same destination are taken from one origin after the other, so that a
+ * proxy with lots of calls to make doesn't starve the others, and bulk calls get one turn for each
+ * BackgroundShare background calls, so that they get through eventually.
+ */
+
+struct TP_QT_NO_EXPORT DBusCallQueue::Lane
+{
+    bool isEmpty() const { return origins.isEmpty(); }
+
+    void enqueue(PendingCall *call)
+    {
+        QQueue<PendingCall *> &queue = calls[call->origin()];
+        if (queue.isEmpty()) {
+            origins.append(call->origin());
+        }
+        queue.enqueue(call);
+    }
+
+    PendingCall *dequeue()
+    {
+        QString origin = origins.takeFirst();
+        QQueue<PendingCall *> &queue = calls[origin];
+        PendingCall *call = queue.dequeue();
+        if (queue.isEmpty()) {
+            calls.remove(origin);
+        } else {
+            // Back to the end of the line
+            origins.append(origin);
+        }
+        return call;
+    }
+
+    bool remove(PendingCall *call)
+    {
+        QHash<QString, QQueue<PendingCall *> >::iterator i = calls.find(call->origin());
+        if (i == calls.end() || !i->removeOne(call)) {
+            return false;
+        }
+
+        if (i->isEmpty()) {
+            calls.erase(i);
+            origins.removeOne(call->origin());
+        }
+        return true;
+    }
+
+    QList<QString> origins;
+    QHash<QString, QQueue<PendingCall *> > calls;
+};
+
+struct TP_QT_NO_EXPORT DBusCallQueue::Destination
+{
+    Destination()
+        : inFlight(0),
+          backgroundStreak(0)
+    {
+    }
+
+    bool isIdle() const
+    {
+        return inFlight == 0 && lanes[DBusCallScheduler::PriorityBackground].isEmpty() &&
+            lanes[DBusCallScheduler::PriorityBulk].isEmpty();
+    }
+
+    uint inFlight;
+    uint backgroundStreak;
+    // Interactive calls are never queued, so their lane stays empty
+    Lane lanes[DBusCallScheduler::PriorityBulk + 1];
+};
+
+struct TP_QT_NO_EXPORT DBusCallQueue::Flight
+{
+    Flight()
+        : priority(DBusCallScheduler::PriorityInteractive)
+    {
+    }
+
+    Flight(const QString &service, DBusCallScheduler::Priority priority, PendingCall *call)
+        : service(service),
+          priority(priority),
+          call(call)
+    {
+    }
+
+    QString service;
+    DBusCallScheduler::Priority priority;
+    QPointer<PendingCall> call;
+};
+
+DBusCallQueue *DBusCallQueue::forBus(const QDBusConnection &bus)
+{
+    return DBusConnectionRegistry<DBusCallQueue>::forBus(bus);
+}
+
+DBusCallQueue::DBusCallQueue(const QDBusConnection &bus)
+    : QObject(),
+      mBus(bus),
+      mMaxInFlightCalls(DefaultMaxInFlightCalls)
+{
+}
+
+DBusCallQueue::~DBusCallQueue()
+{
+    foreach (Destination *dest, mDestinations) {
+        for (int priority = DBusCallScheduler::PriorityBackground;
+                priority <= DBusCallScheduler::PriorityBulk; ++priority) {
+            Lane &lane = dest->lanes[priority];
+            while (!lane.isEmpty()) {
+                lane.dequeue()->abort();
+            }
+        }
+        delete dest;
+    }
+}
+
+void DBusCallQueue::setMaxInFlightCalls(uint max)
+{
+    mMaxInFlightCalls = max;
+
+    // Make use of any room the new limit leaves
+    foreach (const QString &service, mDestinations.keys()) {
+        dispatch(service);
+    }
+}
+
+DBusCallScheduler::Statistics DBusCallQueue::statistics(
+        DBusCallScheduler::Priority priority) const
+{
+    return mStatistics[priority];
+}
+
+void DBusCallQueue::resetStatistics()
+{
+    for (int priority = DBusCallScheduler::PriorityInteractive;
+            priority <= DBusCallScheduler::PriorityBulk; ++priority) {
+        DBusCallScheduler::Statistics &stats = mStatistics[priority];
+        // The queue depth and calls in flight are the current state, not something accumulated
+        stats.issued = 0;
+        stats.totalWaitTime = 0;
+        stats.maxWaitTime = 0;
+    }
+}
+
+/*
+ * Issue \a message right away, as somebody is waiting for its reply.
+ */
+QDBusPendingCall DBusCallQueue::callNow(const QDBusMessage &message)
+{
+    ++mStatistics[DBusCallScheduler::PriorityInteractive].issued;
+    return issue(message, DBusCallScheduler::PriorityInteractive, 0);
+}
+
+/*
+ * Issue \a message with the given \a priority, on behalf of \a origin. The returned operation
+ * finishes once the reply arrives, and holds a reference to \a object until then.
+ */
+DBusCallQueue::PendingCall *DBusCallQueue::call(const QDBusMessage &message,
+        DBusCallScheduler::Priority priority, const QString &origin,
+        const SharedPtr<RefCounted> &object)
+{
+    PendingCall *call = new PendingCall(message, priority, origin, object);
+    if (priority == DBusCallScheduler::PriorityInteractive) {
+        issue(call);
+        return call;
+    }
+
+    destination(message.service())->lanes[priority].enqueue(call);
+    ++mStatistics[priority].queued;
+    dispatch(message.service());
+    return call;
+}
+
+/*
+ * Issue \a call right away if it's still waiting, as somebody is now waiting for its reply.
+ */
+void DBusCallQueue::expedite(PendingCall *call)
+{
+    if (call->isIssued()) {
+        return;
+    }
+
+    Destination *dest = mDestinations.value(call->mMessage.service());
+    if (!dest || !dest->lanes[call->priority()].remove(call)) {
+        warning() << "Trying to expedite a call which is not queued";
+        return;
+    }
+
+    debug() << "Expediting" << call->mMessage.interface() << "." << call->mMessage.member() <<
+        "for" << call->origin();
+    --mStatistics[call->priority()].queued;
+    issue(call);
+}
+
+/*
+ * Drop \a call if it's still waiting, finishing it with TP_QT_ERROR_CANCELLED.
+ */
+void DBusCallQueue::cancel(PendingCall *call)
+{
+    if (call->isIssued()) {
+        return;
+    }
+
+    QString service = call->mMessage.service();
+    Destination *dest = mDestinations.value(service);
+    if (!dest || !dest->lanes[call->priority()].remove(call)) {
+        return;
+    }
+
+    --mStatistics[call->priority()].queued;
+    call->abort();
+    releaseDestination(service);
+}
+
+void DBusCallQueue::onCallFinished(QDBusPendingCallWatcher *watcher)
+{
+    Flight flight = mFlights.take(watcher);
+    watcher->deleteLater();
+
+    --mStatistics[flight.priority].inFlight;
+    --destination(flight.service)->inFlight;
+
+    if (flight.call) {
+        flight.call->finish(watcher);
+    }
+
+    dispatch(flight.service);
+    releaseDestination(flight.service);
+}
+
+DBusCallQueue::Destination *DBusCallQueue::destination(const QString &service)
+{
+    Destination *dest = mDestinations.value(service);
+    if (!dest) {
+        dest = new Destination;
+        mDestinations.insert(service, dest);
+    }
+    return dest;
+}
+
+void DBusCallQueue::releaseDestination(const QString &service)
+{
+    Destination *dest = mDestinations.value(service);
+    if (dest && dest->isIdle()) {
+        mDestinations.remove(service);
+        delete dest;
+    }
+}
+
+void DBusCallQueue::dispatch(const QString &service)
+{
+    Destination *dest = mDestinations.value(service);
+    if (!dest) {
+        return;
+    }
+
+    Lane &background = dest->lanes[DBusCallScheduler::PriorityBackground];
+    Lane &bulk = dest->lanes[DBusCallScheduler::PriorityBulk];
+    while (mMaxInFlightCalls == 0 || dest->inFlight < mMaxInFlightCalls) {
+        PendingCall *call;
+        if (!bulk.isEmpty() &&
+                (background.isEmpty() || dest->backgroundStreak >= BackgroundShare)) {
+            call = bulk.dequeue();
+            dest->backgroundStreak = 0;
+        } else if (!background.isEmpty()) {
+            call = background.dequeue();
+            ++dest->backgroundStreak;
+        } else {
+            break;
+        }
+
+        --mStatistics[call->priority()].queued;
+        issue(call);
+    }
+}
+
+void DBusCallQueue::issue(PendingCall *call)
+{
+    DBusCallScheduler::Statistics &stats = mStatistics[call->priority()];
+    int waitTime = call->mQueuedAt.elapsed();
+    ++stats.issued;
+    stats.totalWaitTime += waitTime;
+    if (waitTime > stats.maxWaitTime) {
+        stats.maxWaitTime = waitTime;
+    }
+
+    call->mIssued = true;
+    call->mCall = issue(call->mMessage, call->priority(), call);
+}
+
+QDBusPendingCall DBusCallQueue::issue(const QDBusMessage &message,
+        DBusCallScheduler::Priority priority, PendingCall *call)
+{
+    ++mStatistics[priority].inFlight;
+    ++destination(message.service())->inFlight;
+
+    QDBusPendingCall pendingCall = mBus.asyncCall(message);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pendingCall, this);
+    connect(watcher,
+            SIGNAL(finished(QDBusPendingCallWatcher*)),
+            SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+    mFlights.insert(watcher, Flight(message.service(), priority, call));
+    return pendingCall;
+}
+
+DBusCallQueue::PendingCall::PendingCall(const QDBusMessage &message,
+        DBusCallScheduler::Priority priority, const QString &origin,
+        const SharedPtr<RefCounted> &object)
+    : PendingOperation(object),
+      mMessage(message),
+      mPriority(priority),
+      mOrigin(origin),
+      mIssued(false),
+      mCall(QDBusPendingCall::fromCompletedCall(QDBusMessage()))
+{
+    mQueuedAt.start();
+}
+
+DBusCallQueue::PendingCall::~PendingCall()
+{
+}
+
+void DBusCallQueue::PendingCall::finish(QDBusPendingCallWatcher *watcher)
+{
+    if (watcher->isError()) {
+        debug().nospace() << mMessage.interface() << "." << mMessage.member() <<
+            " for " << mOrigin << " failed: " << watcher->error().name() << ": " <<
+            watcher->error().message();
+        setFinishedWithError(watcher->error());
+        return;
+    }
+
+    mReply = watcher->reply();
+    setFinished();
+}
+
+void DBusCallQueue::PendingCall::abort()
+{
+    setFinishedWithError(TP_QT_ERROR_CANCELLED,
+            QLatin1String("The call was dropped before being made"));
+}
+
+} // Tp
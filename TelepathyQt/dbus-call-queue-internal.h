@@ -0,0 +1,146 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_dbus_call_queue_internal_h_HEADER_GUARD_
+#define _TelepathyQt_dbus_call_queue_internal_h_HEADER_GUARD_
+
+#include <TelepathyQt/DBusCallScheduler>
+#include <TelepathyQt/Global>
+#include <TelepathyQt/PendingOperation>
+
+#include "TelepathyQt/dbus-connection-registry-internal.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCall>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QQueue>
+#include <QString>
+#include <QTime>
+
+class QDBusPendingCallWatcher;
+
+namespace Tp
+{
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+class TP_QT_NO_EXPORT DBusCallQueue : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(DBusCallQueue)
+
+public:
+    class PendingCall;
+
+    static DBusCallQueue *forBus(const QDBusConnection &bus);
+
+    ~DBusCallQueue();
+
+    QDBusConnection dbusConnection() const { return mBus; }
+
+    uint maxInFlightCalls() const { return mMaxInFlightCalls; }
+    void setMaxInFlightCalls(uint max);
+
+    DBusCallScheduler::Statistics statistics(DBusCallScheduler::Priority priority) const;
+    void resetStatistics();
+
+    QDBusPendingCall callNow(const QDBusMessage &message);
+    PendingCall *call(const QDBusMessage &message, DBusCallScheduler::Priority priority,
+            const QString &origin, const SharedPtr<RefCounted> &object);
+    void expedite(PendingCall *call);
+    void cancel(PendingCall *call);
+
+private Q_SLOTS:
+    void onCallFinished(QDBusPendingCallWatcher *watcher);
+
+private:
+    struct Lane;
+    struct Destination;
+    struct Flight;
+
+    enum {
+        // How many background calls can be issued in a row to a destination while bulk calls are
+        // waiting for it
+        BackgroundShare = 3,
+        DefaultMaxInFlightCalls = 4
+    };
+
+    friend class DBusConnectionRegistry<DBusCallQueue>;
+
+    DBusCallQueue(const QDBusConnection &bus);
+
+    Destination *destination(const QString &service);
+    void releaseDestination(const QString &service);
+    void dispatch(const QString &service);
+    void issue(PendingCall *call);
+    QDBusPendingCall issue(const QDBusMessage &message, DBusCallScheduler::Priority priority,
+            PendingCall *call);
+
+    QDBusConnection mBus;
+    uint mMaxInFlightCalls;
+    QHash<QString, Destination *> mDestinations;
+    QHash<QDBusPendingCallWatcher *, Flight> mFlights;
+    DBusCallScheduler::Statistics mStatistics[DBusCallScheduler::PriorityBulk + 1];
+};
+
+class TP_QT_NO_EXPORT DBusCallQueue::PendingCall : public PendingOperation
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(PendingCall)
+
+public:
+    ~PendingCall();
+
+    DBusCallScheduler::Priority priority() const { return mPriority; }
+    QString origin() const { return mOrigin; }
+
+    bool isIssued() const { return mIssued; }
+    QDBusPendingCall pendingCall() const { return mCall; }
+    QDBusMessage reply() const { return mReply; }
+
+private:
+    friend class DBusCallQueue;
+
+    PendingCall(const QDBusMessage &message, DBusCallScheduler::Priority priority,
+            const QString &origin, const SharedPtr<RefCounted> &object);
+
+    void finish(QDBusPendingCallWatcher *watcher);
+    void abort();
+
+    QDBusMessage mMessage;
+    DBusCallScheduler::Priority mPriority;
+    QString mOrigin;
+    QTime mQueuedAt;
+    bool mIssued;
+    QDBusPendingCall mCall;
+    QDBusMessage mReply;
+};
+
+#endif // DOXYGEN_SHOULD_SKIP_THIS
+
+} // Tp
+
+#endif
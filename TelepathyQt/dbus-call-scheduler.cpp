@@ -0,0 +1,183 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <TelepathyQt/DBusCallScheduler>
+
+#include "TelepathyQt/dbus-call-queue-internal.h"
+
+namespace Tp
+{
+
+/**
+ * \class DBusCallScheduler
+ * \ingroup utils
+ * \headerfile TelepathyQt/dbus-call-scheduler.h <TelepathyQt/DBusCallScheduler>
+ *
+ * \brief The DBusCallScheduler class controls how the D-Bus calls made by the library on a bus
+ * are spread over time.
+ *
+ * Not all of the calls made by the library are equally urgent. Calls whose results something is
+ * waiting on, such as those made while making proxies ready, are issued right away. Calls made
+ * ahead of time, such as prefetching the properties of new channels, and calls made for many
+ * contacts at once, such as requesting their avatars, are held back while the service they are
+ * made to already has maxInFlightCalls() calls in flight.
+ *
+ * Held back calls are issued in a round-robin fashion between the objects making them, so that
+ * one of them can't starve the others. Prefetches are made on behalf of the channel they are for,
+ * but avatar and contact info requests are made on behalf of their connection, so those are only
+ * balanced between connections, not between the contacts of a single connection.
+ *
+ * The calls which go through the scheduler are the prefetching of channel properties
+ * (background), the Properties.GetAll calls made while introspecting connections and channels and
+ * the contact attribute requests made when building contacts (interactive), and the avatar and
+ * contact info requests made by ContactManager (bulk). Other calls, such as the individual
+ * Properties.Get calls and those made by the proxies of connection managers, the account manager,
+ * accounts and channel dispatcher objects, are made through the interfaces directly. They are not
+ * counted in the statistics() and don't count towards maxInFlightCalls(), so the number of calls
+ * in flight to a service can be higher than what the scheduler sees.
+ *
+ * The statistics() for each priority can be used to see how much the calls are being held back.
+ */
+
+/**
+ * \enum DBusCallScheduler::Priority
+ *
+ * The priority classes of the calls made by the library.
+ */
+
+/**
+ * \var DBusCallScheduler::Priority DBusCallScheduler::PriorityInteractive
+ *
+ * Something is waiting for the reply. The call is issued right away.
+ */
+
+/**
+ * \var DBusCallScheduler::Priority DBusCallScheduler::PriorityBackground
+ *
+ * The call is made ahead of time, so that its reply is already there when it's needed.
+ */
+
+/**
+ * \var DBusCallScheduler::Priority DBusCallScheduler::PriorityBulk
+ *
+ * The call is made on behalf of many objects at once, for something that isn't needed right
+ * away, such as avatars. Bulk calls get one turn for every few background calls.
+ */
+
+/**
+ * \struct DBusCallScheduler::Statistics
+ * \ingroup utils
+ * \headerfile TelepathyQt/dbus-call-scheduler.h <TelepathyQt/DBusCallScheduler>
+ *
+ * \brief The DBusCallScheduler::Statistics struct holds the figures for the calls of a given
+ * priority made on a bus.
+ *
+ * \a queued and \a inFlight reflect the current state, and are not affected by
+ * DBusCallScheduler::resetStatistics().
+ */
+
+/**
+ * \var uint DBusCallScheduler::Statistics::queued
+ *
+ * The number of calls currently waiting to be issued.
+ */
+
+/**
+ * \var uint DBusCallScheduler::Statistics::inFlight
+ *
+ * The number of calls issued whose reply is yet to arrive.
+ */
+
+/**
+ * \var uint DBusCallScheduler::Statistics::issued
+ *
+ * The number of calls issued.
+ */
+
+/**
+ * \var qint64 DBusCallScheduler::Statistics::totalWaitTime
+ *
+ * The total time, in milliseconds, the issued calls have waited before being issued.
+ */
+
+/**
+ * \var int DBusCallScheduler::Statistics::maxWaitTime
+ *
+ * The longest time, in milliseconds, an issued call has waited before being issued.
+ */
+
+/**
+ * Return the maximum number of calls in flight to a single service on \a bus before background
+ * and bulk calls to it are held back.
+ *
+ * The default is 4.
+ *
+ * \param bus The bus the calls are made on.
+ * \return The maximum number of calls in flight per service, or 0 if there is no limit.
+ * \sa setMaxInFlightCalls()
+ */
+uint DBusCallScheduler::maxInFlightCalls(const QDBusConnection &bus)
+{
+    return DBusCallQueue::forBus(bus)->maxInFlightCalls();
+}
+
+/**
+ * Set the maximum number of calls in flight to a single service on \a bus before background
+ * and bulk calls to it are held back.
+ *
+ * Interactive calls are never held back, but do count towards the limit.
+ *
+ * \param bus The bus the calls are made on.
+ * \param max The maximum number of calls in flight per service, or 0 for no limit.
+ * \sa maxInFlightCalls()
+ */
+void DBusCallScheduler::setMaxInFlightCalls(const QDBusConnection &bus, uint max)
+{
+    DBusCallQueue::forBus(bus)->setMaxInFlightCalls(max);
+}
+
+/**
+ * Return the statistics for the calls with the given \a priority made on \a bus.
+ *
+ * \param bus The bus the calls are made on.
+ * \param priority The priority of the calls.
+ * \return The statistics as a DBusCallScheduler::Statistics struct.
+ * \sa resetStatistics()
+ */
+DBusCallScheduler::Statistics DBusCallScheduler::statistics(const QDBusConnection &bus,
+        Priority priority)
+{
+    return DBusCallQueue::forBus(bus)->statistics(priority);
+}
+
+/**
+ * Reset the accumulated statistics for the calls made on \a bus.
+ *
+ * \param bus The bus the calls are made on.
+ * \sa statistics()
+ */
+void DBusCallScheduler::resetStatistics(const QDBusConnection &bus)
+{
+    DBusCallQueue::forBus(bus)->resetStatistics();
+}
+
+} // Tp
@@ -0,0 +1,107 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_dbus_connection_registry_internal_h_HEADER_GUARD_
+#define _TelepathyQt_dbus_connection_registry_internal_h_HEADER_GUARD_
+
+#include <TelepathyQt/Global>
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QHash>
+#include <QString>
+#include <QtGlobal>
+
+namespace Tp
+{
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+/*
+ * DBusConnectionRegistry keeps a single instance of T for each D-Bus connection, looked up by the
+ * connection name. T is a QObject, constructed from the QDBusConnection, which returns it from
+ * dbusConnection().
+ *
+ * Instances whose connection has gone away are dropped the next time a new instance is needed, so
+ * a connection name which is reused, for instance to connect to the bus again, gets a fresh one.
+ * The rest are deleted along with the application object.
+ */
+template <class T>
+class DBusConnectionRegistry
+{
+public:
+    static T *forBus(const QDBusConnection &bus)
+    {
+        QHash<QString, T *> &instances = registry();
+        T *instance = instances.value(bus.name());
+        // Callers still holding on to a connection which has gone away keep getting the instance
+        // which was made for it, as long as it's around
+        if (instance && (instance->dbusConnection().isConnected() || !bus.isConnected())) {
+            return instance;
+        }
+
+        dropDisconnected(instances);
+        instance = new T(bus);
+        instances.insert(bus.name(), instance);
+        return instance;
+    }
+
+private:
+    static QHash<QString, T *> &registry()
+    {
+        static QHash<QString, T *> instances;
+        static bool cleanupAdded = false;
+        if (!cleanupAdded) {
+            qAddPostRoutine(&DBusConnectionRegistry<T>::clear);
+            cleanupAdded = true;
+        }
+        return instances;
+    }
+
+    static void dropDisconnected(QHash<QString, T *> &instances)
+    {
+        typename QHash<QString, T *>::iterator i = instances.begin();
+        while (i != instances.end()) {
+            if ((*i)->dbusConnection().isConnected()) {
+                ++i;
+                continue;
+            }
+
+            // We might be called from within one of its methods
+            (*i)->deleteLater();
+            i = instances.erase(i);
+        }
+    }
+
+    static void clear()
+    {
+        QHash<QString, T *> &instances = registry();
+        qDeleteAll(instances);
+        instances.clear();
+    }
+};
+
+#endif // DOXYGEN_SHOULD_SKIP_THIS
+
+} // Tp
+
+#endif
@@ -0,0 +1,227 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TelepathyQt/dbus-name-owner-cache-internal.h"
+
+#include "TelepathyQt/_gen/dbus-name-owner-cache-internal.moc.hpp"
+
+#include "TelepathyQt/debug-internal.h"
+
+#include <TelepathyQt/DBusProxy>
+
+#include <QDBusConnectionInterface>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusReply>
+#include <QDBusServiceWatcher>
+
+namespace Tp
+{
+
+/*
+ * DBusNameOwnerCache keeps track of the unique names owning the well-known names that
+ * StatefulDBusProxy instances have been constructed for, so that only the first proxy for a given
+ * service has to ask the bus daemon about it. Entries are kept current by a single
+ * QDBusServiceWatcher per bus and dropped as soon as the name loses its owner.
+ *
+ * The same watcher also tells the proxies themselves about their service going away: rather than
+ * each proxy having its own QDBusServiceWatcher, and thus its own match rule and signal hook, they
+ * register here and owner changes are fanned out by name. All the channels of a connection share
+ * its bus name, so this keeps a single match rule per connection manager.
+ */
+
+DBusNameOwnerCache *DBusNameOwnerCache::forBus(const QDBusConnection &bus)
+{
+    return DBusConnectionRegistry<DBusNameOwnerCache>::forBus(bus);
+}
+
+DBusNameOwnerCache::DBusNameOwnerCache(const QDBusConnection &bus)
+    : QObject(),
+      mBus(bus),
+      mServiceWatcher(new QDBusServiceWatcher(this))
+{
+    mServiceWatcher->setConnection(bus);
+    mServiceWatcher->setWatchMode(QDBusServiceWatcher::WatchForOwnerChange);
+    connect(mServiceWatcher,
+            SIGNAL(serviceOwnerChanged(QString,QString,QString)),
+            SLOT(onServiceOwnerChanged(QString,QString,QString)));
+}
+
+DBusNameOwnerCache::~DBusNameOwnerCache()
+{
+}
+
+/*
+ * Return the unique name currently owning \a name, if it is known without asking the bus daemon.
+ * Unique names are returned as is.
+ */
+QString DBusNameOwnerCache::cachedOwner(const QString &name) const
+{
+    if (name.startsWith(QLatin1Char(':'))) {
+        return name;
+    }
+
+    return mOwners.value(name);
+}
+
+/*
+ * Return the unique name currently owning \a name, blocking on a GetNameOwner call if it isn't
+ * known yet. The result is cached for subsequent lookups.
+ */
+QString DBusNameOwnerCache::ownerFor(const QString &name, QString &error, QString &message)
+{
+    QString owner = cachedOwner(name);
+    if (!owner.isEmpty()) {
+        return owner;
+    }
+
+    // Start watching before asking, so that we don't miss an owner change happening in between
+    watch(name);
+
+    QDBusReply<QString> reply = mBus.interface()->serviceOwner(name);
+    if (!reply.isValid()) {
+        error = reply.error().name();
+        message = reply.error().message();
+        unwatchIfUnused(name);
+        return QString();
+    }
+
+    owner = reply.value();
+    mOwners.insert(name, owner);
+    return owner;
+}
+
+/*
+ * Resolve the unique name owning \a name without blocking. ownerResolved() is emitted when the
+ * answer is known, which may already happen before this function returns if \a name is cached.
+ * Concurrent requests for the same name are served by a single GetNameOwner call.
+ */
+void DBusNameOwnerCache::resolveOwner(const QString &name)
+{
+    QString owner = cachedOwner(name);
+    if (!owner.isEmpty()) {
+        emit ownerResolved(name, owner, QString(), QString());
+        return;
+    }
+
+    if (mPendingNames.contains(name)) {
+        return;
+    }
+
+    watch(name);
+
+    QDBusPendingCall call = mBus.interface()->asyncCall(QLatin1String("GetNameOwner"), name);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher,
+            SIGNAL(finished(QDBusPendingCallWatcher*)),
+            SLOT(onGetNameOwnerFinished(QDBusPendingCallWatcher*)));
+    mPendingLookups.insert(watcher, name);
+    mPendingNames.insert(name);
+}
+
+/*
+ * Register \a proxy to be told about owner changes of \a name. The name is watched for as long as
+ * at least one proxy is registered for it.
+ */
+void DBusNameOwnerCache::addProxy(const QString &name, StatefulDBusProxy *proxy)
+{
+    QSet<StatefulDBusProxy *> &proxies = mProxies[name];
+    if (proxies.isEmpty()) {
+        watch(name);
+    }
+    proxies.insert(proxy);
+}
+
+void DBusNameOwnerCache::removeProxy(const QString &name, StatefulDBusProxy *proxy)
+{
+    QHash<QString, QSet<StatefulDBusProxy *> >::iterator i = mProxies.find(name);
+    if (i == mProxies.end()) {
+        return;
+    }
+
+    i->remove(proxy);
+    if (i->isEmpty()) {
+        mProxies.erase(i);
+        unwatchIfUnused(name);
+    }
+}
+
+void DBusNameOwnerCache::watch(const QString &name)
+{
+    if (!mWatchedNames.contains(name)) {
+        mWatchedNames.insert(name);
+        mServiceWatcher->addWatchedService(name);
+    }
+}
+
+void DBusNameOwnerCache::unwatchIfUnused(const QString &name)
+{
+    // Names with a known owner stay watched so that the cache is kept current
+    if (!mOwners.contains(name) && !mPendingNames.contains(name) && !mProxies.contains(name) &&
+            mWatchedNames.remove(name)) {
+        mServiceWatcher->removeWatchedService(name);
+    }
+}
+
+void DBusNameOwnerCache::onServiceOwnerChanged(const QString &name, const QString &oldOwner,
+        const QString &newOwner)
+{
+    if (newOwner.isEmpty()) {
+        mOwners.remove(name);
+    } else {
+        mOwners.insert(name, newOwner);
+    }
+
+    // Iterate over a copy, as the proxies are free to unregister themselves meanwhile
+    QSet<StatefulDBusProxy *> proxies = mProxies.value(name);
+    foreach (StatefulDBusProxy *proxy, proxies) {
+        proxy->onServiceOwnerChanged(name, oldOwner, newOwner);
+    }
+
+    if (newOwner.isEmpty()) {
+        unwatchIfUnused(name);
+    }
+}
+
+void DBusNameOwnerCache::onGetNameOwnerFinished(QDBusPendingCallWatcher *watcher)
+{
+    QString name = mPendingLookups.take(watcher);
+    mPendingNames.remove(name);
+
+    QDBusPendingReply<QString> reply = *watcher;
+    watcher->deleteLater();
+
+    if (reply.isError()) {
+        debug().nospace() << "GetNameOwner(" << name << ") failed: " <<
+            reply.error().name() << ": " << reply.error().message();
+        mOwners.remove(name);
+        unwatchIfUnused(name);
+        emit ownerResolved(name, QString(), reply.error().name(), reply.error().message());
+        return;
+    }
+
+    QString owner = reply.value();
+    mOwners.insert(name, owner);
+    emit ownerResolved(name, owner, QString(), QString());
+}
+
+} // Tp
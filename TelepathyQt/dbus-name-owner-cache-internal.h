@@ -0,0 +1,95 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_dbus_name_owner_cache_internal_h_HEADER_GUARD_
+#define _TelepathyQt_dbus_name_owner_cache_internal_h_HEADER_GUARD_
+
+#include <TelepathyQt/Global>
+
+#include "TelepathyQt/dbus-connection-registry-internal.h"
+
+#include <QDBusConnection>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+class QDBusPendingCallWatcher;
+class QDBusServiceWatcher;
+
+namespace Tp
+{
+
+class StatefulDBusProxy;
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+class TP_QT_NO_EXPORT DBusNameOwnerCache : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(DBusNameOwnerCache)
+
+public:
+    static DBusNameOwnerCache *forBus(const QDBusConnection &bus);
+
+    ~DBusNameOwnerCache();
+
+    QDBusConnection dbusConnection() const { return mBus; }
+
+    QString cachedOwner(const QString &name) const;
+    QString ownerFor(const QString &name, QString &error, QString &message);
+    void resolveOwner(const QString &name);
+
+    void addProxy(const QString &name, StatefulDBusProxy *proxy);
+    void removeProxy(const QString &name, StatefulDBusProxy *proxy);
+
+Q_SIGNALS:
+    void ownerResolved(const QString &name, const QString &owner,
+            const QString &errorName, const QString &errorMessage);
+
+private Q_SLOTS:
+    void onServiceOwnerChanged(const QString &name, const QString &oldOwner,
+            const QString &newOwner);
+    void onGetNameOwnerFinished(QDBusPendingCallWatcher *watcher);
+
+private:
+    friend class DBusConnectionRegistry<DBusNameOwnerCache>;
+
+    DBusNameOwnerCache(const QDBusConnection &bus);
+
+    void watch(const QString &name);
+    void unwatchIfUnused(const QString &name);
+
+    QDBusConnection mBus;
+    QDBusServiceWatcher *mServiceWatcher;
+    QSet<QString> mWatchedNames;
+    QHash<QString, QString> mOwners;
+    QHash<QDBusPendingCallWatcher *, QString> mPendingLookups;
+    QSet<QString> mPendingNames;
+    QHash<QString, QSet<StatefulDBusProxy *> > mProxies;
+};
+
+#endif // DOXYGEN_SHOULD_SKIP_THIS
+
+} // Tp
+
+#endif
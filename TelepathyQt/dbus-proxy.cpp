@@ -26,14 +26,13 @@
 
 #include "TelepathyQt/_gen/dbus-proxy.moc.hpp"
 
+#include "TelepathyQt/dbus-name-owner-cache-internal.h"
 #include "TelepathyQt/debug-internal.h"
 
 #include <TelepathyQt/Constants>
 
 #include <QDBusConnection>
-#include <QDBusConnectionInterface>
 #include <QDBusError>
-#include <QDBusServiceWatcher>
 #include <QTimer>
 
 namespace Tp
@@ -250,9 +249,11 @@ void DBusProxy::emitInvalidated()
 struct TP_QT_NO_EXPORT StatefulDBusProxy::Private
 {
     Private(const QString &originalName)
-        : originalName(originalName) {}
+        : originalName(originalName),
+          resolvingUniqueName(false) {}
 
     QString originalName;
+    bool resolvingUniqueName;
 };
 
 /**
@@ -272,6 +273,17 @@ struct TP_QT_NO_EXPORT StatefulDBusProxy::Private
 /**
  * Construct a new StatefulDBusProxy object.
  *
+ * If \a busName is a well-known name, the proxy binds to the unique name owning it. When that
+ * owner is already known to the process, because another proxy for the same service has been
+ * constructed before, this happens immediately. Otherwise the unique name is looked up
+ * asynchronously: busName() keeps returning the well-known name until the lookup finishes, and the
+ * introspection of the core feature only starts after that. If the name turns out to have no
+ * owner, the proxy is invalidated.
+ *
+ * Interfaces created from the proxy while the lookup is in progress are bound to the well-known
+ * name, which makes QtDBus look its owner up with a blocking call, so subclasses should only create
+ * them once busName() is a unique name. Connection and Channel do so.
+ *
  * \param dbusConnection QDBusConnection to use.
  * \param busName D-Bus bus name of the service that provides the remote object.
  * \param objectPath The object path.
@@ -282,21 +294,26 @@ StatefulDBusProxy::StatefulDBusProxy(const QDBusConnection &dbusConnection,
     : DBusProxy(dbusConnection, busName, objectPath, featureCore),
       mPriv(new Private(busName))
 {
-    QDBusServiceWatcher *serviceWatcher = new QDBusServiceWatcher(busName,
-            dbusConnection, QDBusServiceWatcher::WatchForUnregistration, this);
-    connect(serviceWatcher,
-            SIGNAL(serviceOwnerChanged(QString,QString,QString)),
-            SLOT(onServiceOwnerChanged(QString,QString,QString)));
+    // The service watching is shared with all the other proxies for the same bus name, so creating
+    // lots of channels on a connection doesn't mean lots of match rules
+    DBusNameOwnerCache *cache = DBusNameOwnerCache::forBus(dbusConnection);
+    cache->addProxy(busName, this);
 
-    QString error, message;
-    QString uniqueName = uniqueNameFrom(dbusConnection, busName, error, message);
+    if (busName.startsWith(QLatin1Char(':')) || !isValid()) {
+        return;
+    }
 
-    if (uniqueName.isEmpty()) {
-        invalidate(error, message);
+    QString uniqueName = cache->cachedOwner(busName);
+    if (!uniqueName.isEmpty()) {
+        setBusName(uniqueName);
         return;
     }
 
-    setBusName(uniqueName);
+    mPriv->resolvingUniqueName = true;
+    connect(cache,
+            SIGNAL(ownerResolved(QString,QString,QString,QString)),
+            SLOT(onUniqueNameResolved(QString,QString,QString,QString)));
+    cache->resolveOwner(busName);
 }
 
 /**
@@ -304,9 +321,21 @@ StatefulDBusProxy::StatefulDBusProxy(const QDBusConnection &dbusConnection,
  */
 StatefulDBusProxy::~StatefulDBusProxy()
 {
+    DBusNameOwnerCache::forBus(dbusConnection())->removeProxy(mPriv->originalName, this);
     delete mPriv;
 }
 
+/**
+ * Return the unique name owning \a name on \a bus.
+ *
+ * Owners already known to the process are returned without contacting the bus daemon; otherwise
+ * this blocks on a GetNameOwner call, and the result is remembered for subsequent lookups and
+ * proxy constructions.
+ *
+ * \param bus The bus to look \a name up on.
+ * \param name A unique or well-known name.
+ * \return The unique name owning \a name, or an empty string if it has no owner.
+ */
 QString StatefulDBusProxy::uniqueNameFrom(const QDBusConnection &bus, const QString &name)
 {
     QString error, message;
@@ -328,14 +357,7 @@ QString StatefulDBusProxy::uniqueNameFrom(const QDBusConnection &bus, const QStr
 
     // For a stateful interface, it makes no sense to follow name-owner
     // changes, so we want to bind to the unique name.
-    QDBusReply<QString> reply = bus.interface()->serviceOwner(name);
-    if (reply.isValid()) {
-        return reply.value();
-    } else {
-        error = reply.error().name();
-        message = reply.error().message();
-        return QString();
-    }
+    return DBusNameOwnerCache::forBus(bus)->ownerFor(name, error, message);
 }
 
 void StatefulDBusProxy::onServiceOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner)
@@ -348,6 +370,28 @@ void StatefulDBusProxy::onServiceOwnerChanged(const QString &name, const QString
     }
 }
 
+void StatefulDBusProxy::onUniqueNameResolved(const QString &name, const QString &uniqueName,
+        const QString &errorName, const QString &errorMessage)
+{
+    if (!mPriv->resolvingUniqueName || name != mPriv->originalName) {
+        return;
+    }
+
+    mPriv->resolvingUniqueName = false;
+    disconnect(DBusNameOwnerCache::forBus(dbusConnection()),
+            SIGNAL(ownerResolved(QString,QString,QString,QString)),
+            this,
+            SLOT(onUniqueNameResolved(QString,QString,QString,QString)));
+
+    if (uniqueName.isEmpty()) {
+        invalidate(errorName, errorMessage);
+        return;
+    }
+
+    debug() << "Resolved" << name << "to" << uniqueName;
+    setBusName(uniqueName);
+}
+
 // ==== StatelessDBusProxy =============================================
 
 /**
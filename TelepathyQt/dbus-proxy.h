@@ -37,6 +37,7 @@ class QDBusError;
 namespace Tp
 {
 
+class DBusNameOwnerCache;
 class TestBackdoors;
 
 class TP_QT_EXPORT DBusProxy : public Object, public ReadyObject
@@ -110,8 +111,12 @@ public:
 private Q_SLOTS:
     TP_QT_NO_EXPORT void onServiceOwnerChanged(const QString &name, const QString &oldOwner,
             const QString &newOwner);
+    TP_QT_NO_EXPORT void onUniqueNameResolved(const QString &name, const QString &uniqueName,
+            const QString &errorName, const QString &errorMessage);
 
 private:
+    friend class DBusNameOwnerCache;
+
     struct Private;
     friend struct Private;
     Private *mPriv;
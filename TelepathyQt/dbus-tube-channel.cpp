@@ -31,6 +31,9 @@
 #include <TelepathyQt/PendingVariant>
 #include <TelepathyQt/PendingVariantMap>
 
+#include <QQueue>
+#include <QTimer>
+
 namespace Tp
 {
 
@@ -41,6 +44,22 @@ struct TP_QT_NO_EXPORT DBusTubeChannel::Private
     void extractProperties(const QVariantMap &props);
     void extractParticipants(const Tp::DBusTubeParticipants &participants);
 
+    struct BusNamesChange
+    {
+        BusNamesChange() : reset(false), retrieved(false) { }
+
+        QUuid uuid;
+        DBusTubeParticipants added;
+        UIntList removed;
+        bool reset;
+        // Whether the contacts for the added bus names have been built
+        bool retrieved;
+        QList<ContactPtr> contacts;
+    };
+
+    void queueBusNamesChange(const BusNamesChange &change);
+    void applyBusNamesChange(const BusNamesChange &change, const QList<ContactPtr> &contacts);
+
     static void introspectDBusTube(Private *self);
     static void introspectBusNamesMonitoring(Private *self);
 
@@ -53,10 +72,13 @@ struct TP_QT_NO_EXPORT DBusTubeChannel::Private
     UIntList accessControls;
     QString serviceName;
     QHash<QString, Tp::ContactPtr> contactsForBusNames;
+    QHash<uint, QString> busNamesForHandles;
     QString address;
 
-    QHash<QUuid, QString> pendingNewBusNamesToAdd;
-    QList<QUuid> pendingNewBusNamesToRemove;
+    // Changes are applied in the order they were signalled, each one once its contacts and those of
+    // the ones before it are built; the ones with a null uuid only remove bus names and don't need
+    // to wait for any contact
+    QQueue<BusNamesChange> pendingBusNamesChanges;
 
     QueuedContactFactory *queuedContactFactory;
 };
@@ -101,12 +123,93 @@ void DBusTubeChannel::Private::extractProperties(const QVariantMap &props)
 
 void DBusTubeChannel::Private::extractParticipants(const Tp::DBusTubeParticipants &participants)
 {
-    contactsForBusNames.clear();
-    for (DBusTubeParticipants::const_iterator i = participants.constBegin();
-         i != participants.constEnd();
+    // The participants replace whatever the changes queued before them would have left
+    BusNamesChange change;
+    change.added = participants;
+    change.reset = true;
+    queueBusNamesChange(change);
+}
+
+void DBusTubeChannel::Private::queueBusNamesChange(const BusNamesChange &change)
+{
+    BusNamesChange queued = change;
+    if (!queued.added.isEmpty()) {
+        // Build the contacts for the whole batch at once
+        queued.uuid = queuedContactFactory->appendNewRequest(queued.added.keys());
+    }
+    pendingBusNamesChanges.enqueue(queued);
+
+    if (pendingBusNamesChanges.size() == 1 && queued.uuid.isNull()) {
+        // Nothing to wait for
+        parent->processPendingBusNamesChanges();
+    }
+}
+
+void DBusTubeChannel::Private::applyBusNamesChange(const BusNamesChange &change,
+        const QList<ContactPtr> &contacts)
+{
+    if (change.reset) {
+        contactsForBusNames.clear();
+        busNamesForHandles.clear();
+    }
+
+    bool notify = parent->isReady(DBusTubeChannel::FeatureBusNameMonitoring);
+    QHash<QString, ContactPtr> removedBusNames;
+    QHash<QString, ContactPtr> addedBusNames;
+
+    foreach (uint handle, change.removed) {
+        QString busName = busNamesForHandles.take(handle);
+        if (busName.isEmpty()) {
+            warning() << "Trying to remove a bus name for handle" << handle <<
+                "which has not been retrieved previously!";
+            continue;
+        }
+
+        ContactPtr contact = contactsForBusNames.take(busName);
+        removedBusNames.insert(busName, contact);
+
+        if (notify) {
+            emit parent->busNameRemoved(busName, contact);
+        }
+    }
+
+    QHash<uint, ContactPtr> contactsForHandles;
+    foreach (const ContactPtr &contact, contacts) {
+        contactsForHandles.insert(contact->handle()[0], contact);
+    }
+
+    for (DBusTubeParticipants::const_iterator i = change.added.constBegin();
+         i != change.added.constEnd();
          ++i) {
-        QUuid uuid = queuedContactFactory->appendNewRequest(UIntList() << i.key());
-        pendingNewBusNamesToAdd.insert(uuid, i.value());
+        ContactPtr contact = contactsForHandles.value(i.key());
+        if (!contact) {
+            warning() << "Unable to build the contact for handle" << i.key() <<
+                "- ignoring bus name" << i.value();
+            continue;
+        }
+
+        // A contact has at most one bus name on the tube
+        QString oldBusName = busNamesForHandles.value(i.key());
+        if (!oldBusName.isEmpty()) {
+            contactsForBusNames.remove(oldBusName);
+        }
+
+        contactsForBusNames.insert(i.value(), contact);
+        busNamesForHandles.insert(i.key(), i.value());
+        addedBusNames.insert(i.value(), contact);
+
+        if (notify) {
+            emit parent->busNameAdded(i.value(), contact);
+        }
+    }
+
+    if (notify) {
+        if (!removedBusNames.isEmpty()) {
+            emit parent->busNamesRemoved(removedBusNames);
+        }
+        if (!addedBusNames.isEmpty()) {
+            emit parent->busNamesAdded(addedBusNames);
+        }
     }
 }
 
@@ -189,7 +292,7 @@ const Feature DBusTubeChannel::FeatureCore = Feature(QLatin1String(DBusTubeChann
  *
  * See bus name monitoring specific methods' documentation for more details.
  *
- * \sa busNameAdded(), busNameRemoved()
+ * \sa busNameAdded(), busNameRemoved(), busNamesAdded(), busNamesRemoved()
  */
 const Feature DBusTubeChannel::FeatureBusNameMonitoring = Feature(QLatin1String(DBusTubeChannel::staticMetaObject.className()), 1);
 
@@ -323,7 +426,11 @@ QString DBusTubeChannel::address() const
  *
  * This method requires FeatureBusNameMonitoring to be enabled.
  *
+ * The returned hash is implicitly shared, so this function is cheap to call; to find out
+ * the contact behind a single bus name, contactForBusName() is however more convenient.
+ *
  * \returns A list of active connection ids known to this tube
+ * \sa contactForBusName(), busNameForContact()
  */
 QHash<QString, Tp::ContactPtr> DBusTubeChannel::contactsForBusNames() const
 {
@@ -336,6 +443,57 @@ QHash<QString, Tp::ContactPtr> DBusTubeChannel::contactsForBusNames() const
     return mPriv->contactsForBusNames;
 }
 
+/**
+ * Return the contact owning the given bus name in this tube.
+ *
+ * This is meant to be used for instance to find out who sent a message received
+ * through the tube, and takes constant time regardless of the number of participants.
+ *
+ * This method requires FeatureBusNameMonitoring to be enabled.
+ *
+ * \param busName The bus name to look up.
+ * \return A pointer to the Contact object owning \a busName, or a null ContactPtr if
+ *         there is no participant with that bus name in this tube.
+ * \sa busNameForContact(), contactsForBusNames()
+ */
+Tp::ContactPtr DBusTubeChannel::contactForBusName(const QString &busName) const
+{
+    if (!isReady(FeatureBusNameMonitoring)) {
+        warning() << "DBusTubeChannel::contactForBusName() used with "
+            "FeatureBusNameMonitoring not ready";
+        return ContactPtr();
+    }
+
+    return mPriv->contactsForBusNames.value(busName);
+}
+
+/**
+ * Return the bus name the given contact is using in this tube.
+ *
+ * A contact has at most one bus name in a tube at any time.
+ *
+ * This method requires FeatureBusNameMonitoring to be enabled.
+ *
+ * \param contact The contact to look up.
+ * \return The bus name of \a contact, or an empty string if \a contact is not
+ *         participating in this tube.
+ * \sa contactForBusName(), contactsForBusNames()
+ */
+QString DBusTubeChannel::busNameForContact(const Tp::ContactPtr &contact) const
+{
+    if (!isReady(FeatureBusNameMonitoring)) {
+        warning() << "DBusTubeChannel::busNameForContact() used with "
+            "FeatureBusNameMonitoring not ready";
+        return QString();
+    }
+
+    if (!contact || contact->manager()->connection() != connection()) {
+        return QString();
+    }
+
+    return mPriv->busNamesForHandles.value(contact->handle()[0]);
+}
+
 void DBusTubeChannel::onRequestAllPropertiesFinished(PendingOperation *op)
 {
     if (!op->isError()) {
@@ -398,58 +556,50 @@ void DBusTubeChannel::onQueueCompleted()
 void DBusTubeChannel::onDBusNamesChanged(const Tp::DBusTubeParticipants &added,
         const Tp::UIntList &removed)
 {
-    for (DBusTubeParticipants::const_iterator i = added.constBegin();
-         i != added.constEnd();
-         ++i) {
-        QUuid uuid = mPriv->queuedContactFactory->appendNewRequest(UIntList() << i.key());
-        // Add it to our hash as well
-        mPriv->pendingNewBusNamesToAdd.insert(uuid, i.value());
-    }
-
-    foreach (uint handle, removed) {
-        QUuid uuid = mPriv->queuedContactFactory->appendNewRequest(UIntList() << handle);
-        // Add it to pending removed as well
-        mPriv->pendingNewBusNamesToRemove << uuid;
-    }
+    Private::BusNamesChange change;
+    change.added = added;
+    change.removed = removed;
+    mPriv->queueBusNamesChange(change);
 }
 
 void DBusTubeChannel::onContactsRetrieved(const QUuid &uuid, const QList<ContactPtr> &contacts)
 {
-    // Retrieve our hash
-    if (mPriv->pendingNewBusNamesToAdd.contains(uuid)) {
-        QString busName = mPriv->pendingNewBusNamesToAdd.take(uuid);
-
-        // Add it to our connections hash
-        foreach (const Tp::ContactPtr &contact, contacts) {
-            mPriv->contactsForBusNames.insert(busName, contact);
-
-            // Time for us to emit the signal - if the feature is ready
-            if (isReady(FeatureBusNameMonitoring)) {
-                emit busNameAdded(busName, contact);
-            }
-        }
-    } else if (mPriv->pendingNewBusNamesToRemove.contains(uuid)) {
-        mPriv->pendingNewBusNamesToRemove.removeOne(uuid);
-
-        // Remove it from our connections hash
-        foreach (const Tp::ContactPtr &contact, contacts) {
-            if (mPriv->contactsForBusNames.values().contains(contact)) {
-                QString busName = mPriv->contactsForBusNames.key(contact);
-                mPriv->contactsForBusNames.remove(busName);
-
-                // Time for us to emit the signal - if the feature is ready
-                if (isReady(FeatureBusNameMonitoring)) {
-                    emit busNameRemoved(busName, contact);
-                }
-            } else {
-                warning() << "Trying to remove a bus name for contact " << contact->id()
-                          << " which has not been retrieved previously!";
-            }
-        }
-    } else {
+    QQueue<Private::BusNamesChange>::iterator i = mPriv->pendingBusNamesChanges.begin();
+    while (i != mPriv->pendingBusNamesChanges.end() && i->uuid != uuid) {
+        ++i;
+    }
+
+    if (uuid.isNull() || i == mPriv->pendingBusNamesChanges.end()) {
         warning() << "Contacts retrieved but no pending bus names were found";
         return;
     }
+
+    // The contacts are kept with the change until the ones signalled before it are applied
+    i->retrieved = true;
+    i->contacts = contacts;
+    if (i != mPriv->pendingBusNamesChanges.begin()) {
+        return;
+    }
+
+    Private::BusNamesChange change = mPriv->pendingBusNamesChanges.dequeue();
+    mPriv->applyBusNamesChange(change, change.contacts);
+
+    if (!mPriv->pendingBusNamesChanges.isEmpty() &&
+        (mPriv->pendingBusNamesChanges.head().uuid.isNull() ||
+         mPriv->pendingBusNamesChanges.head().retrieved)) {
+        // Let the handlers of the changes just applied see them before the next ones
+        QTimer::singleShot(0, this, SLOT(processPendingBusNamesChanges()));
+    }
+}
+
+void DBusTubeChannel::processPendingBusNamesChanges()
+{
+    while (!mPriv->pendingBusNamesChanges.isEmpty() &&
+           (mPriv->pendingBusNamesChanges.head().uuid.isNull() ||
+            mPriv->pendingBusNamesChanges.head().retrieved)) {
+        Private::BusNamesChange change = mPriv->pendingBusNamesChanges.dequeue();
+        mPriv->applyBusNamesChange(change, change.contacts);
+    }
 }
 
 void DBusTubeChannel::setAddress(const QString& address)
@@ -482,4 +632,30 @@ void DBusTubeChannel::setAddress(const QString& address)
  * \param contact The ContactPtr identifying the participant
  */
 
+/**
+ * \fn void DBusTubeChannel::busNamesAdded(const QHash<QString, Tp::ContactPtr> &busNames)
+ *
+ * Emitted once for each batch of participants joining this tube, after busNameAdded()
+ * has been emitted for each of them.
+ *
+ * This signal will be emitted only if the tube is a group tube (not p2p), and if the
+ * FeatureBusNameMonitoring feature has been enabled.
+ *
+ * \param busNames The bus names of the new participants, mapped to the contacts
+ *                 identifying them.
+ */
+
+/**
+ * \fn void DBusTubeChannel::busNamesRemoved(const QHash<QString, Tp::ContactPtr> &busNames)
+ *
+ * Emitted once for each batch of participants leaving this tube, after busNameRemoved()
+ * has been emitted for each of them.
+ *
+ * This signal will be emitted only if the tube is a group tube (not p2p), and if the
+ * FeatureBusNameMonitoring feature has been enabled.
+ *
+ * \param busNames The bus names of the participants leaving, mapped to the contacts
+ *                 identifying them.
+ */
+
 }
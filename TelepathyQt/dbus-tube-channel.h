@@ -50,6 +50,8 @@ public:
     bool supportsRestrictingToCurrentUser() const;
 
     QHash<QString, Tp::ContactPtr> contactsForBusNames() const;
+    Tp::ContactPtr contactForBusName(const QString &busName) const;
+    QString busNameForContact(const Tp::ContactPtr &contact) const;
 
     QString address() const;
 
@@ -60,6 +62,8 @@ protected:
 Q_SIGNALS:
     void busNameAdded(const QString &busName, const Tp::ContactPtr &contact);
     void busNameRemoved(const QString &busName, const Tp::ContactPtr &contact);
+    void busNamesAdded(const QHash<QString, Tp::ContactPtr> &busNames);
+    void busNamesRemoved(const QHash<QString, Tp::ContactPtr> &busNames);
 
 private Q_SLOTS:
     TP_QT_NO_EXPORT void onRequestAllPropertiesFinished(Tp::PendingOperation*);
@@ -67,6 +71,7 @@ private Q_SLOTS:
     TP_QT_NO_EXPORT void onDBusNamesChanged(const Tp::DBusTubeParticipants &added, const Tp::UIntList &removed);
     TP_QT_NO_EXPORT void onContactsRetrieved(const QUuid &uuid, const QList<Tp::ContactPtr> &contacts);
     TP_QT_NO_EXPORT void onQueueCompleted();
+    TP_QT_NO_EXPORT void processPendingBusNamesChanges();
 
 private:
     TP_QT_NO_EXPORT void setAddress(const QString &address);
@@ -25,6 +25,7 @@
 #include "TelepathyQt/_gen/file-transfer-channel.moc.hpp"
 
 #include "TelepathyQt/debug-internal.h"
+#include "TelepathyQt/properties-prefetcher-internal.h"
 
 #include <TelepathyQt/Connection>
 #include <TelepathyQt/Types>
@@ -118,8 +119,8 @@ void FileTransferChannel::Private::introspectProperties(
 {
     QDBusPendingCallWatcher *watcher =
         new QDBusPendingCallWatcher(
-                self->properties->GetAll(
-                    TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER),
+                PropertiesPrefetcher::forBus(self->parent->dbusConnection())->getAll(
+                    self->parent, TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER),
                 self->parent);
     self->parent->connect(watcher,
             SIGNAL(finished(QDBusPendingCallWatcher*)),
@@ -82,11 +82,48 @@ struct TP_QT_NO_EXPORT Message::Private : public QSharedData
     Private(const MessagePartList &parts);
     ~Private();
 
+    // The well-known header keys, unwrapped from their QDBusVariants whenever
+    // the parts are set
+    struct Header
+    {
+        uint messageType;
+        uint sent;
+        uint received;
+        uint senderHandle;
+        uint pendingId;
+        QString senderId;
+        QString senderNickname;
+        QString messageToken;
+        QString supersededToken;
+        QString dbusInterface;
+        bool scrollback;
+        bool rescued;
+    };
+
+    // What can be derived from the body parts, also computed whenever the parts
+    // are set
+    struct Body
+    {
+        QString text;
+        bool truncated;
+        bool nonTextContent;
+    };
+
+    const Header &header() const { return parsedHeader; }
+    const Body &body() const { return parsedBody; }
+
     uint senderHandle() const;
     QString senderId() const;
     uint pendingId() const;
     void clearSenderHandle();
 
+    // Must be called whenever the parts change. The results are never
+    // computed lazily, as copies of a Message share them and may be read
+    // from several threads at once.
+    void parse();
+    void parseHeader();
+    void parseBody();
+
     MessagePartList parts;
 
     // if the Text interface says "non-text" we still only have the text,
@@ -96,6 +133,9 @@ struct TP_QT_NO_EXPORT Message::Private : public QSharedData
     // for received messages only
     WeakPtr<TextChannel> textChannel;
     ContactPtr sender;
+
+    Header parsedHeader;
+    Body parsedBody;
 };
 
 Message::Private::Private(const MessagePartList &parts)
@@ -103,30 +143,115 @@ Message::Private::Private(const MessagePartList &parts)
       forceNonText(false),
       sender(0)
 {
+    parse();
 }
 
 Message::Private::~Private()
 {
 }
 
+void Message::Private::parse()
+{
+    parseHeader();
+    parseBody();
+}
+
+void Message::Private::parseHeader()
+{
+    if (parts.isEmpty()) {
+        // only the internal default constructor gets here
+        parsedHeader = Header();
+        return;
+    }
+
+    // FIXME See http://bugs.freedesktop.org/show_bug.cgi?id=21690
+    parsedHeader.messageType = uintOrZeroFromPart(parts, 0, "message-type");
+    parsedHeader.sent = uintOrZeroFromPart(parts, 0, "message-sent");
+    parsedHeader.received = uintOrZeroFromPart(parts, 0, "message-received");
+    parsedHeader.senderHandle = uintOrZeroFromPart(parts, 0, "message-sender");
+    parsedHeader.pendingId = uintOrZeroFromPart(parts, 0, "pending-message-id");
+    parsedHeader.senderId = stringOrEmptyFromPart(parts, 0, "message-sender-id");
+    parsedHeader.senderNickname = stringOrEmptyFromPart(parts, 0, "sender-nickname");
+    parsedHeader.messageToken = stringOrEmptyFromPart(parts, 0, "message-token");
+    parsedHeader.supersededToken = stringOrEmptyFromPart(parts, 0, "supersedes");
+    parsedHeader.dbusInterface = stringOrEmptyFromPart(parts, 0, "interface");
+    parsedHeader.scrollback = booleanFromPart(parts, 0, "scrollback", false);
+    parsedHeader.rescued = booleanFromPart(parts, 0, "rescued", false);
+}
+
+void Message::Private::parseBody()
+{
+    // Alternative-groups for which we've already emitted an alternative
+    QSet<QString> altGroupsUsed;
+    // Alternative-groups containing a text/plain alternative, and those needing one
+    QSet<QString> texts;
+    QSet<QString> textNeeded;
+    bool unrescuableNonText = false;
+
+    parsedBody.text = QString();
+    parsedBody.truncated = false;
+
+    for (int i = 1; i < parts.size(); i++) {
+        if (booleanFromPart(parts, i, "truncated", false)) {
+            parsedBody.truncated = true;
+        }
+
+        QString altGroup = stringOrEmptyFromPart(parts, i, "alternative");
+        QString contentType = stringOrEmptyFromPart(parts, i, "content-type");
+
+        if (contentType == QLatin1String("text/plain")) {
+            if (!altGroup.isEmpty()) {
+                // we can use this as an alternative for a non-text part
+                // with the same altGroup
+                texts << altGroup;
+
+                if (altGroupsUsed.contains(altGroup)) {
+                    continue;
+                } else {
+                    altGroupsUsed << altGroup;
+                }
+            }
+
+            QVariant content = valueFromPart(parts, i, "content");
+            if (content.type() == QVariant::String) {
+                parsedBody.text += content.toString();
+            } else {
+                // O RLY?
+                debug() << "allegedly text/plain part wasn't";
+            }
+        } else if (altGroup.isEmpty()) {
+            // we can't possibly rescue this part by using a text/plain
+            // alternative, because it's not in any alternative group
+            unrescuableNonText = true;
+        } else {
+            // maybe we'll find a text/plain alternative for this
+            textNeeded << altGroup;
+        }
+    }
+
+    textNeeded -= texts;
+    parsedBody.nonTextContent = unrescuableNonText || !textNeeded.isEmpty();
+}
+
 inline uint Message::Private::senderHandle() const
 {
-    return uintOrZeroFromPart(parts, 0, "message-sender");
+    return header().senderHandle;
 }
 
 inline QString Message::Private::senderId() const
 {
-    return stringOrEmptyFromPart(parts, 0, "message-sender-id");
+    return header().senderId;
 }
 
 inline uint Message::Private::pendingId() const
 {
-    return uintOrZeroFromPart(parts, 0, "pending-message-id");
+    return header().pendingId;
 }
 
 void Message::Private::clearSenderHandle()
 {
     parts[0].remove(QLatin1String("message-sender"));
+    parseHeader();
 }
 
 /**
@@ -177,6 +302,7 @@ Message::Message(uint timestamp, uint type, const QString &text)
     mPriv->parts[1].insert(QLatin1String("content-type"),
             QDBusVariant(QLatin1String("text/plain")));
     mPriv->parts[1].insert(QLatin1String("content"), QDBusVariant(text));
+    mPriv->parse();
 }
 
 /**
@@ -194,6 +320,7 @@ Message::Message(ChannelTextMessageType type, const QString &text)
     mPriv->parts[1].insert(QLatin1String("content-type"),
             QDBusVariant(QLatin1String("text/plain")));
     mPriv->parts[1].insert(QLatin1String("content"), QDBusVariant(text));
+    mPriv->parse();
 }
 
 /**
@@ -239,8 +366,7 @@ Message::~Message()
  */
 QDateTime Message::sent() const
 {
-    // FIXME See http://bugs.freedesktop.org/show_bug.cgi?id=21690
-    uint stamp = valueFromPart(mPriv->parts, 0, "message-sent").toUInt();
+    uint stamp = mPriv->header().sent;
     if (stamp != 0) {
         return QDateTime::fromTime_t(stamp);
     } else {
@@ -256,7 +382,7 @@ QDateTime Message::sent() const
  */
 ChannelTextMessageType Message::messageType() const
 {
-    uint raw = valueFromPart(mPriv->parts, 0, "message-type").toUInt();
+    uint raw = mPriv->header().messageType;
 
     if (raw < static_cast<uint>(NUM_CHANNEL_TEXT_MESSAGE_TYPES)) {
         return ChannelTextMessageType(raw);
@@ -272,12 +398,7 @@ ChannelTextMessageType Message::messageType() const
  */
 bool Message::isTruncated() const
 {
-    for (int i = 1; i < size(); i++) {
-        if (booleanFromPart(mPriv->parts, i, "truncated", false)) {
-            return true;
-        }
-    }
-    return false;
+    return mPriv->body().truncated;
 }
 
 /**
@@ -293,34 +414,7 @@ bool Message::hasNonTextContent() const
         return true;
     }
 
-    QSet<QString> texts;
-    QSet<QString> textNeeded;
-
-    for (int i = 1; i < size(); i++) {
-        QString altGroup = stringOrEmptyFromPart(mPriv->parts, i, "alternative");
-        QString contentType = stringOrEmptyFromPart(mPriv->parts, i, "content-type");
-
-        if (contentType == QLatin1String("text/plain")) {
-            if (!altGroup.isEmpty()) {
-                // we can use this as an alternative for a non-text part
-                // with the same altGroup
-                texts << altGroup;
-            }
-        } else {
-            QString alt = stringOrEmptyFromPart(mPriv->parts, i, "alternative");
-            if (altGroup.isEmpty()) {
-                // we can't possibly rescue this part by using a text/plain
-                // alternative, because it's not in any alternative group
-                return true;
-            } else {
-                // maybe we'll find a text/plain alternative for this
-                textNeeded << altGroup;
-            }
-        }
-    }
-
-    textNeeded -= texts;
-    return !textNeeded.isEmpty();
+    return mPriv->body().nonTextContent;
 }
 
 /**
@@ -331,7 +425,7 @@ bool Message::hasNonTextContent() const
  */
 QString Message::messageToken() const
 {
-    return stringOrEmptyFromPart(mPriv->parts, 0, "message-token");
+    return mPriv->header().messageToken;
 }
 
 /**
@@ -361,7 +455,7 @@ bool Message::isSpecificToDBusInterface() const
  */
 QString Message::dbusInterface() const
 {
-    return stringOrEmptyFromPart(mPriv->parts, 0, "interface");
+    return mPriv->header().dbusInterface;
 }
 
 /**
@@ -371,34 +465,7 @@ QString Message::dbusInterface() const
  */
 QString Message::text() const
 {
-    // Alternative-groups for which we've already emitted an alternative
-    QSet<QString> altGroupsUsed;
-    QString text;
-
-    for (int i = 1; i < size(); i++) {
-        QString altGroup = stringOrEmptyFromPart(mPriv->parts, i, "alternative");
-        QString contentType = stringOrEmptyFromPart(mPriv->parts, i, "content-type");
-
-        if (contentType == QLatin1String("text/plain")) {
-            if (!altGroup.isEmpty()) {
-                if (altGroupsUsed.contains(altGroup)) {
-                    continue;
-                } else {
-                    altGroupsUsed << altGroup;
-                }
-            }
-
-            QVariant content = valueFromPart(mPriv->parts, i, "content");
-            if (content.type() == QVariant::String) {
-                text += content.toString();
-            } else {
-                // O RLY?
-                debug() << "allegedly text/plain part wasn't";
-            }
-        }
-    }
-
-    return text;
+    return mPriv->body().text;
 }
 
 /**
@@ -474,11 +541,29 @@ MessagePartList Message::parts() const
 struct TP_QT_NO_EXPORT ReceivedMessage::DeliveryDetails::Private : public QSharedData
 {
     Private(const MessagePartList &parts)
-        : parts(parts)
+        : status(static_cast<DeliveryStatus>(uintOrZeroFromPart(parts, 0, "delivery-status"))),
+          error(static_cast<ChannelTextSendError>(uintOrZeroFromPart(parts, 0, "delivery-error"))),
+          hasOriginalToken(partContains(parts, 0, "delivery-token")),
+          originalToken(stringOrEmptyFromPart(parts, 0, "delivery-token")),
+          hasDebugMessage(partContains(parts, 0, "delivery-error-message")),
+          debugMessage(stringOrEmptyFromPart(parts, 0, "delivery-error-message")),
+          dbusError(stringOrEmptyFromPart(parts, 0, "delivery-dbus-error")),
+          hasEchoedMessage(partContains(parts, 0, "delivery-echo"))
     {
+        if (hasEchoedMessage) {
+            echoedMessageParts = partsFromPart(parts, 0, "delivery-echo");
+        }
     }
 
-    MessagePartList parts;
+    DeliveryStatus status;
+    ChannelTextSendError error;
+    bool hasOriginalToken;
+    QString originalToken;
+    bool hasDebugMessage;
+    QString debugMessage;
+    QString dbusError;
+    bool hasEchoedMessage;
+    MessagePartList echoedMessageParts;
 };
 
 /**
@@ -533,7 +618,7 @@ DeliveryStatus ReceivedMessage::DeliveryDetails::status() const
     if (!isValid()) {
         return DeliveryStatusUnknown;
     }
-    return static_cast<DeliveryStatus>(uintOrZeroFromPart(mPriv->parts, 0, "delivery-status"));
+    return mPriv->status;
 }
 
 /**
@@ -548,7 +633,7 @@ bool ReceivedMessage::DeliveryDetails::hasOriginalToken() const
     if (!isValid()) {
         return false;
     }
-    return partContains(mPriv->parts, 0, "delivery-token");
+    return mPriv->hasOriginalToken;
 }
 
 /**
@@ -568,7 +653,7 @@ QString ReceivedMessage::DeliveryDetails::originalToken() const
     if (!isValid()) {
         return QString();
     }
-    return stringOrEmptyFromPart(mPriv->parts, 0, "delivery-token");
+    return mPriv->originalToken;
 }
 
 /**
@@ -597,7 +682,7 @@ ChannelTextSendError ReceivedMessage::DeliveryDetails::error() const
     if (!isValid()) {
         return ChannelTextSendErrorUnknown;
     }
-    return static_cast<ChannelTextSendError>(uintOrZeroFromPart(mPriv->parts, 0, "delivery-error"));
+    return mPriv->error;
 }
 
 /**
@@ -612,7 +697,7 @@ bool ReceivedMessage::DeliveryDetails::hasDebugMessage() const
     if (!isValid()) {
         return false;
     }
-    return partContains(mPriv->parts, 0, "delivery-error-message");
+    return mPriv->hasDebugMessage;
 }
 
 /**
@@ -627,7 +712,7 @@ QString ReceivedMessage::DeliveryDetails::debugMessage() const
     if (!isValid()) {
         return QString();
     }
-    return stringOrEmptyFromPart(mPriv->parts, 0, "delivery-error-message");
+    return mPriv->debugMessage;
 }
 
 /**
@@ -641,7 +726,7 @@ QString ReceivedMessage::DeliveryDetails::dbusError() const
     if (!isValid()) {
         return QString();
     }
-    QString ret = stringOrEmptyFromPart(mPriv->parts, 0, "delivery-dbus-error");
+    QString ret = mPriv->dbusError;
     if (ret.isEmpty()) {
         switch (error()) {
             case ChannelTextSendErrorOffline:
@@ -677,7 +762,7 @@ bool ReceivedMessage::DeliveryDetails::hasEchoedMessage() const
     if (!isValid()) {
         return false;
     }
-    return partContains(mPriv->parts, 0, "delivery-echo");
+    return mPriv->hasEchoedMessage;
 }
 
 /**
@@ -701,7 +786,7 @@ Message ReceivedMessage::DeliveryDetails::echoedMessage() const
     if (!isValid()) {
         return Message();
     }
-    return Message(partsFromPart(mPriv->parts, 0, "delivery-echo"));
+    return Message(mPriv->echoedMessageParts);
 }
 
 /**
@@ -726,6 +811,7 @@ ReceivedMessage::ReceivedMessage(const MessagePartList &parts,
         mPriv->parts[0].insert(QLatin1String("message-received"),
                 QDBusVariant(static_cast<qlonglong>(
                         QDateTime::currentDateTime().toTime_t())));
+        mPriv->parseHeader();
     }
     mPriv->textChannel = channel;
 }
@@ -764,8 +850,7 @@ ReceivedMessage::~ReceivedMessage()
  */
 QDateTime ReceivedMessage::received() const
 {
-    // FIXME See http://bugs.freedesktop.org/show_bug.cgi?id=21690
-    uint stamp = valueFromPart(mPriv->parts, 0, "message-received").toUInt();
+    uint stamp = mPriv->header().received;
     if (stamp != 0) {
         return QDateTime::fromTime_t(stamp);
     } else {
@@ -793,7 +878,7 @@ ContactPtr ReceivedMessage::sender() const
  */
 QString ReceivedMessage::senderNickname() const
 {
-    QString ret = stringOrEmptyFromPart(mPriv->parts, 0, "sender-nickname");
+    QString ret = mPriv->header().senderNickname;
     if (ret.isEmpty() && mPriv->sender) {
         ret = mPriv->sender->alias();
     }
@@ -811,7 +896,7 @@ QString ReceivedMessage::senderNickname() const
  */
 QString ReceivedMessage::supersededToken() const
 {
-    return stringOrEmptyFromPart(mPriv->parts, 0, "supersedes");
+    return mPriv->header().supersededToken;
 }
 
 /**
@@ -826,7 +911,7 @@ QString ReceivedMessage::supersededToken() const
  */
 bool ReceivedMessage::isScrollback() const
 {
-    return booleanFromPart(mPriv->parts, 0, "scrollback", false);
+    return mPriv->header().scrollback;
 }
 
 /**
@@ -840,7 +925,7 @@ bool ReceivedMessage::isScrollback() const
  */
 bool ReceivedMessage::isRescued() const
 {
-    return booleanFromPart(mPriv->parts, 0, "rescued", false);
+    return mPriv->header().rescued;
 }
 
 /**
@@ -31,9 +31,11 @@
 
 #include "TelepathyQt/debug-internal.h"
 
+#include <QCoreApplication>
 #include <QDBusPendingCall>
 #include <QDBusPendingCallWatcher>
-#include <QTimer>
+#include <QEvent>
+#include <QPair>
 
 namespace Tp
 {
@@ -46,12 +48,21 @@ struct TP_QT_NO_EXPORT PendingOperation::Private
     {
     }
 
+    static QEvent::Type finishedEventType();
+
     SharedPtr<RefCounted> object;
     QString errorName;
     QString errorMessage;
     bool finished;
+    QList<QPair<FinishedCallback, void *> > finishedCallbacks;
 };
 
+QEvent::Type PendingOperation::Private::finishedEventType()
+{
+    static int type = QEvent::registerEventType();
+    return static_cast<QEvent::Type>(type);
+}
+
 /**
  * \class PendingOperation
  * \headerfile TelepathyQt/pending-operation.h <TelepathyQt/PendingOperation>
@@ -82,6 +93,52 @@ struct TP_QT_NO_EXPORT PendingOperation::Private
  * See \ref async_model
  */
 
+/**
+ * \class PendingOperationAwaiter
+ * \headerfile TelepathyQt/pending-operation.h <TelepathyQt/PendingOperation>
+ *
+ * \brief The PendingOperationAwaiter class allows a PendingOperation to be
+ * awaited from a C++20 coroutine.
+ *
+ * This class is only available when the code including TelepathyQt is built
+ * with coroutine support and Qt 5. It is not meant to be used directly,
+ * use awaitFinished() instead:
+ *
+ * \code
+ *
+ * PendingContacts *pc = co_await Tp::awaitFinished(
+ *         connection->contactManager()->contactsForIdentifiers(ids));
+ * if (pc->isValid()) {
+ *     doSomething(pc->contacts());
+ * }
+ *
+ * \endcode
+ *
+ * If the operation has already finished when it is awaited, the coroutine
+ * carries on immediately without returning to the event loop. Otherwise it is
+ * resumed right before the operation emits finished(), without going through
+ * a signal connection. In both cases the operation is still alive when the
+ * coroutine resumes, and will be deleted once the coroutine suspends again or
+ * returns, as usual.
+ *
+ * If the operation is deleted before finishing, the awaiting coroutine is
+ * never resumed. Awaiting an operation which has already been deleted carries
+ * on immediately, with a null pointer as the result. If the coroutine is destroyed while it is waiting, the
+ * operation forgets about it and will not try to resume it.
+ */
+
+/**
+ * \fn template<class T> PendingOperationAwaiter<T> awaitFinished(T *operation)
+ *
+ * Return an awaitable object for the given \a operation, which can be any
+ * PendingOperation subclass, such as PendingReady, PendingContacts,
+ * PendingVariant or PendingChannel. Awaiting it yields \a operation once it
+ * has finished.
+ *
+ * \param operation The operation to await.
+ * \return A PendingOperationAwaiter for \a operation.
+ */
+
 /**
  * Construct a new PendingOperation object.
  *
@@ -117,9 +174,51 @@ SharedPtr<RefCounted> PendingOperation::object() const
     return mPriv->object;
 }
 
+/**
+ * Reimplemented from QObject to emit finished() once the event loop runs
+ * after the operation has finished.
+ *
+ * \param event The event to be handled.
+ * \return \c true if the event was handled, \c false otherwise.
+ */
+bool PendingOperation::event(QEvent *event)
+{
+    if (event->type() == Private::finishedEventType()) {
+        emitFinished();
+        return true;
+    }
+
+    return QObject::event(event);
+}
+
+void PendingOperation::addFinishedCallback(FinishedCallback callback, void *data)
+{
+    mPriv->finishedCallbacks.append(qMakePair(callback, data));
+}
+
+void PendingOperation::removeFinishedCallback(FinishedCallback callback, void *data)
+{
+    mPriv->finishedCallbacks.removeAll(qMakePair(callback, data));
+}
+
+void PendingOperation::scheduleEmitFinished()
+{
+    // Emitting from a posted event rather than a single-shot timer saves setting up a timer for
+    // every operation on Qt 4
+    QCoreApplication::postEvent(this, new QEvent(Private::finishedEventType()));
+}
+
 void PendingOperation::emitFinished()
 {
     Q_ASSERT(mPriv->finished);
+
+    // Callbacks may remove the ones after them (i.e. a resumed coroutine destroying another one
+    // waiting on us), so take them one at a time
+    while (!mPriv->finishedCallbacks.isEmpty()) {
+        QPair<FinishedCallback, void *> callback = mPriv->finishedCallbacks.takeFirst();
+        callback.first(this, callback.second);
+    }
+
     emit finished(this);
     deleteLater();
 }
@@ -143,7 +242,7 @@ void PendingOperation::setFinished()
 
     mPriv->finished = true;
     Q_ASSERT(isValid());
-    QTimer::singleShot(0, this, SLOT(emitFinished()));
+    scheduleEmitFinished();
 }
 
 /**
@@ -178,7 +277,7 @@ void PendingOperation::setFinishedWithError(const QString &name,
     mPriv->errorMessage = message;
     mPriv->finished = true;
     Q_ASSERT(isError());
-    QTimer::singleShot(0, this, SLOT(emitFinished()));
+    scheduleEmitFinished();
 }
 
 /**
@@ -364,9 +463,7 @@ PendingComposite::PendingComposite(const QList<PendingOperation*> &operations,
       mPriv(new Private(true, operations.size()))
 {
     foreach (PendingOperation *operation, operations) {
-        connect(operation,
-                SIGNAL(finished(Tp::PendingOperation*)),
-                SLOT(onOperationFinished(Tp::PendingOperation*)));
+        watchOperation(operation);
     }
 }
 
@@ -376,9 +473,7 @@ PendingComposite::PendingComposite(const QList<PendingOperation*> &operations,
       mPriv(new Private(failOnFirstError, operations.size()))
 {
     foreach (PendingOperation *operation, operations) {
-        connect(operation,
-                SIGNAL(finished(Tp::PendingOperation*)),
-                SLOT(onOperationFinished(Tp::PendingOperation*)));
+        watchOperation(operation);
     }
 }
 
@@ -387,6 +482,19 @@ PendingComposite::~PendingComposite()
     delete mPriv;
 }
 
+void PendingComposite::watchOperation(PendingOperation *operation)
+{
+    if (operation->isFinished()) {
+        // No need to wait for finished() to be emitted, the result is already known
+        onOperationFinished(operation);
+        return;
+    }
+
+    connect(operation,
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(onOperationFinished(Tp::PendingOperation*)));
+}
+
 void PendingComposite::onOperationFinished(Tp::PendingOperation *op)
 {
     if (op->isError()) {
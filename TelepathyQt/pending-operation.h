@@ -32,10 +32,17 @@
 #include <TelepathyQt/SharedPtr>
 
 #include <QObject>
+#include <QPointer>
+
+#if defined(__cpp_impl_coroutine) && QT_VERSION >= 0x050000
+#define TP_QT_ENABLE_COROUTINES
+#include <coroutine>
+#endif
 
 class QDBusError;
 class QDBusPendingCall;
 class QDBusPendingCallWatcher;
+class QEvent;
 
 namespace Tp
 {
@@ -65,6 +72,8 @@ protected:
     PendingOperation(const SharedPtr<RefCounted> &object);
     SharedPtr<RefCounted> object() const;
 
+    bool event(QEvent *event);
+
 protected Q_SLOTS:
     void setFinished();
     void setFinishedWithError(const QString &name, const QString &message);
@@ -74,14 +83,84 @@ private Q_SLOTS:
     TP_QT_NO_EXPORT void emitFinished();
 
 private:
+    typedef void (*FinishedCallback)(PendingOperation *operation, void *data);
+    void addFinishedCallback(FinishedCallback callback, void *data);
+    void removeFinishedCallback(FinishedCallback callback, void *data);
+
+    TP_QT_NO_EXPORT void scheduleEmitFinished();
+
     friend class ContactManager;
     friend class ReadinessHelper;
+    template<class T> friend class PendingOperationAwaiter;
 
     struct Private;
     friend struct Private;
     Private *mPriv;
 };
 
+#ifdef TP_QT_ENABLE_COROUTINES
+
+template<class T>
+class PendingOperationAwaiter
+{
+public:
+    explicit PendingOperationAwaiter(T *operation)
+        : mOperation(operation),
+          mWaiting(false)
+    {
+    }
+
+    PendingOperationAwaiter(const PendingOperationAwaiter &other)
+        : mOperation(other.mOperation),
+          mWaiting(false)
+    {
+    }
+
+    ~PendingOperationAwaiter()
+    {
+        if (mWaiting && mOperation) {
+            mOperation->removeFinishedCallback(&PendingOperationAwaiter::resume, this);
+        }
+    }
+
+    bool await_ready() const
+    {
+        // An operation which is already gone can't finish anymore, so don't wait for it
+        return !mOperation || mOperation->isFinished();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        mHandle = handle;
+        mWaiting = true;
+        mOperation->addFinishedCallback(&PendingOperationAwaiter::resume, this);
+    }
+
+    T *await_resume() const { return mOperation.data(); }
+
+private:
+    PendingOperationAwaiter &operator=(const PendingOperationAwaiter &);
+
+    static void resume(PendingOperation *, void *data)
+    {
+        PendingOperationAwaiter *self = static_cast<PendingOperationAwaiter *>(data);
+        self->mWaiting = false;
+        self->mHandle.resume();
+    }
+
+    QPointer<T> mOperation;
+    std::coroutine_handle<> mHandle;
+    bool mWaiting;
+};
+
+template<class T>
+inline PendingOperationAwaiter<T> awaitFinished(T *operation)
+{
+    return PendingOperationAwaiter<T>(operation);
+}
+
+#endif
+
 } // Tp
 
 #endif
@@ -0,0 +1,45 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_pending_ready_internal_h_HEADER_GUARD_
+#define _TelepathyQt_pending_ready_internal_h_HEADER_GUARD_
+
+#ifndef BUILDING_TP_QT
+#error "This file is a TpQt internal header not to be included by applications"
+#endif
+
+#include <QList>
+
+#include <TelepathyQt/Global>
+
+namespace Tp
+{
+
+class PendingOperation;
+
+// Whether the objects the PendingReady operations in readyOps are for are ready with the features
+// requested already, even though the operations themselves only finish from the mainloop
+TP_QT_NO_EXPORT bool readyOpsSatisfied(const QList<PendingOperation *> &readyOps);
+
+} // Tp
+
+#endif
@@ -22,11 +22,14 @@
 
 #include <TelepathyQt/PendingReady>
 
+#include "TelepathyQt/pending-ready-internal.h"
+
 #include "TelepathyQt/_gen/pending-ready.moc.hpp"
 
 #include "TelepathyQt/debug-internal.h"
 
 #include <TelepathyQt/DBusProxy>
+#include <TelepathyQt/ReadyObject>
 
 namespace Tp
 {
@@ -145,4 +148,30 @@ void PendingReady::onNestedFinished(Tp::PendingOperation *nested)
     }
 }
 
+bool readyOpsSatisfied(const QList<PendingOperation *> &readyOps)
+{
+    foreach (PendingOperation *readyOp, readyOps) {
+        if (readyOp->isFinished()) {
+            if (readyOp->isError()) {
+                return false;
+            }
+            continue;
+        }
+
+        PendingReady *pr = qobject_cast<PendingReady *>(readyOp);
+        if (!pr) {
+            return false;
+        }
+
+        // A factory with no features to make ready finishes its PendingReady straight away, so
+        // only the ones with features requested get here
+        ReadyObject *readyObject = dynamic_cast<ReadyObject *>(pr->proxy().data());
+        if (!readyObject || !readyObject->isReady(pr->requestedFeatures())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 } // Tp
@@ -0,0 +1,223 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TelepathyQt/properties-changed-dispatcher-internal.h"
+
+#include "TelepathyQt/_gen/properties-changed-dispatcher-internal.moc.hpp"
+
+#include "TelepathyQt/debug-internal.h"
+
+#include <TelepathyQt/AbstractInterface>
+#include <TelepathyQt/Constants>
+
+#include <QTimer>
+
+namespace Tp
+{
+
+/*
+ * PropertiesChangedDispatcher subscribes to PropertiesChanged once per (service, object path) on
+ * behalf of all the AbstractInterface instances monitoring properties on that object, instead of
+ * each of them adding its own match rule. Incoming changes are routed to the interested instances
+ * by interface name, and the changes for an interface arriving within the same mainloop iteration
+ * are merged and delivered as one propertiesChanged() emission.
+ */
+
+PropertiesChangedDispatcher *PropertiesChangedDispatcher::forBus(const QDBusConnection &bus)
+{
+    return DBusConnectionRegistry<PropertiesChangedDispatcher>::forBus(bus);
+}
+
+PropertiesChangedDispatcher::PropertiesChangedDispatcher(const QDBusConnection &bus)
+    : QObject(),
+      mBus(bus)
+{
+}
+
+PropertiesChangedDispatcher::~PropertiesChangedDispatcher()
+{
+    qDeleteAll(mSubscriptions);
+}
+
+bool PropertiesChangedDispatcher::addInterface(AbstractInterface *iface)
+{
+    Key key(iface->service(), iface->path());
+    Subscription *subscription = mSubscriptions.value(key);
+    if (!subscription) {
+        subscription = new Subscription(mBus, key);
+        if (!subscription->connectToBus()) {
+            delete subscription;
+            return false;
+        }
+        mSubscriptions.insert(key, subscription);
+    }
+
+    subscription->addInterface(iface);
+    return true;
+}
+
+bool PropertiesChangedDispatcher::removeInterface(AbstractInterface *iface)
+{
+    Key key(iface->service(), iface->path());
+    Subscription *subscription = mSubscriptions.value(key);
+    if (!subscription) {
+        return false;
+    }
+
+    subscription->removeInterface(iface);
+    if (subscription->isEmpty()) {
+        subscription->disconnectFromBus();
+        mSubscriptions.remove(key);
+        // We might be called from within its flush(), through a propertiesChanged() handler
+        subscription->deleteLater();
+    }
+    return true;
+}
+
+PropertiesChangedDispatcher::Subscription::Subscription(const QDBusConnection &bus,
+        const Key &key)
+    : QObject(),
+      mBus(bus),
+      mKey(key),
+      mConnected(false),
+      mFlushScheduled(false)
+{
+}
+
+PropertiesChangedDispatcher::Subscription::~Subscription()
+{
+    disconnectFromBus();
+}
+
+bool PropertiesChangedDispatcher::Subscription::connectToBus()
+{
+    mConnected = mBus.connect(mKey.first, mKey.second, TP_QT_IFACE_PROPERTIES,
+            QLatin1String("PropertiesChanged"), this,
+            SLOT(onPropertiesChanged(QString,QVariantMap,QStringList)));
+    return mConnected;
+}
+
+void PropertiesChangedDispatcher::Subscription::disconnectFromBus()
+{
+    if (!mConnected) {
+        return;
+    }
+
+    mConnected = false;
+    mInterfaces.clear();
+    mPendingChanges.clear();
+    mPendingOrder.clear();
+
+    if (!mBus.disconnect(mKey.first, mKey.second, TP_QT_IFACE_PROPERTIES,
+                QLatin1String("PropertiesChanged"), this,
+                SLOT(onPropertiesChanged(QString,QVariantMap,QStringList)))) {
+        warning() << "Disconnection from" << TP_QT_IFACE_PROPERTIES <<
+            ".PropertiesChanged failed for" << mKey.first << mKey.second;
+    }
+}
+
+void PropertiesChangedDispatcher::Subscription::addInterface(AbstractInterface *iface)
+{
+    QList<AbstractInterface *> &ifaces = mInterfaces[iface->interface()];
+    if (!ifaces.contains(iface)) {
+        ifaces.append(iface);
+    }
+}
+
+void PropertiesChangedDispatcher::Subscription::removeInterface(AbstractInterface *iface)
+{
+    QHash<QString, QList<AbstractInterface *> >::iterator i = mInterfaces.find(iface->interface());
+    if (i == mInterfaces.end()) {
+        return;
+    }
+
+    i->removeOne(iface);
+    if (i->isEmpty()) {
+        mInterfaces.erase(i);
+        if (mPendingChanges.remove(iface->interface())) {
+            mPendingOrder.removeOne(iface->interface());
+        }
+    }
+}
+
+void PropertiesChangedDispatcher::Subscription::onPropertiesChanged(const QString &interface,
+        const QVariantMap &changedProperties,
+        const QStringList &invalidatedProperties)
+{
+    if (!mInterfaces.contains(interface)) {
+        return;
+    }
+
+    if (!mPendingChanges.contains(interface)) {
+        mPendingOrder.append(interface);
+    }
+    Changes &changes = mPendingChanges[interface];
+
+    // Later changes win over earlier ones, be it a new value or an invalidation
+    for (QVariantMap::const_iterator i = changedProperties.constBegin();
+            i != changedProperties.constEnd(); ++i) {
+        changes.changed.insert(i.key(), i.value());
+        changes.invalidated.removeAll(i.key());
+    }
+    foreach (const QString &property, invalidatedProperties) {
+        changes.changed.remove(property);
+        if (!changes.invalidated.contains(property)) {
+            changes.invalidated.append(property);
+        }
+    }
+
+    if (!mFlushScheduled) {
+        mFlushScheduled = true;
+        QTimer::singleShot(0, this, SLOT(flush()));
+    }
+}
+
+void PropertiesChangedDispatcher::Subscription::flush()
+{
+    mFlushScheduled = false;
+
+    QHash<QString, Changes> pendingChanges = mPendingChanges;
+    QStringList pendingOrder = mPendingOrder;
+    mPendingChanges.clear();
+    mPendingOrder.clear();
+
+    foreach (const QString &interface, pendingOrder) {
+        const Changes &changes = pendingChanges[interface];
+        QList<AbstractInterface *> ifaces = mInterfaces.value(interface);
+        foreach (AbstractInterface *iface, ifaces) {
+            // A handler may have stopped another instance from monitoring, or deleted it
+            if (!mInterfaces.value(interface).contains(iface)) {
+                continue;
+            }
+            PropertiesChangedDispatcher::deliver(iface, interface, changes.changed,
+                    changes.invalidated);
+        }
+    }
+}
+
+void PropertiesChangedDispatcher::deliver(AbstractInterface *iface, const QString &interface,
+        const QVariantMap &changedProperties, const QStringList &invalidatedProperties)
+{
+    iface->onPropertiesChanged(interface, changedProperties, invalidatedProperties);
+}
+
+} // Tp
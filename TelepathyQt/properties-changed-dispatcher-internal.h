@@ -0,0 +1,120 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_properties_changed_dispatcher_internal_h_HEADER_GUARD_
+#define _TelepathyQt_properties_changed_dispatcher_internal_h_HEADER_GUARD_
+
+#include <TelepathyQt/Global>
+
+#include "TelepathyQt/dbus-connection-registry-internal.h"
+
+#include <QDBusConnection>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+namespace Tp
+{
+
+class AbstractInterface;
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+class TP_QT_NO_EXPORT PropertiesChangedDispatcher : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(PropertiesChangedDispatcher)
+
+public:
+    static PropertiesChangedDispatcher *forBus(const QDBusConnection &bus);
+
+    ~PropertiesChangedDispatcher();
+
+    QDBusConnection dbusConnection() const { return mBus; }
+
+    bool addInterface(AbstractInterface *iface);
+    bool removeInterface(AbstractInterface *iface);
+
+private:
+    class Subscription;
+    friend class Subscription;
+
+    typedef QPair<QString /* service */, QString /* path */> Key;
+
+    friend class DBusConnectionRegistry<PropertiesChangedDispatcher>;
+
+    PropertiesChangedDispatcher(const QDBusConnection &bus);
+
+    static void deliver(AbstractInterface *iface, const QString &interface,
+            const QVariantMap &changedProperties, const QStringList &invalidatedProperties);
+
+    QDBusConnection mBus;
+    QHash<Key, Subscription *> mSubscriptions;
+};
+
+class TP_QT_NO_EXPORT PropertiesChangedDispatcher::Subscription : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(Subscription)
+
+public:
+    Subscription(const QDBusConnection &bus, const Key &key);
+    ~Subscription();
+
+    bool connectToBus();
+    void disconnectFromBus();
+
+    bool isEmpty() const { return mInterfaces.isEmpty(); }
+    void addInterface(AbstractInterface *iface);
+    void removeInterface(AbstractInterface *iface);
+
+private Q_SLOTS:
+    void onPropertiesChanged(const QString &interface,
+            const QVariantMap &changedProperties,
+            const QStringList &invalidatedProperties);
+    void flush();
+
+private:
+    struct Changes
+    {
+        QVariantMap changed;
+        QStringList invalidated;
+    };
+
+    QDBusConnection mBus;
+    Key mKey;
+    bool mConnected;
+    QHash<QString, QList<AbstractInterface *> > mInterfaces;
+    QHash<QString, Changes> mPendingChanges;
+    QStringList mPendingOrder;
+    bool mFlushScheduled;
+};
+
+#endif // DOXYGEN_SHOULD_SKIP_THIS
+
+} // Tp
+
+#endif
@@ -0,0 +1,273 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TelepathyQt/properties-prefetcher-internal.h"
+
+#include "TelepathyQt/_gen/properties-prefetcher-internal.moc.hpp"
+
+#include "TelepathyQt/dbus-call-queue-internal.h"
+#include "TelepathyQt/debug-internal.h"
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusProxy>
+
+namespace Tp
+{
+
+/*
+ * PropertiesPrefetcher lets the Properties.GetAll calls needed to make a proxy ready be made as
+ * soon as the proxy is constructed, all at once, rather than one after the other as the
+ * introspection of each feature reaches them. The introspection code then asks for the properties
+ * through getAll(), which hands out the prefetched call, finished or not, if there is one.
+ *
+ * The introspection code connects to the change notification signals of an interface before asking
+ * for its properties, so that no change can be missed. To keep that guarantee, the signals of the
+ * prefetched interfaces are watched from before the prefetch is made, and a prefetched reply is
+ * thrown away if any of them arrives after the reply itself, leaving getAll() to make a fresh call.
+ * Signals arriving before the reply are already accounted for by it. The main Channel interface has
+ * nothing but immutable properties, so it isn't watched.
+ *
+ * Prefetches are made as background calls through DBusCallQueue, so that they don't hold back the
+ * calls somebody is waiting on. A prefetch which is still queued when it's asked for is issued
+ * right away.
+ */
+
+struct TP_QT_NO_EXPORT PropertiesPrefetcher::Entry
+{
+    Entry(QObject *proxy, const QString &service, const QString &path,
+            const QString &interface, DBusCallQueue::PendingCall *op)
+        : proxy(proxy),
+          service(service),
+          path(path),
+          interface(interface),
+          call(op->pendingCall()),
+          op(op),
+          answered(false),
+          watching(false)
+    {
+    }
+
+    QObject *proxy;
+    QString service;
+    QString path;
+    QString interface;
+    QDBusPendingCall call;
+    DBusCallQueue::PendingCall *op;
+    bool answered;
+    bool watching;
+};
+
+PropertiesPrefetcher *PropertiesPrefetcher::forBus(const QDBusConnection &bus)
+{
+    return DBusConnectionRegistry<PropertiesPrefetcher>::forBus(bus);
+}
+
+PropertiesPrefetcher::PropertiesPrefetcher(const QDBusConnection &bus)
+    : QObject(),
+      mBus(bus)
+{
+}
+
+PropertiesPrefetcher::~PropertiesPrefetcher()
+{
+    foreach (const QHash<QString, Entry *> &entries, mEntries) {
+        foreach (Entry *entry, entries) {
+            drop(entry);
+        }
+    }
+}
+
+/*
+ * Start fetching the properties of \a interfaces on \a proxy. The results are kept until they're
+ * asked for with getAll(), invalidated by a change, or \a proxy is destroyed.
+ */
+void PropertiesPrefetcher::prefetch(DBusProxy *proxy, const QStringList &interfaces)
+{
+    bool known = mEntries.contains(proxy);
+    QHash<QString, Entry *> &entries = mEntries[proxy];
+
+    foreach (const QString &interface, interfaces) {
+        if (entries.contains(interface)) {
+            continue;
+        }
+
+        Key key(proxy->objectPath(), interface);
+        bool watch = interface != TP_QT_IFACE_CHANNEL;
+        if (watch) {
+            if (mWatchedEntries.contains(key)) {
+                // Already being prefetched for another proxy for the same object
+                continue;
+            }
+
+            if (!mBus.connect(proxy->busName(), proxy->objectPath(), interface, QString(),
+                        this, SLOT(onSignal(QDBusMessage)))) {
+                warning() << "Unable to watch" << interface << "on" << proxy->objectPath() <<
+                    "- not prefetching its properties";
+                continue;
+            }
+        }
+
+        debug() << "Prefetching Properties::GetAll(" << interface << ") for" <<
+            proxy->objectPath();
+
+        QDBusMessage msg = QDBusMessage::createMethodCall(proxy->busName(), proxy->objectPath(),
+                TP_QT_IFACE_PROPERTIES, QLatin1String("GetAll"));
+        msg << interface;
+        Entry *entry = new Entry(proxy, proxy->busName(), proxy->objectPath(), interface,
+                DBusCallQueue::forBus(mBus)->call(msg, DBusCallScheduler::PriorityBackground,
+                    proxy->objectPath(), SharedPtr<RefCounted>()));
+        entry->watching = watch;
+        if (watch) {
+            mWatchedEntries.insert(key, entry);
+        }
+
+        connect(entry->op,
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(onGetAllFinished(Tp::PendingOperation*)));
+        mPendingEntries.insert(entry->op, entry);
+
+        entries.insert(interface, entry);
+    }
+
+    if (entries.isEmpty()) {
+        mEntries.remove(proxy);
+    } else if (!known) {
+        connect(proxy,
+                SIGNAL(destroyed(QObject*)),
+                SLOT(onProxyDestroyed(QObject*)));
+    }
+}
+
+/*
+ * Return a call to Properties.GetAll(\a interface) on \a proxy, either a prefetched one or, if
+ * there is none which is still usable, a new one.
+ */
+QDBusPendingCall PropertiesPrefetcher::getAll(DBusProxy *proxy, const QString &interface)
+{
+    Entry *entry = take(proxy, interface);
+    if (!entry) {
+        return callGetAll(proxy, interface);
+    }
+
+    debug() << "Using prefetched Properties::GetAll(" << interface << ") for" <<
+        proxy->objectPath();
+
+    QDBusPendingCall call = entry->call;
+    if (entry->op) {
+        DBusCallQueue::forBus(mBus)->expedite(entry->op);
+        call = entry->op->pendingCall();
+    }
+    drop(entry);
+    return call;
+}
+
+QDBusPendingCall PropertiesPrefetcher::callGetAll(DBusProxy *proxy,
+        const QString &interface) const
+{
+    QDBusMessage msg = QDBusMessage::createMethodCall(proxy->busName(), proxy->objectPath(),
+            TP_QT_IFACE_PROPERTIES, QLatin1String("GetAll"));
+    msg << interface;
+    return DBusCallQueue::forBus(mBus)->callNow(msg);
+}
+
+PropertiesPrefetcher::Entry *PropertiesPrefetcher::take(QObject *proxy, const QString &interface)
+{
+    QHash<QObject *, QHash<QString, Entry *> >::iterator i = mEntries.find(proxy);
+    if (i == mEntries.end()) {
+        return 0;
+    }
+
+    Entry *entry = i->take(interface);
+    if (i->isEmpty()) {
+        mEntries.erase(i);
+        disconnect(proxy,
+                SIGNAL(destroyed(QObject*)),
+                this,
+                SLOT(onProxyDestroyed(QObject*)));
+    }
+    return entry;
+}
+
+void PropertiesPrefetcher::drop(Entry *entry)
+{
+    if (entry->watching) {
+        mWatchedEntries.remove(Key(entry->path, entry->interface));
+        mBus.disconnect(entry->service, entry->path, entry->interface, QString(),
+                this, SLOT(onSignal(QDBusMessage)));
+    }
+
+    if (entry->op) {
+        mPendingEntries.remove(entry->op);
+        disconnect(entry->op, 0, this, 0);
+        // Once issued, the call itself carries on for whoever got it from getAll()
+        DBusCallQueue::forBus(mBus)->cancel(entry->op);
+    }
+
+    delete entry;
+}
+
+void PropertiesPrefetcher::onGetAllFinished(PendingOperation *op)
+{
+    Entry *entry = mPendingEntries.take(op);
+    if (!entry) {
+        return;
+    }
+
+    entry->call = entry->op->pendingCall();
+    entry->op = 0;
+
+    if (op->isError()) {
+        // Let the introspection code make its own call and handle the error as it sees fit
+        debug() << "Prefetching Properties::GetAll(" << entry->interface << ") for" <<
+            entry->path << "failed:" << op->errorName();
+        take(entry->proxy, entry->interface);
+        drop(entry);
+        return;
+    }
+
+    entry->answered = true;
+}
+
+void PropertiesPrefetcher::onSignal(const QDBusMessage &message)
+{
+    Entry *entry = mWatchedEntries.value(Key(message.path(), message.interface()));
+    // The operation is finished as soon as the reply arrives, but only tells us later on
+    if (!entry || !(entry->answered || (entry->op && entry->op->isFinished()))) {
+        // The reply is yet to arrive, and will already reflect the change
+        return;
+    }
+
+    debug() << "Dropping prefetched Properties::GetAll(" << entry->interface << ") for" <<
+        entry->path << "as" << message.member() << "was emitted since";
+    take(entry->proxy, entry->interface);
+    drop(entry);
+}
+
+void PropertiesPrefetcher::onProxyDestroyed(QObject *proxy)
+{
+    QHash<QString, Entry *> entries = mEntries.take(proxy);
+    foreach (Entry *entry, entries) {
+        drop(entry);
+    }
+}
+
+} // Tp
@@ -0,0 +1,90 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_properties_prefetcher_internal_h_HEADER_GUARD_
+#define _TelepathyQt_properties_prefetcher_internal_h_HEADER_GUARD_
+
+#include <TelepathyQt/Global>
+
+#include "TelepathyQt/dbus-connection-registry-internal.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCall>
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+namespace Tp
+{
+
+class DBusProxy;
+class PendingOperation;
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+class TP_QT_NO_EXPORT PropertiesPrefetcher : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(PropertiesPrefetcher)
+
+public:
+    static PropertiesPrefetcher *forBus(const QDBusConnection &bus);
+
+    ~PropertiesPrefetcher();
+
+    QDBusConnection dbusConnection() const { return mBus; }
+
+    void prefetch(DBusProxy *proxy, const QStringList &interfaces);
+    QDBusPendingCall getAll(DBusProxy *proxy, const QString &interface);
+
+private Q_SLOTS:
+    void onGetAllFinished(Tp::PendingOperation *op);
+    void onSignal(const QDBusMessage &message);
+    void onProxyDestroyed(QObject *proxy);
+
+private:
+    struct Entry;
+
+    typedef QPair<QString /* path */, QString /* interface */> Key;
+
+    friend class DBusConnectionRegistry<PropertiesPrefetcher>;
+
+    PropertiesPrefetcher(const QDBusConnection &bus);
+
+    QDBusPendingCall callGetAll(DBusProxy *proxy, const QString &interface) const;
+    Entry *take(QObject *proxy, const QString &interface);
+    void drop(Entry *entry);
+
+    QDBusConnection mBus;
+    QHash<QObject *, QHash<QString, Entry *> > mEntries;
+    QHash<Key, Entry *> mWatchedEntries;
+    QHash<PendingOperation *, Entry *> mPendingEntries;
+};
+
+#endif // DOXYGEN_SHOULD_SKIP_THIS
+
+} // Tp
+
+#endif
@@ -24,6 +24,7 @@
 
 #include "TelepathyQt/_gen/readiness-helper.moc.hpp"
 
+#include "TelepathyQt/dbus-name-owner-cache-internal.h"
 #include "TelepathyQt/debug-internal.h"
 
 #include <TelepathyQt/Constants>
@@ -108,6 +109,7 @@ struct TP_QT_NO_EXPORT ReadinessHelper::Private
             const QString &errorName = QString(),
             const QString &errorMessage = QString());
     void iterateIntrospection();
+    bool isWaitingForUniqueName();
     Features depsFor(const Feature &feature); // Recursive dependencies for a feature
 
     void abortOperations(const QString &errorName, const QString &errorMessage);
@@ -130,6 +132,8 @@ struct TP_QT_NO_EXPORT ReadinessHelper::Private
 
     bool pendingStatusChange;
     uint pendingStatus;
+
+    bool waitingForUniqueName;
 };
 
 ReadinessHelper::Private::Private(
@@ -143,7 +147,8 @@ ReadinessHelper::Private::Private(
       currentStatus(currentStatus),
       introspectables(introspectables),
       pendingStatusChange(false),
-      pendingStatus(-1)
+      pendingStatus(-1),
+      waitingForUniqueName(false)
 {
     for (Introspectables::const_iterator i = introspectables.constBegin();
             i != introspectables.constEnd(); ++i) {
@@ -166,7 +171,8 @@ ReadinessHelper::Private::Private(
       currentStatus(currentStatus),
       introspectables(introspectables),
       pendingStatusChange(false),
-      pendingStatus(-1)
+      pendingStatus(-1),
+      waitingForUniqueName(false)
 {
     Q_ASSERT(proxy != 0);
 
@@ -328,6 +334,13 @@ void ReadinessHelper::Private::iterateIntrospection()
     // satisfied + missing
     pendingFeatures -= completedFeatures;
 
+    // Don't fire any introspection jobs before a StatefulDBusProxy has bound to its unique name, as
+    // they'd otherwise end up talking to whoever owns the well-known name at the time
+    if (isWaitingForUniqueName()) {
+        debug() << "ReadinessHelper: not iterating as the proxy unique name is not resolved yet";
+        return;
+    }
+
     // find out which features don't have dependencies that are still pending
     Features readyToIntrospect;
     foreach (const Feature &feature, pendingFeatures) {
@@ -376,6 +389,36 @@ void ReadinessHelper::Private::iterateIntrospection()
     }
 }
 
+bool ReadinessHelper::Private::isWaitingForUniqueName()
+{
+    // A StatefulDBusProxy busName() is only a well-known name while its unique name is being
+    // looked up asynchronously
+    StatefulDBusProxy *statefulProxy = qobject_cast<StatefulDBusProxy *>(proxy);
+    bool waiting = statefulProxy && !statefulProxy->busName().startsWith(QLatin1Char(':'));
+    if (waiting == waitingForUniqueName) {
+        return waiting;
+    }
+
+    waitingForUniqueName = waiting;
+
+    DBusNameOwnerCache *cache = DBusNameOwnerCache::forBus(proxy->dbusConnection());
+    if (waiting) {
+        // Queued, so that the proxy has had the chance to update its bus name by the time we
+        // iterate again
+        parent->connect(cache,
+                SIGNAL(ownerResolved(QString,QString,QString,QString)),
+                SLOT(iterateIntrospection()),
+                Qt::QueuedConnection);
+    } else {
+        parent->disconnect(cache,
+                SIGNAL(ownerResolved(QString,QString,QString,QString)),
+                parent,
+                SLOT(iterateIntrospection()));
+    }
+
+    return waiting;
+}
+
 Features ReadinessHelper::Private::depsFor(const Feature &feature)
 {
     Features deps;
@@ -488,6 +531,46 @@ void ReadinessHelper::forceCurrentStatus(uint currentStatus)
     mPriv->currentStatus = currentStatus;
 }
 
+/**
+ * Force \a feature to be satisfied, without running its introspection.
+ *
+ * This is useful for example when everything the introspection would find out
+ * was supplied when constructing the object, and the other objects the feature
+ * depends on are already ready. isReady() then returns \c true for \a feature
+ * straight away, and becomeReady() calls for it finish without introspecting
+ * anything, though still from the mainloop like any other.
+ *
+ * This must be called before \a feature has been requested, and only when the
+ * features it depends on are satisfied.
+ *
+ * \param feature The feature to set as satisfied.
+ */
+void ReadinessHelper::forceFeatureSatisfied(const Feature &feature)
+{
+    if (!mPriv->supportedFeatures.contains(feature)) {
+        warning() << "ReadinessHelper::forceFeatureSatisfied called with unsupported feature" <<
+            feature;
+        return;
+    }
+
+    if (mPriv->requestedFeatures.contains(feature)) {
+        warning() << "ReadinessHelper::forceFeatureSatisfied called with feature" << feature <<
+            "which has already been requested";
+        return;
+    }
+
+    Features deps = mPriv->depsFor(feature);
+    if (!(deps - mPriv->satisfiedFeatures).isEmpty()) {
+        warning() << "ReadinessHelper::forceFeatureSatisfied called with feature" << feature <<
+            "which depends on unsatisfied features";
+        return;
+    }
+
+    debug() << "ReadinessHelper: feature" << feature << "satisfied without introspection";
+    mPriv->requestedFeatures.insert(feature);
+    mPriv->satisfiedFeatures.insert(feature);
+}
+
 QStringList ReadinessHelper::interfaces() const
 {
     return mPriv->interfaces;
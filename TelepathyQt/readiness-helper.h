@@ -91,6 +91,7 @@ public:
     uint currentStatus() const;
     void setCurrentStatus(uint currentStatus);
     void forceCurrentStatus(uint currentStatus);
+    void forceFeatureSatisfied(const Feature &feature);
 
     QStringList interfaces() const;
     void setInterfaces(const QStringList &interfaces);
@@ -26,24 +26,379 @@
 #include "TelepathyQt/debug-internal.h"
 
 #include <TelepathyQt/Connection>
+#include <TelepathyQt/PendingFailure>
+#include <TelepathyQt/PendingVoid>
+
+#include <QQueue>
+#include <QSet>
+#include <QVector>
+
+#include <algorithm>
 
 namespace Tp
 {
 
+namespace
+{
+
+enum RoomFlag
+{
+    RoomHasMemberCount = 0x1,
+    RoomHasPassword = 0x2,
+    RoomRequiresPassword = 0x4,
+    RoomHasInviteOnly = 0x8,
+    RoomIsInviteOnly = 0x10
+};
+
+}
+
+struct TP_QT_NO_EXPORT RoomListChannel::Room::Private : public QSharedData
+{
+    Private(uint handle, const QString &identifier, const QString &name, uint memberCount,
+            uint flags, const QVariantMap &info, bool hasFullInfo)
+        : handle(handle),
+          identifier(identifier),
+          name(name),
+          memberCount(memberCount),
+          flags(flags),
+          info(info),
+          hasFullInfo(hasFullInfo)
+    {
+    }
+
+    uint handle;
+    QString identifier;
+    QString name;
+    uint memberCount;
+    uint flags;
+    QVariantMap info;
+    bool hasFullInfo;
+};
+
 struct TP_QT_NO_EXPORT RoomListChannel::Private
 {
-    inline Private();
-    inline ~Private();
+    Private(RoomListChannel *parent, const QVariantMap &immutableProperties);
+    ~Private();
+
+    static void introspectMain(Private *self);
+
+    // What is kept for every room listed. The complete info map is only kept for the
+    // maxRoomInfoCount most recently listed rooms, see infos.
+    struct StoredRoom
+    {
+        uint handle;
+        QString identifier;
+        QString name; // empty if the same as identifier
+        uint memberCount;
+        uint flags;
+    };
+
+    // The sorted prefix index refers to the identifier of room i as i * 2 and to its name as
+    // i * 2 + 1
+    struct KeyLessThan
+    {
+        KeyLessThan(const Private *priv) : priv(priv) {}
+        bool operator()(int a, int b) const
+        {
+            return QString::compare(priv->key(a), priv->key(b), Qt::CaseInsensitive) < 0;
+        }
+        bool operator()(int a, const QString &prefix) const
+        {
+            return QString::compare(priv->key(a), prefix, Qt::CaseInsensitive) < 0;
+        }
+        const Private *priv;
+    };
+
+    bool addRoom(const RoomInfo &roomInfo);
+    void storeInfo(uint handle, const QVariantMap &info);
+    void evictInfos();
+    static QSet<QString> trigramsOf(const StoredRoom &stored);
+    void indexTrigrams(int index, const StoredRoom *old, const StoredRoom &stored);
+    const QString &key(int encoded) const;
+    Room roomAt(int index) const;
+    void ensureSortedKeys() const;
+
+    // Public object
+    RoomListChannel *parent;
+
+    QVariantMap immutableProperties;
+
+    Client::ChannelTypeRoomListInterface *roomListInterface;
+    Client::DBus::PropertiesInterface *properties;
+
+    ReadinessHelper *readinessHelper;
+
+    // Introspection
+    QString server;
+    bool listingRooms;
+
+    // Room store
+    QVector<StoredRoom> rooms;
+    QHash<uint, int> roomIndexes;
+
+    int maxRoomInfoCount;
+    QHash<uint, QVariantMap> infos;
+    // Handles in the order their infos were stored. A room listed again is enqueued again rather
+    // than moved, infoListings counting its entries so that only the last one evicts its info.
+    QQueue<uint> infoOrder;
+    QHash<uint, int> infoListings;
+
+    // Substring index: room indexes by the lowercase trigrams of their identifier and name, each
+    // room appearing at most once per trigram
+    QHash<QString, QVector<int> > trigrams;
+
+    // Prefix index, brought up to date lazily as rooms stream in
+    mutable QVector<int> sortedKeys;
+    mutable int sortedRoomCount;
+    mutable bool sortedKeysInvalid;
 };
 
-RoomListChannel::Private::Private()
+RoomListChannel::Private::Private(RoomListChannel *parent,
+        const QVariantMap &immutableProperties)
+    : parent(parent),
+      immutableProperties(immutableProperties),
+      roomListInterface(parent->interface<Client::ChannelTypeRoomListInterface>()),
+      properties(parent->interface<Client::DBus::PropertiesInterface>()),
+      readinessHelper(parent->readinessHelper()),
+      listingRooms(false),
+      maxRoomInfoCount(1000),
+      sortedRoomCount(0),
+      sortedKeysInvalid(false)
 {
+    ReadinessHelper::Introspectables introspectables;
+
+    ReadinessHelper::Introspectable introspectableCore(
+        QSet<uint>() << 0,                                                      // makesSenseForStatuses
+        Features() << Channel::FeatureCore,                                     // dependsOnFeatures (core)
+        QStringList(),                                                          // dependsOnInterfaces
+        (ReadinessHelper::IntrospectFunc) &Private::introspectMain,
+        this);
+    introspectables[FeatureCore] = introspectableCore;
+
+    readinessHelper->addIntrospectables(introspectables);
 }
 
 RoomListChannel::Private::~Private()
 {
 }
 
+void RoomListChannel::Private::introspectMain(RoomListChannel::Private *self)
+{
+    self->parent->connect(self->roomListInterface,
+            SIGNAL(GotRooms(Tp::RoomInfoList)),
+            SLOT(onGotRooms(Tp::RoomInfoList)));
+    self->parent->connect(self->roomListInterface,
+            SIGNAL(ListingRooms(bool)),
+            SLOT(onListingRooms(bool)));
+
+    const static QString serverProperty(TP_QT_IFACE_CHANNEL_TYPE_ROOM_LIST +
+            QLatin1String(".Server"));
+    if (self->immutableProperties.contains(serverProperty)) {
+        self->server = qdbus_cast<QString>(self->immutableProperties.value(serverProperty));
+
+        QDBusPendingCallWatcher *watcher =
+            new QDBusPendingCallWatcher(self->roomListInterface->GetListingRooms(),
+                    self->parent);
+        self->parent->connect(watcher,
+                SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(gotListingRooms(QDBusPendingCallWatcher*)));
+    } else {
+        QDBusPendingCallWatcher *watcher =
+            new QDBusPendingCallWatcher(
+                    self->properties->GetAll(TP_QT_IFACE_CHANNEL_TYPE_ROOM_LIST),
+                    self->parent);
+        self->parent->connect(watcher,
+                SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(gotProperties(QDBusPendingCallWatcher*)));
+    }
+}
+
+bool RoomListChannel::Private::addRoom(const RoomInfo &roomInfo)
+{
+    const QVariantMap &info = roomInfo.info;
+
+    StoredRoom stored;
+    stored.handle = roomInfo.handle;
+    stored.identifier = qdbus_cast<QString>(info.value(QLatin1String("handle-name")));
+    stored.name = qdbus_cast<QString>(info.value(QLatin1String("name")));
+    if (stored.name == stored.identifier) {
+        stored.name.clear();
+    }
+    stored.memberCount = 0;
+    stored.flags = 0;
+
+    QVariantMap::const_iterator i = info.constFind(QLatin1String("members"));
+    if (i != info.constEnd()) {
+        stored.memberCount = qdbus_cast<uint>(i.value());
+        stored.flags |= RoomHasMemberCount;
+    }
+    i = info.constFind(QLatin1String("password"));
+    if (i != info.constEnd()) {
+        stored.flags |= RoomHasPassword;
+        if (qdbus_cast<bool>(i.value())) {
+            stored.flags |= RoomRequiresPassword;
+        }
+    }
+    i = info.constFind(QLatin1String("invite-only"));
+    if (i != info.constEnd()) {
+        stored.flags |= RoomHasInviteOnly;
+        if (qdbus_cast<bool>(i.value())) {
+            stored.flags |= RoomIsInviteOnly;
+        }
+    }
+
+    bool isNew;
+    QHash<uint, int>::const_iterator existing = roomIndexes.constFind(stored.handle);
+    if (existing == roomIndexes.constEnd()) {
+        int index = rooms.size();
+        isNew = true;
+        rooms.append(stored);
+        roomIndexes.insert(stored.handle, index);
+        indexTrigrams(index, 0, stored);
+    } else {
+        // Listed again, e.g. by a second ListRooms() call; the new details win
+        int index = existing.value();
+        isNew = false;
+        const StoredRoom &old = rooms.at(index);
+        if (old.identifier != stored.identifier || old.name != stored.name) {
+            sortedKeysInvalid = true;
+            indexTrigrams(index, &old, stored);
+        }
+        rooms[index] = stored;
+    }
+
+    storeInfo(stored.handle, info);
+    return isNew;
+}
+
+void RoomListChannel::Private::storeInfo(uint handle, const QVariantMap &info)
+{
+    if (maxRoomInfoCount == 0) {
+        return;
+    }
+
+    infoOrder.enqueue(handle);
+    ++infoListings[handle];
+    infos.insert(handle, info);
+
+    // Drop the stale entries of rooms listed again once they outnumber the live ones, so that
+    // periodic relisting doesn't grow the queue
+    if (infoOrder.size() > 2 * infos.size()) {
+        QQueue<uint> live;
+        for (QQueue<uint>::const_iterator i = infoOrder.constBegin(); i != infoOrder.constEnd(); ++i) {
+            int &listings = infoListings[*i];
+            if (--listings == 0) {
+                listings = 1;
+                live.enqueue(*i);
+            }
+        }
+        infoOrder = live;
+    }
+
+    evictInfos();
+}
+
+void RoomListChannel::Private::evictInfos()
+{
+    if (maxRoomInfoCount < 0) {
+        return;
+    }
+
+    while (infos.size() > maxRoomInfoCount) {
+        uint handle = infoOrder.dequeue();
+        QHash<uint, int>::iterator listings = infoListings.find(handle);
+        if (--listings.value() == 0) {
+            infoListings.erase(listings);
+            infos.remove(handle);
+        }
+    }
+}
+
+QSet<QString> RoomListChannel::Private::trigramsOf(const StoredRoom &stored)
+{
+    QSet<QString> ret;
+    QString keys[2] = { stored.identifier.toLower(), stored.name.toLower() };
+    for (int k = 0; k < 2; ++k) {
+        for (int i = 0; i + 3 <= keys[k].size(); ++i) {
+            ret.insert(keys[k].mid(i, 3));
+        }
+    }
+    return ret;
+}
+
+void RoomListChannel::Private::indexTrigrams(int index, const StoredRoom *old,
+        const StoredRoom &stored)
+{
+    QSet<QString> added = trigramsOf(stored);
+    if (old) {
+        // Renamed: only the trigrams the room gained or lost change
+        QSet<QString> removed = trigramsOf(*old);
+        QSet<QString> kept = removed;
+        kept.intersect(added);
+        removed.subtract(kept);
+        added.subtract(kept);
+
+        foreach (const QString &trigram, removed) {
+            QHash<QString, QVector<int> >::iterator postings = trigrams.find(trigram);
+            postings.value().remove(postings.value().indexOf(index));
+            if (postings.value().isEmpty()) {
+                trigrams.erase(postings);
+            }
+        }
+    }
+
+    foreach (const QString &trigram, added) {
+        trigrams[trigram].append(index);
+    }
+}
+
+const QString &RoomListChannel::Private::key(int encoded) const
+{
+    const StoredRoom &stored = rooms.at(encoded / 2);
+    return (encoded % 2) ? stored.name : stored.identifier;
+}
+
+RoomListChannel::Room RoomListChannel::Private::roomAt(int index) const
+{
+    const StoredRoom &stored = rooms.at(index);
+    QHash<uint, QVariantMap>::const_iterator info = infos.constFind(stored.handle);
+    bool hasFullInfo = (info != infos.constEnd());
+    return Room(new Room::Private(stored.handle, stored.identifier, stored.name,
+                stored.memberCount, stored.flags,
+                hasFullInfo ? info.value() : QVariantMap(), hasFullInfo));
+}
+
+void RoomListChannel::Private::ensureSortedKeys() const
+{
+    if (sortedKeysInvalid) {
+        sortedKeys.clear();
+        sortedRoomCount = 0;
+        sortedKeysInvalid = false;
+    }
+
+    if (sortedRoomCount == rooms.size()) {
+        return;
+    }
+
+    // Sort the keys of the rooms listed since the last lookup and merge them in, rather than
+    // sorting everything again
+    int middle = sortedKeys.size();
+    for (int i = sortedRoomCount; i < rooms.size(); ++i) {
+        if (!rooms.at(i).identifier.isEmpty()) {
+            sortedKeys.append(i * 2);
+        }
+        if (!rooms.at(i).name.isEmpty()) {
+            sortedKeys.append(i * 2 + 1);
+        }
+    }
+    sortedRoomCount = rooms.size();
+
+    KeyLessThan lessThan(this);
+    std::sort(sortedKeys.begin() + middle, sortedKeys.end(), lessThan);
+    std::inplace_merge(sortedKeys.begin(), sortedKeys.begin() + middle, sortedKeys.end(),
+            lessThan);
+}
+
 /**
  * \class RoomListChannel
  * \ingroup clientchannel
@@ -51,14 +406,178 @@ RoomListChannel::Private::~Private()
  *
  * \brief The RoomListChannel class represents a Telepathy Channel of type RoomList.
  *
- * Note that this subclass of Channel will eventually provide a high-level API for the
- * RoomList interface. Until then, it's just a Channel.
+ * Once FeatureCore is ready, listRooms() asks the server for its rooms. They are then received in
+ * batches, each of which is added to a room store kept by this object and announced by
+ * roomsAdded(). The store can be searched locally by prefix or substring with roomsWithPrefix()
+ * and roomsContaining().
+ *
+ * As room lists can be very long, only a compact record is kept for each room, along with the
+ * complete information map of the maxRoomInfoCount() most recently listed rooms.
  *
  * For more details, please refer to \telepathy_spec.
  *
  * See \ref async_model, \ref shared_ptr
  */
 
+/**
+ * \class RoomListChannel::Room
+ * \ingroup wrappers
+ * \headerfile TelepathyQt/room-list-channel.h <TelepathyQt/RoomListChannel>
+ *
+ * \brief The RoomListChannel::Room class represents a room listed by a RoomListChannel.
+ *
+ * \sa RoomListChannel
+ */
+
+RoomListChannel::Room::Room()
+{
+}
+
+RoomListChannel::Room::Room(Private *priv)
+    : mPriv(priv)
+{
+}
+
+RoomListChannel::Room::Room(const Room &other)
+    : mPriv(other.mPriv)
+{
+}
+
+RoomListChannel::Room::~Room()
+{
+}
+
+RoomListChannel::Room &RoomListChannel::Room::operator=(const Room &other)
+{
+    this->mPriv = other.mPriv;
+    return *this;
+}
+
+/**
+ * Return the handle of this room, as can be used to request a channel to it with
+ * #HandleTypeRoom.
+ *
+ * \return The room handle.
+ */
+uint RoomListChannel::Room::handle() const
+{
+    return isValid() ? mPriv->handle : 0;
+}
+
+/**
+ * Return the identifier of this room, as given by the "handle-name" key of info().
+ *
+ * \return The room identifier.
+ */
+QString RoomListChannel::Room::identifier() const
+{
+    return isValid() ? mPriv->identifier : QString();
+}
+
+/**
+ * Return the human-readable name of this room.
+ *
+ * \return The room name, or identifier() if the service didn't give a different one.
+ */
+QString RoomListChannel::Room::name() const
+{
+    if (!isValid()) {
+        return QString();
+    }
+    return mPriv->name.isEmpty() ? mPriv->identifier : mPriv->name;
+}
+
+/**
+ * Return the number of members in this room.
+ *
+ * \return The member count, or 0 if unknown.
+ */
+uint RoomListChannel::Room::memberCount() const
+{
+    return isValid() ? mPriv->memberCount : 0;
+}
+
+/**
+ * Return whether a password is needed to enter this room.
+ *
+ * \return \c true if the room is password protected, \c false otherwise.
+ */
+bool RoomListChannel::Room::requiresPassword() const
+{
+    return isValid() && (mPriv->flags & RoomRequiresPassword);
+}
+
+/**
+ * Return whether this room can only be joined by invitation.
+ *
+ * \return \c true if the room is invite-only, \c false otherwise.
+ */
+bool RoomListChannel::Room::isInviteOnly() const
+{
+    return isValid() && (mPriv->flags & RoomIsInviteOnly);
+}
+
+/**
+ * Return whether info() returns the complete information received for this room.
+ *
+ * This is the case for the RoomListChannel::maxRoomInfoCount() most recently listed rooms.
+ *
+ * \return \c true if the complete information is available, \c false otherwise.
+ */
+bool RoomListChannel::Room::hasFullInfo() const
+{
+    return isValid() && mPriv->hasFullInfo;
+}
+
+/**
+ * Return the information about this room as received from the service, using the keys
+ * documented for the GotRooms signal in the \telepathy_spec.
+ *
+ * If hasFullInfo() is \c false, only the keys kept for all the rooms ("handle-name", "name",
+ * "members", "password" and "invite-only") are present.
+ *
+ * \return The room information.
+ */
+QVariantMap RoomListChannel::Room::info() const
+{
+    if (!isValid()) {
+        return QVariantMap();
+    }
+
+    if (mPriv->hasFullInfo) {
+        return mPriv->info;
+    }
+
+    QVariantMap ret;
+    ret.insert(QLatin1String("handle-name"), mPriv->identifier);
+    if (!mPriv->name.isEmpty()) {
+        ret.insert(QLatin1String("name"), mPriv->name);
+    }
+    if (mPriv->flags & RoomHasMemberCount) {
+        ret.insert(QLatin1String("members"), mPriv->memberCount);
+    }
+    if (mPriv->flags & RoomHasPassword) {
+        ret.insert(QLatin1String("password"), bool(mPriv->flags & RoomRequiresPassword));
+    }
+    if (mPriv->flags & RoomHasInviteOnly) {
+        ret.insert(QLatin1String("invite-only"), bool(mPriv->flags & RoomIsInviteOnly));
+    }
+    return ret;
+}
+
+/**
+ * Feature representing the core that needs to become ready to make the
+ * RoomListChannel object usable.
+ *
+ * Note that this feature must be enabled in order to use most
+ * RoomListChannel methods.
+ * See specific methods documentation for more details.
+ *
+ * When calling isReady(), becomeReady(), this feature is implicitly added
+ * to the requested features.
+ */
+const Feature RoomListChannel::FeatureCore = Feature(QLatin1String(RoomListChannel::staticMetaObject.className()), 0);
+
 /**
  * Create a new RoomListChannel object.
  *
@@ -73,7 +592,7 @@ RoomListChannelPtr RoomListChannel::create(const ConnectionPtr &connection,
         const QString &objectPath, const QVariantMap &immutableProperties)
 {
     return RoomListChannelPtr(new RoomListChannel(connection, objectPath,
-                immutableProperties));
+                immutableProperties, RoomListChannel::FeatureCore));
 }
 
 /**
@@ -84,14 +603,14 @@ RoomListChannelPtr RoomListChannel::create(const ConnectionPtr &connection,
  * \param objectPath The channel object path.
  * \param immutableProperties The channel immutable properties.
  * \param coreFeature The core feature of the channel type, if any. The corresponding introspectable should
- *                    should depend on Channel::FeatureCore.
+ *                    depend on RoomListChannel::FeatureCore.
  */
 RoomListChannel::RoomListChannel(const ConnectionPtr &connection,
         const QString &objectPath,
         const QVariantMap &immutableProperties,
         const Feature &coreFeature)
     : Channel(connection, objectPath, immutableProperties, coreFeature),
-      mPriv(new Private())
+      mPriv(new Private(this, immutableProperties))
 {
 }
 
@@ -103,4 +622,327 @@ RoomListChannel::~RoomListChannel()
     delete mPriv;
 }
 
+/**
+ * Return the DNS name of the server whose rooms are listed by this channel.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \return The server name, or an empty string for the default server of the connection.
+ */
+QString RoomListChannel::server() const
+{
+    return mPriv->server;
+}
+
+/**
+ * Return whether the rooms are currently being listed.
+ *
+ * Change notification is via the listingRoomsChanged() signal.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \return \c true if a listing is in progress, \c false otherwise.
+ * \sa listRooms(), stopListing()
+ */
+bool RoomListChannel::isListingRooms() const
+{
+    return mPriv->listingRooms;
+}
+
+/**
+ * Request the list of rooms from the server.
+ *
+ * The rooms are then added to the room store as they are received, and announced by
+ * roomsAdded(). Rooms which were already known are updated instead.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \return A PendingOperation which will emit PendingOperation::finished
+ *         when the request has been made.
+ * \sa isListingRooms(), stopListing()
+ */
+PendingOperation *RoomListChannel::listRooms()
+{
+    if (!isReady(FeatureCore)) {
+        return new PendingFailure(TP_QT_ERROR_NOT_AVAILABLE,
+                QLatin1String("Channel not ready"),
+                RoomListChannelPtr(this));
+    }
+
+    return new PendingVoid(mPriv->roomListInterface->ListRooms(),
+            RoomListChannelPtr(this));
+}
+
+/**
+ * Stop listing the rooms, if it is in progress.
+ *
+ * The rooms received so far are kept.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \return A PendingOperation which will emit PendingOperation::finished
+ *         when the call has finished.
+ * \sa isListingRooms(), listRooms()
+ */
+PendingOperation *RoomListChannel::stopListing()
+{
+    if (!isReady(FeatureCore)) {
+        return new PendingFailure(TP_QT_ERROR_NOT_AVAILABLE,
+                QLatin1String("Channel not ready"),
+                RoomListChannelPtr(this));
+    }
+
+    return new PendingVoid(mPriv->roomListInterface->StopListing(),
+            RoomListChannelPtr(this));
+}
+
+/**
+ * Return the number of rooms received so far.
+ *
+ * \return The number of rooms in the room store.
+ */
+int RoomListChannel::roomCount() const
+{
+    return mPriv->rooms.size();
+}
+
+/**
+ * Return all the rooms received so far, in the order they were first listed.
+ *
+ * \return A list of rooms.
+ * \sa roomsAdded()
+ */
+QList<RoomListChannel::Room> RoomListChannel::rooms() const
+{
+    QList<Room> ret;
+    for (int i = 0; i < mPriv->rooms.size(); ++i) {
+        ret << mPriv->roomAt(i);
+    }
+    return ret;
+}
+
+/**
+ * Return the room with the given \a handle.
+ *
+ * \param handle The room handle.
+ * \return The room, or an invalid Room if it hasn't been listed.
+ */
+RoomListChannel::Room RoomListChannel::room(uint handle) const
+{
+    QHash<uint, int>::const_iterator i = mPriv->roomIndexes.constFind(handle);
+    if (i == mPriv->roomIndexes.constEnd()) {
+        return Room();
+    }
+    return mPriv->roomAt(i.value());
+}
+
+/**
+ * Return the rooms whose identifier or name starts with \a prefix, compared case-insensitively.
+ *
+ * This uses an index sorted by identifier and name, which is updated with the rooms received
+ * since the previous lookup.
+ *
+ * \param prefix The prefix to look for.
+ * \return A list of rooms, sorted by the matching identifier or name.
+ * \sa roomsContaining()
+ */
+QList<RoomListChannel::Room> RoomListChannel::roomsWithPrefix(const QString &prefix) const
+{
+    if (prefix.isEmpty()) {
+        return rooms();
+    }
+
+    mPriv->ensureSortedKeys();
+
+    QList<Room> ret;
+    QSet<int> seen;
+    QVector<int>::const_iterator i = std::lower_bound(mPriv->sortedKeys.constBegin(),
+            mPriv->sortedKeys.constEnd(), prefix, Private::KeyLessThan(mPriv));
+    for (; i != mPriv->sortedKeys.constEnd(); ++i) {
+        if (!mPriv->key(*i).startsWith(prefix, Qt::CaseInsensitive)) {
+            break;
+        }
+
+        int index = *i / 2;
+        if (!seen.contains(index)) {
+            seen.insert(index);
+            ret << mPriv->roomAt(index);
+        }
+    }
+    return ret;
+}
+
+/**
+ * Return the rooms whose identifier or name contains \a text, compared case-insensitively.
+ *
+ * Lookups for three characters or more use an index of the trigrams of the room identifiers and
+ * names, so only the rooms sharing the rarest trigram of \a text have to be checked.
+ *
+ * \param text The text to look for.
+ * \return A list of rooms, in the order they were first listed.
+ * \sa roomsWithPrefix()
+ */
+QList<RoomListChannel::Room> RoomListChannel::roomsContaining(const QString &text) const
+{
+    if (text.isEmpty()) {
+        return rooms();
+    }
+
+    QList<int> matches;
+    if (text.size() < 3) {
+        for (int i = 0; i < mPriv->rooms.size(); ++i) {
+            const Private::StoredRoom &stored = mPriv->rooms.at(i);
+            if (stored.identifier.contains(text, Qt::CaseInsensitive) ||
+                    stored.name.contains(text, Qt::CaseInsensitive)) {
+                matches << i;
+            }
+        }
+    } else {
+        QString folded = text.toLower();
+        const QVector<int> *candidates = 0;
+        for (int i = 0; i + 3 <= folded.size(); ++i) {
+            QHash<QString, QVector<int> >::const_iterator postings =
+                mPriv->trigrams.constFind(folded.mid(i, 3));
+            if (postings == mPriv->trigrams.constEnd()) {
+                return QList<Room>();
+            }
+            if (!candidates || postings.value().size() < candidates->size()) {
+                candidates = &postings.value();
+            }
+        }
+
+        foreach (int index, *candidates) {
+            const Private::StoredRoom &stored = mPriv->rooms.at(index);
+            if (stored.identifier.contains(text, Qt::CaseInsensitive) ||
+                    stored.name.contains(text, Qt::CaseInsensitive)) {
+                matches << index;
+            }
+        }
+        qSort(matches);
+    }
+
+    QList<Room> ret;
+    foreach (int index, matches) {
+        ret << mPriv->roomAt(index);
+    }
+    return ret;
+}
+
+/**
+ * Return the number of rooms for which the complete information map is kept.
+ *
+ * \return The maximum number of rooms with Room::hasFullInfo(), or a negative number if there is
+ *         no limit.
+ * \sa setMaxRoomInfoCount()
+ */
+int RoomListChannel::maxRoomInfoCount() const
+{
+    return mPriv->maxRoomInfoCount;
+}
+
+/**
+ * Set the number of rooms for which the complete information map is kept.
+ *
+ * Only the most recently listed rooms keep their complete information; for the others only the
+ * identifier, name, member count and access flags are kept. The default is 1000.
+ *
+ * \param count The maximum number of rooms with Room::hasFullInfo(), or a negative number for no
+ *              limit.
+ * \sa maxRoomInfoCount()
+ */
+void RoomListChannel::setMaxRoomInfoCount(int count)
+{
+    mPriv->maxRoomInfoCount = count;
+    mPriv->evictInfos();
+}
+
+void RoomListChannel::gotProperties(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<QVariantMap> reply = *watcher;
+
+    if (!reply.isError()) {
+        QVariantMap props = reply.value();
+        mPriv->server = qdbus_cast<QString>(props[QLatin1String("Server")]);
+
+        debug() << "Got reply to Properties::GetAll(RoomListChannel)";
+
+        QDBusPendingCallWatcher *listingWatcher =
+            new QDBusPendingCallWatcher(mPriv->roomListInterface->GetListingRooms(), this);
+        connect(listingWatcher,
+                SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(gotListingRooms(QDBusPendingCallWatcher*)));
+    } else {
+        warning().nospace() << "Properties::GetAll(RoomListChannel) failed "
+            "with " << reply.error().name() << ": " << reply.error().message();
+        mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false,
+                reply.error());
+    }
+
+    watcher->deleteLater();
+}
+
+void RoomListChannel::gotListingRooms(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<bool> reply = *watcher;
+
+    if (!reply.isError()) {
+        mPriv->listingRooms = reply.value();
+
+        debug() << "Got reply to RoomList::GetListingRooms()";
+        mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, true);
+    } else {
+        warning().nospace() << "RoomList::GetListingRooms() failed "
+            "with " << reply.error().name() << ": " << reply.error().message();
+        mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false,
+                reply.error());
+    }
+
+    watcher->deleteLater();
+}
+
+void RoomListChannel::onGotRooms(const Tp::RoomInfoList &rooms)
+{
+    QList<Room> added;
+    foreach (const RoomInfo &roomInfo, rooms) {
+        if (mPriv->addRoom(roomInfo)) {
+            added << mPriv->roomAt(mPriv->rooms.size() - 1);
+        }
+    }
+
+    debug() << "Got" << rooms.size() << "rooms," << added.size() << "of them new," <<
+        mPriv->rooms.size() << "in total";
+
+    if (!added.isEmpty()) {
+        emit roomsAdded(added);
+    }
+}
+
+void RoomListChannel::onListingRooms(bool listing)
+{
+    if (mPriv->listingRooms == listing) {
+        return;
+    }
+
+    mPriv->listingRooms = listing;
+    emit listingRoomsChanged(listing);
+}
+
+/**
+ * \fn void RoomListChannel::listingRoomsChanged(bool listing)
+ *
+ * Emitted when the value of isListingRooms() changes.
+ *
+ * \param listing Whether a listing is in progress.
+ * \sa isListingRooms()
+ */
+
+/**
+ * \fn void RoomListChannel::roomsAdded(const QList<Tp::RoomListChannel::Room> &rooms)
+ *
+ * Emitted when a batch of rooms not seen before is received from the server.
+ *
+ * \param rooms The new rooms.
+ * \sa rooms()
+ */
+
 } // Tp
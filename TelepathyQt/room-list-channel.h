@@ -28,25 +28,87 @@
 #endif
 
 #include <TelepathyQt/Channel>
+#include <TelepathyQt/Types>
+
+#include <QSharedDataPointer>
 
 namespace Tp
 {
 
+class PendingOperation;
+
 class TP_QT_EXPORT RoomListChannel : public Channel
 {
     Q_OBJECT
     Q_DISABLE_COPY(RoomListChannel)
 
 public:
+    static const Feature FeatureCore;
+
+    class Room
+    {
+    public:
+        Room();
+        Room(const Room &other);
+        ~Room();
+
+        bool isValid() const { return mPriv.constData() != 0; }
+
+        Room &operator=(const Room &other);
+
+        uint handle() const;
+        QString identifier() const;
+        QString name() const;
+        uint memberCount() const;
+        bool requiresPassword() const;
+        bool isInviteOnly() const;
+
+        bool hasFullInfo() const;
+        QVariantMap info() const;
+
+    private:
+        friend class RoomListChannel;
+
+        struct Private;
+        TP_QT_NO_EXPORT Room(Private *priv);
+        friend struct Private;
+        QSharedDataPointer<Private> mPriv;
+    };
+
     static RoomListChannelPtr create(const ConnectionPtr &connection,
             const QString &objectPath, const QVariantMap &immutableProperties);
 
     virtual ~RoomListChannel();
 
+    QString server() const;
+    bool isListingRooms() const;
+
+    PendingOperation *listRooms();
+    PendingOperation *stopListing();
+
+    int roomCount() const;
+    QList<Room> rooms() const;
+    Room room(uint handle) const;
+    QList<Room> roomsWithPrefix(const QString &prefix) const;
+    QList<Room> roomsContaining(const QString &text) const;
+
+    int maxRoomInfoCount() const;
+    void setMaxRoomInfoCount(int count);
+
+Q_SIGNALS:
+    void listingRoomsChanged(bool listing);
+    void roomsAdded(const QList<Tp::RoomListChannel::Room> &rooms);
+
 protected:
     RoomListChannel(const ConnectionPtr &connection, const QString &objectPath,
             const QVariantMap &immutableProperties,
-            const Feature &coreFeature = Channel::FeatureCore);
+            const Feature &coreFeature = RoomListChannel::FeatureCore);
+
+private Q_SLOTS:
+    TP_QT_NO_EXPORT void gotProperties(QDBusPendingCallWatcher *watcher);
+    TP_QT_NO_EXPORT void gotListingRooms(QDBusPendingCallWatcher *watcher);
+    TP_QT_NO_EXPORT void onGotRooms(const Tp::RoomInfoList &rooms);
+    TP_QT_NO_EXPORT void onListingRooms(bool listing);
 
 private:
     struct Private;
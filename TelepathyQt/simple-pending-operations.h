@@ -100,6 +100,8 @@ private Q_SLOTS:
     TP_QT_NO_EXPORT void onOperationFinished(Tp::PendingOperation *);
 
 private:
+    TP_QT_NO_EXPORT void watchOperation(PendingOperation *operation);
+
     struct Private;
     friend struct Private;
     Private *mPriv;
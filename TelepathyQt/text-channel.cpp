@@ -37,6 +37,10 @@
 #include <TelepathyQt/ReferencedHandles>
 
 #include <QDateTime>
+#include <QMap>
+#include <QMultiHash>
+#include <QTimer>
+#include <QtAlgorithms>
 
 namespace Tp
 {
@@ -55,7 +59,15 @@ struct TP_QT_NO_EXPORT TextChannel::Private
     void updateCapabilities();
 
     void processMessageQueue();
+    void processMessageQueuePerSender();
+    void requestMissingSenders();
+    void resolveSenderFromCache(ReceivedMessage &message);
     void processChatStateQueue();
+    void flushCoalescedChatStates();
+    void processChatStateBatches();
+
+    void acknowledgePendingMessages(const UIntList &ids);
+    void flushAcknowledgeBatch();
 
     void contactLost(uint handle);
     void contactFound(ContactPtr contact);
@@ -86,18 +98,52 @@ struct TP_QT_NO_EXPORT TextChannel::Private
         MessageEvent(const ReceivedMessage &message)
             : isMessage(true), message(message),
                 removed(0)
-        { }
+        {
+            queued.start();
+        }
         MessageEvent(uint removed)
             : isMessage(false), message(), removed(removed)
-        { }
+        {
+            queued.start();
+        }
 
         bool isMessage;
         ReceivedMessage message;
         uint removed;
+        QTime queued;
+    };
+
+    // Received messages in arrival order, indexed by pending message ID. IDs aren't necessarily
+    // globally unique, so one ID may map to more than one slot.
+    class MessageQueue
+    {
+    public:
+        MessageQueue() : nextSlot(0) {}
+
+        bool isEmpty() const { return entries.isEmpty(); }
+        QList<ReceivedMessage> toList() const { return entries.values(); }
+
+        void append(const ReceivedMessage &message);
+        bool removeOne(const ReceivedMessage &message);
+        QList<ReceivedMessage> takeByPendingId(uint pendingId);
+        QList<ReceivedMessage> takeAll();
+
+    private:
+        QMap<quint64, ReceivedMessage> entries;
+        QMultiHash<uint, quint64> slotsByPendingId;
+        quint64 nextSlot;
     };
-    QList<ReceivedMessage> messages;
+    MessageQueue messages;
     QList<MessageEvent *> incompleteMessages;
     QHash<QDBusPendingCallWatcher *, UIntList> acknowledgeBatches;
+    MessageDeliveryMode messageDeliveryMode;
+    int maxSenderResolutionTime;
+    QTimer *senderResolutionTimer;
+
+    // Acknowledgements waiting to be sent in a single call
+    int acknowledgeBatchInterval;
+    UIntList pendingAcknowledgements;
+    QTimer *acknowledgeBatchTimer;
 
     // FeatureChatState
     struct ChatStateEvent
@@ -113,6 +159,18 @@ struct TP_QT_NO_EXPORT TextChannel::Private
     QList<ChatStateEvent *> chatStateQueue;
     QHash<ContactPtr, ChannelChatState> chatStates;
 
+    // FeatureChatState when coalescing: only the latest state per handle within the current
+    // window is kept, and windows are delivered as batches in order
+    struct ChatStateBatch
+    {
+        QHash<uint, uint> states;
+        QHash<uint, ContactPtr> contacts;
+    };
+    int chatStateCoalescingInterval;
+    QTimer *chatStateCoalescingTimer;
+    QHash<uint, uint> coalescedChatStates;
+    QList<ChatStateBatch *> chatStateBatches;
+
     QSet<uint> awaitingContacts;
 };
 
@@ -125,7 +183,14 @@ TextChannel::Private::Private(TextChannel *parent)
       gotProperties(false),
       messagePartSupport(0),
       deliveryReportingSupport(0),
-      initialMessagesReceived(false)
+      initialMessagesReceived(false),
+      messageDeliveryMode(MessageDeliveryModeInOrder),
+      maxSenderResolutionTime(0),
+      senderResolutionTimer(0),
+      chatStateCoalescingInterval(0),
+      chatStateCoalescingTimer(0),
+      acknowledgeBatchInterval(0),
+      acknowledgeBatchTimer(0)
 {
     ReadinessHelper::Introspectables introspectables;
 
@@ -166,6 +231,12 @@ TextChannel::Private::Private(TextChannel *parent)
 
 TextChannel::Private::~Private()
 {
+    // don't lose acknowledgements still waiting for the batch window to expire; nobody is
+    // interested in the reply anymore at this point
+    if (!pendingAcknowledgements.isEmpty()) {
+        textInterface->AcknowledgePendingMessages(pendingAcknowledgements);
+    }
+
     foreach (MessageEvent *e, incompleteMessages) {
         delete e;
     }
@@ -173,6 +244,10 @@ TextChannel::Private::~Private()
     foreach (ChatStateEvent *e, chatStateQueue) {
         delete e;
     }
+
+    foreach (ChatStateBatch *batch, chatStateBatches) {
+        delete batch;
+    }
 }
 
 void TextChannel::Private::introspectMessageQueue(
@@ -340,6 +415,11 @@ void TextChannel::Private::updateCapabilities()
 
 void TextChannel::Private::processMessageQueue()
 {
+    if (messageDeliveryMode == MessageDeliveryModePerSender) {
+        processMessageQueuePerSender();
+        return;
+    }
+
     // Proceed as far as we can with the processing of incoming messages
     // and message-removal events; message IDs aren't necessarily globally
     // unique, so we need to process them in the correct order relative
@@ -359,20 +439,13 @@ void TextChannel::Private::processMessageQueue()
 
             // if we reach here, the message is ready
             debug() << "Message is usable, copying to main queue";
-            messages << e->message;
+            messages.append(e->message);
             emit parent->messageReceived(e->message);
         } else {
             // forget about the message(s) with ID e->removed (there should be
             // at most one under normal circumstances)
-            int i = 0;
-            while (i < messages.size()) {
-                if (messages.at(i).pendingId() == e->removed) {
-                    ReceivedMessage removedMessage = messages.at(i);
-                    messages.removeAt(i);
-                    emit parent->pendingMessageRemoved(removedMessage);
-                } else {
-                    i++;
-                }
+            foreach (const ReceivedMessage &removedMessage, messages.takeByPendingId(e->removed)) {
+                emit parent->pendingMessageRemoved(removedMessage);
             }
         }
 
@@ -390,6 +463,100 @@ void TextChannel::Private::processMessageQueue()
         return;
     }
 
+    requestMissingSenders();
+}
+
+void TextChannel::Private::processMessageQueuePerSender()
+{
+    // Deliver every message whose sender is known, holding back only the messages from senders
+    // whose Contact objects are still being built, and anything after them from the same sender.
+    // Removal events are held back while a message with the same ID is held, as IDs aren't
+    // necessarily globally unique.
+    QSet<uint> heldSenders;
+    QSet<uint> heldPendingIds;
+    int nextHoldDeadline = -1;
+
+    int i = 0;
+    while (i < incompleteMessages.size()) {
+        MessageEvent *e = incompleteMessages.at(i);
+
+        if (e->isMessage) {
+            uint handle = e->message.senderHandle();
+            bool hold = heldSenders.contains(handle);
+
+            if (!hold && handle != 0 && !e->message.sender()) {
+                int elapsed = e->queued.elapsed();
+                if (maxSenderResolutionTime > 0 && elapsed >= maxSenderResolutionTime) {
+                    debug() << "Sender of message" << e->message.pendingId() <<
+                        "not resolved in time, delivering it without a sender Contact";
+                } else {
+                    hold = true;
+                    if (maxSenderResolutionTime > 0) {
+                        int remaining = maxSenderResolutionTime - elapsed;
+                        if (nextHoldDeadline < 0 || remaining < nextHoldDeadline) {
+                            nextHoldDeadline = remaining;
+                        }
+                    }
+                }
+            }
+
+            if (hold) {
+                heldSenders << handle;
+                heldPendingIds << e->message.pendingId();
+                ++i;
+                continue;
+            }
+
+            incompleteMessages.removeAt(i);
+            messages.append(e->message);
+            emit parent->messageReceived(e->message);
+        } else {
+            if (heldPendingIds.contains(e->removed)) {
+                ++i;
+                continue;
+            }
+
+            incompleteMessages.removeAt(i);
+            foreach (const ReceivedMessage &removedMessage, messages.takeByPendingId(e->removed)) {
+                emit parent->pendingMessageRemoved(removedMessage);
+            }
+        }
+
+        delete e;
+    }
+
+    if (incompleteMessages.isEmpty()) {
+        if (senderResolutionTimer) {
+            senderResolutionTimer->stop();
+        }
+
+        if (readinessHelper->requestedFeatures().contains(FeatureMessageQueue) &&
+            !readinessHelper->isReady(Features() << FeatureMessageQueue)) {
+            debug() << "incompleteMessages empty for the first time: "
+                "FeatureMessageQueue is now ready";
+            readinessHelper->setIntrospectCompleted(FeatureMessageQueue, true);
+        }
+        return;
+    }
+
+    if (nextHoldDeadline >= 0) {
+        if (!senderResolutionTimer) {
+            senderResolutionTimer = new QTimer(parent);
+            senderResolutionTimer->setSingleShot(true);
+            parent->connect(senderResolutionTimer,
+                    SIGNAL(timeout()),
+                    SLOT(onSenderResolutionTimeout()));
+        }
+        senderResolutionTimer->start(nextHoldDeadline);
+    } else if (senderResolutionTimer) {
+        senderResolutionTimer->stop();
+    }
+
+    requestMissingSenders();
+}
+
+void TextChannel::Private::requestMissingSenders()
+{
     // What Contact objects do we need in order to proceed, ignoring those
     // for which we've already sent a request?
     HandleIdentifierMap contactsRequired;
@@ -418,9 +585,25 @@ void TextChannel::Private::processMessageQueue()
     awaitingContacts |= contactsRequired.keys().toSet();
 }
 
+void TextChannel::Private::resolveSenderFromCache(ReceivedMessage &message)
+{
+    uint handle = message.senderHandle();
+    if (handle == 0 || message.sender()) {
+        return;
+    }
+
+    // The handle might have been reused for someone else since the cached Contact was built, so
+    // only trust it if it has the identifier the message was sent with
+    ContactPtr contact = parent->cachedContact(handle);
+    if (contact && (message.senderId().isEmpty() || contact->id() == message.senderId())) {
+        message.setSender(contact);
+    }
+}
+
 void TextChannel::Private::processChatStateQueue()
 {
-    while (!chatStateQueue.isEmpty()) {
+    // coalesced batches still waiting for their contacts are older than anything in the queue
+    while (chatStateBatches.isEmpty() && !chatStateQueue.isEmpty()) {
         const ChatStateEvent *e = chatStateQueue.first();
         debug() << "ChatStateEvent:" << reinterpret_cast<const void *>(e);
 
@@ -464,6 +647,204 @@ void TextChannel::Private::processChatStateQueue()
     awaitingContacts |= contactsRequired;
 }
 
+void TextChannel::Private::acknowledgePendingMessages(const UIntList &ids)
+{
+    if (acknowledgeBatchInterval <= 0) {
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+                textInterface->AcknowledgePendingMessages(ids),
+                parent);
+        parent->connect(watcher,
+                SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(onAcknowledgePendingMessagesReply(QDBusPendingCallWatcher*)));
+        acknowledgeBatches[watcher] = ids;
+        return;
+    }
+
+    // a message acknowledged twice within the window must only be in the call once, or the
+    // connection manager would reject the whole batch
+    foreach (uint id, ids) {
+        if (!pendingAcknowledgements.contains(id)) {
+            pendingAcknowledgements << id;
+        }
+    }
+
+    if (!acknowledgeBatchTimer) {
+        acknowledgeBatchTimer = new QTimer(parent);
+        acknowledgeBatchTimer->setSingleShot(true);
+        parent->connect(acknowledgeBatchTimer,
+                SIGNAL(timeout()),
+                SLOT(onAcknowledgeBatchTimeout()));
+    }
+
+    // the window starts with the first acknowledgement of a batch and is not extended by later
+    // ones, so a steady stream of acknowledgements can't delay the call indefinitely
+    if (!acknowledgeBatchTimer->isActive()) {
+        acknowledgeBatchTimer->start(acknowledgeBatchInterval);
+    }
+}
+
+void TextChannel::Private::flushAcknowledgeBatch()
+{
+    if (acknowledgeBatchTimer) {
+        acknowledgeBatchTimer->stop();
+    }
+
+    if (pendingAcknowledgements.isEmpty()) {
+        return;
+    }
+
+    debug() << "Acknowledging a batch of" << pendingAcknowledgements.size() << "messages";
+
+    UIntList ids = pendingAcknowledgements;
+    pendingAcknowledgements.clear();
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+            textInterface->AcknowledgePendingMessages(ids),
+            parent);
+    parent->connect(watcher,
+            SIGNAL(finished(QDBusPendingCallWatcher*)),
+            SLOT(onAcknowledgePendingMessagesReply(QDBusPendingCallWatcher*)));
+    acknowledgeBatches[watcher] = ids;
+}
+
+void TextChannel::Private::MessageQueue::append(const ReceivedMessage &message)
+{
+    quint64 slot = nextSlot++;
+    entries.insert(slot, message);
+    slotsByPendingId.insert(message.pendingId(), slot);
+}
+
+bool TextChannel::Private::MessageQueue::removeOne(const ReceivedMessage &message)
+{
+    uint pendingId = message.pendingId();
+    QMultiHash<uint, quint64>::iterator i = slotsByPendingId.find(pendingId);
+    while (i != slotsByPendingId.end() && i.key() == pendingId) {
+        QMap<quint64, ReceivedMessage>::iterator entry = entries.find(i.value());
+        Q_ASSERT(entry != entries.end());
+        if (entry.value() == message) {
+            entries.erase(entry);
+            slotsByPendingId.erase(i);
+            return true;
+        }
+        ++i;
+    }
+    return false;
+}
+
+QList<ReceivedMessage> TextChannel::Private::MessageQueue::takeByPendingId(uint pendingId)
+{
+    QList<quint64> matchingSlots = slotsByPendingId.values(pendingId);
+    slotsByPendingId.remove(pendingId);
+
+    // keep the relative order in which the messages were received
+    qSort(matchingSlots);
+
+    QList<ReceivedMessage> taken;
+    foreach (quint64 slot, matchingSlots) {
+        QMap<quint64, ReceivedMessage>::iterator entry = entries.find(slot);
+        Q_ASSERT(entry != entries.end());
+        taken << entry.value();
+        entries.erase(entry);
+    }
+    return taken;
+}
+
+QList<ReceivedMessage> TextChannel::Private::MessageQueue::takeAll()
+{
+    QList<ReceivedMessage> taken = entries.values();
+    entries.clear();
+    slotsByPendingId.clear();
+    return taken;
+}
+
+void TextChannel::Private::flushCoalescedChatStates()
+{
+    if (chatStateCoalescingTimer) {
+        chatStateCoalescingTimer->stop();
+    }
+
+    if (coalescedChatStates.isEmpty()) {
+        return;
+    }
+
+    ChatStateBatch *batch = new ChatStateBatch;
+    batch->states = coalescedChatStates;
+    coalescedChatStates.clear();
+
+    QHash<uint, uint>::const_iterator i = batch->states.constBegin();
+    QHash<uint, uint>::const_iterator end = batch->states.constEnd();
+    for (; i != end; ++i) {
+        ContactPtr contact = parent->cachedContact(i.key());
+        if (contact) {
+            batch->contacts.insert(i.key(), contact);
+        }
+    }
+
+    chatStateBatches << batch;
+    processChatStateBatches();
+}
+
+void TextChannel::Private::processChatStateBatches()
+{
+    while (!chatStateBatches.isEmpty()) {
+        ChatStateBatch *batch = chatStateBatches.first();
+        if (batch->contacts.size() < batch->states.size()) {
+            // We'll have to stop processing here, and come back to it
+            // when we have more Contact objects
+            break;
+        }
+
+        chatStateBatches.removeFirst();
+
+        QHash<ContactPtr, ChannelChatState> changed;
+        QHash<uint, uint>::const_iterator i = batch->states.constBegin();
+        QHash<uint, uint>::const_iterator end = batch->states.constEnd();
+        for (; i != end; ++i) {
+            ContactPtr contact = batch->contacts.value(i.key());
+            ChannelChatState state = (ChannelChatState) i.value();
+            if (chatStates.contains(contact) && chatStates.value(contact) == state) {
+                // the contact went back to the state it was in before the window started
+                continue;
+            }
+
+            chatStates.insert(contact, state);
+            changed.insert(contact, state);
+        }
+        delete batch;
+
+        if (changed.isEmpty()) {
+            continue;
+        }
+
+        QHash<ContactPtr, ChannelChatState>::const_iterator j = changed.constBegin();
+        QHash<ContactPtr, ChannelChatState>::const_iterator changedEnd = changed.constEnd();
+        for (; j != changedEnd; ++j) {
+            emit parent->chatStateChanged(j.key(), j.value());
+        }
+        emit parent->chatStatesChanged(changed);
+    }
+
+    QSet<uint> contactsRequired;
+    foreach (const ChatStateBatch *batch, chatStateBatches) {
+        foreach (uint handle, batch->states.keys()) {
+            if (!batch->contacts.contains(handle) && !awaitingContacts.contains(handle)) {
+                contactsRequired << handle;
+            }
+        }
+    }
+
+    if (contactsRequired.isEmpty()) {
+        return;
+    }
+
+    parent->connect(parent->connection()->contactManager()->contactsForHandles(
+                contactsRequired.toList()),
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(onContactsFinished(Tp::PendingOperation*)));
+
+    awaitingContacts |= contactsRequired;
+}
+
 void TextChannel::Private::contactLost(uint handle)
 {
     // we're not going to get a Contact object for this handle, so mark the
@@ -483,6 +864,10 @@ void TextChannel::Private::contactLost(uint handle)
             delete e;
         }
     }
+
+    foreach (ChatStateBatch *batch, chatStateBatches) {
+        batch->states.remove(handle);
+    }
 }
 
 void TextChannel::Private::contactFound(ContactPtr contact)
@@ -501,6 +886,12 @@ void TextChannel::Private::contactFound(ContactPtr contact)
             e->contact = contact;
         }
     }
+
+    foreach (ChatStateBatch *batch, chatStateBatches) {
+        if (batch->states.contains(handle)) {
+            batch->contacts.insert(handle, contact);
+        }
+    }
 }
 
 /**
@@ -621,6 +1012,20 @@ const Feature TextChannel::FeatureChatState = Feature(QLatin1String(TextChannel:
  * \sa chatState()
  */
 
+/**
+ * \fn void TextChannel::chatStatesChanged(
+ *      const QHash<Tp::ContactPtr, Tp::ChannelChatState> &states)
+ *
+ * Emitted once per coalescing window with the chat states that changed in it, if the
+ * TextChannel::FeatureChatState feature has been enabled and a coalescing interval has been
+ * set with setChatStateCoalescingInterval().
+ *
+ * chatStateChanged() is still emitted for each contact in \a states, just before this signal.
+ *
+ * \param states The new chat state of each contact whose state changed.
+ * \sa setChatStateCoalescingInterval(), chatState()
+ */
+
 /**
  * Create a new TextChannel object.
  *
@@ -825,7 +1230,88 @@ DeliveryReportingSupportFlags TextChannel::deliveryReportingSupport() const
  */
 QList<ReceivedMessage> TextChannel::messageQueue() const
 {
-    return mPriv->messages;
+    return mPriv->messages.toList();
+}
+
+/**
+ * \enum TextChannel::MessageDeliveryMode
+ *
+ * Specifies how received messages are added to messageQueue() while the Contact objects for
+ * their senders are being built.
+ *
+ * \sa setMessageDeliveryMode()
+ */
+
+/**
+ * \var TextChannel::MessageDeliveryMode TextChannel::MessageDeliveryModeInOrder
+ *
+ * Messages are delivered strictly in the order they were received. A message whose sender
+ * is not known yet holds back every message received after it.
+ */
+
+/**
+ * \var TextChannel::MessageDeliveryMode TextChannel::MessageDeliveryModePerSender
+ *
+ * Senders are looked up in the Contact objects the connection already has before a request
+ * is made, and messages are delivered in order per sender: only messages from senders whose
+ * Contact objects are still being built are held back.
+ */
+
+/**
+ * Return the mode in which received messages are added to messageQueue().
+ *
+ * \return The delivery mode as #MessageDeliveryMode.
+ * \sa setMessageDeliveryMode()
+ */
+TextChannel::MessageDeliveryMode TextChannel::messageDeliveryMode() const
+{
+    return mPriv->messageDeliveryMode;
+}
+
+/**
+ * Return the maximum time in milliseconds a message is held back waiting for its sender in
+ * #MessageDeliveryModePerSender mode.
+ *
+ * \return The maximum time in milliseconds, or 0 if there is no limit.
+ * \sa setMessageDeliveryMode()
+ */
+int TextChannel::maxSenderResolutionTime() const
+{
+    return mPriv->maxSenderResolutionTime;
+}
+
+/**
+ * Set the mode in which received messages are added to messageQueue().
+ *
+ * In #MessageDeliveryModePerSender mode, a message from a sender whose Contact object has not
+ * been built after \a maxSenderResolutionTime milliseconds is delivered anyway, with
+ * ReceivedMessage::sender() returning a null ContactPtr. Messages are never reordered
+ * relative to other messages from the same sender.
+ *
+ * The default mode is #MessageDeliveryModeInOrder. The mode should be set before
+ * TextChannel::FeatureMessageQueue is requested.
+ *
+ * \param mode The delivery mode.
+ * \param maxSenderResolutionTime The maximum time in milliseconds a message is held back in
+ *                                #MessageDeliveryModePerSender mode, or 0 for no limit.
+ * \sa messageDeliveryMode(), messageReceived()
+ */
+void TextChannel::setMessageDeliveryMode(MessageDeliveryMode mode, int maxSenderResolutionTime)
+{
+    mPriv->messageDeliveryMode = mode;
+    mPriv->maxSenderResolutionTime = qMax(maxSenderResolutionTime, 0);
+
+    if (mode == MessageDeliveryModePerSender) {
+        foreach (Private::MessageEvent *e, mPriv->incompleteMessages) {
+            if (e->isMessage) {
+                mPriv->resolveSenderFromCache(e->message);
+            }
+        }
+    }
+
+    if (!mPriv->incompleteMessages.isEmpty()) {
+        mPriv->processMessageQueue();
+    }
 }
 
 /**
@@ -852,6 +1338,47 @@ ChannelChatState TextChannel::chatState(const ContactPtr &contact) const
     return ChannelChatStateInactive;
 }
 
+/**
+ * Return the interval in milliseconds within which chat state changes are coalesced.
+ *
+ * \return The interval in milliseconds, or 0 if chat state changes are signalled as
+ *         they arrive.
+ * \sa setChatStateCoalescingInterval()
+ */
+int TextChannel::chatStateCoalescingInterval() const
+{
+    return mPriv->chatStateCoalescingInterval;
+}
+
+/**
+ * Set the interval in milliseconds within which chat state changes are coalesced.
+ *
+ * By default, chatStateChanged() is emitted for every change signalled by the service. In busy
+ * rooms, where members continuously switch between composing and paused, setting an interval
+ * makes only the latest state of each contact within the interval count: the others are
+ * dropped before any Contact object is looked up for them, chatStateChanged() is emitted only
+ * for contacts whose state actually changed, and chatStatesChanged() is emitted once with all
+ * of them.
+ *
+ * Setting the interval to 0 disables coalescing and delivers any changes still waiting.
+ * Changes are always signalled in the order the service signalled them: while changes from before
+ * coalescing was enabled are still waiting for their Contact objects, later changes are queued
+ * behind them and signalled one by one.
+ *
+ * This method requires TextChannel::FeatureChatState to be ready for the changes to be
+ * signalled at all.
+ *
+ * \param msecs The interval in milliseconds.
+ * \sa chatStatesChanged(), chatState()
+ */
+void TextChannel::setChatStateCoalescingInterval(int msecs)
+{
+    mPriv->chatStateCoalescingInterval = qMax(msecs, 0);
+    if (mPriv->chatStateCoalescingInterval == 0) {
+        mPriv->flushCoalescedChatStates();
+    }
+}
+
 void TextChannel::onAcknowledgePendingMessagesReply(
         QDBusPendingCallWatcher *watcher)
 {
@@ -909,13 +1436,73 @@ void TextChannel::acknowledge(const QList<ReceivedMessage> &messages)
     // them from the list immediately
     forget(messages);
 
-    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
-            mPriv->textInterface->AcknowledgePendingMessages(ids),
-            this);
-    connect(watcher,
-            SIGNAL(finished(QDBusPendingCallWatcher*)),
-            SLOT(onAcknowledgePendingMessagesReply(QDBusPendingCallWatcher*)));
-    mPriv->acknowledgeBatches[watcher] = ids;
+    mPriv->acknowledgePendingMessages(ids);
+}
+
+/**
+ * Acknowledge that all messages currently in messageQueue() have been displayed to the user.
+ *
+ * This is equivalent to calling acknowledge() with messageQueue(), but avoids copying the
+ * queue and checking each message individually. The pendingMessageRemoved() signal is still
+ * emitted for each message.
+ *
+ * The same restrictions as for acknowledge() apply to which client should call this method.
+ *
+ * This method requires TextChannel::FeatureMessageQueue to be ready.
+ *
+ * \sa acknowledge(), messageQueue()
+ */
+void TextChannel::acknowledgeAll()
+{
+    QList<ReceivedMessage> messages = mPriv->messages.takeAll();
+    if (messages.isEmpty()) {
+        return;
+    }
+
+    UIntList ids;
+    ids.reserve(messages.size());
+    foreach (const ReceivedMessage &m, messages) {
+        ids << m.pendingId();
+    }
+
+    mPriv->acknowledgePendingMessages(ids);
+
+    foreach (const ReceivedMessage &m, messages) {
+        emit pendingMessageRemoved(m);
+    }
+}
+
+/**
+ * Return the time window in milliseconds within which acknowledge() and acknowledgeAll()
+ * calls are coalesced into a single D-Bus call.
+ *
+ * \return The batch interval in milliseconds, or 0 if acknowledgements are sent immediately.
+ * \sa setAcknowledgeBatchInterval()
+ */
+int TextChannel::acknowledgeBatchInterval() const
+{
+    return mPriv->acknowledgeBatchInterval;
+}
+
+/**
+ * Set the time window in milliseconds within which acknowledge() and acknowledgeAll() calls
+ * are coalesced into a single D-Bus call.
+ *
+ * By default each call to acknowledge() results in its own D-Bus call. Handlers acknowledging
+ * messages one at a time as they are displayed can set a short interval to have them sent to
+ * the service in batches instead. Messages are always removed from messageQueue() immediately.
+ *
+ * Setting the interval to 0 disables batching and sends any acknowledgements still waiting.
+ *
+ * \param msecs The batch interval in milliseconds.
+ * \sa acknowledgeBatchInterval(), acknowledge()
+ */
+void TextChannel::setAcknowledgeBatchInterval(int msecs)
+{
+    mPriv->acknowledgeBatchInterval = qMax(msecs, 0);
+    if (mPriv->acknowledgeBatchInterval == 0) {
+        mPriv->flushAcknowledgeBatch();
+    }
 }
 
 /**
@@ -1062,6 +1649,21 @@ PendingOperation *TextChannel::requestChatState(ChannelChatState state)
                 (uint) state), TextChannelPtr(this));
 }
 
+void TextChannel::onAcknowledgeBatchTimeout()
+{
+    mPriv->flushAcknowledgeBatch();
+}
+
+void TextChannel::onSenderResolutionTimeout()
+{
+    mPriv->processMessageQueue();
+}
+
+void TextChannel::onChatStateCoalescingTimeout()
+{
+    mPriv->flushCoalescedChatStates();
+}
+
 void TextChannel::onMessageSent(const MessagePartList &parts,
         uint flags,
         const QString &sentMessageToken)
@@ -1099,6 +1701,7 @@ void TextChannel::onContactsFinished(PendingOperation *op)
     // all contacts for messages and chat state events we were asking about
     // should now be ready
     mPriv->processMessageQueue();
+    mPriv->processChatStateBatches();
     mPriv->processChatStateQueue();
 }
 
@@ -1108,8 +1711,12 @@ void TextChannel::onMessageReceived(const MessagePartList &parts)
         return;
     }
 
-    mPriv->incompleteMessages << new Private::MessageEvent(
-            ReceivedMessage(parts, TextChannelPtr(this)));
+    ReceivedMessage m(parts, TextChannelPtr(this));
+    if (mPriv->messageDeliveryMode == MessageDeliveryModePerSender) {
+        mPriv->resolveSenderFromCache(m);
+    }
+
+    mPriv->incompleteMessages << new Private::MessageEvent(m);
     mPriv->processMessageQueue();
 }
 
@@ -1177,6 +1784,10 @@ void TextChannel::onTextReceived(uint id, uint timestamp, uint sender,
         m.setForceNonText();
     }
 
+    if (mPriv->messageDeliveryMode == MessageDeliveryModePerSender) {
+        mPriv->resolveSenderFromCache(m);
+    }
+
     mPriv->incompleteMessages << new Private::MessageEvent(m);
     mPriv->processMessageQueue();
 }
@@ -1313,6 +1924,25 @@ void TextChannel::gotPendingMessages(QDBusPendingCallWatcher *watcher)
 
 void TextChannel::onChatStateChanged(uint contactHandle, uint state)
 {
+    // changes still waiting for their contacts from before coalescing was enabled are delivered
+    // one by one, and later changes queue up behind them rather than overtaking them in a batch
+    if (mPriv->chatStateCoalescingInterval > 0 && mPriv->chatStateQueue.isEmpty()) {
+        // superseded states are dropped here, before anything is allocated for them
+        mPriv->coalescedChatStates.insert(contactHandle, state);
+
+        if (!mPriv->chatStateCoalescingTimer) {
+            mPriv->chatStateCoalescingTimer = new QTimer(this);
+            mPriv->chatStateCoalescingTimer->setSingleShot(true);
+            connect(mPriv->chatStateCoalescingTimer,
+                    SIGNAL(timeout()),
+                    SLOT(onChatStateCoalescingTimeout()));
+        }
+        if (!mPriv->chatStateCoalescingTimer->isActive()) {
+            mPriv->chatStateCoalescingTimer->start(mPriv->chatStateCoalescingInterval);
+        }
+        return;
+    }
+
     mPriv->chatStateQueue.append(new Private::ChatStateEvent(
                 contactHandle, state));
     mPriv->processChatStateQueue();
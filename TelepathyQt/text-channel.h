@@ -49,6 +49,11 @@ public:
     static const Feature FeatureMessageSentSignal;
     static const Feature FeatureChatState;
 
+    enum MessageDeliveryMode {
+        MessageDeliveryModeInOrder,
+        MessageDeliveryModePerSender
+    };
+
     static TextChannelPtr create(const ConnectionPtr &connection,
             const QString &objectPath, const QVariantMap &immutableProperties);
 
@@ -68,11 +73,22 @@ public:
     // requires FeatureMessageQueue
     QList<ReceivedMessage> messageQueue() const;
 
+    int acknowledgeBatchInterval() const;
+    void setAcknowledgeBatchInterval(int msecs);
+
+    MessageDeliveryMode messageDeliveryMode() const;
+    int maxSenderResolutionTime() const;
+    void setMessageDeliveryMode(MessageDeliveryMode mode, int maxSenderResolutionTime = 0);
+
     // requires FeatureChatState
     ChannelChatState chatState(const ContactPtr &contact) const;
 
+    int chatStateCoalescingInterval() const;
+    void setChatStateCoalescingInterval(int msecs);
+
 public Q_SLOTS:
     void acknowledge(const QList<ReceivedMessage> &messages);
+    void acknowledgeAll();
 
     void forget(const QList<ReceivedMessage> &messages);
 
@@ -106,6 +122,7 @@ Q_SIGNALS:
     // FeatureChatState
     void chatStateChanged(const Tp::ContactPtr &contact,
             Tp::ChannelChatState state);
+    void chatStatesChanged(const QHash<Tp::ContactPtr, Tp::ChannelChatState> &states);
 
 protected:
     TextChannel(const ConnectionPtr &connection, const QString &objectPath,
@@ -115,6 +132,9 @@ protected:
 private Q_SLOTS:
     TP_QT_NO_EXPORT void onContactsFinished(Tp::PendingOperation *);
     TP_QT_NO_EXPORT void onAcknowledgePendingMessagesReply(QDBusPendingCallWatcher *);
+    TP_QT_NO_EXPORT void onAcknowledgeBatchTimeout();
+    TP_QT_NO_EXPORT void onSenderResolutionTimeout();
+    TP_QT_NO_EXPORT void onChatStateCoalescingTimeout();
 
     TP_QT_NO_EXPORT void onMessageSent(const Tp::MessagePartList &, uint,
             const QString &);
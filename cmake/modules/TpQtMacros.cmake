@@ -102,6 +102,13 @@
 #       and optional argument a set of additional libraries the target will link to. Please remember that you need to
 #       set up the DBus environment by calling TPQT_SETUP_DBUS_TEST_ENVIRONMENT BEFORE you call this macro.
 #
+# macro TPQT_ADD_BENCHMARK (fancyName name runnerScript [libraries ...])
+#       This macro takes care of building a QTest benchmark contained in a single source file named ${name}.cpp.
+#       Benchmarks are not added to the CTest suite: instead, a run-benchmark-${fancyName} target runs the benchmark
+#       through runnerScript (runGenericTest.sh or runDbusTest.sh), writing its results in QTest's XML format to
+#       benchmark-${fancyName}.xml, and is added to the "benchmarks" target, which must exist. You can specify as a fourth
+#       and optional argument a set of additional libraries the target will link to.
+#
 # macro _TPQT_ADD_CHECK_TARGETS (fancyName name command [args])
 #       This is an internal macro which is meant to be used by TPQT_ADD_DBUS_UNIT_TEST and TPQT_ADD_GENERIC_UNIT_TEST.
 #       It takes care of generating a check target for each test method available (currently normal execution, valgrind and
@@ -424,6 +431,22 @@ macro(tpqt_add_dbus_unit_test _fancyName _name)
     _tpqt_add_check_targets(${_fancyName} ${_name} ${with_session_bus} ${CMAKE_CURRENT_BINARY_DIR}/test-${_name})
 endmacro(tpqt_add_dbus_unit_test _fancyName _name)
 
+macro(tpqt_add_benchmark _fancyName _name _runnerScript)
+    tpqt_generate_moc_i(${_name}.cpp ${CMAKE_CURRENT_BINARY_DIR}/_gen/${_name}.cpp.moc.hpp)
+    add_executable(benchmark-${_name} ${_name}.cpp ${CMAKE_CURRENT_BINARY_DIR}/_gen/${_name}.cpp.moc.hpp)
+    target_link_libraries(benchmark-${_name} ${QT_QTCORE_LIBRARY} ${QT_QTDBUS_LIBRARY} ${QT_QTNETWORK_LIBRARY} ${QT_QTXML_LIBRARY} ${QT_QTTEST_LIBRARY} telepathy-qt${QT_VERSION_MAJOR} tp-qt-tests ${TP_QT_EXECUTABLE_LINKER_FLAGS} ${ARGN})
+
+    add_custom_target(run-benchmark-${_fancyName}
+        ${SH} ${_runnerScript} ${CMAKE_CURRENT_BINARY_DIR}/benchmark-${_name}
+              -xml -o ${CMAKE_CURRENT_BINARY_DIR}/benchmark-${_fancyName}.xml
+        WORKING_DIRECTORY
+            ${CMAKE_CURRENT_BINARY_DIR}
+        COMMENT
+            "Running benchmark \"${_fancyName}\"")
+    add_dependencies(run-benchmark-${_fancyName} benchmark-${_name})
+    add_dependencies(benchmarks run-benchmark-${_fancyName})
+endmacro(tpqt_add_benchmark _fancyName _name _runnerScript)
+
 macro(_tpqt_add_check_targets _fancyName _name _runnerScript)
     set_tests_properties(${_fancyName}
         PROPERTIES
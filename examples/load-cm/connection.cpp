@@ -0,0 +1,441 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "connection.h"
+#include "_gen/connection.moc.hpp"
+
+#include "protocol.h"
+
+#include <TelepathyQt/BaseHandleRepository>
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/Types>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QLatin1String>
+#include <QVariantMap>
+
+using namespace Tp;
+
+namespace
+{
+
+// The load is generated in ticks of this many milliseconds, rates being per second
+const int tickInterval = 100;
+
+const char *contactStatuses[] = { "available", "away", "busy", "offline" };
+
+}
+
+LoadConnection::LoadConnection(const QDBusConnection &dbusConnection,
+        const QString &cmName, const QString &protocolName,
+        const QVariantMap &parameters)
+    : BaseConnection(dbusConnection, cmName, protocolName, parameters),
+      mContacts(parameters.value(QLatin1String("contacts"), 1000u).toUInt()),
+      mPresenceRate(parameters.value(QLatin1String("presence-rate"), 10u).toUInt()),
+      mChannels(parameters.value(QLatin1String("channels"), 0u).toUInt()),
+      mMessageRate(parameters.value(QLatin1String("message-rate"), 0u).toUInt()),
+      mAvatarRate(parameters.value(QLatin1String("avatar-rate"), 0u).toUInt()),
+      mPresenceDebt(0),
+      mMessageDebt(0),
+      mAvatarDebt(0),
+      mSentMessages(0),
+      mGeneratedMessages(0)
+{
+    // The same seed always produces the same sequence of events
+    qsrand(parameters.value(QLatin1String("seed"), 1u).toUInt());
+
+    setConnectCallback(memFun(this, &LoadConnection::doConnect));
+    setCreateChannelCallback(memFun(this, &LoadConnection::requestChannel));
+
+    contactsIface = BaseConnectionContactsInterface::create(this);
+    contactsIface->setContactAttributeInterfaces(QStringList() <<
+            TP_QT_IFACE_CONNECTION <<
+            TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE <<
+            TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST <<
+            TP_QT_IFACE_CONNECTION_INTERFACE_ALIASING <<
+            TP_QT_IFACE_CONNECTION_INTERFACE_AVATARS);
+    contactsIface->setGetContactAttributesCallback(memFun(this, &LoadConnection::getContactAttributes));
+    plugInterface(AbstractConnectionInterfacePtr::dynamicCast(contactsIface));
+
+    simplePresenceIface = BaseConnectionSimplePresenceInterface::create();
+    simplePresenceIface->setStatuses(Protocol::statuses());
+    simplePresenceIface->setSetPresenceCallback(memFun(this, &LoadConnection::setPresence));
+    plugInterface(AbstractConnectionInterfacePtr::dynamicCast(simplePresenceIface));
+
+    contactListIface = BaseConnectionContactListInterface::create();
+    contactListIface->setContactListPersists(true);
+    contactListIface->setCanChangeContactList(false);
+    contactListIface->setDownloadAtConnection(true);
+    contactListIface->setListContactsCallback(memFun(this, &LoadConnection::listContacts));
+    contactListIface->setGetContactListAttributesPageCallback(
+            memFun(this, &LoadConnection::getContactAttributes));
+    plugInterface(AbstractConnectionInterfacePtr::dynamicCast(contactListIface));
+
+    aliasingIface = BaseConnectionAliasingInterface::create();
+    aliasingIface->setGetAliasesCallback(memFun(this, &LoadConnection::getAliases));
+    plugInterface(AbstractConnectionInterfacePtr::dynamicCast(aliasingIface));
+
+    avatarsIface = BaseConnectionAvatarsInterface::create();
+    avatarsIface->setAvatarDetails(AvatarSpec(QStringList() << QLatin1String("image/png"),
+                16, 64, 32, 16, 64, 32, 1024));
+    avatarsIface->setGetKnownAvatarTokensCallback(memFun(this, &LoadConnection::getKnownAvatarTokens));
+    avatarsIface->setRequestAvatarsCallback(memFun(this, &LoadConnection::requestAvatars));
+    plugInterface(AbstractConnectionInterfacePtr::dynamicCast(avatarsIface));
+
+    requestsIface = BaseConnectionRequestsInterface::create(this);
+    RequestableChannelClass text;
+    text.fixedProperties[TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")] =
+        TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+    text.fixedProperties[TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType")] =
+        HandleTypeContact;
+    text.allowedProperties << TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle") <<
+        TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID");
+    requestsIface->requestableChannelClasses << text;
+    plugInterface(AbstractConnectionInterfacePtr::dynamicCast(requestsIface));
+
+    mLoadTimer.setInterval(tickInterval);
+    QObject::connect(&mLoadTimer, SIGNAL(timeout()), SLOT(onLoadTimeout()));
+}
+
+LoadConnection::~LoadConnection()
+{
+    qDebug() << "Connection" << objectPath() << "sent" << mSentMessages <<
+        "and generated" << mGeneratedMessages << "messages";
+}
+
+void LoadConnection::doConnect(Tp::DBusError *error)
+{
+    setStatus(ConnectionStatusConnecting, ConnectionStatusReasonRequested);
+
+    BaseHandleRepository *repository = handleRepository(HandleTypeContact);
+    repository->reserve(mContacts + 1);
+
+    uint selfHandle = repository->ensureHandle(
+            parameters().value(QLatin1String("account")).toString().toLower(), error);
+    if (error->isValid()) {
+        return;
+    }
+    setSelfHandle(selfHandle);
+    setSelfID(repository->identifier(selfHandle));
+
+    QStringList identifiers;
+    for (uint i = 1; i <= mContacts; ++i) {
+        identifiers << QString(QLatin1String("contact%1@load.example")).arg(i);
+    }
+    mRoster = repository->ensureHandles(identifiers, error);
+    if (error->isValid()) {
+        return;
+    }
+
+    SimpleContactPresences presences;
+    SimplePresence self;
+    self.type = ConnectionPresenceTypeAvailable;
+    self.status = QLatin1String("available");
+    presences.insert(selfHandle, self);
+    foreach (uint handle, mRoster) {
+        SimplePresence presence;
+        presence.type = ConnectionPresenceTypeAvailable;
+        presence.status = QLatin1String("available");
+        presences.insert(handle, presence);
+    }
+    simplePresenceIface->setPresences(presences);
+
+    contactListIface->setContactListState(ContactListStateSuccess);
+    setStatus(ConnectionStatusConnected, ConnectionStatusReasonRequested);
+
+    for (uint i = 0; i < mChannels && i < mContacts; ++i) {
+        addChannel(createTextChannel(mRoster.at(i), false));
+    }
+
+    if (mPresenceRate > 0 || mMessageRate > 0 || mAvatarRate > 0) {
+        mLoadTimer.start();
+    }
+}
+
+BaseChannelPtr LoadConnection::requestChannel(const QVariantMap &request, Tp::DBusError *error)
+{
+    QString channelType = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")).toString();
+    uint targetHandleType = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType")).toUInt();
+    if (channelType != TP_QT_IFACE_CHANNEL_TYPE_TEXT || targetHandleType != HandleTypeContact) {
+        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Only 1-1 text chats are supported"));
+        return BaseChannelPtr();
+    }
+
+    BaseHandleRepository *repository = handleRepository(HandleTypeContact);
+    uint targetHandle = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle")).toUInt();
+    if (targetHandle == 0) {
+        QString targetID = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID")).toString();
+        targetHandle = repository->handle(targetID.toLower());
+    }
+    if (!repository->isValid(targetHandle)) {
+        error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Unknown contact"));
+        return BaseChannelPtr();
+    }
+
+    return createTextChannel(targetHandle, true);
+}
+
+BaseChannelPtr LoadConnection::createTextChannel(uint targetHandle, bool requested)
+{
+    BaseChannelPtr channel = BaseChannel::create(this, TP_QT_IFACE_CHANNEL_TYPE_TEXT,
+            HandleTypeContact, targetHandle);
+    channel->setTargetID(handleRepository(HandleTypeContact)->identifier(targetHandle));
+    channel->setRequested(requested);
+    channel->setInitiatorHandle(requested ? selfHandle() : targetHandle);
+
+    BaseChannelTextTypePtr textType = BaseChannelTextType::create(channel.data());
+    channel->plugInterface(AbstractChannelInterfacePtr::dynamicCast(textType));
+
+    BaseChannelMessagesInterfacePtr messages = BaseChannelMessagesInterface::create(
+            textType.data(),
+            QStringList() << QLatin1String("text/plain"),
+            Tp::UIntList() << ChannelTextMessageTypeNormal << ChannelTextMessageTypeAction,
+            MessagePartSupportFlagOneAttachment | MessagePartSupportFlagMultipleAttachments,
+            DeliveryReportingSupportFlagReceiveSuccesses);
+    messages->setSendMessageCallback(memFun(this, &LoadConnection::sendMessage));
+    channel->plugInterface(AbstractChannelInterfacePtr::dynamicCast(messages));
+
+    mTextChannels.insert(channel.data(), textType);
+    QObject::connect(channel.data(), SIGNAL(closed()), SLOT(onChannelClosed()));
+    return channel;
+}
+
+void LoadConnection::onChannelClosed()
+{
+    mTextChannels.remove(qobject_cast<BaseChannel*>(sender()));
+}
+
+uint LoadConnection::setPresence(const QString &status, const QString &message, Tp::DBusError *error)
+{
+    SimpleStatusSpecMap statuses = Protocol::statuses();
+    if (!statuses.contains(status)) {
+        error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("Unknown status"));
+        return 0;
+    }
+
+    SimpleContactPresences presences;
+    SimplePresence presence;
+    presence.type = statuses.value(status).type;
+    presence.status = status;
+    presence.statusMessage = message;
+    presences.insert(selfHandle(), presence);
+    simplePresenceIface->setPresences(presences);
+    return selfHandle();
+}
+
+Tp::ContactAttributesMap LoadConnection::getContactAttributes(const Tp::UIntList &handles,
+        const QStringList &interfaces, Tp::DBusError *error)
+{
+    BaseHandleRepository *repository = handleRepository(HandleTypeContact);
+    if (!repository->areValid(handles)) {
+        error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Invalid handle"));
+        return Tp::ContactAttributesMap();
+    }
+
+    SimpleContactPresences presences;
+    if (interfaces.contains(TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE)) {
+        presences = simplePresenceIface->getPresences(handles);
+    }
+
+    Tp::ContactAttributesMap attributes;
+    foreach (uint handle, handles) {
+        QVariantMap &contactAttributes = attributes[handle];
+        contactAttributes.insert(TP_QT_IFACE_CONNECTION + QLatin1String("/contact-id"),
+                repository->identifier(handle));
+        if (interfaces.contains(TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE)) {
+            contactAttributes.insert(TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE +
+                    QLatin1String("/presence"), QVariant::fromValue(presences.value(handle)));
+        }
+        if (interfaces.contains(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) &&
+                handle != selfHandle()) {
+            contactAttributes.insert(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST +
+                    QLatin1String("/subscribe"), static_cast<uint>(SubscriptionStateYes));
+            contactAttributes.insert(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST +
+                    QLatin1String("/publish"), static_cast<uint>(SubscriptionStateYes));
+        }
+        if (interfaces.contains(TP_QT_IFACE_CONNECTION_INTERFACE_ALIASING)) {
+            contactAttributes.insert(TP_QT_IFACE_CONNECTION_INTERFACE_ALIASING +
+                    QLatin1String("/alias"), alias(handle));
+        }
+        if (interfaces.contains(TP_QT_IFACE_CONNECTION_INTERFACE_AVATARS)) {
+            contactAttributes.insert(TP_QT_IFACE_CONNECTION_INTERFACE_AVATARS +
+                    QLatin1String("/token"), avatarToken(handle));
+        }
+    }
+    return attributes;
+}
+
+Tp::UIntList LoadConnection::listContacts(Tp::DBusError *error)
+{
+    Q_UNUSED(error);
+
+    return mRoster;
+}
+
+Tp::AliasMap LoadConnection::getAliases(const Tp::UIntList &contacts, Tp::DBusError *error)
+{
+    if (!handleRepository(HandleTypeContact)->areValid(contacts)) {
+        error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Invalid handle"));
+        return Tp::AliasMap();
+    }
+
+    Tp::AliasMap aliases;
+    foreach (uint handle, contacts) {
+        aliases.insert(handle, alias(handle));
+    }
+    return aliases;
+}
+
+Tp::AvatarTokenMap LoadConnection::getKnownAvatarTokens(const Tp::UIntList &contacts,
+        Tp::DBusError *error)
+{
+    if (!handleRepository(HandleTypeContact)->areValid(contacts)) {
+        error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Invalid handle"));
+        return Tp::AvatarTokenMap();
+    }
+
+    Tp::AvatarTokenMap tokens;
+    foreach (uint handle, contacts) {
+        tokens.insert(handle, avatarToken(handle));
+    }
+    return tokens;
+}
+
+void LoadConnection::requestAvatars(const Tp::UIntList &contacts, Tp::DBusError *error)
+{
+    if (!handleRepository(HandleTypeContact)->areValid(contacts)) {
+        error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Invalid handle"));
+        return;
+    }
+
+    foreach (uint handle, contacts) {
+        // Not a real image: only the size and the token matter for load testing
+        QString token = avatarToken(handle);
+        avatarsIface->avatarRetrieved(handle, token, token.toLatin1().repeated(32),
+                QLatin1String("image/png"));
+    }
+}
+
+QString LoadConnection::sendMessage(const Tp::MessagePartList &message, uint flags,
+        Tp::DBusError *error)
+{
+    Q_UNUSED(message);
+    Q_UNUSED(flags);
+    Q_UNUSED(error);
+
+    return QString(QLatin1String("sent-%1")).arg(++mSentMessages);
+}
+
+uint LoadConnection::randomContact() const
+{
+    return mRoster.at(qrand() % mRoster.size());
+}
+
+QString LoadConnection::alias(uint handle) const
+{
+    return handleRepository(HandleTypeContact)->identifier(handle).section(QLatin1Char('@'), 0, 0);
+}
+
+QString LoadConnection::avatarToken(uint handle) const
+{
+    return QString(QLatin1String("avatar-%1-%2")).arg(handle).arg(mAvatarGenerations.value(handle));
+}
+
+void LoadConnection::onLoadTimeout()
+{
+    // Spread each rate evenly over the ticks of a second, carrying the remainders over
+    mPresenceDebt += mPresenceRate * tickInterval;
+    churnPresences(mPresenceDebt / 1000);
+    mPresenceDebt %= 1000;
+
+    mAvatarDebt += mAvatarRate * tickInterval;
+    churnAvatars(mAvatarDebt / 1000);
+    mAvatarDebt %= 1000;
+
+    mMessageDebt += mMessageRate * tickInterval;
+    generateMessages(mMessageDebt / 1000);
+    mMessageDebt %= 1000;
+}
+
+void LoadConnection::churnPresences(uint count)
+{
+    if (count == 0 || mRoster.isEmpty()) {
+        return;
+    }
+
+    SimpleStatusSpecMap statuses = Protocol::statuses();
+    SimpleContactPresences presences;
+    for (uint i = 0; i < count; ++i) {
+        SimplePresence presence;
+        presence.status = QLatin1String(contactStatuses[qrand() % 4]);
+        presence.type = statuses.value(presence.status).type;
+        if (presence.type != ConnectionPresenceTypeOffline) {
+            presence.statusMessage = QString(QLatin1String("Status %1")).arg(qrand() % 100);
+        }
+        presences.insert(randomContact(), presence);
+    }
+    simplePresenceIface->setPresences(presences);
+}
+
+void LoadConnection::churnAvatars(uint count)
+{
+    if (mRoster.isEmpty()) {
+        return;
+    }
+
+    for (uint i = 0; i < count; ++i) {
+        uint handle = randomContact();
+        ++mAvatarGenerations[handle];
+        avatarsIface->avatarUpdated(handle, avatarToken(handle));
+    }
+}
+
+void LoadConnection::generateMessages(uint count)
+{
+    if (count == 0 || mTextChannels.isEmpty()) {
+        return;
+    }
+
+    QList<BaseChannel*> channels = mTextChannels.keys();
+    uint timestamp = QDateTime::currentDateTime().toTime_t();
+    for (uint i = 0; i < count; ++i) {
+        BaseChannel *channel = channels.at(qrand() % channels.size());
+        BaseChannelTextTypePtr textType = mTextChannels.value(channel);
+
+        MessagePart header;
+        header[QLatin1String("message-token")] = QDBusVariant(
+                QString(QLatin1String("generated-%1")).arg(++mGeneratedMessages));
+        header[QLatin1String("message-sender")] = QDBusVariant(channel->targetHandle());
+        header[QLatin1String("message-sender-id")] = QDBusVariant(channel->targetID());
+        header[QLatin1String("message-received")] = QDBusVariant(timestamp);
+        header[QLatin1String("message-type")] = QDBusVariant(
+                static_cast<uint>(ChannelTextMessageTypeNormal));
+
+        MessagePart body;
+        body[QLatin1String("content-type")] = QDBusVariant(QLatin1String("text/plain"));
+        body[QLatin1String("content")] = QDBusVariant(
+                QString(QLatin1String("Generated message %1")).arg(mGeneratedMessages));
+
+        textType->addReceivedMessage(MessagePartList() << header << body);
+    }
+}
@@ -0,0 +1,95 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_examples_load_cm_connection_h_HEADER_GUARD_
+#define _TelepathyQt_examples_load_cm_connection_h_HEADER_GUARD_
+
+#include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/BaseConnection>
+
+#include <QHash>
+#include <QTimer>
+
+class LoadConnection : public Tp::BaseConnection
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(LoadConnection)
+
+public:
+    LoadConnection(const QDBusConnection &dbusConnection,
+            const QString &cmName, const QString &protocolName,
+            const QVariantMap &parameters);
+    virtual ~LoadConnection();
+
+private Q_SLOTS:
+    void onLoadTimeout();
+    void onChannelClosed();
+
+private:
+    void doConnect(Tp::DBusError *error);
+    Tp::BaseChannelPtr requestChannel(const QVariantMap &request, Tp::DBusError *error);
+    Tp::BaseChannelPtr createTextChannel(uint targetHandle, bool requested);
+
+    uint setPresence(const QString &status, const QString &message, Tp::DBusError *error);
+    Tp::ContactAttributesMap getContactAttributes(const Tp::UIntList &handles,
+            const QStringList &interfaces, Tp::DBusError *error);
+    Tp::UIntList listContacts(Tp::DBusError *error);
+    Tp::AliasMap getAliases(const Tp::UIntList &contacts, Tp::DBusError *error);
+    Tp::AvatarTokenMap getKnownAvatarTokens(const Tp::UIntList &contacts, Tp::DBusError *error);
+    void requestAvatars(const Tp::UIntList &contacts, Tp::DBusError *error);
+    QString sendMessage(const Tp::MessagePartList &message, uint flags, Tp::DBusError *error);
+
+    uint randomContact() const;
+    QString alias(uint handle) const;
+    QString avatarToken(uint handle) const;
+
+    void churnPresences(uint count);
+    void churnAvatars(uint count);
+    void generateMessages(uint count);
+
+    Tp::BaseConnectionContactsInterfacePtr contactsIface;
+    Tp::BaseConnectionSimplePresenceInterfacePtr simplePresenceIface;
+    Tp::BaseConnectionContactListInterfacePtr contactListIface;
+    Tp::BaseConnectionAliasingInterfacePtr aliasingIface;
+    Tp::BaseConnectionAvatarsInterfacePtr avatarsIface;
+    Tp::BaseConnectionRequestsInterfacePtr requestsIface;
+
+    uint mContacts;
+    uint mPresenceRate;
+    uint mChannels;
+    uint mMessageRate;
+    uint mAvatarRate;
+
+    // Fractions of an event carried over between ticks, in thousandths
+    uint mPresenceDebt;
+    uint mMessageDebt;
+    uint mAvatarDebt;
+
+    Tp::UIntList mRoster;
+    QTimer mLoadTimer;
+    QHash<uint, uint> mAvatarGenerations;
+    QHash<Tp::BaseChannel*, Tp::BaseChannelTextTypePtr> mTextChannels;
+    uint mSentMessages;
+    uint mGeneratedMessages;
+};
+
+#endif
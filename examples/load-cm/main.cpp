@@ -0,0 +1,44 @@
+/*
+ * A connection manager generating a configurable, reproducible load, for benchmarking
+ * clients and capacity testing without any network.
+ *
+ * Every connection of its "load" protocol exposes "contacts" contacts on its roster, changes
+ * the presence of "presence-rate" of them and the avatar of "avatar-rate" of them per second,
+ * opens "channels" incoming text channels on connection and receives "message-rate" messages
+ * per second spread over them, all driven by a random generator seeded with "seed".
+ *
+ * Run it on a private session bus so it does not disturb, nor get disturbed by, the desktop:
+ *
+ *     dbus-run-session -- sh -c './load-cm & ./my-client'
+ */
+
+#include <TelepathyQt/BaseConnectionManager>
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/Debug>
+#include <TelepathyQt/Types>
+
+#include <QDebug>
+#include <QtCore>
+
+#include "protocol.h"
+
+using namespace Tp;
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    Tp::registerTypes();
+    Tp::enableDebug(app.arguments().contains(QLatin1String("--debug")));
+    Tp::enableWarnings(true);
+
+    BaseProtocolPtr proto = BaseProtocol::create<Protocol>(
+            QDBusConnection::sessionBus(),
+            QLatin1String("load"));
+    BaseConnectionManagerPtr cm = BaseConnectionManager::create(
+            QDBusConnection::sessionBus(), QLatin1String("tpqt_load"));
+    cm->addProtocol(proto);
+    cm->registerObject();
+
+    return app.exec();
+}
@@ -0,0 +1,138 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ * @copyright Copyright (C) 2012 Nokia Corporation
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "protocol.h"
+#include "_gen/protocol.moc.hpp"
+
+#include "connection.h"
+
+#include <TelepathyQt/BaseConnection>
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/RequestableChannelClassSpec>
+#include <TelepathyQt/RequestableChannelClassSpecList>
+#include <TelepathyQt/Types>
+
+#include <QLatin1String>
+#include <QVariantMap>
+
+using namespace Tp;
+
+Protocol::Protocol(const QDBusConnection &dbusConnection, const QString &name)
+    : BaseProtocol(dbusConnection, name)
+{
+    // All the load knobs are connection parameters, so that every connection can be
+    // configured independently and runs are reproducible from the account alone
+    setParameters(ProtocolParameterList() <<
+            ProtocolParameter(QLatin1String("account"),
+                QLatin1String("s"), ConnMgrParamFlagRequired) <<
+            ProtocolParameter(QLatin1String("contacts"),
+                QLatin1String("u"), ConnMgrParamFlagHasDefault, 1000u) <<
+            ProtocolParameter(QLatin1String("presence-rate"),
+                QLatin1String("u"), ConnMgrParamFlagHasDefault, 10u) <<
+            ProtocolParameter(QLatin1String("channels"),
+                QLatin1String("u"), ConnMgrParamFlagHasDefault, 0u) <<
+            ProtocolParameter(QLatin1String("message-rate"),
+                QLatin1String("u"), ConnMgrParamFlagHasDefault, 0u) <<
+            ProtocolParameter(QLatin1String("avatar-rate"),
+                QLatin1String("u"), ConnMgrParamFlagHasDefault, 0u) <<
+            ProtocolParameter(QLatin1String("seed"),
+                QLatin1String("u"), ConnMgrParamFlagHasDefault, 1u));
+    setRequestableChannelClasses(
+            RequestableChannelClassSpecList() << RequestableChannelClassSpec::textChat());
+    setEnglishName(QLatin1String("Load generator"));
+    setIconName(QLatin1String("im-load"));
+    setVCardField(QLatin1String("x-load"));
+
+    // callbacks
+    setCreateConnectionCallback(memFun(this, &Protocol::createConnection));
+    setIdentifyAccountCallback(memFun(this, &Protocol::identifyAccount));
+    setNormalizeContactCallback(memFun(this, &Protocol::normalizeContact));
+
+    avatarsIface = BaseProtocolAvatarsInterface::create();
+    avatarsIface->setAvatarDetails(AvatarSpec(QStringList() << QLatin1String("image/png"),
+                16, 64, 32, 16, 64, 32, 1024));
+    plugInterface(AbstractProtocolInterfacePtr::dynamicCast(avatarsIface));
+
+    presenceIface = BaseProtocolPresenceInterface::create();
+    presenceIface->setStatuses(PresenceSpecList(statuses()));
+    plugInterface(AbstractProtocolInterfacePtr::dynamicCast(presenceIface));
+}
+
+Protocol::~Protocol()
+{
+}
+
+SimpleStatusSpecMap Protocol::statuses()
+{
+    SimpleStatusSpec spAvailable;
+    spAvailable.type = ConnectionPresenceTypeAvailable;
+    spAvailable.maySetOnSelf = true;
+    spAvailable.canHaveMessage = true;
+
+    SimpleStatusSpec spAway;
+    spAway.type = ConnectionPresenceTypeAway;
+    spAway.maySetOnSelf = true;
+    spAway.canHaveMessage = true;
+
+    SimpleStatusSpec spBusy;
+    spBusy.type = ConnectionPresenceTypeBusy;
+    spBusy.maySetOnSelf = true;
+    spBusy.canHaveMessage = true;
+
+    SimpleStatusSpec spOffline;
+    spOffline.type = ConnectionPresenceTypeOffline;
+    spOffline.maySetOnSelf = true;
+    spOffline.canHaveMessage = false;
+
+    SimpleStatusSpecMap specs;
+    specs.insert(QLatin1String("available"), spAvailable);
+    specs.insert(QLatin1String("away"), spAway);
+    specs.insert(QLatin1String("busy"), spBusy);
+    specs.insert(QLatin1String("offline"), spOffline);
+    return specs;
+}
+
+BaseConnectionPtr Protocol::createConnection(const QVariantMap &parameters, Tp::DBusError *error)
+{
+    Q_UNUSED(error);
+    return BaseConnection::create<LoadConnection>(QLatin1String("tpqt_load"), name(), parameters,
+            dbusConnection());
+}
+
+QString Protocol::identifyAccount(const QVariantMap &parameters, Tp::DBusError *error)
+{
+    QString account = parameters.value(QLatin1String("account")).toString();
+    if (account.isEmpty()) {
+        error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("account parameter is required"));
+        return QString();
+    }
+    return normalizeContact(account, error);
+}
+
+QString Protocol::normalizeContact(const QString &contactId, Tp::DBusError *error)
+{
+    if (contactId.isEmpty()) {
+        error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Empty contact identifier"));
+        return QString();
+    }
+    return contactId.toLower();
+}
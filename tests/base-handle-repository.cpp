@@ -0,0 +1,138 @@
+#include <QtTest/QtTest>
+
+#include <TelepathyQt/BaseHandleRepository>
+#include <TelepathyQt/Callbacks>
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusError>
+
+using namespace Tp;
+
+class TestBaseHandleRepository : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testInterning();
+    void testNormalization();
+    void testBatch();
+    void testBatchReinterning();
+};
+
+static QString normalizeLower(const QString &identifier, DBusError *error)
+{
+    if (!identifier.contains(QLatin1Char('@'))) {
+        error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Not an address"));
+        return QString();
+    }
+    return identifier.toLower();
+}
+
+void TestBaseHandleRepository::testInterning()
+{
+    BaseHandleRepository repository(HandleTypeContact);
+    QCOMPARE(repository.handleType(), static_cast<uint>(HandleTypeContact));
+    QCOMPARE(repository.count(), 0);
+    QCOMPARE(repository.handle(QLatin1String("alice")), 0U);
+
+    DBusError error;
+    uint alice = repository.ensureHandle(QLatin1String("alice"), &error);
+    QVERIFY(!error.isValid());
+    QCOMPARE(alice, 1U);
+    uint bob = repository.ensureHandle(QLatin1String("bob"), &error);
+    QCOMPARE(bob, 2U);
+    QCOMPARE(repository.ensureHandle(QLatin1String("alice"), &error), alice);
+    QCOMPARE(repository.count(), 2);
+
+    QCOMPARE(repository.handle(QLatin1String("bob")), bob);
+    QCOMPARE(repository.identifier(alice), QLatin1String("alice"));
+    QVERIFY(repository.isValid(bob));
+    QVERIFY(!repository.isValid(0));
+    QVERIFY(!repository.isValid(3));
+    QCOMPARE(repository.identifier(3), QString());
+
+    repository.ensureHandle(QString(), &error);
+    QVERIFY(error.isValid());
+    QCOMPARE(error.name(), TP_QT_ERROR_INVALID_HANDLE);
+    QCOMPARE(repository.count(), 2);
+
+    // Grow well past the initial table size
+    for (int i = 0; i < 1000; ++i) {
+        DBusError itemError;
+        QCOMPARE(repository.ensureHandle(QString::number(i), &itemError), static_cast<uint>(i + 3));
+    }
+    QCOMPARE(repository.handle(QLatin1String("alice")), alice);
+    QCOMPARE(repository.handle(QLatin1String("999")), 1002U);
+}
+
+void TestBaseHandleRepository::testNormalization()
+{
+    BaseHandleRepository repository(HandleTypeContact);
+    repository.setNormalizeCallback(ptrFun(&normalizeLower));
+
+    DBusError error;
+    uint handle = repository.ensureHandle(QLatin1String("Alice@Example.com"), &error);
+    QVERIFY(!error.isValid());
+    QCOMPARE(repository.ensureHandle(QLatin1String("alice@example.COM"), &error), handle);
+    QCOMPARE(repository.identifier(handle), QLatin1String("alice@example.com"));
+
+    QCOMPARE(repository.ensureHandle(QLatin1String("alice"), &error), 0U);
+    QVERIFY(error.isValid());
+    QCOMPARE(error.name(), TP_QT_ERROR_INVALID_HANDLE);
+}
+
+void TestBaseHandleRepository::testBatch()
+{
+    BaseHandleRepository repository(HandleTypeRoom);
+    repository.setNormalizeCallback(ptrFun(&normalizeLower));
+
+    DBusError error;
+    UIntList handles = repository.ensureHandles(QStringList() <<
+            QLatin1String("a@b") << QLatin1String("C@D") << QLatin1String("A@B"), &error);
+    QVERIFY(!error.isValid());
+    QCOMPARE(handles, UIntList() << 1 << 2 << 1);
+    QVERIFY(repository.areValid(handles));
+
+    QCOMPARE(repository.identifiers(handles, &error),
+            QStringList() << QLatin1String("a@b") << QLatin1String("c@d") << QLatin1String("a@b"));
+    QVERIFY(!error.isValid());
+
+    // Nothing gets interned if any of the identifiers is invalid
+    handles = repository.ensureHandles(QStringList() <<
+            QLatin1String("e@f") << QLatin1String("invalid"), &error);
+    QVERIFY(error.isValid());
+    QVERIFY(handles.isEmpty());
+    QCOMPARE(repository.count(), 2);
+
+    DBusError inspectError;
+    QVERIFY(repository.identifiers(UIntList() << 1 << 5, &inspectError).isEmpty());
+    QCOMPARE(inspectError.name(), TP_QT_ERROR_INVALID_HANDLE);
+}
+
+void TestBaseHandleRepository::testBatchReinterning()
+{
+    // Large repositories are benchmarked in tests/benchmarks, this only checks that a batch
+    // big enough to grow the tables a few times comes back the same when interned again
+    const int count = 10000;
+    QStringList identifiers;
+    for (int i = 0; i < count; ++i) {
+        identifiers.append(QString(QLatin1String("contact%1@example.com")).arg(i));
+    }
+
+    BaseHandleRepository repository(HandleTypeContact);
+    DBusError error;
+    UIntList handles = repository.ensureHandles(identifiers, &error);
+    QVERIFY(!error.isValid());
+    QCOMPARE(handles.size(), count);
+    QCOMPARE(repository.count(), count);
+
+    QCOMPARE(repository.ensureHandles(identifiers, &error), handles);
+    QVERIFY(!error.isValid());
+    QCOMPARE(repository.count(), count);
+    QCOMPARE(repository.handle(identifiers.last()), static_cast<uint>(count));
+    QCOMPARE(repository.identifier(count / 2), identifiers.at(count / 2 - 1));
+    QCOMPARE(repository.identifiers(handles, &error), identifiers);
+}
+
+QTEST_MAIN(TestBaseHandleRepository)
+
+#include "_gen/base-handle-repository.cpp.moc.hpp"
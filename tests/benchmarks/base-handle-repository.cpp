@@ -0,0 +1,79 @@
+#include <QtTest/QtTest>
+
+#include <TelepathyQt/BaseHandleRepository>
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusError>
+
+#include <tests/benchmarks/benchmark.h>
+
+using namespace Tp;
+
+class BenchmarkBaseHandleRepository : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchmarkIntern_data();
+    void benchmarkIntern();
+    void benchmarkReintern_data();
+    void benchmarkReintern();
+
+private:
+    static QStringList makeIdentifiers(int count);
+};
+
+QStringList BenchmarkBaseHandleRepository::makeIdentifiers(int count)
+{
+    QStringList identifiers;
+    for (int i = 0; i < count; ++i) {
+        identifiers.append(QString(QLatin1String("contact%1@example.com")).arg(i));
+    }
+    return identifiers;
+}
+
+void BenchmarkBaseHandleRepository::benchmarkIntern_data()
+{
+    addBenchmarkSizes(QList<int>() << 1000 << 100000 << 1000000);
+}
+
+// Interning into an empty repository, which has to grow its tables as it goes
+void BenchmarkBaseHandleRepository::benchmarkIntern()
+{
+    QFETCH(int, size);
+
+    QStringList identifiers = makeIdentifiers(size);
+
+    QBENCHMARK {
+        BaseHandleRepository repository(HandleTypeContact);
+        DBusError error;
+        repository.ensureHandles(identifiers, &error);
+        QVERIFY(!error.isValid());
+        QCOMPARE(repository.count(), size);
+    }
+}
+
+void BenchmarkBaseHandleRepository::benchmarkReintern_data()
+{
+    addBenchmarkSizes(QList<int>() << 1000 << 100000 << 1000000);
+}
+
+// Interning identifiers which already have handles, i.e. only lookups
+void BenchmarkBaseHandleRepository::benchmarkReintern()
+{
+    QFETCH(int, size);
+
+    QStringList identifiers = makeIdentifiers(size);
+    BaseHandleRepository repository(HandleTypeContact);
+    DBusError error;
+    repository.ensureHandles(identifiers, &error);
+    QVERIFY(!error.isValid());
+
+    QBENCHMARK {
+        QCOMPARE(repository.ensureHandles(identifiers, &error).size(), size);
+    }
+    QCOMPARE(repository.count(), size);
+}
+
+QTEST_MAIN(BenchmarkBaseHandleRepository)
+
+#include "_gen/base-handle-repository.cpp.moc.hpp"
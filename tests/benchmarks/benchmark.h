@@ -0,0 +1,27 @@
+#ifndef _TelepathyQt_tests_benchmarks_benchmark_h_HEADER_GUARD_
+#define _TelepathyQt_tests_benchmarks_benchmark_h_HEADER_GUARD_
+
+#include <QByteArray>
+#include <QList>
+#include <QtTest>
+
+// Factor the fixture sizes are multiplied by, taken from the TPQT_BENCHMARK_SCALE
+// environment variable so the same benchmarks can be run against larger fixtures
+inline int benchmarkScale()
+{
+    bool ok;
+    int scale = qgetenv("TPQT_BENCHMARK_SCALE").toInt(&ok);
+    return (ok && scale > 0) ? scale : 1;
+}
+
+// Add a "size" column and one data row per scaled size, tagged with the size itself
+inline void addBenchmarkSizes(const QList<int> &sizes)
+{
+    QTest::addColumn<int>("size");
+    Q_FOREACH (int size, sizes) {
+        int scaled = size * benchmarkScale();
+        QTest::newRow(QByteArray::number(scaled).constData()) << scaled;
+    }
+}
+
+#endif // _TelepathyQt_tests_benchmarks_benchmark_h_HEADER_GUARD_
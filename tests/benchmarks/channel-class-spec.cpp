@@ -0,0 +1,101 @@
+#include <QtTest/QtTest>
+
+#include <TelepathyQt/ChannelClassSpec>
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/Types>
+
+#include <tests/benchmarks/benchmark.h>
+
+using namespace Tp;
+
+class BenchmarkChannelClassSpec : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchmarkMatches_data();
+    void benchmarkMatches();
+    void benchmarkIsSubsetOf_data();
+    void benchmarkIsSubsetOf();
+
+private:
+    ChannelClassSpecList filter(int size) const;
+};
+
+// A typical handler filter: the well-known classes followed by size - 6 stream tube services,
+// none of which match a text chat, so that matching has to walk the whole list
+ChannelClassSpecList BenchmarkChannelClassSpec::filter(int size) const
+{
+    ChannelClassSpecList specs;
+    specs << ChannelClassSpec::audioCall() << ChannelClassSpec::videoCall() <<
+        ChannelClassSpec::incomingFileTransfer() << ChannelClassSpec::roomList() <<
+        ChannelClassSpec::textChatroom() << ChannelClassSpec::serverAuthentication();
+    for (int i = specs.size(); i < size; ++i) {
+        specs << ChannelClassSpec::incomingStreamTube(QString(QLatin1String("service%1")).arg(i));
+    }
+    specs << ChannelClassSpec::textChat();
+    return specs;
+}
+
+void BenchmarkChannelClassSpec::benchmarkMatches_data()
+{
+    addBenchmarkSizes(QList<int>() << 10 << 100 << 1000);
+}
+
+void BenchmarkChannelClassSpec::benchmarkMatches()
+{
+    QFETCH(int, size);
+
+    ChannelClassSpecList specs = filter(size);
+
+    QVariantMap immutableProperties;
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"),
+            TP_QT_IFACE_CHANNEL_TYPE_TEXT);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+            static_cast<uint>(HandleTypeContact));
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"), 42u);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"),
+            QLatin1String("someone@example.com"));
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".Requested"), false);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".InitiatorHandle"), 42u);
+
+    int matched = 0;
+    QBENCHMARK {
+        matched = 0;
+        Q_FOREACH (const ChannelClassSpec &spec, specs) {
+            if (spec.matches(immutableProperties)) {
+                ++matched;
+            }
+        }
+    }
+    QCOMPARE(matched, 1);
+}
+
+void BenchmarkChannelClassSpec::benchmarkIsSubsetOf_data()
+{
+    addBenchmarkSizes(QList<int>() << 10 << 100 << 1000);
+}
+
+void BenchmarkChannelClassSpec::benchmarkIsSubsetOf()
+{
+    QFETCH(int, size);
+
+    ChannelClassSpecList specs = filter(size);
+    ChannelClassSpec requested = ChannelClassSpec::textChat();
+    requested.setRequested(false);
+
+    int matched = 0;
+    QBENCHMARK {
+        matched = 0;
+        Q_FOREACH (const ChannelClassSpec &spec, specs) {
+            if (spec.isSubsetOf(requested)) {
+                ++matched;
+            }
+        }
+    }
+    QCOMPARE(matched, 1);
+}
+
+QTEST_MAIN(BenchmarkChannelClassSpec)
+
+#include "_gen/channel-class-spec.cpp.moc.hpp"
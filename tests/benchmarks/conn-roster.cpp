@@ -0,0 +1,125 @@
+#include <tests/lib/test.h>
+
+#include <tests/lib/glib-helpers/test-conn-helper.h>
+
+#include <tests/lib/glib/contactlist2/conn.h>
+
+#include <tests/benchmarks/benchmark.h>
+
+#include <TelepathyQt/ChannelFactory>
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/Contact>
+#include <TelepathyQt/ContactFactory>
+#include <TelepathyQt/ContactManager>
+#include <TelepathyQt/PendingReady>
+
+#include <telepathy-glib/debug.h>
+
+using namespace Tp;
+
+class BenchmarkConnRoster : public Test
+{
+    Q_OBJECT
+
+public:
+    BenchmarkConnRoster(QObject *parent = 0)
+        : Test(parent), mConn(0)
+    { }
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void benchmarkBecomeReady_data();
+    void benchmarkBecomeReady();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    TestConnHelper *mConn;
+};
+
+void BenchmarkConnRoster::initTestCase()
+{
+    initTestCaseImpl();
+
+    g_type_init();
+    g_set_prgname("benchmark-conn-roster");
+    tp_debug_set_flags("");
+    dbus_g_bus_get(DBUS_BUS_STARTER, 0);
+
+    mConn = new TestConnHelper(this,
+            ChannelFactory::create(QDBusConnection::sessionBus()),
+            ContactFactory::create(Contact::FeatureAlias),
+            EXAMPLE_TYPE_CONTACT_LIST_CONNECTION,
+            "account", "me@example.com",
+            "protocol", "contactlist",
+            "simulation-delay", 1,
+            NULL);
+    QCOMPARE(mConn->connect(), true);
+}
+
+void BenchmarkConnRoster::init()
+{
+    initImpl();
+}
+
+void BenchmarkConnRoster::benchmarkBecomeReady_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("roster");
+
+    int size = benchmarkScale();
+    QTest::newRow("core") << size << false;
+    QTest::newRow("roster") << size << true;
+}
+
+void BenchmarkConnRoster::benchmarkBecomeReady()
+{
+    QFETCH(int, size);
+    QFETCH(bool, roster);
+
+    Features features = Features() << Connection::FeatureCore <<
+        Connection::FeatureSelfContact << Connection::FeatureSimplePresence;
+    if (roster) {
+        features << Connection::FeatureRoster << Connection::FeatureRosterGroups;
+    }
+
+    QBENCHMARK {
+        // Each round introspects size fresh proxies for the same connection until their
+        // ReadinessHelper converges, which for the roster includes building all the contacts
+        for (int i = 0; i < size; ++i) {
+            ConnectionPtr conn = Connection::create(mConn->client()->busName(),
+                    mConn->objectPath(),
+                    ChannelFactory::create(QDBusConnection::sessionBus()),
+                    ContactFactory::create(Contact::FeatureAlias));
+            QVERIFY(connect(conn->becomeReady(features),
+                        SIGNAL(finished(Tp::PendingOperation*)),
+                        SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+            QCOMPARE(mLoop->exec(), 0);
+            QVERIFY(conn->isReady(features));
+            if (roster) {
+                QCOMPARE(conn->contactManager()->state(), ContactListStateSuccess);
+                QVERIFY(!conn->contactManager()->allKnownContacts().isEmpty());
+            }
+        }
+    }
+}
+
+void BenchmarkConnRoster::cleanup()
+{
+    cleanupImpl();
+}
+
+void BenchmarkConnRoster::cleanupTestCase()
+{
+    QCOMPARE(mConn->disconnect(), true);
+    delete mConn;
+
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(BenchmarkConnRoster)
+
+#include "_gen/conn-roster.cpp.moc.hpp"
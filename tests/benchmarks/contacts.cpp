@@ -0,0 +1,196 @@
+#include <tests/lib/test.h>
+
+#include <tests/lib/glib-helpers/test-conn-helper.h>
+
+#include <tests/lib/glib/contacts-conn.h>
+
+#include <tests/benchmarks/benchmark.h>
+
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/Contact>
+#include <TelepathyQt/ContactManager>
+#include <TelepathyQt/PendingContacts>
+
+#include <telepathy-glib/debug.h>
+
+using namespace Tp;
+
+class BenchmarkContacts : public Test
+{
+    Q_OBJECT
+
+public:
+    BenchmarkContacts(QObject *parent = 0)
+        : Test(parent), mConn(0), mContactRepo(0)
+    { }
+
+protected Q_SLOTS:
+    void expectPendingContactsFinished(Tp::PendingOperation *op);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void benchmarkContactsForHandles_data();
+    void benchmarkContactsForHandles();
+    void benchmarkContactsForIdentifiers_data();
+    void benchmarkContactsForIdentifiers();
+    void benchmarkUpgradeContacts_data();
+    void benchmarkUpgradeContacts();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    QStringList identifiers(int size) const;
+    UIntList ensureHandles(int size);
+    bool waitForContacts(PendingContacts *pending);
+
+    TestConnHelper *mConn;
+    TpHandleRepoIface *mContactRepo;
+    QList<ContactPtr> mContacts;
+};
+
+void BenchmarkContacts::expectPendingContactsFinished(PendingOperation *op)
+{
+    TEST_VERIFY_OP(op);
+
+    PendingContacts *pending = qobject_cast<PendingContacts *>(op);
+    mContacts = pending->contacts();
+    mLoop->exit(0);
+}
+
+QStringList BenchmarkContacts::identifiers(int size) const
+{
+    QStringList ids;
+    for (int i = 0; i < size; ++i) {
+        ids << QString(QLatin1String("contact%1@example.com")).arg(i);
+    }
+    return ids;
+}
+
+UIntList BenchmarkContacts::ensureHandles(int size)
+{
+    UIntList handles;
+    Q_FOREACH (const QString &id, identifiers(size)) {
+        handles << tp_handle_ensure(mContactRepo, id.toLatin1().constData(), 0, 0);
+    }
+    return handles;
+}
+
+bool BenchmarkContacts::waitForContacts(PendingContacts *pending)
+{
+    connect(pending,
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(expectPendingContactsFinished(Tp::PendingOperation*)));
+    return mLoop->exec() == 0;
+}
+
+void BenchmarkContacts::initTestCase()
+{
+    initTestCaseImpl();
+
+    g_type_init();
+    g_set_prgname("benchmark-contacts");
+    tp_debug_set_flags("");
+    dbus_g_bus_get(DBUS_BUS_STARTER, 0);
+
+    mConn = new TestConnHelper(this,
+            TP_TESTS_TYPE_CONTACTS_CONNECTION,
+            "account", "me@example.com",
+            "protocol", "simple",
+            NULL);
+    QCOMPARE(mConn->connect(), true);
+
+    mContactRepo = tp_base_connection_get_handles(TP_BASE_CONNECTION(mConn->service()),
+            TP_HANDLE_TYPE_CONTACT);
+}
+
+void BenchmarkContacts::init()
+{
+    initImpl();
+}
+
+void BenchmarkContacts::benchmarkContactsForHandles_data()
+{
+    addBenchmarkSizes(QList<int>() << 10 << 100 << 1000);
+}
+
+void BenchmarkContacts::benchmarkContactsForHandles()
+{
+    QFETCH(int, size);
+
+    UIntList handles = ensureHandles(size);
+    Features features = Features() << Contact::FeatureAlias << Contact::FeatureAvatarToken <<
+        Contact::FeatureSimplePresence;
+
+    QBENCHMARK {
+        // Contacts are only cached while referenced, so every iteration builds them anew
+        mContacts.clear();
+        QVERIFY(waitForContacts(mConn->client()->contactManager()->contactsForHandles(
+                        handles, features)));
+        QCOMPARE(mContacts.size(), size);
+    }
+}
+
+void BenchmarkContacts::benchmarkContactsForIdentifiers_data()
+{
+    addBenchmarkSizes(QList<int>() << 10 << 100 << 1000);
+}
+
+void BenchmarkContacts::benchmarkContactsForIdentifiers()
+{
+    QFETCH(int, size);
+
+    QStringList ids = identifiers(size);
+    Features features = Features() << Contact::FeatureAlias << Contact::FeatureAvatarToken <<
+        Contact::FeatureSimplePresence;
+
+    QBENCHMARK {
+        mContacts.clear();
+        QVERIFY(waitForContacts(mConn->client()->contactManager()->contactsForIdentifiers(
+                        ids, features)));
+        QCOMPARE(mContacts.size(), size);
+    }
+}
+
+void BenchmarkContacts::benchmarkUpgradeContacts_data()
+{
+    addBenchmarkSizes(QList<int>() << 10 << 100 << 1000);
+}
+
+void BenchmarkContacts::benchmarkUpgradeContacts()
+{
+    QFETCH(int, size);
+
+    UIntList handles = ensureHandles(size);
+    Features features = Features() << Contact::FeatureAlias << Contact::FeatureAvatarToken <<
+        Contact::FeatureSimplePresence;
+
+    QBENCHMARK {
+        mContacts.clear();
+        QVERIFY(waitForContacts(mConn->client()->contactManager()->contactsForHandles(handles)));
+        QVERIFY(waitForContacts(mConn->client()->contactManager()->upgradeContacts(
+                        mContacts, features)));
+        QCOMPARE(mContacts.size(), size);
+    }
+}
+
+void BenchmarkContacts::cleanup()
+{
+    mContacts.clear();
+
+    cleanupImpl();
+}
+
+void BenchmarkContacts::cleanupTestCase()
+{
+    QCOMPARE(mConn->disconnect(), true);
+    delete mConn;
+
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(BenchmarkContacts)
+
+#include "_gen/contacts.cpp.moc.hpp"
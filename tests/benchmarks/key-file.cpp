@@ -0,0 +1,101 @@
+#include <QtTest/QtTest>
+
+#include <QTemporaryFile>
+#include <QTextStream>
+
+#include "TelepathyQt/key-file.h"
+
+#include <tests/benchmarks/benchmark.h>
+
+using namespace Tp;
+
+class BenchmarkKeyFile : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchmarkParse_data();
+    void benchmarkParse();
+    void benchmarkLookup_data();
+    void benchmarkLookup();
+
+private:
+    bool writeKeyFile(QTemporaryFile &file, int groups);
+};
+
+// Write a .manager-like key file with the given number of groups of 10 keys each,
+// mixing plain values, escaped values and string lists
+bool BenchmarkKeyFile::writeKeyFile(QTemporaryFile &file, int groups)
+{
+    if (!file.open()) {
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "[ConnectionManager]\n";
+    out << "Interfaces=\n\n";
+    for (int i = 0; i < groups; ++i) {
+        out << "[Protocol example" << i << "]\n";
+        out << "param-account=s required register\n";
+        out << "param-password=s required register secret\n";
+        out << "param-port=q\n";
+        out << "default-port=" << (5222 + i) << "\n";
+        out << "param-server=s\n";
+        out << "default-server=server\\s" << i << "\\t.example.com\n";
+        out << "ConnectionInterfaces=org.freedesktop.Telepathy.Connection.Interface.Aliasing;"
+            "org.freedesktop.Telepathy.Connection.Interface.Avatars;"
+            "org.freedesktop.Telepathy.Connection.Interface.SimplePresence;\n";
+        out << "VCardField=x-example" << i << "\n";
+        out << "EnglishName=Example protocol " << i << "\n";
+        out << "Icon=im-example\n\n";
+    }
+    out.flush();
+    file.close();
+    return out.status() == QTextStream::Ok;
+}
+
+void BenchmarkKeyFile::benchmarkParse_data()
+{
+    addBenchmarkSizes(QList<int>() << 10 << 100 << 1000);
+}
+
+void BenchmarkKeyFile::benchmarkParse()
+{
+    QFETCH(int, size);
+
+    QTemporaryFile file;
+    QVERIFY(writeKeyFile(file, size));
+
+    QBENCHMARK {
+        KeyFile keyFile(file.fileName());
+        QCOMPARE(keyFile.status(), KeyFile::NoError);
+    }
+}
+
+void BenchmarkKeyFile::benchmarkLookup_data()
+{
+    addBenchmarkSizes(QList<int>() << 10 << 100 << 1000);
+}
+
+void BenchmarkKeyFile::benchmarkLookup()
+{
+    QFETCH(int, size);
+
+    QTemporaryFile file;
+    QVERIFY(writeKeyFile(file, size));
+    KeyFile keyFile(file.fileName());
+    QCOMPARE(keyFile.status(), KeyFile::NoError);
+    QCOMPARE(keyFile.allGroups().size(), size + 1);
+
+    QBENCHMARK {
+        for (int i = 0; i < size; ++i) {
+            keyFile.setGroup(QString(QLatin1String("Protocol example%1")).arg(i));
+            QVERIFY(!keyFile.value(QLatin1String("default-server")).isEmpty());
+            QCOMPARE(keyFile.valueAsStringList(QLatin1String("ConnectionInterfaces")).size(), 3);
+        }
+    }
+}
+
+QTEST_MAIN(BenchmarkKeyFile)
+
+#include "_gen/key-file.cpp.moc.hpp"
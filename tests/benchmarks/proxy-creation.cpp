@@ -0,0 +1,116 @@
+#include <tests/lib/test.h>
+
+#include <tests/lib/glib-helpers/test-conn-helper.h>
+
+#include <tests/lib/glib/contacts-conn.h>
+
+#include <tests/benchmarks/benchmark.h>
+
+#include <TelepathyQt/Channel>
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/Constants>
+
+#include <telepathy-glib/debug.h>
+
+using namespace Tp;
+
+class BenchmarkProxyCreation : public Test
+{
+    Q_OBJECT
+
+public:
+    BenchmarkProxyCreation(QObject *parent = 0)
+        : Test(parent),
+          mConn(0)
+    { }
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void benchmarkCreateChannels_data();
+    void benchmarkCreateChannels();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    TestConnHelper *mConn;
+};
+
+void BenchmarkProxyCreation::initTestCase()
+{
+    initTestCaseImpl();
+
+    g_type_init();
+    g_set_prgname("benchmark-proxy-creation");
+    tp_debug_set_flags("");
+    dbus_g_bus_get(DBUS_BUS_STARTER, 0);
+
+    mConn = new TestConnHelper(this,
+            TP_TESTS_TYPE_CONTACTS_CONNECTION,
+            "account", "me@example.com",
+            "protocol", "example",
+            NULL);
+    QCOMPARE(mConn->connect(), true);
+}
+
+void BenchmarkProxyCreation::init()
+{
+    initImpl();
+}
+
+void BenchmarkProxyCreation::benchmarkCreateChannels_data()
+{
+    addBenchmarkSizes(QList<int>() << 100 << 1000 << 10000);
+}
+
+void BenchmarkProxyCreation::benchmarkCreateChannels()
+{
+    QFETCH(int, size);
+
+    // The channels don't need to exist on the service side, as constructing the proxies doesn't
+    // make any calls on them; what is measured is the per-proxy setup, including watching the
+    // connection bus name they all share
+    QStringList paths;
+    for (int i = 0; i < size; ++i) {
+        paths << QString(QLatin1String("%1/Channel%2")).arg(mConn->objectPath()).arg(i);
+    }
+
+    QVariantMap immutableProperties;
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"),
+            TP_QT_IFACE_CHANNEL_TYPE_TEXT);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+            static_cast<uint>(HandleTypeContact));
+
+    QList<ChannelPtr> channels;
+    QBENCHMARK {
+        channels.clear();
+        Q_FOREACH (const QString &path, paths) {
+            channels << Channel::create(mConn->client(), path, immutableProperties);
+        }
+    }
+
+    QCOMPARE(channels.size(), size);
+    Q_FOREACH (const ChannelPtr &channel, channels) {
+        QVERIFY(channel->isValid());
+        QCOMPARE(channel->busName(), mConn->client()->busName());
+    }
+}
+
+void BenchmarkProxyCreation::cleanup()
+{
+    cleanupImpl();
+}
+
+void BenchmarkProxyCreation::cleanupTestCase()
+{
+    QCOMPARE(mConn->disconnect(), true);
+    delete mConn;
+
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(BenchmarkProxyCreation)
+
+#include "_gen/proxy-creation.cpp.moc.hpp"
@@ -0,0 +1,234 @@
+// The legacy echo channel uses the deprecated TpTextMixin
+#define _TP_IGNORE_DEPRECATIONS
+
+#include <tests/lib/test.h>
+
+#include <tests/lib/glib-helpers/test-conn-helper.h>
+
+#include <tests/lib/glib/contacts-conn.h>
+#include <tests/lib/glib/echo/chan.h>
+#include <tests/lib/glib/echo2/chan.h>
+
+#include <tests/benchmarks/benchmark.h>
+
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/Message>
+#include <TelepathyQt/PendingReady>
+#include <TelepathyQt/ReceivedMessage>
+#include <TelepathyQt/TextChannel>
+
+#include <telepathy-glib/debug.h>
+
+using namespace Tp;
+
+class BenchmarkTextChan : public Test
+{
+    Q_OBJECT
+
+public:
+    BenchmarkTextChan(QObject *parent = 0)
+        : Test(parent),
+          mConn(0), mTextChanService(0), mMessagesChanService(0),
+          mExpectedMessages(0)
+    { }
+
+protected Q_SLOTS:
+    void onMessageReceived(const Tp::ReceivedMessage &);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void benchmarkBecomeReady_data();
+    void benchmarkBecomeReady();
+    void benchmarkMessageIntake_data();
+    void benchmarkMessageIntake();
+    void benchmarkLegacyMessageIntake_data();
+    void benchmarkLegacyMessageIntake();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    void messageIntake(const QString &channelPath, int size);
+
+    TestConnHelper *mConn;
+    TextChannelPtr mChan;
+    ExampleEchoChannel *mTextChanService;
+    QString mTextChanPath;
+    ExampleEcho2Channel *mMessagesChanService;
+    QString mMessagesChanPath;
+    QList<ReceivedMessage> mReceived;
+    int mExpectedMessages;
+};
+
+void BenchmarkTextChan::onMessageReceived(const ReceivedMessage &message)
+{
+    mReceived << message;
+    if (mReceived.size() == mExpectedMessages) {
+        mLoop->exit(0);
+    }
+}
+
+void BenchmarkTextChan::initTestCase()
+{
+    initTestCaseImpl();
+
+    g_type_init();
+    g_set_prgname("benchmark-text-chan");
+    tp_debug_set_flags("");
+    dbus_g_bus_get(DBUS_BUS_STARTER, 0);
+
+    mConn = new TestConnHelper(this,
+            TP_TESTS_TYPE_CONTACTS_CONNECTION,
+            "account", "me@example.com",
+            "protocol", "example",
+            NULL);
+    QCOMPARE(mConn->connect(), true);
+
+    TpHandleRepoIface *contactRepo = tp_base_connection_get_handles(
+            TP_BASE_CONNECTION(mConn->service()), TP_HANDLE_TYPE_CONTACT);
+    guint handle = tp_handle_ensure(contactRepo, "someone@localhost", 0, 0);
+
+    // create the channels by magic, rather than doing D-Bus round-trips for them
+    mTextChanPath = mConn->objectPath() + QLatin1String("/TextChannel");
+    QByteArray chanPath(mTextChanPath.toLatin1());
+    mTextChanService = EXAMPLE_ECHO_CHANNEL(g_object_new(
+                EXAMPLE_TYPE_ECHO_CHANNEL,
+                "connection", mConn->service(),
+                "object-path", chanPath.data(),
+                "handle", handle,
+                NULL));
+
+    mMessagesChanPath = mConn->objectPath() + QLatin1String("/MessagesChannel");
+    chanPath = mMessagesChanPath.toLatin1();
+    mMessagesChanService = EXAMPLE_ECHO_2_CHANNEL(g_object_new(
+                EXAMPLE_TYPE_ECHO_2_CHANNEL,
+                "connection", mConn->service(),
+                "object-path", chanPath.data(),
+                "handle", handle,
+                NULL));
+}
+
+void BenchmarkTextChan::init()
+{
+    initImpl();
+
+    mChan.reset();
+    mReceived.clear();
+    mExpectedMessages = 0;
+}
+
+void BenchmarkTextChan::benchmarkBecomeReady_data()
+{
+    addBenchmarkSizes(QList<int>() << 1 << 10);
+}
+
+void BenchmarkTextChan::benchmarkBecomeReady()
+{
+    QFETCH(int, size);
+
+    Features features = Features() << TextChannel::FeatureCore <<
+        TextChannel::FeatureMessageQueue << TextChannel::FeatureMessageCapabilities <<
+        TextChannel::FeatureChatState;
+
+    QBENCHMARK {
+        // Each round introspects size fresh proxies until the ReadinessHelper converges
+        for (int i = 0; i < size; ++i) {
+            TextChannelPtr chan = TextChannel::create(mConn->client(), mMessagesChanPath,
+                    QVariantMap());
+            QVERIFY(connect(chan->becomeReady(features),
+                        SIGNAL(finished(Tp::PendingOperation *)),
+                        SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+            QCOMPARE(mLoop->exec(), 0);
+            QVERIFY(chan->isReady(features));
+        }
+    }
+}
+
+void BenchmarkTextChan::messageIntake(const QString &channelPath, int size)
+{
+    mChan = TextChannel::create(mConn->client(), channelPath, QVariantMap());
+    QVERIFY(connect(mChan->becomeReady(TextChannel::FeatureMessageQueue),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    QVERIFY(connect(mChan.data(),
+                SIGNAL(messageReceived(const Tp::ReceivedMessage &)),
+                SLOT(onMessageReceived(const Tp::ReceivedMessage &))));
+
+    QBENCHMARK {
+        mReceived.clear();
+        mExpectedMessages = size;
+
+        // The echo channels send every message back, so this measures the whole round
+        // trip from send() to messageReceived(), sender contact building included
+        for (int i = 0; i < size; ++i) {
+            mChan->send(QString(QLatin1String("Message %1")).arg(i));
+        }
+        QCOMPARE(mLoop->exec(), 0);
+        QCOMPARE(mReceived.size(), size);
+
+        mChan->acknowledgeAll();
+        QCOMPARE(mChan->messageQueue().size(), 0);
+    }
+}
+
+void BenchmarkTextChan::benchmarkMessageIntake_data()
+{
+    addBenchmarkSizes(QList<int>() << 10 << 100 << 1000);
+}
+
+void BenchmarkTextChan::benchmarkMessageIntake()
+{
+    QFETCH(int, size);
+
+    messageIntake(mMessagesChanPath, size);
+}
+
+void BenchmarkTextChan::benchmarkLegacyMessageIntake_data()
+{
+    addBenchmarkSizes(QList<int>() << 10 << 100 << 1000);
+}
+
+void BenchmarkTextChan::benchmarkLegacyMessageIntake()
+{
+    QFETCH(int, size);
+
+    messageIntake(mTextChanPath, size);
+}
+
+void BenchmarkTextChan::cleanup()
+{
+    mChan.reset();
+
+    // Let the services process the acknowledgements before the next benchmark
+    while (tp_message_mixin_has_pending_messages(G_OBJECT(mMessagesChanService), 0)) {
+        QTest::qWait(1);
+    }
+
+    cleanupImpl();
+}
+
+void BenchmarkTextChan::cleanupTestCase()
+{
+    QCOMPARE(mConn->disconnect(), true);
+    delete mConn;
+
+    if (mTextChanService != 0) {
+        g_object_unref(mTextChanService);
+        mTextChanService = 0;
+    }
+
+    if (mMessagesChanService != 0) {
+        g_object_unref(mMessagesChanService);
+        mMessagesChanService = 0;
+    }
+
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(BenchmarkTextChan)
+
+#include "_gen/text-chan.cpp.moc.hpp"
@@ -43,6 +43,9 @@ protected Q_SLOTS:
     void onAccountAutomaticPresenceChanged(const Tp::Presence &);
     void onAccountRequestedPresenceChanged(const Tp::Presence &);
     void onAccountCurrentPresenceChanged(const Tp::Presence &);
+    void recordRequestedPresenceChanged(const Tp::Presence &);
+    void recordCurrentPresenceChanged(const Tp::Presence &);
+    void recordPropertyChanged(const QString &);
 
 private Q_SLOTS:
     void initTestCase();
@@ -63,6 +66,7 @@ private:
     bool mCreatingAccount;
 
     QHash<QString, QVariant> mProps;
+    QStringList mSignals;
 };
 
 #define TEST_VERIFY_PROPERTY_CHANGE(acc, Type, PropertyName, propertyName, expectedValue) \
@@ -129,6 +133,22 @@ TEST_IMPLEMENT_PROPERTY_CHANGE_SLOT(const Presence &, AutomaticPresence)
 TEST_IMPLEMENT_PROPERTY_CHANGE_SLOT(const Presence &, RequestedPresence)
 TEST_IMPLEMENT_PROPERTY_CHANGE_SLOT(const Presence &, CurrentPresence)
 
+void TestAccountBasics::recordRequestedPresenceChanged(const Tp::Presence &)
+{
+    mSignals << QLatin1String("requestedPresenceChanged");
+}
+
+void TestAccountBasics::recordCurrentPresenceChanged(const Tp::Presence &)
+{
+    mSignals << QLatin1String("currentPresenceChanged");
+    mLoop->exit(0);
+}
+
+void TestAccountBasics::recordPropertyChanged(const QString &propertyName)
+{
+    mSignals << QLatin1String("propertyChanged:") + propertyName;
+}
+
 QStringList TestAccountBasics::pathsForAccounts(const QList<AccountPtr> &list)
 {
     QStringList ret;
@@ -540,12 +560,36 @@ void TestAccountBasics::testBasics()
 
     // once the status change the capabilities will be updated
     mProps.clear();
+    mSignals.clear();
+    QVERIFY(connect(acc.data(),
+                    SIGNAL(requestedPresenceChanged(Tp::Presence)),
+                    SLOT(recordRequestedPresenceChanged(Tp::Presence))));
+    QVERIFY(connect(acc.data(),
+                    SIGNAL(currentPresenceChanged(Tp::Presence)),
+                    SLOT(recordCurrentPresenceChanged(Tp::Presence))));
+    QVERIFY(connect(acc.data(),
+                    SIGNAL(propertyChanged(QString)),
+                    SLOT(recordPropertyChanged(QString))));
     QVERIFY(connect(acc->setRequestedPresence(Presence::available()),
                     SIGNAL(finished(Tp::PendingOperation*)),
                     SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
-    while (!mProps.contains(QLatin1String("Capabilities"))) {
+    while (!mProps.contains(QLatin1String("Capabilities")) ||
+            !mSignals.contains(QLatin1String("currentPresenceChanged"))) {
         QCOMPARE(mLoop->exec(), 0);
     }
+    QVERIFY(disconnect(acc.data(), 0, this, SLOT(recordRequestedPresenceChanged(Tp::Presence))));
+    QVERIFY(disconnect(acc.data(), 0, this, SLOT(recordCurrentPresenceChanged(Tp::Presence))));
+    QVERIFY(disconnect(acc.data(), 0, this, SLOT(recordPropertyChanged(QString))));
+
+    // the changes came with others in the same AccountPropertyChanged signals, and each
+    // propertyChanged() still comes right after the typed signal for the property
+    int index = mSignals.indexOf(QLatin1String("requestedPresenceChanged"));
+    QVERIFY(index >= 0);
+    QCOMPARE(mSignals.value(index + 1), QString(QLatin1String("propertyChanged:requestedPresence")));
+    index = mSignals.indexOf(QLatin1String("currentPresenceChanged"));
+    QVERIFY(index >= 0);
+    QCOMPARE(mSignals.value(index + 1), QString(QLatin1String("propertyChanged:currentPresence")));
+    QCOMPARE(mSignals.value(index + 2), QString(QLatin1String("propertyChanged:online")));
 
     // using connection caps now
     caps = acc->capabilities();
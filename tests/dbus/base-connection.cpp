@@ -0,0 +1,722 @@
+#include <tests/lib/test.h>
+#include <tests/lib/test-thread-helper.h>
+
+#include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/BaseConnection>
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusError>
+#include <TelepathyQt/Types>
+
+using namespace Tp;
+
+class TestBaseConnectionSvc;
+typedef SharedPtr<TestBaseConnectionSvc> TestBaseConnectionSvcPtr;
+
+class TestBaseConnectionSvc : public BaseConnection
+{
+public:
+    TestBaseConnectionSvc(const QDBusConnection &dbusConnection, const QString &cmName,
+            const QString &protocolName, const QVariantMap &parameters)
+        : BaseConnection(dbusConnection, cmName, protocolName, parameters),
+          looseMatching(false),
+          matchChannelCalls(0)
+    {
+        setInspectHandlesCallback(memFun(this, &TestBaseConnectionSvc::inspectHandlesCb));
+        setCreateChannelCallback(memFun(this, &TestBaseConnectionSvc::createChannelCb));
+    }
+
+    static void createConnection(TestBaseConnectionSvcPtr &conn);
+
+    BaseConnectionContactsInterfacePtr contactsIface;
+    BaseConnectionSimplePresenceInterfacePtr presenceIface;
+    BaseConnectionContactListInterfacePtr contactListIface;
+    bool looseMatching;
+    uint matchChannelCalls;
+    // The handles and interfaces of each call to the GetContactAttributes callback
+    QList<QPair<UIntList, QStringList> > getContactAttributesCalls;
+    UIntList roster;
+    // The handles of each page requested from the GetContactListAttributes page callback
+    QList<UIntList> contactListPages;
+
+    ContactAttributesMap getContactAttributesCb(const UIntList &handles,
+            const QStringList &interfaces, DBusError *error)
+    {
+        Q_UNUSED(error);
+
+        getContactAttributesCalls.append(qMakePair(handles, interfaces));
+
+        SimplePresence offline;
+        offline.type = ConnectionPresenceTypeOffline;
+        offline.status = QLatin1String("offline");
+
+        ContactAttributesMap attributes;
+        Q_FOREACH (uint handle, handles) {
+            QVariantMap &contactAttributes = attributes[handle];
+            if (interfaces.contains(TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE)) {
+                contactAttributes.insert(TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE +
+                        QLatin1String("/presence"), QVariant::fromValue(offline));
+            }
+            if (interfaces.contains(TP_QT_IFACE_CONNECTION_INTERFACE_ALIASING)) {
+                contactAttributes.insert(TP_QT_IFACE_CONNECTION_INTERFACE_ALIASING +
+                        QLatin1String("/alias"), QString(QLatin1String("Contact %1")).arg(handle));
+            }
+        }
+        return attributes;
+    }
+
+    UIntList listContactsCb(DBusError *error)
+    {
+        Q_UNUSED(error);
+        return roster;
+    }
+
+    ContactAttributesMap getContactListAttributesPageCb(const UIntList &handles,
+            const QStringList &interfaces, DBusError *error)
+    {
+        Q_UNUSED(interfaces);
+        Q_UNUSED(error);
+
+        contactListPages.append(handles);
+        if (contactListPages.size() == 1) {
+            // The roster changes while the reply is being built
+            ContactSubscriptions subscriptions;
+            subscriptions.subscribe = SubscriptionStateYes;
+            subscriptions.publish = SubscriptionStateYes;
+            ContactSubscriptionMap changes;
+            changes.insert(6, subscriptions);
+            HandleIdentifierMap identifiers;
+            identifiers.insert(6, QLatin1String("contact6"));
+            HandleIdentifierMap removals;
+            removals.insert(5, QLatin1String("contact5"));
+
+            roster.removeOne(5);
+            roster.append(6);
+            contactListIface->contactsChangedWithID(changes, identifiers, removals);
+        }
+
+        ContactAttributesMap attributes;
+        Q_FOREACH (uint handle, handles) {
+            attributes[handle].insert(TP_QT_IFACE_CONNECTION + QLatin1String("/contact-id"),
+                    QString(QLatin1String("contact%1")).arg(handle));
+        }
+        return attributes;
+    }
+
+protected:
+    bool matchChannel(const BaseChannelPtr &channel, const QVariantMap &request,
+            DBusError *error)
+    {
+        ++matchChannelCalls;
+
+        QString targetID = request.value(
+                TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID")).toString();
+        if (looseMatching && !targetID.isEmpty()) {
+            // Like a protocol with case-insensitive IDs would do
+            return channel->targetID().toLower() == targetID.toLower();
+        }
+
+        return BaseConnection::matchChannel(channel, request, error);
+    }
+
+private:
+    QStringList inspectHandlesCb(uint handleType, const UIntList &handles, DBusError *error)
+    {
+        Q_UNUSED(handleType);
+        Q_UNUSED(error);
+
+        QStringList ids;
+        Q_FOREACH (uint handle, handles) {
+            ids << QString(QLatin1String("contact%1")).arg(handle);
+        }
+        return ids;
+    }
+
+    BaseChannelPtr createChannelCb(const QVariantMap &request, DBusError *error)
+    {
+        Q_UNUSED(error);
+
+        BaseChannelPtr channel = BaseChannel::create(this, TP_QT_IFACE_CHANNEL_TYPE_TEXT,
+                HandleTypeContact,
+                request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle")).toUInt());
+        if (request.contains(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"))) {
+            channel->setTargetID(request.value(
+                        TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID")).toString());
+        }
+        return channel;
+    }
+};
+
+void TestBaseConnectionSvc::createConnection(TestBaseConnectionSvcPtr &conn)
+{
+    conn = BaseConnection::create<TestBaseConnectionSvc>(QLatin1String("testcm"),
+            QLatin1String("example"), QVariantMap());
+
+    conn->contactsIface = BaseConnectionContactsInterface::create(conn.data());
+    conn->contactsIface->setGetContactAttributesCallback(
+            memFun(conn.data(), &TestBaseConnectionSvc::getContactAttributesCb));
+    QVERIFY(conn->plugInterface(conn->contactsIface));
+
+    conn->presenceIface = BaseConnectionSimplePresenceInterface::create();
+    QVERIFY(conn->plugInterface(conn->presenceIface));
+
+    conn->contactListIface = BaseConnectionContactListInterface::create();
+    conn->contactListIface->setListContactsCallback(
+            memFun(conn.data(), &TestBaseConnectionSvc::listContactsCb));
+    conn->contactListIface->setGetContactListAttributesPageCallback(
+            memFun(conn.data(), &TestBaseConnectionSvc::getContactListAttributesPageCb));
+    QVERIFY(conn->plugInterface(conn->contactListIface));
+
+    Tp::DBusError err;
+    QVERIFY(conn->registerObject(&err));
+    QVERIFY(!err.isValid());
+}
+
+class TestBaseConnection : public Test
+{
+    Q_OBJECT
+public:
+    TestBaseConnection(QObject *parent = 0)
+        : Test(parent)
+    { }
+
+private:
+    static QVariantMap textChannelRequest(uint targetHandle);
+    static QVariantMap textChannelRequest(const QString &targetID);
+
+    static void ensureChannelSvcSideCb(TestBaseConnectionSvcPtr &conn);
+    static void removeChannelSvcSideCb(TestBaseConnectionSvcPtr &conn);
+    static void setPresencesSvcSideCb(TestBaseConnectionSvcPtr &conn);
+    static void coalescePresencesSvcSideCb(TestBaseConnectionSvcPtr &conn);
+    static void coalescedPresencesSvcSideCb(TestBaseConnectionSvcPtr &conn);
+    static void contactAttributeCacheSvcSideCb(TestBaseConnectionSvcPtr &conn);
+    static void contactListAttributesSvcSideCb(TestBaseConnectionSvcPtr &conn);
+    static void contactListAttributesPagesSvcSideCb(TestBaseConnectionSvcPtr &conn);
+
+protected Q_SLOTS:
+    void onContactListAttributes(QDBusPendingCallWatcher *watcher);
+    void onContactsChangedWithID(const Tp::ContactSubscriptionMap &changes,
+            const Tp::HandleIdentifierMap &identifiers, const Tp::HandleIdentifierMap &removals);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void ensureChannelSvcSide();
+    void removeChannelSvcSide();
+    void setPresencesSvcSide();
+    void coalescePresencesSvcSide();
+    void contactAttributeCacheSvcSide();
+    void contactListAttributesClientSide();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    TestThreadHelper<TestBaseConnectionSvcPtr> *mThreadHelper;
+
+    static QString mConnBusName;
+    static QString mConnObjectPath;
+
+    // What the client received, in order: "reply" or "changed"
+    QStringList mContactListEvents;
+    ContactAttributesMap mContactListAttributes;
+    ContactSubscriptionMap mContactListChanges;
+    HandleIdentifierMap mContactListRemovals;
+};
+
+QString TestBaseConnection::mConnBusName;
+QString TestBaseConnection::mConnObjectPath;
+
+QVariantMap TestBaseConnection::textChannelRequest(uint targetHandle)
+{
+    QVariantMap request;
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"),
+            TP_QT_IFACE_CHANNEL_TYPE_TEXT);
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+            (uint) HandleTypeContact);
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"), targetHandle);
+    return request;
+}
+
+QVariantMap TestBaseConnection::textChannelRequest(const QString &targetID)
+{
+    QVariantMap request;
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"),
+            TP_QT_IFACE_CHANNEL_TYPE_TEXT);
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+            (uint) HandleTypeContact);
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"), targetID);
+    return request;
+}
+
+void TestBaseConnection::initTestCase()
+{
+    initTestCaseImpl();
+}
+
+void TestBaseConnection::init()
+{
+    initImpl();
+    mThreadHelper = new TestThreadHelper<TestBaseConnectionSvcPtr>();
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseConnectionSvc::createConnection);
+}
+
+void TestBaseConnection::ensureChannelSvcSideCb(TestBaseConnectionSvcPtr &conn)
+{
+    bool yours = false;
+    Tp::DBusError err;
+
+    BaseChannelPtr channel1 = conn->ensureChannel(textChannelRequest(1), yours, false, &err);
+    QVERIFY(!err.isValid());
+    QVERIFY(!channel1.isNull());
+    QVERIFY(yours);
+    QCOMPARE(channel1->targetID(), QLatin1String("contact1"));
+
+    // The same target gets the same channel
+    BaseChannelPtr channel = conn->ensureChannel(textChannelRequest(1), yours, false, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(channel, channel1);
+    QVERIFY(!yours);
+
+    channel = conn->ensureChannel(textChannelRequest(QLatin1String("contact1")), yours,
+            false, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(channel, channel1);
+    QVERIFY(!yours);
+
+    BaseChannelPtr channel2 = conn->ensureChannel(textChannelRequest(2), yours, false, &err);
+    QVERIFY(!err.isValid());
+    QVERIFY(channel2 != channel1);
+    QVERIFY(yours);
+    QCOMPARE(conn->channelsInfo().size(), 2);
+    QCOMPARE(conn->channelsDetails().size(), 2);
+
+    // By default, a reimplemented matchChannel() sees every channel of the requested type, so
+    // that it can match targets loosely
+    QVERIFY(!conn->isExactTargetMatchingEnabled());
+    conn->looseMatching = true;
+    conn->matchChannelCalls = 0;
+    channel = conn->ensureChannel(textChannelRequest(QLatin1String("CONTACT2")), yours,
+            false, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(channel, channel2);
+    QVERIFY(!yours);
+    QVERIFY(conn->matchChannelCalls > 0);
+    QCOMPARE(conn->channelsInfo().size(), 2);
+
+    // With exact target matching, only the channel with the requested target is checked
+    conn->looseMatching = false;
+    conn->setExactTargetMatchingEnabled(true);
+    QVERIFY(conn->isExactTargetMatchingEnabled());
+
+    conn->matchChannelCalls = 0;
+    channel = conn->ensureChannel(textChannelRequest(2), yours, false, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(channel, channel2);
+    QVERIFY(!yours);
+    QCOMPARE(conn->matchChannelCalls, 1U);
+
+    conn->matchChannelCalls = 0;
+    channel = conn->ensureChannel(textChannelRequest(QLatin1String("contact1")), yours,
+            false, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(channel, channel1);
+    QVERIFY(!yours);
+    QCOMPARE(conn->matchChannelCalls, 1U);
+
+    conn->matchChannelCalls = 0;
+    BaseChannelPtr channel3 = conn->ensureChannel(textChannelRequest(3), yours, false, &err);
+    QVERIFY(!err.isValid());
+    QVERIFY(yours);
+    QCOMPARE(conn->matchChannelCalls, 0U);
+    QCOMPARE(conn->channelsInfo().size(), 3);
+
+    channel1->close();
+    channel2->close();
+    channel3->close();
+    QCOMPARE(conn->channelsInfo().size(), 0);
+}
+
+void TestBaseConnection::ensureChannelSvcSide()
+{
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseConnection::ensureChannelSvcSideCb);
+}
+
+void TestBaseConnection::removeChannelSvcSideCb(TestBaseConnectionSvcPtr &conn)
+{
+    conn->setExactTargetMatchingEnabled(true);
+
+    bool yours = false;
+    Tp::DBusError err;
+    QList<BaseChannelPtr> channels;
+    for (uint handle = 1; handle <= 4; ++handle) {
+        channels << conn->ensureChannel(textChannelRequest(handle), yours, false, &err);
+        QVERIFY(!err.isValid());
+        QVERIFY(yours);
+    }
+    QCOMPARE(conn->channelsInfo().size(), 4);
+
+    // Remove one from the middle of the Channels property and one from its end
+    channels[1]->close();
+    channels[3]->close();
+
+    ChannelInfoList info = conn->channelsInfo();
+    ChannelDetailsList details = conn->channelsDetails();
+    QCOMPARE(info.size(), 2);
+    QCOMPARE(details.size(), 2);
+
+    QSet<QString> paths;
+    for (int i = 0; i < info.size(); ++i) {
+        QCOMPARE(info[i].channel.path(), details[i].channel.path());
+        paths << info[i].channel.path();
+    }
+    QCOMPARE(paths, QSet<QString>() << channels[0]->objectPath() << channels[2]->objectPath());
+
+    // The closed channels are not reused, the remaining ones still are
+    BaseChannelPtr channel = conn->ensureChannel(textChannelRequest(2), yours, false, &err);
+    QVERIFY(!err.isValid());
+    QVERIFY(yours);
+    QVERIFY(channel != channels[1]);
+    channels[1] = channel;
+
+    channel = conn->ensureChannel(textChannelRequest(QLatin1String("contact4")), yours,
+            false, &err);
+    QVERIFY(!err.isValid());
+    QVERIFY(yours);
+    QVERIFY(channel != channels[3]);
+    channels[3] = channel;
+
+    channel = conn->ensureChannel(textChannelRequest(3), yours, false, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(channel, channels[2]);
+    QVERIFY(!yours);
+    QCOMPARE(conn->channelsInfo().size(), 4);
+
+    Q_FOREACH (const BaseChannelPtr &channel, channels) {
+        channel->close();
+    }
+    QCOMPARE(conn->channelsInfo().size(), 0);
+    QCOMPARE(conn->channelsDetails().size(), 0);
+}
+
+void TestBaseConnection::removeChannelSvcSide()
+{
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseConnection::removeChannelSvcSideCb);
+}
+
+static SimplePresence makePresence(ConnectionPresenceType type, const char *status)
+{
+    SimplePresence presence;
+    presence.type = type;
+    presence.status = QLatin1String(status);
+    return presence;
+}
+
+void TestBaseConnection::setPresencesSvcSideCb(TestBaseConnectionSvcPtr &conn)
+{
+    BaseConnectionSimplePresenceInterfacePtr iface = conn->presenceIface;
+    SimplePresence available = makePresence(ConnectionPresenceTypeAvailable, "available");
+    SimplePresence away = makePresence(ConnectionPresenceTypeAway, "away");
+    SimplePresence busy = makePresence(ConnectionPresenceTypeBusy, "busy");
+
+    SimpleContactPresences presences;
+    presences.insert(1, available);
+    presences.insert(2, away);
+    iface->setPresences(presences);
+    QCOMPARE(iface->emittedPresenceUpdates(), 2ULL);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 0ULL);
+
+    // Only the contact whose presence changed is signalled
+    presences.insert(2, busy);
+    iface->setPresences(presences);
+    QCOMPARE(iface->emittedPresenceUpdates(), 3ULL);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 1ULL);
+
+    SimpleContactPresences current = iface->getPresences(UIntList() << 1 << 2 << 3);
+    QCOMPARE(current.value(1), available);
+    QCOMPARE(current.value(2), busy);
+    QCOMPARE(current.value(3).type, (uint) ConnectionPresenceTypeUnknown);
+
+    // While coalescing, a change which is reverted before being signalled counts once
+    iface->setPresenceCoalescingInterval(60000);
+    SimpleContactPresences change;
+    change.insert(1, away);
+    iface->setPresences(change);
+    QCOMPARE(iface->emittedPresenceUpdates(), 3ULL);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 1ULL);
+    QCOMPARE(iface->getPresences(UIntList() << 1).value(1), away);
+
+    change.insert(1, available);
+    iface->setPresences(change);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 2ULL);
+    QCOMPARE(iface->getPresences(UIntList() << 1).value(1), available);
+
+    iface->flushPresences();
+    QCOMPARE(iface->emittedPresenceUpdates(), 3ULL);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 2ULL);
+
+    // A superseded change is not signalled either, the latest one is
+    change.insert(1, away);
+    iface->setPresences(change);
+    change.insert(1, busy);
+    iface->setPresences(change);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 3ULL);
+    QCOMPARE(iface->emittedPresenceUpdates(), 3ULL);
+
+    iface->flushPresences();
+    QCOMPARE(iface->emittedPresenceUpdates(), 4ULL);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 3ULL);
+    QCOMPARE(iface->getPresences(UIntList() << 1).value(1), busy);
+
+    // Setting the same presence again while coalescing is not a change
+    iface->setPresences(change);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 4ULL);
+    iface->flushPresences();
+    QCOMPARE(iface->emittedPresenceUpdates(), 4ULL);
+
+    // Reaching the maximum batch size signals straight away
+    iface->setMaximumPresenceBatchSize(2);
+    change.clear();
+    change.insert(3, available);
+    iface->setPresences(change);
+    QCOMPARE(iface->emittedPresenceUpdates(), 4ULL);
+    change.clear();
+    change.insert(4, available);
+    iface->setPresences(change);
+    QCOMPARE(iface->emittedPresenceUpdates(), 6ULL);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 4ULL);
+
+    iface->setPresenceCoalescingInterval(0);
+    iface->setMaximumPresenceBatchSize(0);
+}
+
+void TestBaseConnection::setPresencesSvcSide()
+{
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseConnection::setPresencesSvcSideCb);
+}
+
+void TestBaseConnection::coalescePresencesSvcSideCb(TestBaseConnectionSvcPtr &conn)
+{
+    BaseConnectionSimplePresenceInterfacePtr iface = conn->presenceIface;
+    iface->setPresenceCoalescingInterval(50);
+
+    SimpleContactPresences change;
+    change.insert(1, makePresence(ConnectionPresenceTypeAway, "away"));
+    iface->setPresences(change);
+    change.insert(2, makePresence(ConnectionPresenceTypeBusy, "busy"));
+    iface->setPresences(change);
+
+    QCOMPARE(iface->emittedPresenceUpdates(), 0ULL);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 1ULL);
+}
+
+void TestBaseConnection::coalescedPresencesSvcSideCb(TestBaseConnectionSvcPtr &conn)
+{
+    // Both contacts were signalled together once the interval expired
+    BaseConnectionSimplePresenceInterfacePtr iface = conn->presenceIface;
+    QCOMPARE(iface->emittedPresenceUpdates(), 2ULL);
+    QCOMPARE(iface->suppressedPresenceUpdates(), 1ULL);
+}
+
+void TestBaseConnection::coalescePresencesSvcSide()
+{
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseConnection::coalescePresencesSvcSideCb);
+
+    QTest::qWait(200);
+
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseConnection::coalescedPresencesSvcSideCb);
+}
+
+void TestBaseConnection::contactAttributeCacheSvcSideCb(TestBaseConnectionSvcPtr &conn)
+{
+    static const QString keyPresence(TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE +
+            QLatin1String("/presence"));
+    static const QString keyAlias(TP_QT_IFACE_CONNECTION_INTERFACE_ALIASING +
+            QLatin1String("/alias"));
+    const QStringList presence = QStringList() << TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE;
+    const QStringList aliasing = QStringList() << TP_QT_IFACE_CONNECTION_INTERFACE_ALIASING;
+
+    BaseConnectionContactsInterfacePtr contactsIface = conn->contactsIface;
+    contactsIface->setContactAttributeCacheEnabled(true);
+
+    Tp::DBusError err;
+    ContactAttributesMap attributes = contactsIface->getContactAttributes(
+            UIntList() << 1 << 2, presence, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(conn->getContactAttributesCalls.size(), 1);
+    QCOMPARE(conn->getContactAttributesCalls.last().first, UIntList() << 1 << 2);
+    QCOMPARE(conn->getContactAttributesCalls.last().second, presence);
+    QCOMPARE(qdbus_cast<SimplePresence>(attributes[1].value(keyPresence)).status,
+            QLatin1String("offline"));
+
+    // Answered from the cache
+    attributes = contactsIface->getContactAttributes(UIntList() << 1 << 2, presence, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(conn->getContactAttributesCalls.size(), 1);
+    QCOMPARE(qdbus_cast<SimplePresence>(attributes[2].value(keyPresence)).status,
+            QLatin1String("offline"));
+
+    // Presences set on the connection update the cache, even while they are being coalesced
+    SimplePresence available;
+    available.type = ConnectionPresenceTypeAvailable;
+    available.status = QLatin1String("available");
+    SimplePresence away;
+    away.type = ConnectionPresenceTypeAway;
+    away.status = QLatin1String("away");
+
+    SimpleContactPresences change;
+    change.insert(1, available);
+    conn->presenceIface->setPresences(change);
+
+    conn->presenceIface->setPresenceCoalescingInterval(60000);
+    change.clear();
+    change.insert(2, away);
+    conn->presenceIface->setPresences(change);
+
+    attributes = contactsIface->getContactAttributes(UIntList() << 1 << 2, presence, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(conn->getContactAttributesCalls.size(), 1);
+    QCOMPARE(qdbus_cast<SimplePresence>(attributes[1].value(keyPresence)), available);
+    QCOMPARE(qdbus_cast<SimplePresence>(attributes[2].value(keyPresence)), away);
+    conn->presenceIface->setPresenceCoalescingInterval(0);
+
+    // Only the missing contacts are fetched...
+    contactsIface->invalidateCachedContactAttributes(UIntList() << 2, presence.first());
+    attributes = contactsIface->getContactAttributes(UIntList() << 1 << 2, presence, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(conn->getContactAttributesCalls.size(), 2);
+    QCOMPARE(conn->getContactAttributesCalls.last().first, UIntList() << 2);
+    QCOMPARE(conn->getContactAttributesCalls.last().second, presence);
+    QCOMPARE(qdbus_cast<SimplePresence>(attributes[1].value(keyPresence)), available);
+
+    // ...for the missing interfaces only
+    attributes = contactsIface->getContactAttributes(UIntList() << 1 << 2,
+            presence + aliasing, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(conn->getContactAttributesCalls.size(), 3);
+    QCOMPARE(conn->getContactAttributesCalls.last().first, UIntList() << 1 << 2);
+    QCOMPARE(conn->getContactAttributesCalls.last().second, aliasing);
+    QCOMPARE(attributes[1].value(keyAlias).toString(), QLatin1String("Contact 1"));
+    QCOMPARE(qdbus_cast<SimplePresence>(attributes[1].value(keyPresence)), available);
+
+    // Contacts missing different interfaces are fetched separately
+    contactsIface->invalidateCachedContactAttributes(UIntList() << 1, presence.first());
+    attributes = contactsIface->getContactAttributes(UIntList() << 1 << 2 << 3,
+            presence + aliasing, &err);
+    QVERIFY(!err.isValid());
+    QCOMPARE(conn->getContactAttributesCalls.size(), 5);
+    QCOMPARE(conn->getContactAttributesCalls.at(3).first, UIntList() << 1);
+    QCOMPARE(conn->getContactAttributesCalls.at(3).second, presence);
+    QCOMPARE(conn->getContactAttributesCalls.at(4).first, UIntList() << 3);
+    QCOMPARE(conn->getContactAttributesCalls.at(4).second, presence + aliasing);
+    QCOMPARE(attributes.size(), 3);
+    QCOMPARE(attributes[3].value(keyAlias).toString(), QLatin1String("Contact 3"));
+    QCOMPARE(attributes[2].value(keyAlias).toString(), QLatin1String("Contact 2"));
+}
+
+void TestBaseConnection::contactAttributeCacheSvcSide()
+{
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseConnection::contactAttributeCacheSvcSideCb);
+}
+
+void TestBaseConnection::onContactListAttributes(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<ContactAttributesMap> reply = *watcher;
+    watcher->deleteLater();
+    if (reply.isError()) {
+        qWarning().nospace() << reply.error().name() << ": " << reply.error().message();
+        mLoop->exit(1);
+        return;
+    }
+
+    mContactListEvents << QLatin1String("reply");
+    mContactListAttributes = reply.value();
+    mLoop->exit(0);
+}
+
+void TestBaseConnection::onContactsChangedWithID(const Tp::ContactSubscriptionMap &changes,
+        const Tp::HandleIdentifierMap &identifiers, const Tp::HandleIdentifierMap &removals)
+{
+    Q_UNUSED(identifiers);
+
+    mContactListEvents << QLatin1String("changed");
+    mContactListChanges = changes;
+    mContactListRemovals = removals;
+    mLoop->exit(0);
+}
+
+void TestBaseConnection::contactListAttributesSvcSideCb(TestBaseConnectionSvcPtr &conn)
+{
+    mConnBusName = conn->busName();
+    mConnObjectPath = conn->objectPath();
+
+    conn->roster = UIntList() << 1 << 2 << 3 << 4 << 5;
+    conn->contactListIface->setContactListPageSize(2);
+}
+
+void TestBaseConnection::contactListAttributesPagesSvcSideCb(TestBaseConnectionSvcPtr &conn)
+{
+    // The whole snapshot was fetched, in pages of two contacts
+    QCOMPARE(conn->contactListPages.size(), 3);
+    QCOMPARE(conn->contactListPages.at(0), UIntList() << 1 << 2);
+    QCOMPARE(conn->contactListPages.at(1), UIntList() << 3 << 4);
+    QCOMPARE(conn->contactListPages.at(2), UIntList() << 5);
+}
+
+void TestBaseConnection::contactListAttributesClientSide()
+{
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseConnection::contactListAttributesSvcSideCb);
+
+    Client::ConnectionInterfaceContactListInterface iface(mConnBusName, mConnObjectPath);
+    QVERIFY(connect(&iface,
+                SIGNAL(ContactsChangedWithID(Tp::ContactSubscriptionMap,Tp::HandleIdentifierMap,Tp::HandleIdentifierMap)),
+                SLOT(onContactsChangedWithID(Tp::ContactSubscriptionMap,Tp::HandleIdentifierMap,Tp::HandleIdentifierMap))));
+
+    mContactListEvents.clear();
+    QVERIFY(connect(new QDBusPendingCallWatcher(
+                    iface.GetContactListAttributes(QStringList(), false), this),
+                SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(onContactListAttributes(QDBusPendingCallWatcher*))));
+    while (mContactListEvents.size() < 2) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+
+    // The roster changed while the reply was being built: the reply describes the roster as it
+    // was when the call was made, and the change is only signalled after it
+    QCOMPARE(mContactListEvents, QStringList() << QLatin1String("reply") <<
+            QLatin1String("changed"));
+    QCOMPARE(mContactListAttributes.keys(), QList<uint>() << 1 << 2 << 3 << 4 << 5);
+    QCOMPARE(mContactListAttributes.value(5).value(
+                TP_QT_IFACE_CONNECTION + QLatin1String("/contact-id")).toString(),
+            QLatin1String("contact5"));
+    QCOMPARE(mContactListChanges.keys(), QList<uint>() << 6);
+    QCOMPARE(mContactListRemovals.keys(), QList<uint>() << 5);
+
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper,
+            &TestBaseConnection::contactListAttributesPagesSvcSideCb);
+
+    // A later call sees the change
+    mContactListEvents.clear();
+    QVERIFY(connect(new QDBusPendingCallWatcher(
+                    iface.GetContactListAttributes(QStringList(), false), this),
+                SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(onContactListAttributes(QDBusPendingCallWatcher*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mContactListEvents, QStringList() << QLatin1String("reply"));
+    QCOMPARE(mContactListAttributes.keys(), QList<uint>() << 1 << 2 << 3 << 4 << 6);
+}
+
+void TestBaseConnection::cleanup()
+{
+    delete mThreadHelper;
+    cleanupImpl();
+}
+
+void TestBaseConnection::cleanupTestCase()
+{
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(TestBaseConnection)
+#include "_gen/base-connection.cpp.moc.hpp"
@@ -25,6 +25,7 @@ class TestChanGroup : public Test
 public:
     TestChanGroup(QObject *parent = 0)
         : Test(parent), mConn(0), mChanService(0),
+          mGroupMembersChangedCount(0),
           mGotGroupFlagsChanged(false),
           mGroupFlags((ChannelGroupFlags) 0),
           mGroupFlagsAdded((ChannelGroupFlags) 0),
@@ -51,6 +52,7 @@ private Q_SLOTS:
     void testLeave();
     void testLeaveWithFallback();
     void testGroupFlagsChange();
+    void testCoalescedMembersChanged();
 
     void cleanup();
     void cleanupTestCase();
@@ -70,6 +72,7 @@ private:
     Contacts mChangedRP;
     Contacts mChangedRemoved;
     Channel::GroupMemberChangeDetails mDetails;
+    int mGroupMembersChangedCount;
     UIntList mInitialMembers;
     bool mGotGroupFlagsChanged;
     ChannelGroupFlags mGroupFlags;
@@ -90,6 +93,7 @@ void TestChanGroup::onGroupMembersChanged(
     mChangedRP = groupRemotePendingMembersAdded;
     mChangedRemoved = groupMembersRemoved;
     mDetails = details;
+    mGroupMembersChangedCount++;
     debugContacts();
     mLoop->exit(0);
 }
@@ -157,6 +161,7 @@ void TestChanGroup::init()
     mChangedRP.clear();
     mChangedRemoved.clear();
     mDetails = Channel::GroupMemberChangeDetails();
+    mGroupMembersChangedCount = 0;
     mGotGroupFlagsChanged = false;
     mGroupFlags = (ChannelGroupFlags) 0;
     mGroupFlagsAdded = (ChannelGroupFlags) 0;
@@ -484,6 +489,156 @@ void TestChanGroup::testGroupFlagsChange()
     QCOMPARE(mGroupFlagsRemoved, (ChannelGroupFlags) 0);
 }
 
+void TestChanGroup::testCoalescedMembersChanged()
+{
+    mChanObjectPath = QString(QLatin1String("%1/ChannelForTpQtCoalescingTest"))
+        .arg(mConn->objectPath());
+    QByteArray chanPathLatin1(mChanObjectPath.toLatin1());
+
+    mChanService = TP_TESTS_TEXT_CHANNEL_GROUP(g_object_new(
+                TP_TESTS_TYPE_TEXT_CHANNEL_GROUP,
+                "connection", mConn->service(),
+                "object-path", chanPathLatin1.data(),
+                "detailed", TRUE,
+                "properties", TRUE,
+                NULL));
+    QVERIFY(mChanService != 0);
+
+    mChan = Channel::create(mConn->client(), mChanObjectPath, QVariantMap());
+    QVERIFY(mChan);
+    QCOMPARE(mChan->groupCoalescesMembersChanged(), false);
+    mChan->setGroupCoalescesMembersChanged(true);
+    QCOMPARE(mChan->groupCoalescesMembersChanged(), true);
+
+    QVERIFY(connect(mChan->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mChan->isReady(), true);
+
+    QVERIFY(connect(mChan.data(),
+                    SIGNAL(groupMembersChanged(
+                            const Tp::Contacts &,
+                            const Tp::Contacts &,
+                            const Tp::Contacts &,
+                            const Tp::Contacts &,
+                            const Tp::Channel::GroupMemberChangeDetails &)),
+                    SLOT(onGroupMembersChanged(
+                            const Tp::Contacts &,
+                            const Tp::Contacts &,
+                            const Tp::Contacts &,
+                            const Tp::Contacts &,
+                            const Tp::Channel::GroupMemberChangeDetails &))));
+
+    TpHandleRepoIface *contactRepo = tp_base_connection_get_handles(
+            TP_BASE_CONNECTION(mConn->service()),
+            TP_HANDLE_TYPE_CONTACT);
+    QStringList ids;
+    ids << QLatin1String("alice@example.com") << QLatin1String("bob@example.com") <<
+        QLatin1String("carol@example.com") << QLatin1String("dave@example.com");
+    UIntList handles;
+    Q_FOREACH (const QString &id, ids) {
+        handles << tp_handle_ensure(contactRepo, id.toLatin1().constData(), 0, 0);
+    }
+
+    // Announce the members one by one, as a chat room would do on join, with bob leaving again
+    // before we had the chance to build his contact
+    for (int i = 0; i < handles.size(); ++i) {
+        TpIntSet *add = tp_intset_new_containing(handles[i]);
+        QVERIFY(tp_group_mixin_change_members(G_OBJECT(mChanService), "joined",
+                    add, NULL, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE));
+        tp_intset_destroy(add);
+    }
+    TpIntSet *remove = tp_intset_new_containing(handles[1]);
+    QVERIFY(tp_group_mixin_change_members(G_OBJECT(mChanService), "joined",
+                NULL, remove, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE));
+    tp_intset_destroy(remove);
+
+    UIntList memberHandles;
+    while (memberHandles.size() != 3) {
+        QCOMPARE(mLoop->exec(), 0);
+        memberHandles.clear();
+        Q_FOREACH (const ContactPtr &contact, mChan->groupContacts()) {
+            if (handles.contains(contact->handle()[0])) {
+                memberHandles << contact->handle()[0];
+            }
+        }
+    }
+
+    QVERIFY(memberHandles.contains(handles[0]));
+    QVERIFY(!memberHandles.contains(handles[1]));
+    QVERIFY(memberHandles.contains(handles[2]));
+    QVERIFY(memberHandles.contains(handles[3]));
+
+    // Everything queued while the first change was being processed is signalled at once
+    QVERIFY(mGroupMembersChangedCount < 5);
+    QVERIFY(mChangedRemoved.isEmpty());
+    QCOMPARE(mDetails.message(), QLatin1String("joined"));
+
+    // Changes with different details are not folded together
+    mGroupMembersChangedCount = 0;
+    remove = tp_intset_new_containing(handles[0]);
+    QVERIFY(tp_group_mixin_change_members(G_OBJECT(mChanService), "kicked",
+                NULL, remove, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_KICKED));
+    tp_intset_destroy(remove);
+    remove = tp_intset_new_containing(handles[2]);
+    QVERIFY(tp_group_mixin_change_members(G_OBJECT(mChanService), "left",
+                NULL, remove, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE));
+    tp_intset_destroy(remove);
+
+    while (mGroupMembersChangedCount < 2) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    QCOMPARE(mGroupMembersChangedCount, 2);
+    QCOMPARE(mChangedRemoved.size(), 1);
+    QCOMPARE(mChangedRemoved.toList().first()->handle()[0], handles[2]);
+    QCOMPARE(mDetails.message(), QLatin1String("left"));
+
+    // A member who leaves and comes back while the changes are being folded isn't reported at
+    // all: erin's contact is being built while dave's changes and frank's arrival are queued
+    uint erin = tp_handle_ensure(contactRepo, "erin@example.com", 0, 0);
+    uint frank = tp_handle_ensure(contactRepo, "frank@example.com", 0, 0);
+    TpIntSet *add = tp_intset_new_containing(erin);
+    QVERIFY(tp_group_mixin_change_members(G_OBJECT(mChanService), "rejoined",
+                add, NULL, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE));
+    tp_intset_destroy(add);
+    remove = tp_intset_new_containing(handles[3]);
+    QVERIFY(tp_group_mixin_change_members(G_OBJECT(mChanService), "rejoined",
+                NULL, remove, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE));
+    tp_intset_destroy(remove);
+    add = tp_intset_new_containing(handles[3]);
+    QVERIFY(tp_group_mixin_change_members(G_OBJECT(mChanService), "rejoined",
+                add, NULL, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE));
+    tp_intset_destroy(add);
+    add = tp_intset_new_containing(frank);
+    QVERIFY(tp_group_mixin_change_members(G_OBJECT(mChanService), "rejoined",
+                add, NULL, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE));
+    tp_intset_destroy(add);
+
+    bool haveFrank = false;
+    bool daveReported = false;
+    while (!haveFrank) {
+        QCOMPARE(mLoop->exec(), 0);
+        Q_FOREACH (const ContactPtr &contact, mChangedCurrent) {
+            daveReported |= contact->handle()[0] == handles[3];
+        }
+        Q_FOREACH (const ContactPtr &contact, mChangedRemoved) {
+            daveReported |= contact->handle()[0] == handles[3];
+        }
+        Q_FOREACH (const ContactPtr &contact, mChan->groupContacts()) {
+            haveFrank |= contact->handle()[0] == frank;
+        }
+    }
+
+    QVERIFY(!daveReported);
+    memberHandles.clear();
+    Q_FOREACH (const ContactPtr &contact, mChan->groupContacts()) {
+        memberHandles << contact->handle()[0];
+    }
+    QVERIFY(memberHandles.contains(handles[3]));
+    QVERIFY(memberHandles.contains(erin));
+}
+
 void TestChanGroup::cleanup()
 {
     if (mChanService) {
@@ -0,0 +1,382 @@
+#include <QtCore/QDebug>
+
+#include <QtDBus/QtDBus>
+
+#include <QtTest/QtTest>
+
+#include <TelepathyQt/CallChannel>
+#include <TelepathyQt/Channel>
+#include <TelepathyQt/ChannelFactory>
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/ContactFactory>
+#include <TelepathyQt/DBusCallScheduler>
+#include <TelepathyQt/DBusTubeChannel>
+#include <TelepathyQt/PendingReady>
+
+#include <telepathy-glib/base-connection.h>
+#include <telepathy-glib/dbus.h>
+#include <telepathy-glib/debug.h>
+#include <telepathy-glib/group-mixin.h>
+
+#include <tests/lib/glib/bug16307-conn.h>
+#include <tests/lib/glib/textchan-group.h>
+#include <tests/lib/test.h>
+
+using namespace Tp;
+
+class TestChanPrefetch : public Test
+{
+    Q_OBJECT
+
+public:
+    TestChanPrefetch(QObject *parent = 0)
+        : Test(parent), mConnService(0), mChanService(0), mGroupFlagsChanged(0)
+    { }
+
+protected Q_SLOTS:
+    void expectConnInvalidated();
+    void onGroupFlagsChanged(uint added, uint removed);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void testPrefetch();
+    void testPrefetchChangedSince();
+    void testPrefetchError();
+    void testPrefetchTypeProperties();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    void createChannelService();
+    PendingReady *channelFromFactory(bool completeImmutableProperties);
+    QVariantMap contactChannelProperties(const QString &channelType) const;
+    void waitForPrefetches();
+    DBusCallScheduler::Statistics statistics(DBusCallScheduler::Priority priority) const;
+
+    TpTestsBug16307Connection *mConnService;
+    ConnectionPtr mConn;
+    ChannelFactoryPtr mChanFactory;
+    TpTestsTextChannelGroup *mChanService;
+    QString mChanObjectPath;
+    ChannelPtr mChan;
+    int mGroupFlagsChanged;
+};
+
+void TestChanPrefetch::expectConnInvalidated()
+{
+    mLoop->exit(0);
+}
+
+void TestChanPrefetch::onGroupFlagsChanged(uint added, uint removed)
+{
+    qDebug() << "group flags changed, added:" << added << "removed:" << removed;
+    mGroupFlagsChanged++;
+    mLoop->exit(0);
+}
+
+void TestChanPrefetch::createChannelService()
+{
+    QByteArray chanPath(mChanObjectPath.toLatin1());
+    mChanService = TP_TESTS_TEXT_CHANNEL_GROUP(g_object_new(
+                TP_TESTS_TYPE_TEXT_CHANNEL_GROUP,
+                "connection", mConnService,
+                "object-path", chanPath.data(),
+                "detailed", TRUE,
+                "properties", TRUE,
+                NULL));
+}
+
+PendingReady *TestChanPrefetch::channelFromFactory(bool completeImmutableProperties)
+{
+    QVariantMap immutableProperties;
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"),
+            TP_QT_IFACE_CHANNEL_TYPE_TEXT);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".Interfaces"),
+            QStringList() << TP_QT_IFACE_CHANNEL_INTERFACE_GROUP);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+            (uint) HandleTypeNone);
+    if (completeImmutableProperties) {
+        immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"),
+                (uint) 0);
+        immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"),
+                QString());
+        immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".Requested"), true);
+        immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".InitiatorHandle"),
+                TP_BASE_CONNECTION(mConnService)->self_handle);
+        immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".InitiatorID"),
+                QLatin1String("me@example.com"));
+    }
+
+    PendingReady *pr = mChanFactory->proxy(mConn, mChanObjectPath, immutableProperties);
+    mChan = ChannelPtr::qObjectCast(pr->proxy());
+    return pr;
+}
+
+QVariantMap TestChanPrefetch::contactChannelProperties(const QString &channelType) const
+{
+    uint selfHandle = TP_BASE_CONNECTION(mConnService)->self_handle;
+    QVariantMap immutableProperties;
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"), channelType);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".Interfaces"),
+            QStringList());
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+            (uint) HandleTypeContact);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"), selfHandle);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"),
+            QLatin1String("me@example.com"));
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".Requested"), true);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".InitiatorHandle"),
+            selfHandle);
+    immutableProperties.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".InitiatorID"),
+            QLatin1String("me@example.com"));
+    return immutableProperties;
+}
+
+void TestChanPrefetch::waitForPrefetches()
+{
+    while (statistics(DBusCallScheduler::PriorityBackground).inFlight > 0) {
+        mLoop->processEvents();
+    }
+}
+
+DBusCallScheduler::Statistics TestChanPrefetch::statistics(
+        DBusCallScheduler::Priority priority) const
+{
+    return DBusCallScheduler::statistics(QDBusConnection::sessionBus(), priority);
+}
+
+void TestChanPrefetch::initTestCase()
+{
+    initTestCaseImpl();
+
+    g_type_init();
+    g_set_prgname("chan-prefetch");
+    tp_debug_set_flags("all");
+    dbus_g_bus_get(DBUS_BUS_STARTER, 0);
+}
+
+void TestChanPrefetch::init()
+{
+    initImpl();
+
+    gchar *name;
+    gchar *connPath;
+    GError *error = 0;
+
+    // The Connection is only ready once the test lets GetStatus return, and channels only start
+    // their own introspection after that, so what happens to the prefetched calls in between can be
+    // controlled
+    mConnService = TP_TESTS_BUG16307_CONNECTION(g_object_new(
+                TP_TESTS_TYPE_BUG16307_CONNECTION,
+                "account", "me@example.com",
+                "protocol", "simple",
+                NULL));
+    QVERIFY(mConnService != 0);
+    tp_tests_simple_connection_set_identifier(TP_TESTS_SIMPLE_CONNECTION(mConnService),
+            "me@example.com");
+
+    QVERIFY(tp_base_connection_register(TP_BASE_CONNECTION(mConnService), "simple",
+                &name, &connPath, &error));
+    QVERIFY(error == 0);
+
+    mChanFactory = ChannelFactory::create(QDBusConnection::sessionBus());
+    mChanFactory->addCommonFeatures(Channel::FeatureCore);
+    mConn = Connection::create(QLatin1String(name), QLatin1String(connPath),
+            mChanFactory, ContactFactory::create());
+    QCOMPARE(mConn->isReady(), false);
+
+    mChanObjectPath = QString(QLatin1String("%1/GroupChannel")).arg(QLatin1String(connPath));
+
+    g_free(name);
+    g_free(connPath);
+
+    // The Connection's own Properties::GetAll goes through the scheduler too, so get it out of
+    // the way before counting the channels' calls
+    mConn->becomeReady();
+    while (statistics(DBusCallScheduler::PriorityInteractive).issued == 0) {
+        mLoop->processEvents();
+    }
+
+    mGroupFlagsChanged = 0;
+    DBusCallScheduler::resetStatistics(QDBusConnection::sessionBus());
+}
+
+void TestChanPrefetch::testPrefetch()
+{
+    createChannelService();
+
+    // All of the interfaces introspected by FeatureCore are fetched straight away, even though the
+    // Connection isn't ready yet
+    PendingReady *pr = channelFromFactory(false);
+    QVERIFY(connect(pr,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(statistics(DBusCallScheduler::PriorityBackground).issued, 2U);
+    waitForPrefetches();
+    QVERIFY(!mChan->isReady());
+
+    tp_tests_bug16307_connection_inject_get_status_return(mConnService);
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(mChan->isReady());
+
+    // The introspection used the prefetched replies rather than calling GetAll again
+    QCOMPARE(statistics(DBusCallScheduler::PriorityBackground).issued, 2U);
+    QCOMPARE(statistics(DBusCallScheduler::PriorityInteractive).issued, 0U);
+
+    QCOMPARE(mChan->channelType(), TP_QT_IFACE_CHANNEL_TYPE_TEXT);
+    QCOMPARE(mChan->isRequested(), true);
+    QVERIFY(mChan->interfaces().contains(TP_QT_IFACE_CHANNEL_INTERFACE_GROUP));
+    QCOMPARE(mChan->groupCanAddContacts(), false);
+}
+
+void TestChanPrefetch::testPrefetchChangedSince()
+{
+    createChannelService();
+
+    // The immutable properties are complete, so only the Group properties are prefetched
+    PendingReady *pr = channelFromFactory(true);
+    QCOMPARE(statistics(DBusCallScheduler::PriorityBackground).issued, 1U);
+    waitForPrefetches();
+
+    // A change signalled after the prefetched reply makes the reply stale
+    QVERIFY(QDBusConnection::sessionBus().connect(mConn->busName(), mChanObjectPath,
+                TP_QT_IFACE_CHANNEL_INTERFACE_GROUP, QLatin1String("GroupFlagsChanged"),
+                this, SLOT(onGroupFlagsChanged(uint,uint))));
+    tp_group_mixin_change_flags(G_OBJECT(mChanService), TP_CHANNEL_GROUP_FLAG_CAN_ADD, 0);
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mGroupFlagsChanged, 1);
+    QVERIFY(!mChan->isReady());
+
+    QVERIFY(connect(pr,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    tp_tests_bug16307_connection_inject_get_status_return(mConnService);
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(mChan->isReady());
+
+    // So the introspection made a fresh call, and sees the change
+    QCOMPARE(statistics(DBusCallScheduler::PriorityInteractive).issued, 1U);
+    QCOMPARE(mChan->groupCanAddContacts(), true);
+
+    QDBusConnection::sessionBus().disconnect(mConn->busName(), mChanObjectPath,
+            TP_QT_IFACE_CHANNEL_INTERFACE_GROUP, QLatin1String("GroupFlagsChanged"),
+            this, SLOT(onGroupFlagsChanged(uint,uint)));
+}
+
+void TestChanPrefetch::testPrefetchError()
+{
+    // The channel isn't on the bus yet, so the prefetched call fails
+    PendingReady *pr = channelFromFactory(true);
+    QVERIFY(connect(pr,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(statistics(DBusCallScheduler::PriorityBackground).issued, 1U);
+    waitForPrefetches();
+
+    createChannelService();
+
+    tp_tests_bug16307_connection_inject_get_status_return(mConnService);
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(mChan->isReady());
+
+    // The error wasn't handed to the introspection, which made its own call instead
+    QCOMPARE(statistics(DBusCallScheduler::PriorityInteractive).issued, 1U);
+    QCOMPARE(mChan->groupCanAddContacts(), false);
+}
+
+void TestChanPrefetch::testPrefetchTypeProperties()
+{
+    // DBusTubeChannel and CallChannel only ask for the properties of their type when the immutable
+    // properties don't have the ones they need, so they're prefetched in that case only
+    QVariantMap tubeProperties = contactChannelProperties(TP_QT_IFACE_CHANNEL_TYPE_DBUS_TUBE);
+    PendingReady *pr = mChanFactory->proxy(mConn, mChanObjectPath + QLatin1String("/Tube1"),
+            tubeProperties);
+    ChannelPtr tube1 = ChannelPtr::qObjectCast(pr->proxy());
+    QVERIFY(DBusTubeChannelPtr::qObjectCast(tube1));
+    QCOMPARE(statistics(DBusCallScheduler::PriorityBackground).issued, 1U);
+
+    tubeProperties.insert(TP_QT_IFACE_CHANNEL_TYPE_DBUS_TUBE + QLatin1String(".ServiceName"),
+            QLatin1String("org.example.Service"));
+    tubeProperties.insert(
+            TP_QT_IFACE_CHANNEL_TYPE_DBUS_TUBE + QLatin1String(".SupportedAccessControls"),
+            QVariant::fromValue(UIntList() << SocketAccessControlLocalhost));
+    pr = mChanFactory->proxy(mConn, mChanObjectPath + QLatin1String("/Tube2"), tubeProperties);
+    ChannelPtr tube2 = ChannelPtr::qObjectCast(pr->proxy());
+    QVERIFY(DBusTubeChannelPtr::qObjectCast(tube2));
+    QCOMPARE(statistics(DBusCallScheduler::PriorityBackground).issued, 1U);
+
+    QVariantMap callProperties = contactChannelProperties(TP_QT_IFACE_CHANNEL_TYPE_CALL);
+    callProperties.insert(TP_QT_IFACE_CHANNEL_TYPE_CALL + QLatin1String(".InitialAudio"), true);
+    pr = mChanFactory->proxy(mConn, mChanObjectPath + QLatin1String("/Call1"), callProperties);
+    ChannelPtr call1 = ChannelPtr::qObjectCast(pr->proxy());
+    QVERIFY(CallChannelPtr::qObjectCast(call1));
+    QCOMPARE(statistics(DBusCallScheduler::PriorityBackground).issued, 2U);
+
+    callProperties.insert(TP_QT_IFACE_CHANNEL_TYPE_CALL + QLatin1String(".HardwareStreaming"),
+            false);
+    callProperties.insert(TP_QT_IFACE_CHANNEL_TYPE_CALL + QLatin1String(".InitialTransport"),
+            (uint) StreamTransportTypeUnknown);
+    callProperties.insert(TP_QT_IFACE_CHANNEL_TYPE_CALL + QLatin1String(".InitialVideo"), false);
+    callProperties.insert(TP_QT_IFACE_CHANNEL_TYPE_CALL + QLatin1String(".InitialAudioName"),
+            QLatin1String("audio"));
+    callProperties.insert(TP_QT_IFACE_CHANNEL_TYPE_CALL + QLatin1String(".InitialVideoName"),
+            QString());
+    callProperties.insert(TP_QT_IFACE_CHANNEL_TYPE_CALL + QLatin1String(".MutableContents"),
+            true);
+    pr = mChanFactory->proxy(mConn, mChanObjectPath + QLatin1String("/Call2"), callProperties);
+    ChannelPtr call2 = ChannelPtr::qObjectCast(pr->proxy());
+    QVERIFY(CallChannelPtr::qObjectCast(call2));
+    QCOMPARE(statistics(DBusCallScheduler::PriorityBackground).issued, 2U);
+
+    // None of these are on the bus, so the prefetched calls just fail
+    waitForPrefetches();
+}
+
+void TestChanPrefetch::cleanup()
+{
+    mChan.reset();
+
+    if (mChanService != 0) {
+        g_object_unref(mChanService);
+        mChanService = 0;
+    }
+
+    if (mConn) {
+        // Disconnect and wait for invalidation
+        tp_base_connection_change_status(
+                TP_BASE_CONNECTION(mConnService),
+                TP_CONNECTION_STATUS_DISCONNECTED,
+                TP_CONNECTION_STATUS_REASON_REQUESTED);
+
+        QVERIFY(connect(mConn.data(),
+                    SIGNAL(invalidated(Tp::DBusProxy *,
+                            const QString &, const QString &)),
+                    SLOT(expectConnInvalidated())));
+        QCOMPARE(mLoop->exec(), 0);
+        QVERIFY(!mConn->isValid());
+
+        processDBusQueue(mConn.data());
+
+        mConn.reset();
+    }
+
+    mChanFactory.reset();
+
+    if (mConnService != 0) {
+        g_object_unref(mConnService);
+        mConnService = 0;
+    }
+
+    cleanupImpl();
+}
+
+void TestChanPrefetch::cleanupTestCase()
+{
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(TestChanPrefetch)
+#include "_gen/chan-prefetch.cpp.moc.hpp"
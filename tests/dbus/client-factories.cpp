@@ -38,6 +38,7 @@
 #include <TelepathyQt/OutgoingStreamTubeChannel>
 #include <TelepathyQt/PendingAccount>
 #include <TelepathyQt/PendingReady>
+#include <TelepathyQt/RoomListChannel>
 #include <TelepathyQt/StreamedMediaChannel>
 #include <TelepathyQt/StreamTubeChannel>
 #include <TelepathyQt/TextChannel>
@@ -1049,10 +1050,8 @@ void TestClientFactories::testChannelFactoryAccessors()
     chanFact->addFeaturesForStreamedMediaCalls(streamedMediaFeatures);
     streamedMediaFeatures |= commonFeatures;
 
-    // RoomListChannel has no feature, let's use FeatureConferenceInitialInviteeContacts just for
-    // testing purposes
     Features roomListFeatures;
-    roomListFeatures.insert(Channel::FeatureConferenceInitialInviteeContacts);
+    roomListFeatures.insert(RoomListChannel::FeatureCore);
     chanFact->addFeaturesForRoomLists(roomListFeatures);
     roomListFeatures |= commonFeatures;
 
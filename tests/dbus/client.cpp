@@ -8,6 +8,7 @@
 #define TP_QT_ENABLE_LOWLEVEL_API
 
 #include <TelepathyQt/Account>
+#include <TelepathyQt/AccountFactory>
 #include <TelepathyQt/AccountManager>
 #include <TelepathyQt/AbstractClientHandler>
 #include <TelepathyQt/AbstractClientObserver>
@@ -20,9 +21,14 @@
 #include <TelepathyQt/ClientObserverInterface>
 #include <TelepathyQt/ClientRegistrar>
 #include <TelepathyQt/Connection>
+#include <TelepathyQt/ConnectionFactory>
 #include <TelepathyQt/ConnectionLowlevel>
+#include <TelepathyQt/ContactFactory>
+#include <TelepathyQt/ContactManager>
+#include <TelepathyQt/DBusCallScheduler>
 #include <TelepathyQt/MethodInvocationContext>
 #include <TelepathyQt/PendingAccount>
+#include <TelepathyQt/PendingContacts>
 #include <TelepathyQt/PendingReady>
 
 #include <telepathy-glib/debug.h>
@@ -195,6 +201,49 @@ private:
     QStringList mPossibleHandlers;
 };
 
+// Remembers which object the event being delivered goes to, so that it can be told whether a client
+// was invoked straight from the D-Bus call to it, or from a PendingOperation finishing once the
+// proxies for it became ready from the mainloop
+class EventTracker : public QObject
+{
+public:
+    EventTracker(QObject *parent = 0)
+        : QObject(parent)
+    {
+        QCoreApplication::instance()->installEventFilter(this);
+    }
+
+    static bool inPendingOperation()
+    {
+        return qobject_cast<PendingOperation *>(mReceiver.data()) != 0;
+    }
+
+protected:
+    bool eventFilter(QObject *receiver, QEvent *event)
+    {
+        switch (event->type()) {
+            // These are sent synchronously while other events are being handled
+            case QEvent::ChildAdded:
+            case QEvent::ChildPolished:
+            case QEvent::ChildRemoved:
+            case QEvent::DynamicPropertyChange:
+            case QEvent::ParentAboutToChange:
+            case QEvent::ParentChange:
+            case QEvent::ThreadChange:
+                break;
+            default:
+                mReceiver = receiver;
+                break;
+        }
+        return false;
+    }
+
+private:
+    static QPointer<QObject> mReceiver;
+};
+
+QPointer<QObject> EventTracker::mReceiver;
+
 class MyClient : public QObject,
                  public AbstractClientObserver,
                  public AbstractClientApprover,
@@ -220,7 +269,9 @@ public:
         : AbstractClientObserver(channelFilter),
           AbstractClientApprover(channelFilter),
           AbstractClientHandler(channelFilter, capabilities, wantsRequestNotification),
-          mBypassApproval(bypassApproval)
+          mAddDispatchOperationFromMainloop(false),
+          mBypassApproval(bypassApproval),
+          mHandleChannelsFromMainloop(false)
     {
     }
 
@@ -252,6 +303,7 @@ public:
     {
         mAddDispatchOperationChannels = dispatchOperation->channels();
         mAddDispatchOperationDispatchOperation = dispatchOperation;
+        mAddDispatchOperationFromMainloop = EventTracker::inPendingOperation();
 
         QVERIFY(connect(dispatchOperation->claim(AbstractClientHandlerPtr(this)),
                     SIGNAL(finished(Tp::PendingOperation*)),
@@ -280,6 +332,7 @@ public:
         mHandleChannelsRequestsSatisfied = requestsSatisfied;
         mHandleChannelsUserActionTime = userActionTime;
         mHandleChannelsHandlerInfo = handlerInfo;
+        mHandleChannelsFromMainloop = EventTracker::inPendingOperation();
 
         Q_FOREACH (const ChannelPtr &channel, channels) {
             connect(channel.data(),
@@ -316,6 +369,7 @@ public:
 
     QList<ChannelPtr> mAddDispatchOperationChannels;
     ChannelDispatchOperationPtr mAddDispatchOperationDispatchOperation;
+    bool mAddDispatchOperationFromMainloop;
 
     bool mBypassApproval;
     AccountPtr mHandleChannelsAccount;
@@ -324,6 +378,7 @@ public:
     QList<ChannelRequestPtr> mHandleChannelsRequestsSatisfied;
     QDateTime mHandleChannelsUserActionTime;
     AbstractClientHandler::HandlerInfo mHandleChannelsHandlerInfo;
+    bool mHandleChannelsFromMainloop;
     ChannelRequestPtr mAddRequestRequest;
     ChannelRequestPtr mRemoveRequestRequest;
     QString mRemoveRequestErrorName;
@@ -368,6 +423,8 @@ private Q_SLOTS:
     void testObserveChannels();
     void testAddDispatchOperation();
     void testRequests();
+    void testImmediateDispatch();
+    void testImmediateDispatchChannels();
     void testHandleChannels();
 
     void cleanup();
@@ -416,6 +473,8 @@ void TestClient::initTestCase()
 {
     initTestCaseImpl();
 
+    new EventTracker(this);
+
     g_type_init();
     g_set_prgname("client");
     tp_debug_set_flags("all");
@@ -695,6 +754,19 @@ void TestClient::testObserveChannelsCommon(const AbstractClientPtr &clientObject
                 TP_QT_IFACE_CHANNEL_REQUEST + QLatin1String(".Interface.DomainSpecific.IntegerProp")), true);
     QCOMPARE(qdbus_cast<int>(client->mObserveChannelsRequestsSatisfied.first()->immutableProperties().value(
                 TP_QT_IFACE_CHANNEL_REQUEST + QLatin1String(".Interface.DomainSpecific.IntegerProp"))), 3);
+
+    ClientRegistrar::InvocationStatistics stats = mClientRegistrar->invocationStatistics(
+            clientObject, TP_QT_IFACE_CLIENT_OBSERVER);
+    QVERIFY(stats.isValid());
+    QCOMPARE(stats.queueDepth(), 0);
+    QVERIFY(stats.peakQueueDepth() >= 1);
+    QVERIFY(stats.completedInvocations() >= 1);
+    QCOMPARE(stats.failedInvocations(), 0U);
+    QVERIFY(stats.timeToReadyPercentile(50) >= 0);
+    QVERIFY(stats.timeToReadyPercentile(99) >= stats.timeToReadyPercentile(50));
+
+    QVERIFY(!mClientRegistrar->invocationStatistics(AbstractClientPtr(),
+                TP_QT_IFACE_CLIENT_OBSERVER).isValid());
 }
 
 void TestClient::testObserveChannels()
@@ -748,6 +820,8 @@ void TestClient::testAddDispatchOperation()
 
     QCOMPARE(client->mAddDispatchOperationChannels.first()->objectPath(), mText1ChanPath);
     QCOMPARE(client->mAddDispatchOperationDispatchOperation->objectPath(), mCDOPath);
+    // The approver was only invoked once the proxies had been made ready from the mainloop
+    QVERIFY(client->mAddDispatchOperationFromMainloop);
 
     // Claim finished, Handler.HandledChannels should be populated now
     handledChannels.clear();
@@ -762,6 +836,217 @@ void TestClient::testAddDispatchOperation()
     QCOMPARE(handledChannels, expectedHandledChannels);
 }
 
+void TestClient::testImmediateDispatch()
+{
+    QVERIFY(connect(mAccount->becomeReady(),
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    ObjectImmutablePropertiesMap reqPropsMap = qdbus_cast<ObjectImmutablePropertiesMap>(
+            mHandlerInfo.value(QLatin1String("request-properties")));
+    QVariantMap dispatchOperationProperties;
+    dispatchOperationProperties.insert(
+            TP_QT_IFACE_CHANNEL_DISPATCH_OPERATION + QLatin1String(".Connection"),
+            QVariant::fromValue(QDBusObjectPath(mConn->objectPath())));
+    dispatchOperationProperties.insert(
+            TP_QT_IFACE_CHANNEL_DISPATCH_OPERATION + QLatin1String(".Account"),
+            QVariant::fromValue(QDBusObjectPath(mAccount->objectPath())));
+    dispatchOperationProperties.insert(
+            TP_QT_IFACE_CHANNEL_DISPATCH_OPERATION + QLatin1String(".Interfaces"),
+            QVariant::fromValue(QStringList()));
+    dispatchOperationProperties.insert(
+            TP_QT_IFACE_CHANNEL_DISPATCH_OPERATION + QLatin1String(".PossibleHandlers"),
+            QVariant::fromValue(QStringList() << mClientObject1BusName));
+
+    // Even with all of their properties supplied and the account ready, the objects created
+    // outside of a client registrar with immediate dispatch enabled aren't made ready until asked
+    // to, and becomeReady() finishes from the mainloop as usual
+    QVERIFY(!mClientRegistrar->isImmediateDispatchEnabled());
+    ChannelRequestPtr channelRequest = ChannelRequest::create(mAccount, mChannelRequestPath,
+            reqPropsMap.value(QDBusObjectPath(mChannelRequestPath)));
+    QVERIFY(!channelRequest->isReady());
+    PendingReady *pr = channelRequest->becomeReady();
+    QVERIFY(!pr->isFinished());
+    QVERIFY(connect(pr,
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(channelRequest->isReady());
+
+    ChannelDispatchOperationPtr dispatchOp = ChannelDispatchOperation::create(
+            mClientRegistrar->dbusConnection(), mCDOPath, dispatchOperationProperties,
+            QList<ChannelPtr>() << Channel::create(mConn->client(), mText1ChanPath, QVariantMap()),
+            mClientRegistrar->accountFactory(),
+            mClientRegistrar->connectionFactory(),
+            mClientRegistrar->channelFactory(),
+            mClientRegistrar->contactFactory());
+    QVERIFY(!dispatchOp->isReady());
+
+    mClientRegistrar->setImmediateDispatchEnabled(true);
+    QVERIFY(mClientRegistrar->isImmediateDispatchEnabled());
+
+    channelRequest = ChannelRequest::create(mAccount, mChannelRequestPath,
+            reqPropsMap.value(QDBusObjectPath(mChannelRequestPath)));
+    QVERIFY(!channelRequest->isReady());
+
+    // The approver is given a dispatch operation made ready from the supplied properties
+    ClientApproverInterface *approverIface = new ClientApproverInterface(
+            mClientRegistrar->dbusConnection(), mClientObject1BusName, mClientObject1Path, this);
+    MyClient *client = dynamic_cast<MyClient*>(mClientObject1.data());
+    // addDispatchOperationFinished() and claimFinished() are still connected to from
+    // testAddDispatchOperation()
+    approverIface->AddDispatchOperation(mCDO->Channels(), QDBusObjectPath(mCDOPath),
+            dispatchOperationProperties);
+    QCOMPARE(mLoop->exec(), 0);
+    while (!mClaimFinished) {
+        mLoop->processEvents();
+    }
+
+    dispatchOp = client->mAddDispatchOperationDispatchOperation;
+    QCOMPARE(dispatchOp->objectPath(), mCDOPath);
+    QVERIFY(dispatchOp->isReady());
+    // The approver was invoked while the D-Bus call to it was being delivered, rather than once
+    // the proxies had become ready from the mainloop
+    QVERIFY(!client->mAddDispatchOperationFromMainloop);
+    QCOMPARE(dispatchOp->account()->objectPath(), mAccount->objectPath());
+    QCOMPARE(dispatchOp->connection()->objectPath(), mConn->objectPath());
+    QCOMPARE(dispatchOp->possibleHandlers(), QStringList() << mClientObject1BusName);
+
+    // The handler is invoked and its results are the same as without immediate dispatch
+    ClientHandlerInterface *handlerIface = new ClientHandlerInterface(
+            mClientRegistrar->dbusConnection(), mClientObject1BusName, mClientObject1Path, this);
+    QVERIFY(connect(client,
+                SIGNAL(handleChannelsFinished()),
+                SLOT(expectSignalEmission())));
+    ChannelDetailsList channelDetailsList;
+    ChannelDetails channelDetails = { QDBusObjectPath(mText1ChanPath), QVariantMap() };
+    channelDetailsList.append(channelDetails);
+
+    handlerIface->HandleChannels(QDBusObjectPath(mAccount->objectPath()),
+            QDBusObjectPath(mConn->objectPath()),
+            channelDetailsList,
+            ObjectPathList() << QDBusObjectPath(mChannelRequestPath),
+            mUserActionTime,
+            mHandlerInfo);
+    QCOMPARE(mLoop->exec(), 0);
+
+    QCOMPARE(client->mHandleChannelsAccount->objectPath(), mAccount->objectPath());
+    QCOMPARE(client->mHandleChannelsConnection->objectPath(), mConn->objectPath());
+    QCOMPARE(client->mHandleChannelsChannels.first()->objectPath(), mText1ChanPath);
+    QCOMPARE(client->mHandleChannelsRequestsSatisfied.first()->objectPath(), mChannelRequestPath);
+    QVERIFY(client->mHandleChannelsRequestsSatisfied.first()->isReady());
+    QCOMPARE(client->mHandleChannelsUserActionTime.toTime_t(), mUserActionTime);
+    QVERIFY(!client->mHandleChannelsFromMainloop);
+
+    QVERIFY(disconnect(client,
+                SIGNAL(handleChannelsFinished()),
+                this,
+                SLOT(expectSignalEmission())));
+    mClientRegistrar->setImmediateDispatchEnabled(false);
+}
+
+void TestClient::testImmediateDispatchChannels()
+{
+    QDBusConnection bus = mClientRegistrar->dbusConnection();
+
+    // A registrar whose factories make the core of every proxy ready, as most applications' do
+    ChannelFactoryPtr chanFactory = ChannelFactory::create(bus);
+    chanFactory->addCommonFeatures(Channel::FeatureCore);
+    ClientRegistrarPtr registrar = ClientRegistrar::create(bus,
+            AccountFactory::create(bus, Account::FeatureCore),
+            ConnectionFactory::create(bus, Connection::FeatureCore),
+            chanFactory, ContactFactory::create());
+    registrar->setImmediateDispatchEnabled(true);
+
+    ChannelClassSpecList filters;
+    filters.append(ChannelClassSpec::textChat());
+    AbstractClientPtr clientObject = MyClient::create(filters,
+            AbstractClientHandler::Capabilities(), false, false);
+    MyClient *client = dynamic_cast<MyClient*>(clientObject.data());
+    QVERIFY(registrar->registerClient(clientObject, QLatin1String("immediate")));
+    QVERIFY(connect(client,
+                SIGNAL(handleChannelsFinished()),
+                SLOT(expectSignalEmission())));
+
+    // The account and connection have been made ready before, and the contacts the channel is
+    // about have been built already
+    PendingReady *pr = registrar->accountFactory()->proxy(TP_QT_ACCOUNT_MANAGER_BUS_NAME,
+            mAccount->objectPath(), registrar->connectionFactory(), registrar->channelFactory(),
+            registrar->contactFactory());
+    AccountPtr account = AccountPtr::qObjectCast(pr->proxy());
+    QVERIFY(connect(pr,
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    pr = registrar->connectionFactory()->proxy(mConn->client()->busName(), mConn->objectPath(),
+            registrar->channelFactory(), registrar->contactFactory());
+    ConnectionPtr connection = ConnectionPtr::qObjectCast(pr->proxy());
+    QVERIFY(connect(pr,
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    uint handle = tp_handle_ensure(mContactRepo, "someone@localhost", 0, 0);
+    PendingContacts *pc = connection->contactManager()->contactsForHandles(
+            UIntList() << connection->selfHandle() << handle);
+    QVERIFY(connect(pc,
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QList<ContactPtr> contacts = pc->contacts();
+    QCOMPARE(contacts.size(), 2);
+
+    QVariantMap chanProps;
+    chanProps.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"),
+            TP_QT_IFACE_CHANNEL_TYPE_TEXT);
+    chanProps.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".Interfaces"), QStringList());
+    chanProps.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+            (uint) HandleTypeContact);
+    chanProps.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"), handle);
+    chanProps.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"),
+            QLatin1String("someone@localhost"));
+    chanProps.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".Requested"), false);
+    chanProps.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".InitiatorHandle"), handle);
+    chanProps.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".InitiatorID"),
+            QLatin1String("someone@localhost"));
+    ChannelDetailsList channelDetailsList;
+    ChannelDetails channelDetails = { QDBusObjectPath(mText1ChanPath), chanProps };
+    channelDetailsList.append(channelDetails);
+
+    // So the new channel is ready as soon as it is constructed, and the handler is invoked while
+    // the D-Bus call is being delivered, without the channel being introspected
+    DBusCallScheduler::resetStatistics(bus);
+    ClientHandlerInterface *handlerIface = new ClientHandlerInterface(bus,
+            QLatin1String("org.freedesktop.Telepathy.Client.immediate"),
+            QLatin1String("/org/freedesktop/Telepathy/Client/immediate"), this);
+    handlerIface->HandleChannels(QDBusObjectPath(mAccount->objectPath()),
+            QDBusObjectPath(mConn->objectPath()),
+            channelDetailsList,
+            ObjectPathList(),
+            mUserActionTime,
+            QVariantMap());
+    QCOMPARE(mLoop->exec(), 0);
+
+    QVERIFY(!client->mHandleChannelsFromMainloop);
+    QCOMPARE(client->mHandleChannelsConnection.data(), connection.data());
+    QCOMPARE(client->mHandleChannelsChannels.size(), 1);
+    ChannelPtr channel = client->mHandleChannelsChannels.first();
+    QCOMPARE(channel->objectPath(), mText1ChanPath);
+    QVERIFY(channel->isReady(Channel::FeatureCore));
+    QCOMPARE(channel->channelType(), TP_QT_IFACE_CHANNEL_TYPE_TEXT);
+    QCOMPARE(channel->targetHandle(), handle);
+    QVERIFY(channel->targetContact());
+    QCOMPARE(channel->targetContact()->id(), QLatin1String("someone@localhost"));
+    QVERIFY(channel->initiatorContact());
+    QCOMPARE(channel->initiatorContact()->handle()[0], handle);
+    QCOMPARE(channel->groupContacts().size(), 2);
+    QCOMPARE(DBusCallScheduler::statistics(bus, DBusCallScheduler::PriorityInteractive).issued, 0U);
+
+    QVERIFY(registrar->unregisterClient(clientObject));
+}
+
 void TestClient::testHandleChannels()
 {
     QDBusConnection bus = mClientRegistrar->dbusConnection();
@@ -790,6 +1075,7 @@ void TestClient::testHandleChannels()
     QCOMPARE(client1->mHandleChannelsChannels.first()->objectPath(), mText1ChanPath);
     QCOMPARE(client1->mHandleChannelsRequestsSatisfied.first()->objectPath(), mChannelRequestPath);
     QCOMPARE(client1->mHandleChannelsUserActionTime.toTime_t(), mUserActionTime);
+    QVERIFY(client1->mHandleChannelsFromMainloop);
 
     Tp::ObjectPathList handledChannels;
     QVERIFY(waitForProperty(handler1Iface->requestPropertyHandledChannels(), &handledChannels));
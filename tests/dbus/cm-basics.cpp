@@ -12,6 +12,13 @@
 
 #include <telepathy-glib/debug.h>
 
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <sys/types.h>
+#include <utime.h>
+
 using namespace Tp;
 
 namespace
@@ -27,6 +34,48 @@ PresenceSpec getPresenceSpec(const PresenceSpecList &specs, const QString &statu
     return PresenceSpec();
 }
 
+// QDataStream writes strings as big-endian UTF-16
+QByteArray utf16(const QString &str)
+{
+    QByteArray ret;
+    Q_FOREACH (const QChar &c, str) {
+        ret.append((char) (c.unicode() >> 8));
+        ret.append((char) (c.unicode() & 0xff));
+    }
+    return ret;
+}
+
+QByteArray readFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+// Overwrite a string stored in the cache file with another one of the same length, which keeps
+// the file well-formed
+bool tamperWithCacheFile(const QString &fileName, const QString &from, const QString &to)
+{
+    if (from.length() != to.length()) {
+        return false;
+    }
+
+    QByteArray data = readFile(fileName);
+    int index = data.indexOf(utf16(from));
+    if (index < 0) {
+        return false;
+    }
+    data.replace(index, from.length() * 2, utf16(to));
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    return file.write(data) == data.size();
+}
+
 }
 
 class TestCmBasics : public Test
@@ -48,6 +97,8 @@ private Q_SLOTS:
 
     void testBasics();
     void testLegacy();
+    void testIntrospectionCache();
+    void testIntrospectionCacheServiceFile();
     void testListNames();
 
     void cleanup();
@@ -62,6 +113,7 @@ private:
 
     QStringList mCMNames;
     QString mPendingStringResult;
+    QString mCacheHome;
 };
 
 void TestCmBasics::expectListNamesFinished(PendingOperation *op)
@@ -309,6 +361,194 @@ void TestCmBasics::testLegacy()
     QCOMPARE(mCMLegacy->supportedProtocols(), QStringList() << QLatin1String("simple"));
 }
 
+void TestCmBasics::testIntrospectionCache()
+{
+    mCacheHome = QString(QLatin1String("%1/cm-basics-cache-%2"))
+        .arg(QDir::tempPath()).arg(QCoreApplication::applicationPid());
+    qputenv("XDG_CACHE_HOME", mCacheHome.toLocal8Bit());
+    QString cacheFileName = mCacheHome +
+        QLatin1String("/telepathy/qt/managers/example_echo_2.cache");
+    QFile::remove(cacheFileName);
+
+    QCOMPARE(ConnectionManager::isIntrospectionCacheEnabled(), false);
+    ConnectionManager::setIntrospectionCacheEnabled(true);
+    QCOMPARE(ConnectionManager::isIntrospectionCacheEnabled(), true);
+
+    // The first instance introspects the CM over D-Bus and fills the cache
+    mCM = ConnectionManager::create(QLatin1String("example_echo_2"));
+    QVERIFY(connect(mCM->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation *)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mCM->isReady(), true);
+    QVERIFY(QFile::exists(cacheFileName));
+
+    ProtocolInfo introspected = mCM->protocol(QLatin1String("example"));
+    QVERIFY(introspected.isValid());
+    QCOMPARE(introspected.englishName(), QLatin1String("Echo II example"));
+
+    // The second one gets the information from the cache, which is told apart from what the CM
+    // has to say by having been tampered with
+    QVERIFY(tamperWithCacheFile(cacheFileName, QLatin1String("Echo II example"),
+                QLatin1String("Echo II cached!")));
+    ConnectionManagerPtr cachedCM = ConnectionManager::create(QLatin1String("example_echo_2"));
+    QVERIFY(connect(cachedCM->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation *)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(cachedCM->isReady(), true);
+
+    QCOMPARE(cachedCM->interfaces(), mCM->interfaces());
+    QCOMPARE(cachedCM->supportedProtocols(), QStringList() << QLatin1String("example"));
+
+    ProtocolInfo info = cachedCM->protocol(QLatin1String("example"));
+    QVERIFY(info.isValid());
+    QCOMPARE(info.cmName(), QLatin1String("example_echo_2"));
+    QCOMPARE(info.vcardField(), introspected.vcardField());
+    QCOMPARE(info.englishName(), QLatin1String("Echo II cached!"));
+    QCOMPARE(info.iconName(), introspected.iconName());
+
+    QCOMPARE(info.parameters().size(), 1);
+    ProtocolParameter param = info.parameters().at(0);
+    QCOMPARE(param.name(), QLatin1String("account"));
+    QCOMPARE(param.dbusSignature().signature(), QLatin1String("s"));
+    QCOMPARE(param.isRequired(), true);
+    QCOMPARE(param.isSecret(), false);
+
+    QCOMPARE(info.capabilities().textChats(), true);
+    QCOMPARE(info.capabilities().textChatrooms(), false);
+    QCOMPARE(info.capabilities().streamedMediaCalls(), false);
+
+    QCOMPARE(info.allowedPresenceStatuses().size(), 3);
+    PresenceSpec spec = getPresenceSpec(info.allowedPresenceStatuses(),
+            QLatin1String("available"));
+    QCOMPARE(spec.isValid(), true);
+    QVERIFY(spec.presence().type() == ConnectionPresenceTypeAvailable);
+    QCOMPARE(spec.maySetOnSelf(), true);
+    QCOMPARE(spec.canHaveStatusMessage(), true);
+
+    AvatarSpec avatarReqs = info.avatarRequirements();
+    QCOMPARE(avatarReqs.supportedMimeTypes(),
+            introspected.avatarRequirements().supportedMimeTypes());
+    QCOMPARE(avatarReqs.recommendedHeight(), (uint) 64);
+    QCOMPARE(avatarReqs.maximumBytes(), (uint) 37748736);
+
+    QCOMPARE(info.addressableVCardFields(), QStringList() << QLatin1String("x-echo2"));
+    QCOMPARE(info.addressableUriSchemes(), QStringList() << QLatin1String("echo2"));
+
+    // The CM is introspected over D-Bus anyway, and the cache is brought up to date with it
+    for (int i = 0; i < 50 && !readFile(cacheFileName).contains(
+                utf16(QLatin1String("Echo II example"))); ++i) {
+        QTest::qWait(100);
+    }
+    QVERIFY(readFile(cacheFileName).contains(utf16(QLatin1String("Echo II example"))));
+    QVERIFY(!readFile(cacheFileName).contains(utf16(QLatin1String("Echo II cached!"))));
+
+    // The CM isn't activatable, so the cache is only trusted for as long as the same process owns
+    // the CM bus name; a cache saved for another owner is ignored
+    QVERIFY(tamperWithCacheFile(cacheFileName, QLatin1String("owner:"),
+                QLatin1String("OWNER:")));
+    QVERIFY(tamperWithCacheFile(cacheFileName, QLatin1String("Echo II example"),
+                QLatin1String("Echo II cached!")));
+    ConnectionManagerPtr staleCM = ConnectionManager::create(QLatin1String("example_echo_2"));
+    QVERIFY(connect(staleCM->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation *)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(staleCM->isReady(), true);
+    QCOMPARE(staleCM->protocol(QLatin1String("example")).englishName(),
+            QLatin1String("Echo II example"));
+    QVERIFY(readFile(cacheFileName).contains(utf16(QLatin1String("owner:"))));
+    QVERIFY(!readFile(cacheFileName).contains(utf16(QLatin1String("Echo II cached!"))));
+
+    ConnectionManager::setIntrospectionCacheEnabled(false);
+}
+
+void TestCmBasics::testIntrospectionCacheServiceFile()
+{
+    mCacheHome = QString(QLatin1String("%1/cm-basics-cache-%2"))
+        .arg(QDir::tempPath()).arg(QCoreApplication::applicationPid());
+    qputenv("XDG_CACHE_HOME", mCacheHome.toLocal8Bit());
+    QString cacheFileName = mCacheHome +
+        QLatin1String("/telepathy/qt/managers/example_echo_2.cache");
+    QFile::remove(cacheFileName);
+
+    // Make the CM look activatable, with a service file naming an executable whose modification
+    // time stands for the build of the CM
+    QByteArray oldDataHome = qgetenv("XDG_DATA_HOME");
+    QString dataHome = mCacheHome + QLatin1String("/data");
+    qputenv("XDG_DATA_HOME", dataHome.toLocal8Bit());
+    QString servicesDir = dataHome + QLatin1String("/dbus-1/services");
+    QVERIFY(QDir().mkpath(servicesDir));
+    QString executable = mCacheHome + QLatin1String("/telepathy-example-echo-2");
+    QFile executableFile(executable);
+    QVERIFY(executableFile.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    executableFile.close();
+    QString serviceFileName = servicesDir + QLatin1String(
+            "/org.freedesktop.Telepathy.ConnectionManager.example_echo_2.service");
+    QFile serviceFile(serviceFileName);
+    QVERIFY(serviceFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text));
+    serviceFile.write(QString(QLatin1String("[D-BUS Service]\n"
+                    "Name=org.freedesktop.Telepathy.ConnectionManager.example_echo_2\n"
+                    "Exec=%1 --some-option\n")).arg(executable).toLocal8Bit());
+    serviceFile.close();
+
+    ConnectionManager::setIntrospectionCacheEnabled(true);
+
+    // The cache is stamped with the executable rather than with the owner of the CM bus name, so
+    // it's still used once the CM process has gone away and been activated again
+    mCM = ConnectionManager::create(QLatin1String("example_echo_2"));
+    QVERIFY(connect(mCM->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation *)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mCM->isReady(), true);
+    QVERIFY(readFile(cacheFileName).contains(utf16(QLatin1String("exec:") + executable)));
+    QVERIFY(!readFile(cacheFileName).contains(utf16(QLatin1String("owner:"))));
+
+    QVERIFY(tamperWithCacheFile(cacheFileName, QLatin1String("Echo II example"),
+                QLatin1String("Echo II cached!")));
+    ConnectionManagerPtr cachedCM = ConnectionManager::create(QLatin1String("example_echo_2"));
+    QVERIFY(connect(cachedCM->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation *)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(cachedCM->isReady(), true);
+    QCOMPARE(cachedCM->protocol(QLatin1String("example")).englishName(),
+            QLatin1String("Echo II cached!"));
+
+    // Wait for the revalidation to be done with the cache before upgrading the CM
+    for (int i = 0; i < 50 && !readFile(cacheFileName).contains(
+                utf16(QLatin1String("Echo II example"))); ++i) {
+        QTest::qWait(100);
+    }
+    QVERIFY(readFile(cacheFileName).contains(utf16(QLatin1String("Echo II example"))));
+
+    // Upgrading the CM changes the modification time of its executable, which makes the cache
+    // stale
+    QVERIFY(tamperWithCacheFile(cacheFileName, QLatin1String("Echo II example"),
+                QLatin1String("Echo II cached!")));
+    struct utimbuf times;
+    times.actime = times.modtime = QFileInfo(executable).lastModified().toTime_t() - 3600;
+    QCOMPARE(utime(QFile::encodeName(executable).constData(), &times), 0);
+    ConnectionManagerPtr upgradedCM = ConnectionManager::create(QLatin1String("example_echo_2"));
+    QVERIFY(connect(upgradedCM->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation *)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(upgradedCM->isReady(), true);
+    QCOMPARE(upgradedCM->protocol(QLatin1String("example")).englishName(),
+            QLatin1String("Echo II example"));
+    QVERIFY(!readFile(cacheFileName).contains(utf16(QLatin1String("Echo II cached!"))));
+
+    ConnectionManager::setIntrospectionCacheEnabled(false);
+
+    qputenv("XDG_DATA_HOME", oldDataHome);
+    QFile::remove(serviceFileName);
+    QFile::remove(executable);
+    QDir().rmpath(servicesDir);
+}
+
 // TODO add a test for the case of getting the information from a .manager file, and if possible,
 // also for using the fallbacks for the CM::Protocols property not being present.
 
@@ -334,6 +574,14 @@ void TestCmBasics::cleanup()
 
 void TestCmBasics::cleanupTestCase()
 {
+    if (!mCacheHome.isEmpty()) {
+        QDir cacheDir(mCacheHome + QLatin1String("/telepathy/qt/managers"));
+        Q_FOREACH (const QString &fileName, cacheDir.entryList(QDir::Files)) {
+            cacheDir.remove(fileName);
+        }
+        QDir().rmpath(cacheDir.path());
+    }
+
     if (mCMService) {
         g_object_unref(mCMService);
         mCMService = 0;
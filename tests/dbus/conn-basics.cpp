@@ -11,6 +11,7 @@
 #include <TelepathyQt/Connection>
 #include <TelepathyQt/ConnectionLowlevel>
 #include <TelepathyQt/ContactFactory>
+#include <TelepathyQt/DBus>
 #include <TelepathyQt/PendingChannel>
 #include <TelepathyQt/PendingReady>
 #include <TelepathyQt/Debug>
@@ -18,11 +19,50 @@
 #include <telepathy-glib/dbus.h>
 #include <telepathy-glib/debug.h>
 
+#include <dbus/dbus-glib-lowlevel.h>
+
 #include <tests/lib/glib/contacts-conn.h>
 #include <tests/lib/test.h>
 
 using namespace Tp;
 
+// Counts the GetNameOwner calls a connection makes for a name, by eavesdropping on the bus. A
+// NameHasOwner call for the same name marks the point up to which they have all been seen.
+struct NameOwnerLookupCounter
+{
+    QString sender;
+    QString name;
+    uint lookups;
+    bool sawMarker;
+};
+
+static DBusHandlerResult countNameOwnerLookups(DBusConnection *connection, DBusMessage *message,
+        void *userData)
+{
+    Q_UNUSED(connection);
+
+    if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL) {
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    // Eavesdropped calls are never meant for us, so make sure libdbus doesn't reply to them
+    NameOwnerLookupCounter *counter = static_cast<NameOwnerLookupCounter *>(userData);
+    const char *name = 0;
+    if (QLatin1String(dbus_message_get_sender(message)) != counter->sender ||
+            !dbus_message_get_args(message, 0, DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID) ||
+            QLatin1String(name) != counter->name) {
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    if (dbus_message_is_method_call(message, DBUS_INTERFACE_DBUS, "GetNameOwner")) {
+        ++counter->lookups;
+    } else if (dbus_message_is_method_call(message, DBUS_INTERFACE_DBUS, "NameHasOwner")) {
+        counter->sawMarker = true;
+    }
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
 class TestConnBasics : public Test
 {
     Q_OBJECT
@@ -44,6 +84,7 @@ private Q_SLOTS:
 
     void testBasics();
     void testSimplePresence();
+    void testNameOwnerLookups();
 
     void cleanup();
     void cleanupTestCase();
@@ -233,6 +274,80 @@ void TestConnBasics::testSimplePresence()
     QCOMPARE(mConn->lowlevel()->maxPresenceStatusMessageLength(), (uint) 512);
 }
 
+void TestConnBasics::testNameOwnerLookups()
+{
+    // A connection the process hasn't seen before, so the owner of its bus name isn't known
+    TpTestsContactsConnection *connService = TP_TESTS_CONTACTS_CONNECTION(g_object_new(
+            TP_TESTS_TYPE_CONTACTS_CONNECTION,
+            "account", "lookups@example.com",
+            "protocol", "contacts",
+            NULL));
+    QVERIFY(connService != 0);
+    gchar *name;
+    gchar *connPath;
+    GError *error = 0;
+    QVERIFY(tp_base_connection_register(TP_BASE_CONNECTION(connService),
+                "contacts", &name, &connPath, &error));
+    QVERIFY(error == 0);
+    QString connName = QLatin1String(name);
+    QString connObjectPath = QLatin1String(connPath);
+    g_free(name);
+    g_free(connPath);
+
+    NameOwnerLookupCounter counter;
+    counter.sender = QDBusConnection::sessionBus().baseService();
+    counter.name = connName;
+    counter.lookups = 0;
+    counter.sawMarker = false;
+
+    DBusError dbusError;
+    dbus_error_init(&dbusError);
+    DBusConnection *eavesdropper = dbus_bus_get_private(DBUS_BUS_SESSION, &dbusError);
+    QVERIFY(eavesdropper != 0);
+    dbus_connection_set_exit_on_disconnect(eavesdropper, FALSE);
+    dbus_connection_setup_with_g_main(eavesdropper, 0);
+    QVERIFY(dbus_connection_add_filter(eavesdropper, countNameOwnerLookups, &counter, 0));
+    dbus_bus_add_match(eavesdropper,
+            "type='method_call',interface='" DBUS_INTERFACE_DBUS "',eavesdrop='true'",
+            &dbusError);
+    QVERIFY(!dbus_error_is_set(&dbusError));
+
+    ConnectionPtr conn = Connection::create(connName, connObjectPath,
+            ChannelFactory::create(QDBusConnection::sessionBus()),
+            ContactFactory::create());
+    QVERIFY(connect(conn->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(conn->busName().startsWith(QLatin1Char(':')));
+
+    // The interfaces have only been built once the unique name was known
+    QCOMPARE(conn->interface<Client::DBus::PropertiesInterface>()->service(), conn->busName());
+
+    QDBusConnection::sessionBus().interface()->isServiceRegistered(connName);
+    while (!counter.sawMarker) {
+        mLoop->processEvents();
+    }
+
+    // The lookup made by StatefulDBusProxy is the only one, QtDBus hasn't blocked on one of its own
+    // for the interfaces
+    QCOMPARE(counter.lookups, 1U);
+
+    dbus_connection_remove_filter(eavesdropper, countNameOwnerLookups, &counter);
+    dbus_connection_close(eavesdropper);
+    dbus_connection_unref(eavesdropper);
+
+    tp_base_connection_change_status(TP_BASE_CONNECTION(connService),
+            TP_CONNECTION_STATUS_DISCONNECTED, TP_CONNECTION_STATUS_REASON_REQUESTED);
+    QVERIFY(connect(conn.data(),
+                SIGNAL(invalidated(Tp::DBusProxy *,
+                        const QString &, const QString &)),
+                SLOT(expectConnInvalidated())));
+    QCOMPARE(mLoop->exec(), 0);
+    conn.reset();
+    g_object_unref(connService);
+}
+
 void TestConnBasics::cleanup()
 {
     if (mConn) {
@@ -21,13 +21,15 @@ public:
     TestContactSearchChan(QObject *parent = 0)
         : Test(parent),
           mConn(0),
-          mChan1Service(0), mChan2Service(0), mSearchReturned(false)
+          mChan1Service(0), mChan2Service(0), mChan3Service(0), mChan4Service(0),
+          mSearchReturned(false)
     { }
 
 protected Q_SLOTS:
     void onSearchStateChanged(Tp::ChannelContactSearchState state, const QString &errorName,
         const Tp::ContactSearchChannel::SearchStateChangeDetails &details);
     void onSearchResultReceived(const Tp::ContactSearchChannel::SearchResult &result);
+    void onRawSearchResultReceived(const Tp::ContactSearchResultMap &result);
     void onSearchReturned(Tp::PendingOperation *op);
 
 private Q_SLOTS:
@@ -36,6 +38,8 @@ private Q_SLOTS:
 
     void testContactSearch();
     void testContactSearchEmptyResult();
+    void testContactSearchRawResult();
+    void testContactSearchPipelined();
 
     void cleanup();
     void cleanupTestCase();
@@ -47,13 +51,21 @@ private:
     ContactSearchChannelPtr mChan;
     ContactSearchChannelPtr mChan1;
     ContactSearchChannelPtr mChan2;
+    ContactSearchChannelPtr mChan3;
+    ContactSearchChannelPtr mChan4;
 
     QString mChan1Path;
     TpTestsContactSearchChannel *mChan1Service;
     QString mChan2Path;
     TpTestsContactSearchChannel *mChan2Service;
+    QString mChan3Path;
+    TpTestsContactSearchChannel *mChan3Service;
+    QString mChan4Path;
+    TpTestsContactSearchChannel *mChan4Service;
 
     ContactSearchChannel::SearchResult mSearchResult;
+    QList<ContactSearchChannel::SearchResult> mSearchResults;
+    QList<ContactSearchResultMap> mRawSearchResults;
     bool mSearchReturned;
 
     struct SearchStateChangeInfo
@@ -84,6 +96,14 @@ void TestContactSearchChan::onSearchResultReceived(
 {
     QCOMPARE(mChan->searchState(), ChannelContactSearchStateInProgress);
     mSearchResult = result;
+    mSearchResults.append(result);
+    mLoop->exit(0);
+}
+
+void TestContactSearchChan::onRawSearchResultReceived(const Tp::ContactSearchResultMap &result)
+{
+    QCOMPARE(mChan->searchState(), ChannelContactSearchStateInProgress);
+    mRawSearchResults.append(result);
     mLoop->exit(0);
 }
 
@@ -129,12 +149,32 @@ void TestContactSearchChan::initTestCase()
                 "connection", mConn->service(),
                 "object-path", chan2Path.data(),
                 NULL));
+
+    QByteArray chan3Path;
+    mChan3Path = mConn->objectPath() + QLatin1String("/ContactSearchChannel/3");
+    chan3Path = mChan3Path.toLatin1();
+    mChan3Service = TP_TESTS_CONTACT_SEARCH_CHANNEL(g_object_new(
+                TP_TESTS_TYPE_CONTACT_SEARCH_CHANNEL,
+                "connection", mConn->service(),
+                "object-path", chan3Path.data(),
+                NULL));
+
+    QByteArray chan4Path;
+    mChan4Path = mConn->objectPath() + QLatin1String("/ContactSearchChannel/4");
+    chan4Path = mChan4Path.toLatin1();
+    mChan4Service = TP_TESTS_CONTACT_SEARCH_CHANNEL(g_object_new(
+                TP_TESTS_TYPE_CONTACT_SEARCH_CHANNEL,
+                "connection", mConn->service(),
+                "object-path", chan4Path.data(),
+                NULL));
 }
 
 void TestContactSearchChan::init()
 {
     initImpl();
     mSearchResult.clear();
+    mSearchResults.clear();
+    mRawSearchResults.clear();
     mSearchStateChangeInfoList.clear();
     mSearchReturned = false;
 }
@@ -283,6 +323,123 @@ void TestContactSearchChan::testContactSearchEmptyResult()
     mChan2.reset();
 }
 
+void TestContactSearchChan::testContactSearchRawResult()
+{
+    mChan3 = ContactSearchChannel::create(mConn->client(), mChan3Path, QVariantMap());
+    mChan = mChan3;
+    QVERIFY(connect(mChan3->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mChan3->isReady(), true);
+
+    QCOMPARE(mChan3->isContactResolutionEnabled(), true);
+    mChan3->setContactResolutionEnabled(false);
+    QCOMPARE(mChan3->isContactResolutionEnabled(), false);
+
+    QVERIFY(connect(mChan3.data(),
+                SIGNAL(searchStateChanged(Tp::ChannelContactSearchState, const QString &,
+                        const Tp::ContactSearchChannel::SearchStateChangeDetails &)),
+                SLOT(onSearchStateChanged(Tp::ChannelContactSearchState, const QString &,
+                        const Tp::ContactSearchChannel::SearchStateChangeDetails &))));
+    QVERIFY(connect(mChan3.data(),
+                SIGNAL(searchResultReceived(const Tp::ContactSearchChannel::SearchResult &)),
+                SLOT(onSearchResultReceived(const Tp::ContactSearchChannel::SearchResult &))));
+    QVERIFY(connect(mChan3.data(),
+                SIGNAL(rawSearchResultReceived(const Tp::ContactSearchResultMap &)),
+                SLOT(onRawSearchResultReceived(const Tp::ContactSearchResultMap &))));
+
+    QVERIFY(connect(mChan3->search(QLatin1String("employer"), QLatin1String("Collabora")),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(onSearchReturned(Tp::PendingOperation *))));
+    while (!mSearchReturned) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    while (mChan3->searchState() != ChannelContactSearchStateCompleted) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+
+    // The result is signalled raw, in order between the state changes, and no contacts are built
+    QCOMPARE(mSearchStateChangeInfoList.count(), 2);
+    QCOMPARE(mSearchResult.isEmpty(), true);
+    QCOMPARE(mRawSearchResults.size(), 1);
+
+    ContactSearchResultMap result = mRawSearchResults.first();
+    QStringList ids = result.keys();
+    ids.sort();
+    QCOMPARE(ids, QStringList() << QLatin1String("andrunko") << QLatin1String("oggis") <<
+            QLatin1String("wjt"));
+    QCOMPARE(result.value(QLatin1String("wjt")).size(), 1);
+    QCOMPARE(result.value(QLatin1String("wjt")).first().fieldName, QLatin1String("fn"));
+    QCOMPARE(result.value(QLatin1String("wjt")).first().fieldValue,
+            QStringList() << QLatin1String("Will Thompson"));
+
+    mChan3.reset();
+}
+
+void TestContactSearchChan::testContactSearchPipelined()
+{
+    mChan4 = ContactSearchChannel::create(mConn->client(), mChan4Path, QVariantMap());
+    mChan = mChan4;
+    QVERIFY(connect(mChan4->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mChan4->isReady(), true);
+
+    // Some of the contacts are already known, so looking them up takes fewer round trips and
+    // completes before the lookups for the pages before them
+    QList<ContactPtr> known = mConn->contacts(QStringList() << QLatin1String("juliet") <<
+            QLatin1String("ophelia") << QLatin1String("puck"));
+    QCOMPARE(known.size(), 3);
+
+    QVERIFY(connect(mChan4.data(),
+                SIGNAL(searchStateChanged(Tp::ChannelContactSearchState, const QString &,
+                        const Tp::ContactSearchChannel::SearchStateChangeDetails &)),
+                SLOT(onSearchStateChanged(Tp::ChannelContactSearchState, const QString &,
+                        const Tp::ContactSearchChannel::SearchStateChangeDetails &))));
+    QVERIFY(connect(mChan4.data(),
+                SIGNAL(searchResultReceived(const Tp::ContactSearchChannel::SearchResult &)),
+                SLOT(onSearchResultReceived(const Tp::ContactSearchChannel::SearchResult &))));
+
+    // One page per contact, more pages than contact lookups are run at once
+    tp_tests_contact_search_channel_set_page_size(mChan4Service, 1);
+    QVERIFY(connect(mChan4->search(QLatin1String("employer"), QLatin1String("Globe Theatre")),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(onSearchReturned(Tp::PendingOperation *))));
+    while (!mSearchReturned) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    while (mChan4->searchState() != ChannelContactSearchStateCompleted) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+
+    // Every page is delivered, in the order it was received, between the state changes
+    QCOMPARE(mSearchStateChangeInfoList.count(), 2);
+    QCOMPARE(mSearchStateChangeInfoList.at(1).state, ChannelContactSearchStateCompleted);
+    QCOMPARE(mSearchResults.size(), 6);
+
+    QStringList ids;
+    QStringList fns;
+    Q_FOREACH (const ContactSearchChannel::SearchResult &result, mSearchResults) {
+        QCOMPARE(result.size(), 1);
+        QCOMPARE(result.constBegin().key().isNull(), false);
+        ids << result.constBegin().key()->id();
+        fns << result.constBegin().value().allFields().first().fieldValue.first();
+    }
+    QCOMPARE(ids, QStringList() << QLatin1String("romeo") << QLatin1String("juliet") <<
+            QLatin1String("hamlet") << QLatin1String("ophelia") << QLatin1String("macbeth") <<
+            QLatin1String("puck"));
+    QCOMPARE(fns.first(), QLatin1String("Romeo Montague"));
+    QCOMPARE(fns.last(), QLatin1String("Robin Goodfellow"));
+
+    // The contacts which were already known are reused
+    QVERIFY(known.contains(mSearchResults.at(1).constBegin().key()));
+    QVERIFY(known.contains(mSearchResults.at(5).constBegin().key()));
+
+    mChan4.reset();
+}
+
 void TestContactSearchChan::cleanup()
 {
     cleanupImpl();
@@ -303,6 +460,16 @@ void TestContactSearchChan::cleanupTestCase()
         mChan2Service = 0;
     }
 
+    if (mChan3Service != 0) {
+        g_object_unref(mChan3Service);
+        mChan3Service = 0;
+    }
+
+    if (mChan4Service != 0) {
+        g_object_unref(mChan4Service);
+        mChan4Service = 0;
+    }
+
     cleanupTestCaseImpl();
 }
 
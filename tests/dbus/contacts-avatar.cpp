@@ -8,6 +8,7 @@
 #include <TelepathyQt/Connection>
 #include <TelepathyQt/Contact>
 #include <TelepathyQt/ContactManager>
+#include <TelepathyQt/DBusCallScheduler>
 #include <TelepathyQt/PendingContacts>
 
 #include <telepathy-glib/debug.h>
@@ -280,6 +281,9 @@ void TestContactsAvatar::testRequestAvatars()
     }
 
     // let's call ContactManager::requestContactAvatars now, it should update all contacts
+    QDBusConnection bus = mConn->client()->dbusConnection();
+    DBusCallScheduler::Statistics bulkStatistics =
+        DBusCallScheduler::statistics(bus, DBusCallScheduler::PriorityBulk);
     mAvatarDatasChanged = 0;
     mConn->client()->contactManager()->requestContactAvatars(contacts);
     processDBusQueue(mConn->client().data());
@@ -289,6 +293,12 @@ void TestContactsAvatar::testRequestAvatars()
         mLoop->processEvents();
     }
 
+    // the avatars were requested through bulk calls
+    QVERIFY(DBusCallScheduler::statistics(bus, DBusCallScheduler::PriorityBulk).issued >
+            bulkStatistics.issued);
+    QCOMPARE(DBusCallScheduler::statistics(bus, DBusCallScheduler::PriorityBulk).queued, 0U);
+    QCOMPARE(DBusCallScheduler::maxInFlightCalls(bus), 4U);
+
     // check the only half got the updates
     QCOMPARE(mAvatarDatasChanged, contacts.size() / 2);
 
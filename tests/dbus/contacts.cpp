@@ -13,6 +13,7 @@
 #include <TelepathyQt/Contact>
 #include <TelepathyQt/ContactFactory>
 #include <TelepathyQt/ContactManager>
+#include <TelepathyQt/DBusCallScheduler>
 #include <TelepathyQt/PendingContacts>
 #include <TelepathyQt/PendingVoid>
 #include <TelepathyQt/PendingReady>
@@ -262,6 +263,7 @@ void TestContacts::testForHandles()
     QVERIFY(!tp_handle_is_valid(serviceRepo, handles[4], NULL));
 
     // Get contacts for the mixture of valid and invalid handles
+    DBusCallScheduler::resetStatistics(mConn->dbusConnection());
     PendingContacts *pending = mConn->contactManager()->contactsForHandles(handles);
 
     // Test the closure accessors
@@ -280,6 +282,10 @@ void TestContacts::testForHandles()
                 SLOT(expectPendingContactsFinished(Tp::PendingOperation*))));
     QCOMPARE(mLoop->exec(), 0);
 
+    // The attributes were fetched through the scheduler, without being held back
+    QVERIFY(DBusCallScheduler::statistics(mConn->dbusConnection(),
+                DBusCallScheduler::PriorityInteractive).issued > 0);
+
     // There should be 3 resulting contacts and 2 handles found to be invalid
     QCOMPARE(mContacts.size(), 3);
 
@@ -0,0 +1,510 @@
+#include <QtCore/QDebug>
+
+#include <QtDBus/QtDBus>
+
+#include <QtTest/QtTest>
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusCallScheduler>
+#include "TelepathyQt/dbus-call-queue-internal.h"
+
+#include <tests/lib/test.h>
+
+using namespace Tp;
+
+namespace
+{
+
+QString serviceName()
+{
+    return QLatin1String("org.freedesktop.Telepathy.Qt.TestDBusCallQueue");
+}
+
+QString objectPath()
+{
+    return QLatin1String("/org/freedesktop/Telepathy/Qt/TestDBusCallQueue");
+}
+
+}
+
+// Holds back the replies to the calls made to it until the test releases them, so that the calls
+// stay in flight for as long as needed
+class HoldingService : public QObject, public QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Qt.TestDBusCallQueue")
+
+public:
+    HoldingService(const QDBusConnection &bus, QObject *parent = 0)
+        : QObject(parent),
+          mBus(bus)
+    {
+    }
+
+    // The tags of the calls received, in the order they arrived in
+    QStringList received() const { return mReceived; }
+
+    void clear()
+    {
+        mReceived.clear();
+    }
+
+    void release(const QString &tag)
+    {
+        for (int i = 0; i < mHeld.size(); ++i) {
+            if (mHeld[i].arguments().first().toString() == tag) {
+                QDBusMessage message = mHeld.takeAt(i);
+                mBus.send(message.createReply(tag));
+                return;
+            }
+        }
+    }
+
+    void releaseAll()
+    {
+        while (!mHeld.isEmpty()) {
+            QDBusMessage message = mHeld.takeFirst();
+            mBus.send(message.createReply(message.arguments().first()));
+        }
+    }
+
+public Q_SLOTS:
+    QString Hold(const QString &tag)
+    {
+        setDelayedReply(true);
+        mReceived.append(tag);
+        mHeld.append(message());
+        return QString();
+    }
+
+private:
+    QDBusConnection mBus;
+    QStringList mReceived;
+    QList<QDBusMessage> mHeld;
+};
+
+class TestDBusCallQueue : public Test
+{
+    Q_OBJECT
+
+public:
+    TestDBusCallQueue(QObject *parent = 0)
+        : Test(parent), mService(0), mQueue(0), mDefaultMaxInFlightCalls(0)
+    { }
+
+protected Q_SLOTS:
+    void onCallFinished(Tp::PendingOperation *op);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void testLimit();
+    void testInteractive();
+    void testBackgroundShare();
+    void testRoundRobin();
+    void testSetMaxInFlightCalls();
+    void testExpedite();
+    void testCancel();
+    void testReconnect();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    QDBusMessage holdMessage(const QString &tag) const;
+    DBusCallQueue::PendingCall *call(DBusCallScheduler::Priority priority,
+            const QString &origin, const QString &tag);
+    void callNow(const QString &tag);
+    void waitForReceived(int count);
+    void releaseUntilReceived(int count);
+    void waitForFinished(int count);
+
+    HoldingService *mService;
+    DBusCallQueue *mQueue;
+    uint mDefaultMaxInFlightCalls;
+
+    QHash<PendingOperation *, QString> mTags;
+    QStringList mFinished;
+    QStringList mFinishedErrors;
+};
+
+void TestDBusCallQueue::onCallFinished(Tp::PendingOperation *op)
+{
+    mFinished.append(mTags.take(op));
+    mFinishedErrors.append(op->isError() ? op->errorName() : QString());
+}
+
+QDBusMessage TestDBusCallQueue::holdMessage(const QString &tag) const
+{
+    QDBusMessage message = QDBusMessage::createMethodCall(serviceName(), objectPath(),
+            QLatin1String("org.freedesktop.Telepathy.Qt.TestDBusCallQueue"),
+            QLatin1String("Hold"));
+    message << tag;
+    return message;
+}
+
+DBusCallQueue::PendingCall *TestDBusCallQueue::call(DBusCallScheduler::Priority priority,
+        const QString &origin, const QString &tag)
+{
+    DBusCallQueue::PendingCall *call = mQueue->call(holdMessage(tag), priority, origin,
+            SharedPtr<RefCounted>());
+    mTags.insert(call, tag);
+    connect(call,
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(onCallFinished(Tp::PendingOperation*)));
+    return call;
+}
+
+void TestDBusCallQueue::callNow(const QString &tag)
+{
+    // Nothing waits for the reply but the queue itself, which needs it to free the slot
+    mQueue->callNow(holdMessage(tag));
+}
+
+void TestDBusCallQueue::waitForReceived(int count)
+{
+    while (mService->received().size() < count) {
+        mLoop->processEvents();
+    }
+}
+
+// With a limit of one call in flight, each reply lets exactly one held back call through, so the
+// order the service receives the calls in is the order they were issued in
+void TestDBusCallQueue::releaseUntilReceived(int count)
+{
+    while (mService->received().size() < count) {
+        mService->releaseAll();
+        mLoop->processEvents();
+    }
+}
+
+void TestDBusCallQueue::waitForFinished(int count)
+{
+    while (mFinished.size() < count) {
+        mLoop->processEvents();
+    }
+}
+
+void TestDBusCallQueue::initTestCase()
+{
+    initTestCaseImpl();
+
+    // The service is on a connection of its own, so that the calls to it go through the bus
+    // rather than being delivered locally
+    QDBusConnection serviceBus = QDBusConnection::connectToBus(QDBusConnection::SessionBus,
+            QLatin1String("dbus-call-queue-service"));
+    QVERIFY(serviceBus.isConnected());
+    mService = new HoldingService(serviceBus, this);
+    QVERIFY(serviceBus.registerService(serviceName()));
+    QVERIFY(serviceBus.registerObject(objectPath(), mService, QDBusConnection::ExportAllSlots));
+
+    mQueue = DBusCallQueue::forBus(QDBusConnection::sessionBus());
+    mDefaultMaxInFlightCalls = mQueue->maxInFlightCalls();
+    QCOMPARE(mDefaultMaxInFlightCalls, 4U);
+}
+
+void TestDBusCallQueue::init()
+{
+    initImpl();
+
+    mService->clear();
+    mQueue->resetStatistics();
+    mTags.clear();
+    mFinished.clear();
+    mFinishedErrors.clear();
+}
+
+void TestDBusCallQueue::testLimit()
+{
+    mQueue->setMaxInFlightCalls(2);
+
+    DBusCallQueue::PendingCall *a1 = call(DBusCallScheduler::PriorityBackground,
+            QLatin1String("a"), QLatin1String("a1"));
+    DBusCallQueue::PendingCall *a2 = call(DBusCallScheduler::PriorityBackground,
+            QLatin1String("a"), QLatin1String("a2"));
+    DBusCallQueue::PendingCall *a3 = call(DBusCallScheduler::PriorityBackground,
+            QLatin1String("a"), QLatin1String("a3"));
+    DBusCallQueue::PendingCall *b1 = call(DBusCallScheduler::PriorityBulk,
+            QLatin1String("b"), QLatin1String("b1"));
+
+    // Background and bulk calls alike are held back once the limit is reached
+    QVERIFY(a1->isIssued());
+    QVERIFY(a2->isIssued());
+    QVERIFY(!a3->isIssued());
+    QVERIFY(!b1->isIssued());
+
+    DBusCallScheduler::Statistics background =
+        mQueue->statistics(DBusCallScheduler::PriorityBackground);
+    QCOMPARE(background.queued, 1U);
+    QCOMPARE(background.inFlight, 2U);
+    QCOMPARE(background.issued, 2U);
+    DBusCallScheduler::Statistics bulk = mQueue->statistics(DBusCallScheduler::PriorityBulk);
+    QCOMPARE(bulk.queued, 1U);
+    QCOMPARE(bulk.inFlight, 0U);
+    QCOMPARE(bulk.issued, 0U);
+
+    waitForReceived(2);
+    QCOMPARE(mService->received(), QStringList() << QLatin1String("a1") << QLatin1String("a2"));
+
+    // Each reply makes room for one more
+    mService->releaseAll();
+    waitForFinished(2);
+    QCOMPARE(mFinished, QStringList() << QLatin1String("a1") << QLatin1String("a2"));
+    QVERIFY(a3->isIssued());
+    QVERIFY(b1->isIssued());
+
+    waitForReceived(4);
+    mService->releaseAll();
+    waitForFinished(4);
+    QCOMPARE(mFinishedErrors, QStringList() << QString() << QString() << QString() << QString());
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).inFlight, 0U);
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBulk).inFlight, 0U);
+}
+
+void TestDBusCallQueue::testInteractive()
+{
+    mQueue->setMaxInFlightCalls(1);
+
+    DBusCallQueue::PendingCall *x1 = call(DBusCallScheduler::PriorityBackground,
+            QLatin1String("x"), QLatin1String("x1"));
+    QVERIFY(x1->isIssued());
+
+    // Interactive calls are issued even though the limit has been reached already
+    callNow(QLatin1String("now"));
+    DBusCallScheduler::Statistics interactive =
+        mQueue->statistics(DBusCallScheduler::PriorityInteractive);
+    QCOMPARE(interactive.queued, 0U);
+    QCOMPARE(interactive.inFlight, 1U);
+    QCOMPARE(interactive.issued, 1U);
+    waitForReceived(2);
+    QCOMPARE(mService->received(), QStringList() << QLatin1String("x1") << QLatin1String("now"));
+
+    DBusCallQueue::PendingCall *x2 = call(DBusCallScheduler::PriorityBackground,
+            QLatin1String("x"), QLatin1String("x2"));
+    QVERIFY(!x2->isIssued());
+
+    // But they count towards the limit, so the interactive call still in flight keeps the next
+    // background call waiting once the first one is done
+    mService->release(QLatin1String("x1"));
+    waitForFinished(1);
+    QCOMPARE(mFinished, QStringList() << QLatin1String("x1"));
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityInteractive).inFlight, 1U);
+    QVERIFY(!x2->isIssued());
+
+    mService->release(QLatin1String("now"));
+    while (mQueue->statistics(DBusCallScheduler::PriorityInteractive).inFlight > 0) {
+        mLoop->processEvents();
+    }
+    QVERIFY(x2->isIssued());
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).queued, 0U);
+    waitForReceived(3);
+}
+
+void TestDBusCallQueue::testBackgroundShare()
+{
+    mQueue->setMaxInFlightCalls(1);
+
+    // The interactive call keeps everything else waiting, without taking a turn of its own
+    callNow(QLatin1String("blocker"));
+    waitForReceived(1);
+
+    QStringList expected;
+    expected << QLatin1String("blocker");
+    for (int i = 1; i <= 4; ++i) {
+        QString tag = QString(QLatin1String("background%1")).arg(i);
+        QVERIFY(!call(DBusCallScheduler::PriorityBackground, QLatin1String("background"),
+                    tag)->isIssued());
+    }
+    for (int i = 1; i <= 2; ++i) {
+        QString tag = QString(QLatin1String("bulk%1")).arg(i);
+        QVERIFY(!call(DBusCallScheduler::PriorityBulk, QLatin1String("bulk"), tag)->isIssued());
+    }
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).queued, 4U);
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBulk).queued, 2U);
+
+    // Bulk calls get one turn for every three background calls, and all of the turns once there
+    // are no background calls left
+    releaseUntilReceived(7);
+    expected << QLatin1String("background1") << QLatin1String("background2") <<
+        QLatin1String("background3") << QLatin1String("bulk1") <<
+        QLatin1String("background4") << QLatin1String("bulk2");
+    QCOMPARE(mService->received(), expected);
+}
+
+void TestDBusCallQueue::testRoundRobin()
+{
+    mQueue->setMaxInFlightCalls(1);
+
+    callNow(QLatin1String("blocker"));
+    waitForReceived(1);
+
+    call(DBusCallScheduler::PriorityBackground, QLatin1String("a"), QLatin1String("a1"));
+    call(DBusCallScheduler::PriorityBackground, QLatin1String("a"), QLatin1String("a2"));
+    call(DBusCallScheduler::PriorityBackground, QLatin1String("a"), QLatin1String("a3"));
+    call(DBusCallScheduler::PriorityBackground, QLatin1String("b"), QLatin1String("b1"));
+    call(DBusCallScheduler::PriorityBackground, QLatin1String("c"), QLatin1String("c1"));
+    call(DBusCallScheduler::PriorityBackground, QLatin1String("b"), QLatin1String("b2"));
+
+    // The calls are taken from one origin after the other, rather than in the order they were made
+    releaseUntilReceived(7);
+    QCOMPARE(mService->received(), QStringList() << QLatin1String("blocker") <<
+            QLatin1String("a1") << QLatin1String("b1") << QLatin1String("c1") <<
+            QLatin1String("a2") << QLatin1String("b2") << QLatin1String("a3"));
+}
+
+void TestDBusCallQueue::testSetMaxInFlightCalls()
+{
+    mQueue->setMaxInFlightCalls(1);
+
+    callNow(QLatin1String("blocker"));
+    DBusCallQueue::PendingCall *c1 = call(DBusCallScheduler::PriorityBackground,
+            QLatin1String("c"), QLatin1String("c1"));
+    DBusCallQueue::PendingCall *c2 = call(DBusCallScheduler::PriorityBackground,
+            QLatin1String("c"), QLatin1String("c2"));
+    DBusCallQueue::PendingCall *c3 = call(DBusCallScheduler::PriorityBackground,
+            QLatin1String("c"), QLatin1String("c3"));
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).queued, 3U);
+
+    // Raising the limit lets as many of the waiting calls through as it makes room for
+    mQueue->setMaxInFlightCalls(3);
+    QCOMPARE(mQueue->maxInFlightCalls(), 3U);
+    QVERIFY(c1->isIssued());
+    QVERIFY(c2->isIssued());
+    QVERIFY(!c3->isIssued());
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).queued, 1U);
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).inFlight, 2U);
+
+    // And removing it lets all of them through
+    mQueue->setMaxInFlightCalls(0);
+    QVERIFY(c3->isIssued());
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).queued, 0U);
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).inFlight, 3U);
+
+    waitForReceived(4);
+}
+
+void TestDBusCallQueue::testExpedite()
+{
+    mQueue->setMaxInFlightCalls(1);
+
+    callNow(QLatin1String("blocker"));
+    DBusCallQueue::PendingCall *prefetch = call(DBusCallScheduler::PriorityBackground,
+            QLatin1String("p"), QLatin1String("prefetch"));
+    QVERIFY(!prefetch->isIssued());
+
+    // Somebody now waits for the reply, so the call is issued right away, regardless of the limit
+    mQueue->expedite(prefetch);
+    QVERIFY(prefetch->isIssued());
+    DBusCallScheduler::Statistics background =
+        mQueue->statistics(DBusCallScheduler::PriorityBackground);
+    QCOMPARE(background.queued, 0U);
+    QCOMPARE(background.inFlight, 1U);
+    QCOMPARE(background.issued, 1U);
+
+    waitForReceived(2);
+    QCOMPARE(mService->received(), QStringList() << QLatin1String("blocker") <<
+            QLatin1String("prefetch"));
+
+    // Expediting a call which has been issued already is harmless
+    mQueue->expedite(prefetch);
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).issued, 1U);
+
+    mService->releaseAll();
+    waitForFinished(1);
+    QCOMPARE(mFinished, QStringList() << QLatin1String("prefetch"));
+    QCOMPARE(mFinishedErrors, QStringList() << QString());
+}
+
+void TestDBusCallQueue::testCancel()
+{
+    mQueue->setMaxInFlightCalls(1);
+
+    callNow(QLatin1String("blocker"));
+    DBusCallQueue::PendingCall *dropped = call(DBusCallScheduler::PriorityBackground,
+            QLatin1String("d"), QLatin1String("dropped"));
+    DBusCallQueue::PendingCall *kept = call(DBusCallScheduler::PriorityBulk,
+            QLatin1String("k"), QLatin1String("kept"));
+
+    // A call which is still waiting is dropped without ever being made
+    mQueue->cancel(dropped);
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).queued, 0U);
+    waitForFinished(1);
+    QCOMPARE(mFinished, QStringList() << QLatin1String("dropped"));
+    QCOMPARE(mFinishedErrors, QStringList() << TP_QT_ERROR_CANCELLED);
+
+    releaseUntilReceived(2);
+    QCOMPARE(mService->received(), QStringList() << QLatin1String("blocker") <<
+            QLatin1String("kept"));
+    QVERIFY(kept->isIssued());
+
+    // A call which has been issued already can't be taken back, and its reply is still delivered
+    mQueue->cancel(kept);
+    mService->releaseAll();
+    waitForFinished(2);
+    QCOMPARE(mFinished, QStringList() << QLatin1String("dropped") << QLatin1String("kept"));
+    QCOMPARE(mFinishedErrors, QStringList() << TP_QT_ERROR_CANCELLED << QString());
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBackground).issued, 0U);
+    QCOMPARE(mQueue->statistics(DBusCallScheduler::PriorityBulk).issued, 1U);
+}
+
+void TestDBusCallQueue::testReconnect()
+{
+    QString name = QLatin1String("dbus-call-queue-reconnect");
+    QDBusConnection bus = QDBusConnection::connectToBus(QDBusConnection::SessionBus, name);
+    QVERIFY(bus.isConnected());
+    DBusCallScheduler::setMaxInFlightCalls(bus, 7);
+    QCOMPARE(DBusCallScheduler::maxInFlightCalls(bus), 7U);
+
+    // Callers still holding on to the connection after it goes away keep seeing its queue
+    QDBusConnection::disconnectFromBus(name);
+    QVERIFY(!bus.isConnected());
+    QCOMPARE(DBusCallScheduler::maxInFlightCalls(bus), 7U);
+
+    // But connecting again under the same name starts afresh
+    QDBusConnection otherBus = QDBusConnection::connectToBus(QDBusConnection::SessionBus, name);
+    QVERIFY(otherBus.isConnected());
+    QCOMPARE(DBusCallScheduler::maxInFlightCalls(otherBus), mDefaultMaxInFlightCalls);
+
+    QDBusConnection::disconnectFromBus(name);
+}
+
+void TestDBusCallQueue::cleanup()
+{
+    // Let whatever is left through, so that the next test starts with nothing in flight
+    mQueue->setMaxInFlightCalls(0);
+    for (;;) {
+        uint pending = 0;
+        for (int priority = DBusCallScheduler::PriorityInteractive;
+                priority <= DBusCallScheduler::PriorityBulk; ++priority) {
+            DBusCallScheduler::Statistics stats =
+                mQueue->statistics((DBusCallScheduler::Priority) priority);
+            pending += stats.queued + stats.inFlight;
+        }
+        if (pending == 0) {
+            break;
+        }
+
+        mService->releaseAll();
+        mLoop->processEvents();
+    }
+
+    // The calls finish from the mainloop
+    while (!mTags.isEmpty()) {
+        mLoop->processEvents();
+    }
+
+    mQueue->setMaxInFlightCalls(mDefaultMaxInFlightCalls);
+
+    cleanupImpl();
+}
+
+void TestDBusCallQueue::cleanupTestCase()
+{
+    QDBusConnection::disconnectFromBus(QLatin1String("dbus-call-queue-service"));
+
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(TestDBusCallQueue)
+#include "_gen/dbus-call-queue.cpp.moc.hpp"
@@ -57,6 +57,8 @@ public:
 protected Q_SLOTS:
     void onBusNameAdded(const QString &busName, const Tp::ContactPtr &contact);
     void onBusNameRemoved(const QString &busName, const Tp::ContactPtr &contact);
+    void onBusNamesAdded(const QHash<QString, Tp::ContactPtr> &busNames);
+    void onBusNamesRemoved(const QHash<QString, Tp::ContactPtr> &busNames);
     void onOfferFinished(Tp::PendingOperation *op);
     void expectPendingTubeConnectionFinished(Tp::PendingOperation *op);
 
@@ -69,6 +71,7 @@ private Q_SLOTS:
     void testAcceptFail();
     void testOfferSuccess();
     void testOutgoingBusNameMonitoring();
+    void testBusNamesChangedBatches();
     void testExtractBusNameMonitoring();
     void testAcceptCornerCases();
     void testOfferCornerCases();
@@ -90,6 +93,9 @@ private:
     QHash<QString, Tp::ContactPtr> mCurrentContactsForBusNames;
     bool mBusNameWasAdded;
     bool mBusNameWasRemoved;
+    // The busNamesAdded()/busNamesRemoved() batches, in order, with the added ones prefixed by + and
+    // the removed ones by -
+    QStringList mBusNamesBatches;
     bool mOfferFinished;
     bool mAllowsOtherUsers;
 
@@ -127,6 +133,32 @@ void TestDBusTubeChan::onBusNameRemoved(const QString &busName,
     mLoop->quit();
 }
 
+void TestDBusTubeChan::onBusNamesAdded(const QHash<QString, Tp::ContactPtr> &busNames)
+{
+    QStringList names = busNames.keys();
+    names.sort();
+    mBusNamesBatches.append(QLatin1Char('+') + names.join(QLatin1String(",")));
+
+    for (QHash<QString, ContactPtr>::const_iterator i = busNames.constBegin();
+            i != busNames.constEnd(); ++i) {
+        QVERIFY(mChan->contactForBusName(i.key()) == i.value());
+        QCOMPARE(mChan->busNameForContact(i.value()), i.key());
+    }
+}
+
+void TestDBusTubeChan::onBusNamesRemoved(const QHash<QString, Tp::ContactPtr> &busNames)
+{
+    QStringList names = busNames.keys();
+    names.sort();
+    mBusNamesBatches.append(QLatin1Char('-') + names.join(QLatin1String(",")));
+
+    for (QHash<QString, ContactPtr>::const_iterator i = busNames.constBegin();
+            i != busNames.constEnd(); ++i) {
+        QVERIFY(mChan->contactForBusName(i.key()).isNull());
+        QCOMPARE(mChan->busNameForContact(i.value()), QString());
+    }
+}
+
 void TestDBusTubeChan::onOfferFinished(Tp::PendingOperation *op)
 {
     TEST_VERIFY_OP(op);
@@ -240,6 +272,7 @@ void TestDBusTubeChan::init()
 
     mBusNameWasAdded = false;
     mBusNameWasRemoved = false;
+    mBusNamesBatches.clear();
     mOfferFinished = false;
     mAllowsOtherUsers = false;
 
@@ -517,6 +550,12 @@ void TestDBusTubeChan::testOutgoingBusNameMonitoring()
     QVERIFY(connect(mChan.data(),
                     SIGNAL(busNameRemoved(QString,Tp::ContactPtr)),
                     SLOT(onBusNameRemoved(QString,Tp::ContactPtr))));
+    QVERIFY(connect(mChan.data(),
+                    SIGNAL(busNamesAdded(QHash<QString,Tp::ContactPtr>)),
+                    SLOT(onBusNamesAdded(QHash<QString,Tp::ContactPtr>))));
+    QVERIFY(connect(mChan.data(),
+                    SIGNAL(busNamesRemoved(QHash<QString,Tp::ContactPtr>)),
+                    SLOT(onBusNamesRemoved(QHash<QString,Tp::ContactPtr>))));
 
     OutgoingDBusTubeChannelPtr chan = OutgoingDBusTubeChannelPtr::qObjectCast(mChan);
     QVERIFY(connect(chan->offerTube(QVariantMap()), // DISCARD
@@ -527,6 +566,8 @@ void TestDBusTubeChan::testOutgoingBusNameMonitoring()
         mLoop->processEvents();
     }
 
+    QVERIFY(mChan->contactForBusName(QLatin1String("org.not.seen.yet")).isNull());
+
     // Simulate a peer connection from someone we don't have a prebuilt contact for yet, and
     // immediately drop it
     TpHandleRepoIface *contactRepo = tp_base_connection_get_handles(
@@ -548,16 +589,121 @@ void TestDBusTubeChan::testOutgoingBusNameMonitoring()
     }
 
     QCOMPARE(mChan->contactsForBusNames().size(), 1);
+    QCOMPARE(mBusNamesBatches, QStringList() << QLatin1String("+org.not.seen.yet"));
+    ContactPtr contact = mChan->contactForBusName(mExpectedBusName);
+    QVERIFY(!contact.isNull());
+    QCOMPARE(contact->handle().first(), mExpectedHandle);
+    QCOMPARE(mChan->busNameForContact(contact), mExpectedBusName);
 
     // The busNameRemoved emission should finally exit the main loop
     QCOMPARE(mLoop->exec(), 0);
     QVERIFY(mBusNameWasRemoved);
+    QCOMPARE(mBusNamesBatches, QStringList() << QLatin1String("+org.not.seen.yet") <<
+            QLatin1String("-org.not.seen.yet"));
 
     QCOMPARE(mChan->contactsForBusNames().size(), 0);
+    QVERIFY(mChan->contactForBusName(mExpectedBusName).isNull());
+    QCOMPARE(mChan->busNameForContact(contact), QString());
 
     g_free (service);
 }
 
+void TestDBusTubeChan::testBusNamesChangedBatches()
+{
+    mCurrentContext = 0; // should point to room, localhost
+    createTubeChannel(true, TP_SOCKET_ADDRESS_TYPE_UNIX, TP_SOCKET_ACCESS_CONTROL_LOCALHOST, false);
+    QVERIFY(connect(mChan->becomeReady(OutgoingDBusTubeChannel::FeatureCore |
+                    DBusTubeChannel::FeatureBusNameMonitoring),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    QVERIFY(connect(mChan.data(),
+                    SIGNAL(busNamesAdded(QHash<QString,Tp::ContactPtr>)),
+                    SLOT(onBusNamesAdded(QHash<QString,Tp::ContactPtr>))));
+    QVERIFY(connect(mChan.data(),
+                    SIGNAL(busNamesRemoved(QHash<QString,Tp::ContactPtr>)),
+                    SLOT(onBusNamesRemoved(QHash<QString,Tp::ContactPtr>))));
+
+    OutgoingDBusTubeChannelPtr chan = OutgoingDBusTubeChannelPtr::qObjectCast(mChan);
+    QVERIFY(connect(chan->offerTube(QVariantMap()), // DISCARD
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(onOfferFinished(Tp::PendingOperation *))));
+
+    while (mChan->state() != TubeChannelStateRemotePending) {
+        mLoop->processEvents();
+    }
+
+    // Carol and Dave are built already, so their batch is likely to be ready before the removal
+    // queued ahead of it has been applied
+    QList<ContactPtr> prebuilt = mConn->contacts(QStringList() << QLatin1String("carol") <<
+            QLatin1String("dave"));
+    QCOMPARE(prebuilt.size(), 2);
+
+    TpHandleRepoIface *contactRepo = tp_base_connection_get_handles(
+            TP_BASE_CONNECTION(mConn->service()), TP_HANDLE_TYPE_CONTACT);
+    TpHandle alice = tp_handle_ensure(contactRepo, "alice", NULL, NULL);
+    TpHandle bob = tp_handle_ensure(contactRepo, "bob", NULL, NULL);
+    TpHandle carol = tp_handle_ensure(contactRepo, "carol", NULL, NULL);
+    TpHandle dave = tp_handle_ensure(contactRepo, "dave", NULL, NULL);
+
+    // Several names at once, a removal followed by an addition, and a removal of names added by
+    // different batches
+    GHashTable *added = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GArray *removed = g_array_new(FALSE, FALSE, sizeof(TpHandle));
+    g_hash_table_insert(added, GUINT_TO_POINTER(alice), (gpointer) "org.example.alice");
+    g_hash_table_insert(added, GUINT_TO_POINTER(bob), (gpointer) "org.example.bob");
+    tp_tests_dbus_tube_channel_change_bus_names(mChanService, added, removed);
+
+    g_hash_table_remove_all(added);
+    g_array_append_val(removed, alice);
+    tp_tests_dbus_tube_channel_change_bus_names(mChanService, added, removed);
+
+    g_array_set_size(removed, 0);
+    g_hash_table_insert(added, GUINT_TO_POINTER(carol), (gpointer) "org.example.carol");
+    g_hash_table_insert(added, GUINT_TO_POINTER(dave), (gpointer) "org.example.dave");
+    tp_tests_dbus_tube_channel_change_bus_names(mChanService, added, removed);
+
+    g_hash_table_remove_all(added);
+    g_array_append_val(removed, bob);
+    g_array_append_val(removed, carol);
+    tp_tests_dbus_tube_channel_change_bus_names(mChanService, added, removed);
+
+    g_hash_table_unref(added);
+    g_array_unref(removed);
+
+    while (!mOfferFinished || mBusNamesBatches.size() < 4) {
+        mLoop->processEvents();
+    }
+
+    // None of the batches is lost, and they are applied in the order they were signalled
+    QCOMPARE(mBusNamesBatches, QStringList() <<
+            QLatin1String("+org.example.alice,org.example.bob") <<
+            QLatin1String("-org.example.alice") <<
+            QLatin1String("+org.example.carol,org.example.dave") <<
+            QLatin1String("-org.example.bob,org.example.carol"));
+
+    QCOMPARE(mChan->contactsForBusNames().size(), 1);
+    ContactPtr contact = mChan->contactForBusName(QLatin1String("org.example.dave"));
+    QVERIFY(!contact.isNull());
+    QCOMPARE(contact->handle().first(), dave);
+    QCOMPARE(mChan->busNameForContact(prebuilt.at(1)), QLatin1String("org.example.dave"));
+
+    // A change made once everything has been applied is still picked up
+    added = g_hash_table_new(g_direct_hash, g_direct_equal);
+    removed = g_array_new(FALSE, FALSE, sizeof(TpHandle));
+    g_hash_table_insert(added, GUINT_TO_POINTER(alice), (gpointer) "org.example.alice");
+    tp_tests_dbus_tube_channel_change_bus_names(mChanService, added, removed);
+    g_hash_table_unref(added);
+    g_array_unref(removed);
+
+    while (mBusNamesBatches.size() < 5) {
+        mLoop->processEvents();
+    }
+    QCOMPARE(mBusNamesBatches.last(), QLatin1String("+org.example.alice"));
+    QCOMPARE(mChan->contactsForBusNames().size(), 2);
+}
+
 void TestDBusTubeChan::testExtractBusNameMonitoring()
 {
     mCurrentContext = 0; // should point to room, localhost
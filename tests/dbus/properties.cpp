@@ -32,6 +32,7 @@ private Q_SLOTS:
     void init();
 
     void testPropertiesMonitoring();
+    void testSharedMonitoring();
 
     void cleanup();
     void cleanupTestCase();
@@ -89,6 +90,7 @@ void TestProperties::testPropertiesMonitoring()
 {
     QCOMPARE(mConn->isMonitoringProperties(), false);
     mConn->setMonitorProperties(true);
+    QCOMPARE(mConn->isMonitoringProperties(), true);
 
     QSignalSpy spy(mConn, SIGNAL(propertiesChanged(QVariantMap,QStringList)));
     connect(mConn, SIGNAL(propertiesChanged(QVariantMap,QStringList)),
@@ -126,6 +128,73 @@ void TestProperties::testPropertiesMonitoring()
     g_hash_table_destroy (changed);
 }
 
+void TestProperties::testSharedMonitoring()
+{
+    // Another instance for the same object shares the subscription, and both get the changes
+    Client::ConnectionInterface *otherConn = new Client::ConnectionInterface(mConnName, mConnPath,
+            this);
+    mConn->setMonitorProperties(true);
+    otherConn->setMonitorProperties(true);
+
+    QSignalSpy spy(mConn, SIGNAL(propertiesChanged(QVariantMap,QStringList)));
+    QSignalSpy otherSpy(otherConn, SIGNAL(propertiesChanged(QVariantMap,QStringList)));
+
+    GHashTable *first = tp_asv_new(
+                "test-prop", G_TYPE_STRING, "first",
+                "test-again", G_TYPE_UINT, 1U,
+                NULL
+                );
+    GHashTable *second = tp_asv_new(
+                "test-prop", G_TYPE_STRING, "second",
+                NULL
+                );
+
+    tp_svc_dbus_properties_emit_properties_changed (mConnService,
+            mConn->interface().toLatin1().data(), first, NULL);
+    tp_svc_dbus_properties_emit_properties_changed (mConnService,
+            mConn->interface().toLatin1().data(), second, NULL);
+
+    // Changes arriving together are merged, with the later value winning, so depending on how
+    // the messages are read from the bus there are one or two emissions
+    QVariantMap merged;
+    while (merged.value(QLatin1String("test-prop")).toString() != QLatin1String("second")) {
+        mLoop->processEvents();
+        while (!spy.isEmpty()) {
+            QVariantMap changed = spy.takeFirst().at(0).toMap();
+            for (QVariantMap::const_iterator i = changed.constBegin();
+                    i != changed.constEnd(); ++i) {
+                merged.insert(i.key(), i.value());
+            }
+        }
+    }
+    QCOMPARE(merged.value(QLatin1String("test-again")).toUInt(), 1U);
+
+    while (otherSpy.isEmpty()) {
+        mLoop->processEvents();
+    }
+    QVERIFY(otherSpy.count() <= 2);
+    QCOMPARE(otherSpy.last().at(0).toMap().value(QLatin1String("test-prop")).toString(),
+            QLatin1String("second"));
+
+    // Stopping one of them doesn't affect the other
+    otherConn->setMonitorProperties(false);
+    QCOMPARE(otherConn->isMonitoringProperties(), false);
+    otherSpy.clear();
+
+    tp_svc_dbus_properties_emit_properties_changed (mConnService,
+            mConn->interface().toLatin1().data(), first, NULL);
+    connect(mConn, SIGNAL(propertiesChanged(QVariantMap,QStringList)),
+            mLoop, SLOT(quit()));
+    mLoop->exec();
+
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(otherSpy.count(), 0);
+
+    delete otherConn;
+    g_hash_table_destroy (first);
+    g_hash_table_destroy (second);
+}
+
 void TestProperties::cleanup()
 {
     if (mConn) {
@@ -0,0 +1,270 @@
+#include <tests/lib/test.h>
+
+#include <tests/lib/glib-helpers/test-conn-helper.h>
+
+#include <tests/lib/glib/echo/conn.h>
+#include <tests/lib/glib/room-list-chan.h>
+
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/PendingReady>
+#include <TelepathyQt/RoomListChannel>
+
+#include <telepathy-glib/debug.h>
+
+using namespace Tp;
+
+class TestRoomListChan : public Test
+{
+    Q_OBJECT
+
+public:
+    TestRoomListChan(QObject *parent = 0)
+        : Test(parent),
+          mConn(0),
+          mChanService(0)
+    { }
+
+protected Q_SLOTS:
+    void onRoomsAdded(const QList<Tp::RoomListChannel::Room> &rooms);
+    void onListingRoomsChanged(bool listing);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void testRoomList();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    QStringList identifiers(const QList<RoomListChannel::Room> &rooms) const;
+
+    TestConnHelper *mConn;
+
+    RoomListChannelPtr mChan;
+
+    QString mChanPath;
+    TpTestsRoomListChannel *mChanService;
+
+    QList<QList<RoomListChannel::Room> > mRoomsAdded;
+    QList<bool> mListingRoomsChanges;
+};
+
+void TestRoomListChan::onRoomsAdded(const QList<Tp::RoomListChannel::Room> &rooms)
+{
+    mRoomsAdded.append(rooms);
+    mLoop->exit(0);
+}
+
+void TestRoomListChan::onListingRoomsChanged(bool listing)
+{
+    QCOMPARE(mChan->isListingRooms(), listing);
+    mListingRoomsChanges.append(listing);
+    mLoop->exit(0);
+}
+
+QStringList TestRoomListChan::identifiers(const QList<RoomListChannel::Room> &rooms) const
+{
+    QStringList ret;
+    Q_FOREACH (const RoomListChannel::Room &room, rooms) {
+        ret << room.identifier();
+    }
+    return ret;
+}
+
+void TestRoomListChan::initTestCase()
+{
+    initTestCaseImpl();
+
+    g_type_init();
+    g_set_prgname("room-list-chan");
+    tp_debug_set_flags("all");
+    dbus_g_bus_get(DBUS_BUS_STARTER, 0);
+
+    mConn = new TestConnHelper(this,
+            EXAMPLE_TYPE_ECHO_CONNECTION,
+            "account", "me@example.com",
+            "protocol", "example",
+            NULL);
+    QCOMPARE(mConn->connect(), true);
+
+    QByteArray chanPath;
+    mChanPath = mConn->objectPath() + QLatin1String("/RoomListChannel");
+    chanPath = mChanPath.toLatin1();
+    mChanService = TP_TESTS_ROOM_LIST_CHANNEL(g_object_new(
+                TP_TESTS_TYPE_ROOM_LIST_CHANNEL,
+                "connection", mConn->service(),
+                "object-path", chanPath.data(),
+                NULL));
+}
+
+void TestRoomListChan::init()
+{
+    initImpl();
+    mRoomsAdded.clear();
+    mListingRoomsChanges.clear();
+}
+
+void TestRoomListChan::testRoomList()
+{
+    mChan = RoomListChannel::create(mConn->client(), mChanPath, QVariantMap());
+
+    // Listing requires FeatureCore
+    QVERIFY(connect(mChan->listRooms(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectFailure(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    // becomeReady with no args should implicitly enable RoomListChannel::FeatureCore
+    QVERIFY(connect(mChan->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mChan->isReady(RoomListChannel::FeatureCore), true);
+
+    QCOMPARE(mChan->server(), QLatin1String("conference.shakespeare.lit"));
+    QCOMPARE(mChan->isListingRooms(), false);
+    QCOMPARE(mChan->roomCount(), 0);
+
+    QVERIFY(connect(mChan.data(),
+                SIGNAL(roomsAdded(const QList<Tp::RoomListChannel::Room> &)),
+                SLOT(onRoomsAdded(const QList<Tp::RoomListChannel::Room> &))));
+    QVERIFY(connect(mChan.data(),
+                SIGNAL(listingRoomsChanged(bool)),
+                SLOT(onListingRoomsChanged(bool))));
+
+    QVERIFY(connect(mChan->listRooms(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    while (mListingRoomsChanges.size() < 2) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    QCOMPARE(mListingRoomsChanges, QList<bool>() << true << false);
+
+    // The service lists its five rooms two at a time
+    QCOMPARE(mRoomsAdded.size(), 3);
+    QCOMPARE(mRoomsAdded.at(0).size(), 2);
+    QCOMPARE(mRoomsAdded.at(1).size(), 2);
+    QCOMPARE(mRoomsAdded.at(2).size(), 1);
+    QCOMPARE(mChan->roomCount(), 5);
+    QCOMPARE(identifiers(mChan->rooms()), QStringList() << QLatin1String("kitchen") <<
+            QLatin1String("garden") << QLatin1String("library") << QLatin1String("lounge") <<
+            QLatin1String("games"));
+
+    RoomListChannel::Room room = mChan->room(1);
+    QVERIFY(room.isValid());
+    QCOMPARE(room.handle(), static_cast<uint>(1));
+    QCOMPARE(room.identifier(), QLatin1String("kitchen"));
+    QCOMPARE(room.name(), QLatin1String("The Kitchen"));
+    QCOMPARE(room.memberCount(), static_cast<uint>(3));
+    QCOMPARE(room.requiresPassword(), false);
+    QCOMPARE(room.isInviteOnly(), false);
+    QCOMPARE(room.hasFullInfo(), true);
+    QCOMPARE(mChan->room(3).requiresPassword(), true);
+    QCOMPARE(mChan->room(4).isInviteOnly(), true);
+    QCOMPARE(mChan->room(42).isValid(), false);
+
+    // Prefix lookups match either the identifier or the name, ignoring case, and are sorted by
+    // the matching key
+    QCOMPARE(identifiers(mChan->roomsWithPrefix(QLatin1String("the"))),
+            QStringList() << QLatin1String("kitchen") << QLatin1String("lounge"));
+    QCOMPARE(identifiers(mChan->roomsWithPrefix(QLatin1String("G"))),
+            QStringList() << QLatin1String("games") << QLatin1String("garden"));
+    QCOMPARE(mChan->roomsWithPrefix(QLatin1String("zzz")).isEmpty(), true);
+    QCOMPARE(mChan->roomsWithPrefix(QString()).size(), 5);
+
+    // Substring lookups, both shorter than a trigram and long enough to use the trigram index
+    QCOMPARE(identifiers(mChan->roomsContaining(QLatin1String("ar"))),
+            QStringList() << QLatin1String("garden") << QLatin1String("library") <<
+            QLatin1String("games"));
+    QCOMPARE(identifiers(mChan->roomsContaining(QLatin1String("LOUNGE"))),
+            QStringList() << QLatin1String("lounge"));
+    QCOMPARE(identifiers(mChan->roomsContaining(QLatin1String("ame"))),
+            QStringList() << QLatin1String("games"));
+    QCOMPARE(mChan->roomsContaining(QLatin1String("xyz")).isEmpty(), true);
+
+    // Only the most recently listed rooms keep their complete info, but the compact fields
+    // remain available for all of them
+    QCOMPARE(mChan->maxRoomInfoCount(), 1000);
+    mChan->setMaxRoomInfoCount(2);
+    QCOMPARE(mChan->maxRoomInfoCount(), 2);
+    room = mChan->room(1);
+    QCOMPARE(room.hasFullInfo(), false);
+    QCOMPARE(room.name(), QLatin1String("The Kitchen"));
+    QCOMPARE(room.memberCount(), static_cast<uint>(3));
+    QCOMPARE(room.info().value(QLatin1String("handle-name")).toString(),
+            QLatin1String("kitchen"));
+    QCOMPARE(room.info().value(QLatin1String("members")).toUInt(), static_cast<uint>(3));
+    QCOMPARE(room.info().value(QLatin1String("invite-only")).toBool(), false);
+    QCOMPARE(mChan->room(4).hasFullInfo(), true);
+    QCOMPARE(mChan->room(5).hasFullInfo(), true);
+
+    // Listing again updates the known rooms instead of adding them again, including the kitchen
+    // which was renamed in the meantime
+    QCOMPARE(identifiers(mChan->roomsContaining(QLatin1String("the kit"))),
+            QStringList() << QLatin1String("kitchen"));
+    tp_tests_room_list_channel_rename_room(mChanService, 1, "Scullery");
+    mChan->setMaxRoomInfoCount(5);
+    mRoomsAdded.clear();
+    mListingRoomsChanges.clear();
+    QVERIFY(connect(mChan->listRooms(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    while (mListingRoomsChanges.size() < 2) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    QCOMPARE(mRoomsAdded.isEmpty(), true);
+    QCOMPARE(mChan->roomCount(), 5);
+    QCOMPARE(mChan->room(1).name(), QLatin1String("Scullery"));
+
+    // The old name is no longer found, by prefix or substring, the new one is
+    QCOMPARE(identifiers(mChan->roomsWithPrefix(QLatin1String("the"))),
+            QStringList() << QLatin1String("lounge"));
+    QCOMPARE(identifiers(mChan->roomsContaining(QLatin1String("the"))),
+            QStringList() << QLatin1String("lounge"));
+    QCOMPARE(mChan->roomsContaining(QLatin1String("the kit")).isEmpty(), true);
+    QCOMPARE(identifiers(mChan->roomsContaining(QLatin1String("scull"))),
+            QStringList() << QLatin1String("kitchen"));
+    QCOMPARE(identifiers(mChan->roomsContaining(QLatin1String("kitchen"))),
+            QStringList() << QLatin1String("kitchen"));
+    QCOMPARE(identifiers(mChan->roomsContaining(QLatin1String("games"))),
+            QStringList() << QLatin1String("games"));
+
+    // The rooms listed again count as the most recently listed ones, even those whose complete
+    // info was already kept
+    mChan->setMaxRoomInfoCount(2);
+    QCOMPARE(mChan->room(3).hasFullInfo(), false);
+    QCOMPARE(mChan->room(4).hasFullInfo(), true);
+    QCOMPARE(mChan->room(5).hasFullInfo(), true);
+
+    QVERIFY(connect(mChan->stopListing(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mChan->isListingRooms(), false);
+    QCOMPARE(mChan->roomCount(), 5);
+
+    mChan.reset();
+}
+
+void TestRoomListChan::cleanup()
+{
+    cleanupImpl();
+}
+
+void TestRoomListChan::cleanupTestCase()
+{
+    QCOMPARE(mConn->disconnect(), true);
+    delete mConn;
+
+    if (mChanService != 0) {
+        g_object_unref(mChanService);
+        mChanService = 0;
+    }
+
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(TestRoomListChan)
+#include "_gen/room-list-chan.cpp.moc.hpp"
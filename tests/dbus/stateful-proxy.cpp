@@ -72,6 +72,8 @@ private Q_SLOTS:
     void init();
 
     void testBasics();
+    void testCachedUniqueName();
+    void testNoOwner();
     void testNameOwnerChanged();
 
     void cleanup();
@@ -145,9 +147,14 @@ void TestStatefulProxy::testBasics()
 
     QVERIFY(mProxy);
     QCOMPARE(mProxy->dbusConnection().baseService(), uniqueName());
-    QCOMPARE(mProxy->busName(), uniqueName());
     QCOMPARE(mProxy->objectPath(), objectPath());
 
+    // the unique name is resolved asynchronously the first time around
+    while (mProxy->busName() != uniqueName()) {
+        QVERIFY(mProxy->isValid());
+        mLoop->processEvents();
+    }
+
     QVERIFY(mProxy->isValid());
     QCOMPARE(mProxy->invalidationReason(), QString());
     QCOMPARE(mProxy->invalidationMessage(), QString());
@@ -255,6 +262,41 @@ void TestStatefulProxy::expectInvalidated(DBusProxy *proxy,
     mLoop->exit(EXPECT_INVALIDATED_SUCCESS);
 }
 
+void TestStatefulProxy::testCachedUniqueName()
+{
+    // testBasics already resolved the owner of the well-known name, so this time it should be known
+    // straight away
+    mProxy = new MyStatefulDBusProxy(QDBusConnection::sessionBus(),
+            wellKnownName(), objectPath());
+
+    QVERIFY(mProxy->isValid());
+    QCOMPARE(mProxy->busName(), uniqueName());
+    QCOMPARE(StatefulDBusProxy::uniqueNameFrom(QDBusConnection::sessionBus(), wellKnownName()),
+            uniqueName());
+}
+
+void TestStatefulProxy::testNoOwner()
+{
+    QString unownedName = QLatin1String("org.freedesktop.Telepathy.Qt.TestStatefulProxy.Unowned");
+
+    mProxy = new MyStatefulDBusProxy(QDBusConnection::sessionBus(),
+            unownedName, objectPath());
+
+    QVERIFY(connect(mProxy, SIGNAL(invalidated(
+                        Tp::DBusProxy *,
+                        const QString &, const QString &)),
+                this, SLOT(expectInvalidated(
+                        Tp::DBusProxy *,
+                        const QString &, const QString &))));
+    QCOMPARE(mLoop->exec(), EXPECT_INVALIDATED_SUCCESS);
+
+    QCOMPARE(mInvalidated, 1);
+    QVERIFY(!mProxy->isValid());
+    QCOMPARE(mProxy->busName(), unownedName);
+    QCOMPARE(mSignalledInvalidationReason,
+            TP_QT_DBUS_ERROR_NAME_HAS_NO_OWNER);
+}
+
 void TestStatefulProxy::testNameOwnerChanged()
 {
     QString otherUniqueName = QDBusConnection::connectToBus(
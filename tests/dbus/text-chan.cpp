@@ -16,9 +16,32 @@
 #include <TelepathyQt/TextChannel>
 
 #include <telepathy-glib/debug.h>
+#include <telepathy-glib/telepathy-glib.h>
+
+#include <dbus/dbus-glib-lowlevel.h>
 
 using namespace Tp;
 
+namespace
+{
+
+// Contact lookups can be held back at the service side, to keep a sender unresolved for as
+// long as a test needs
+bool stealContactRequests = false;
+QList<DBusMessage *> stolenContactRequests;
+
+DBusHandlerResult stealContactRequestsFilter(DBusConnection *, DBusMessage *message, void *)
+{
+    if (stealContactRequests && dbus_message_is_method_call(message,
+                TP_IFACE_CONNECTION_INTERFACE_CONTACTS, "GetContactAttributes")) {
+        stolenContactRequests << dbus_message_ref(message);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+}
+
 struct SentMessageDetails
 {
     SentMessageDetails(const Message &message,
@@ -50,6 +73,7 @@ protected Q_SLOTS:
             Tp::MessageSendingFlags, const QString &);
     void onChatStateChanged(const Tp::ContactPtr &contact,
             Tp::ChannelChatState state);
+    void onChatStatesChanged(const QHash<Tp::ContactPtr, Tp::ChannelChatState> &states);
 
 private Q_SLOTS:
     void initTestCase();
@@ -57,6 +81,9 @@ private Q_SLOTS:
 
     void testMessages();
     void testLegacyText();
+    void testAcknowledgeBatch();
+    void testPerSenderDelivery();
+    void testChatStateCoalescing();
 
     void cleanup();
     void cleanupTestCase();
@@ -64,6 +91,7 @@ private Q_SLOTS:
 private:
     void commonTest(bool withMessages);
     void sendText(const char *text);
+    void receiveText(uint sender, const char *text);
 
     TestConnHelper *mConn;
     TpHandleRepoIface *mContactRepo;
@@ -79,6 +107,7 @@ private:
     bool mGotChatStateChanged;
     ContactPtr mChatStateChangedContact;
     ChannelChatState mChatStateChangedState;
+    QList<QHash<ContactPtr, ChannelChatState> > mChatStatesChanged;
 };
 
 void TestTextChan::onMessageReceived(const ReceivedMessage &message)
@@ -109,6 +138,23 @@ void TestTextChan::onChatStateChanged(const Tp::ContactPtr &contact,
     mChatStateChangedState = state;
 }
 
+void TestTextChan::onChatStatesChanged(const QHash<Tp::ContactPtr, Tp::ChannelChatState> &states)
+{
+    mChatStatesChanged << states;
+    mLoop->exit(0);
+}
+
+void TestTextChan::receiveText(uint sender, const char *text)
+{
+    TpMessage *message = tp_cm_message_new(TP_BASE_CONNECTION(mConn->service()), 2);
+    tp_cm_message_set_sender(message, sender);
+    tp_message_set_uint32(message, 0, "message-type", TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL);
+    tp_message_set_int64(message, 0, "message-received", time(0));
+    tp_message_set_string(message, 1, "content-type", "text/plain");
+    tp_message_set_string(message, 1, "content", text);
+    tp_message_mixin_take_received(G_OBJECT(mMessagesChanService), message);
+}
+
 void TestTextChan::sendText(const char *text)
 {
     qDebug() << "sending message:" << text;
@@ -170,6 +216,7 @@ void TestTextChan::init()
     mChan.reset();
     mGotChatStateChanged = false;
     mChatStateChangedState = (ChannelChatState) -1;
+    mChatStatesChanged.clear();
 }
 
 void TestTextChan::commonTest(bool withMessages)
@@ -534,6 +581,253 @@ void TestTextChan::testLegacyText()
     commonTest(false);
 }
 
+void TestTextChan::testAcknowledgeBatch()
+{
+    mChan = TextChannel::create(mConn->client(), mMessagesChanPath, QVariantMap());
+
+    QVERIFY(connect(mChan->becomeReady(TextChannel::FeatureMessageQueue),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(mChan->isReady(TextChannel::FeatureMessageQueue));
+
+    QVERIFY(connect(mChan.data(),
+                SIGNAL(messageReceived(const Tp::ReceivedMessage &)),
+                SLOT(onMessageReceived(const Tp::ReceivedMessage &))));
+    QVERIFY(connect(mChan.data(),
+                SIGNAL(pendingMessageRemoved(const Tp::ReceivedMessage &)),
+                SLOT(onMessageRemoved(const Tp::ReceivedMessage &))));
+
+    guint acknowledgeCalls = example_echo_2_channel_get_acknowledge_calls(mMessagesChanService);
+
+    QCOMPARE(mChan->acknowledgeBatchInterval(), 0);
+    mChan->setAcknowledgeBatchInterval(50);
+    QCOMPARE(mChan->acknowledgeBatchInterval(), 50);
+
+    sendText("One");
+    sendText("Two");
+    sendText("Three");
+    while (received.size() != 3) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    QCOMPARE(mChan->messageQueue().size(), 3);
+
+    // acknowledge one message on its own and the rest in bulk, both within the same window
+    mChan->acknowledge(QList<ReceivedMessage>() << received.at(0));
+    QCOMPARE(mChan->messageQueue().size(), 2);
+    // acknowledging the same message again must not put it in the call twice
+    mChan->acknowledge(QList<ReceivedMessage>() << received.at(0));
+    QCOMPARE(removed.size(), 1);
+    mChan->acknowledgeAll();
+    QCOMPARE(mChan->messageQueue().size(), 0);
+    QCOMPARE(removed.size(), 3);
+    QVERIFY(removed.at(0) == received.at(0));
+    QVERIFY(removed.at(1) == received.at(1));
+    QVERIFY(removed.at(2) == received.at(2));
+
+    // nothing left to acknowledge
+    mChan->acknowledgeAll();
+    QCOMPARE(removed.size(), 3);
+
+    while (tp_message_mixin_has_pending_messages(
+                G_OBJECT(mMessagesChanService), 0)) {
+        QTest::qWait(1);
+    }
+
+    // all three were acknowledged in a single call, which didn't fail and need to be retried one
+    // message at a time, and the empty acknowledgeAll() made none
+    QTest::qWait(100);
+    QCOMPARE(example_echo_2_channel_get_acknowledge_calls(mMessagesChanService),
+            acknowledgeCalls + 1);
+
+    // an acknowledgement made once the window is over goes in a call of its own
+    sendText("Four");
+    while (received.size() != 4) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    mChan->acknowledge(QList<ReceivedMessage>() << received.at(3));
+    while (tp_message_mixin_has_pending_messages(
+                G_OBJECT(mMessagesChanService), 0)) {
+        QTest::qWait(1);
+    }
+    QTest::qWait(100);
+    QCOMPARE(example_echo_2_channel_get_acknowledge_calls(mMessagesChanService),
+            acknowledgeCalls + 2);
+}
+
+void TestTextChan::testPerSenderDelivery()
+{
+    mChan = TextChannel::create(mConn->client(), mMessagesChanPath, QVariantMap());
+    QCOMPARE(mChan->messageDeliveryMode(), TextChannel::MessageDeliveryModeInOrder);
+    mChan->setMessageDeliveryMode(TextChannel::MessageDeliveryModePerSender, 5000);
+    QCOMPARE(mChan->messageDeliveryMode(), TextChannel::MessageDeliveryModePerSender);
+    QCOMPARE(mChan->maxSenderResolutionTime(), 5000);
+
+    QVERIFY(connect(mChan->becomeReady(TextChannel::FeatureMessageQueue),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    QVERIFY(connect(mChan.data(),
+                SIGNAL(messageReceived(const Tp::ReceivedMessage &)),
+                SLOT(onMessageReceived(const Tp::ReceivedMessage &))));
+
+    // the sender is already known to the connection, so the messages should be delivered
+    // with the cached Contact object
+    sendText("One");
+    sendText("Two");
+    while (received.size() != 2) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    QCOMPARE(received.at(0).text(), QLatin1String("One"));
+    QCOMPARE(received.at(1).text(), QLatin1String("Two"));
+    QCOMPARE(received.at(0).sender(), mContact);
+    QCOMPARE(received.at(1).sender(), mContact);
+
+    // a sender whose Contact is still being built only holds back its own messages
+    DBusConnection *serviceBus = dbus_g_connection_get_connection(tp_proxy_get_dbus_connection(
+                tp_base_connection_get_dbus_daemon(TP_BASE_CONNECTION(mConn->service()))));
+    dbus_connection_add_filter(serviceBus, stealContactRequestsFilter, 0, 0);
+    stealContactRequests = true;
+    mChan->setMessageDeliveryMode(TextChannel::MessageDeliveryModePerSender, 200);
+
+    guint strangerHandle = tp_handle_ensure(mContactRepo, "stranger@localhost", 0, 0);
+    receiveText(strangerHandle, "Stranger one");
+    receiveText(strangerHandle, "Stranger two");
+    sendText("Three");
+    while (received.size() != 3) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    QCOMPARE(received.at(2).text(), QLatin1String("Three"));
+    QCOMPARE(received.at(2).sender(), mContact);
+
+    while (stolenContactRequests.isEmpty()) {
+        mLoop->processEvents();
+    }
+    QCOMPARE(received.size(), 3);
+
+    // the contact lookup never answers, so the held messages are delivered in order without a
+    // sender Contact once the hold time is over
+    while (received.size() != 5) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    QCOMPARE(received.at(3).text(), QLatin1String("Stranger one"));
+    QCOMPARE(received.at(4).text(), QLatin1String("Stranger two"));
+    QVERIFY(received.at(3).sender().isNull());
+    QVERIFY(received.at(4).sender().isNull());
+    QCOMPARE(received.at(3).header().value(QLatin1String("message-sender")).variant().toUInt(),
+            strangerHandle);
+
+    stealContactRequests = false;
+    dbus_connection_remove_filter(serviceBus, stealContactRequestsFilter, 0);
+    foreach (DBusMessage *request, stolenContactRequests) {
+        DBusMessage *reply = dbus_message_new_error(request, TP_ERROR_STR_NOT_AVAILABLE,
+                "Contact lookups were held back by the test");
+        dbus_connection_send(serviceBus, reply, 0);
+        dbus_message_unref(reply);
+        dbus_message_unref(request);
+    }
+    stolenContactRequests.clear();
+
+    mChan->acknowledgeAll();
+    while (tp_message_mixin_has_pending_messages(
+                G_OBJECT(mMessagesChanService), 0)) {
+        QTest::qWait(1);
+    }
+}
+
+void TestTextChan::testChatStateCoalescing()
+{
+    mChan = TextChannel::create(mConn->client(), mMessagesChanPath, QVariantMap());
+
+    QVERIFY(connect(mChan->becomeReady(TextChannel::FeatureChatState),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(mChan->isReady(TextChannel::FeatureChatState));
+
+    QCOMPARE(mChan->chatStateCoalescingInterval(), 0);
+    mChan->setChatStateCoalescingInterval(1000);
+    QCOMPARE(mChan->chatStateCoalescingInterval(), 1000);
+
+    QVERIFY(connect(mChan.data(),
+                SIGNAL(chatStateChanged(Tp::ContactPtr,Tp::ChannelChatState)),
+                SLOT(onChatStateChanged(Tp::ContactPtr,Tp::ChannelChatState))));
+    QVERIFY(connect(mChan.data(),
+                SIGNAL(chatStatesChanged(QHash<Tp::ContactPtr,Tp::ChannelChatState>)),
+                SLOT(onChatStatesChanged(QHash<Tp::ContactPtr,Tp::ChannelChatState>))));
+
+    // all of these land in the same window, so only the last one should be signalled
+    QVERIFY(connect(mChan->requestChatState(ChannelChatStateComposing),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(connect(mChan->requestChatState(ChannelChatStatePaused),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(connect(mChan->requestChatState(ChannelChatStateActive),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    while (mChatStatesChanged.isEmpty()) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+
+    QCOMPARE(mChatStatesChanged.size(), 1);
+    QCOMPARE(mChatStatesChanged.first().size(), 1);
+    QCOMPARE(mChatStatesChanged.first().value(mChan->groupSelfContact()), ChannelChatStateActive);
+    QVERIFY(mGotChatStateChanged);
+    QCOMPARE(mChatStateChangedContact, mChan->groupSelfContact());
+    QCOMPARE(mChatStateChangedState, ChannelChatStateActive);
+    QCOMPARE(mChan->chatState(mChan->groupSelfContact()), ChannelChatStateActive);
+
+    // a change still waiting for its Contact from before coalescing was enabled isn't overtaken
+    // by a batch of later ones
+    mChan->setChatStateCoalescingInterval(0);
+    DBusConnection *serviceBus = dbus_g_connection_get_connection(tp_proxy_get_dbus_connection(
+                tp_base_connection_get_dbus_daemon(TP_BASE_CONNECTION(mConn->service()))));
+    dbus_connection_add_filter(serviceBus, stealContactRequestsFilter, 0, 0);
+    stealContactRequests = true;
+
+    guint strangerHandle = tp_handle_ensure(mContactRepo, "stranger@localhost", 0, 0);
+    tp_svc_channel_interface_chat_state_emit_chat_state_changed(mMessagesChanService,
+            strangerHandle, TP_CHANNEL_CHAT_STATE_COMPOSING);
+    while (stolenContactRequests.isEmpty()) {
+        mLoop->processEvents();
+    }
+    stealContactRequests = false;
+    dbus_connection_remove_filter(serviceBus, stealContactRequestsFilter, 0);
+
+    mChan->setChatStateCoalescingInterval(50);
+    mGotChatStateChanged = false;
+    mChatStatesChanged.clear();
+    QVERIFY(connect(mChan->requestChatState(ChannelChatStateComposing),
+                SIGNAL(finished(Tp::PendingOperation *)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QTest::qWait(200);
+    QVERIFY(!mGotChatStateChanged);
+    QVERIFY(mChatStatesChanged.isEmpty());
+
+    // once the stranger turns out not to exist, the held back change goes through
+    foreach (DBusMessage *request, stolenContactRequests) {
+        DBusMessage *reply = dbus_message_new_error(request, TP_ERROR_STR_NOT_AVAILABLE,
+                "Contact lookups were held back by the test");
+        dbus_connection_send(serviceBus, reply, 0);
+        dbus_message_unref(reply);
+        dbus_message_unref(request);
+    }
+    stolenContactRequests.clear();
+
+    while (!mGotChatStateChanged) {
+        mLoop->processEvents();
+    }
+    QCOMPARE(mChatStateChangedContact, mChan->groupSelfContact());
+    QCOMPARE(mChatStateChangedState, ChannelChatStateComposing);
+}
+
 void TestTextChan::cleanup()
 {
     received.clear();
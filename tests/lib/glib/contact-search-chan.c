@@ -87,6 +87,8 @@ struct _TpTestsContactSearchChannelPrivate
   gchar *contact_search_server;
 
   GSList *contact_search_contacts;
+  /* Number of contacts per SearchResultReceived signal, 0 for a single one */
+  guint page_size;
 
   gboolean disposed;
   gboolean closed;
@@ -175,6 +177,19 @@ constructed (GObject *object)
       new_contact ("foo", "Other Employer", "Foo"));
   self->priv->contact_search_contacts = g_slist_append (self->priv->contact_search_contacts,
       new_contact ("bar", "Other Employer", "Bar"));
+
+  self->priv->contact_search_contacts = g_slist_append (self->priv->contact_search_contacts,
+      new_contact ("romeo", "Globe Theatre", "Romeo Montague"));
+  self->priv->contact_search_contacts = g_slist_append (self->priv->contact_search_contacts,
+      new_contact ("juliet", "Globe Theatre", "Juliet Capulet"));
+  self->priv->contact_search_contacts = g_slist_append (self->priv->contact_search_contacts,
+      new_contact ("hamlet", "Globe Theatre", "Hamlet"));
+  self->priv->contact_search_contacts = g_slist_append (self->priv->contact_search_contacts,
+      new_contact ("ophelia", "Globe Theatre", "Ophelia"));
+  self->priv->contact_search_contacts = g_slist_append (self->priv->contact_search_contacts,
+      new_contact ("macbeth", "Globe Theatre", "Macbeth"));
+  self->priv->contact_search_contacts = g_slist_append (self->priv->contact_search_contacts,
+      new_contact ("puck", "Globe Theatre", "Robin Goodfellow"));
 }
 
 static void
@@ -615,12 +630,23 @@ do_search (TpTestsContactSearchChannel *self,
           if (strcmp (contact->employer, value) == 0)
             {
               g_hash_table_insert (results, contact->id, contact->contact_info);
+
+              if (self->priv->page_size != 0 &&
+                  g_hash_table_size (results) == self->priv->page_size)
+                {
+                  tp_svc_channel_type_contact_search_emit_search_result_received (self,
+                      results);
+                  g_hash_table_remove_all (results);
+                }
             }
         }
     }
 
-  tp_svc_channel_type_contact_search_emit_search_result_received (self,
-      results);
+  if (self->priv->page_size == 0 || g_hash_table_size (results) != 0)
+    {
+      tp_svc_channel_type_contact_search_emit_search_result_received (self,
+          results);
+    }
 
   change_search_state (self, TP_CHANNEL_CONTACT_SEARCH_STATE_COMPLETED, "completed");
 
@@ -706,3 +732,10 @@ contact_search_iface_init (gpointer iface,
   IMPLEMENT (stop);
 #undef IMPLEMENT
 }
+
+void
+tp_tests_contact_search_channel_set_page_size (TpTestsContactSearchChannel *self,
+    guint page_size)
+{
+  self->priv->page_size = page_size;
+}
@@ -69,6 +69,9 @@ struct _TpTestsContactSearchChannel {
     TpTestsContactSearchChannelPrivate *priv;
 };
 
+void tp_tests_contact_search_channel_set_page_size (TpTestsContactSearchChannel *self,
+    guint page_size);
+
 G_END_DECLS
 
 #endif
@@ -700,6 +700,35 @@ tp_tests_dbus_tube_channel_peer_disconnected (TpTestsDBusTubeChannel *self,
   g_array_free (removed, TRUE);
 }
 
+/* Called to emulate several peers connecting to and disconnecting from an
+ * offered tube at once, @added mapping handles to bus names */
+void
+tp_tests_dbus_tube_channel_change_bus_names (TpTestsDBusTubeChannel *self,
+    GHashTable *added,
+    GArray *removed)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  guint i;
+
+  if (self->priv->state == TP_TUBE_CHANNEL_STATE_REMOTE_PENDING)
+    change_state (self, TP_TUBE_CHANNEL_STATE_OPEN);
+
+  g_assert (self->priv->state == TP_TUBE_CHANNEL_STATE_OPEN);
+
+  // Update the global hash table as well
+  for (i = 0; i < removed->len; i++)
+    g_hash_table_remove (self->priv->dbus_names,
+        GUINT_TO_POINTER (g_array_index (removed, TpHandle, i)));
+
+  g_hash_table_iter_init (&iter, added);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_hash_table_insert (self->priv->dbus_names, key, value);
+
+  tp_svc_channel_type_dbus_tube_emit_dbus_names_changed (self, added,
+      removed);
+}
+
 void
 tp_tests_dbus_tube_channel_set_close_on_accept (
     TpTestsDBusTubeChannel *self,
@@ -74,6 +74,11 @@ void tp_tests_dbus_tube_channel_peer_disconnected (
     TpTestsDBusTubeChannel *self,
     TpHandle handle);
 
+void tp_tests_dbus_tube_channel_change_bus_names (
+    TpTestsDBusTubeChannel *self,
+    GHashTable *added,
+    GArray *removed);
+
 #define TP_TESTS_TYPE_CONTACT_DBUS_TUBE_CHANNEL \
   (tp_tests_contact_dbus_tube_channel_get_type ())
 #define TP_TESTS_CONTACT_DBUS_TUBE_CHANNEL(obj) \
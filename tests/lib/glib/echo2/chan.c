@@ -17,6 +17,9 @@
 #include <telepathy-glib/channel-iface.h>
 #include <telepathy-glib/svc-channel.h>
 
+#include <dbus/dbus-glib.h>
+#include <dbus/dbus-glib-lowlevel.h>
+
 #include <string.h>
 
 static void channel_iface_init (gpointer iface, gpointer data);
@@ -66,6 +69,9 @@ struct _ExampleEcho2ChannelPrivate
   TpHandle handle;
   TpHandle initiator;
 
+  DBusConnection *dbus_conn;
+  guint acknowledge_calls;
+
   /* These are really booleans, but gboolean is signed. Thanks, GLib */
   unsigned closed:1;
   unsigned disposed:1;
@@ -223,6 +229,21 @@ finally:
 }
 
 
+static DBusHandlerResult
+count_acknowledge_calls (DBusConnection *conn,
+    DBusMessage *msg,
+    void *data)
+{
+  ExampleEcho2Channel *self = EXAMPLE_ECHO_2_CHANNEL (data);
+
+  if (dbus_message_is_method_call (msg, TP_IFACE_CHANNEL_TYPE_TEXT,
+        "AcknowledgePendingMessages") &&
+      !tp_strdiff (dbus_message_get_path (msg), self->priv->object_path))
+    self->priv->acknowledge_calls++;
+
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
 static GObject *
 constructor (GType type,
              guint n_props,
@@ -243,6 +264,14 @@ constructor (GType type,
       tp_base_connection_get_dbus_daemon (self->priv->conn),
       self->priv->object_path, self);
 
+  /* Count the acknowledgements as they come in, so that tests can check how
+   * they were batched */
+  self->priv->dbus_conn = dbus_connection_ref (dbus_g_connection_get_connection (
+        tp_proxy_get_dbus_connection (
+          tp_base_connection_get_dbus_daemon (self->priv->conn))));
+  dbus_connection_add_filter (self->priv->dbus_conn, count_acknowledge_calls,
+      self, NULL);
+
   tp_message_mixin_init (object, G_STRUCT_OFFSET (ExampleEcho2Channel, text),
       self->priv->conn);
 
@@ -381,6 +410,13 @@ dispose (GObject *object)
 
   self->priv->disposed = TRUE;
 
+  if (self->priv->dbus_conn != NULL)
+    {
+      dbus_connection_remove_filter (self->priv->dbus_conn,
+          count_acknowledge_calls, self);
+      tp_clear_pointer (&self->priv->dbus_conn, dbus_connection_unref);
+    }
+
   if (!self->priv->closed)
     {
       self->priv->closed = TRUE;
@@ -634,3 +670,11 @@ destroyable_iface_init (gpointer iface,
   IMPLEMENT (destroy);
 #undef IMPLEMENT
 }
+
+guint
+example_echo_2_channel_get_acknowledge_calls (ExampleEcho2Channel *self)
+{
+  g_return_val_if_fail (EXAMPLE_IS_ECHO_2_CHANNEL (self), 0);
+
+  return self->priv->acknowledge_calls;
+}
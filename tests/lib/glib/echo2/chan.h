@@ -24,6 +24,8 @@ typedef struct _ExampleEcho2ChannelPrivate ExampleEcho2ChannelPrivate;
 
 GType example_echo_2_channel_get_type (void);
 
+guint example_echo_2_channel_get_acknowledge_calls (ExampleEcho2Channel *self);
+
 #define EXAMPLE_TYPE_ECHO_2_CHANNEL \
   (example_echo_2_channel_get_type ())
 #define EXAMPLE_ECHO_2_CHANNEL(obj) \
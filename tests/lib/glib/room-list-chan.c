@@ -0,0 +1,568 @@
+/*
+ * room-list-chan.c - a tp_tests room list channel
+ *
+ * Copyright © 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "room-list-chan.h"
+
+#include <telepathy-glib/channel-iface.h>
+#include <telepathy-glib/dbus.h>
+#include <telepathy-glib/exportable-channel.h>
+#include <telepathy-glib/gtypes.h>
+#include <telepathy-glib/interfaces.h>
+#include <telepathy-glib/svc-channel.h>
+#include <telepathy-glib/svc-properties-interface.h>
+#include <telepathy-glib/util.h>
+
+static void room_list_iface_init (gpointer iface, gpointer data);
+static void channel_iface_init (gpointer iface, gpointer data);
+
+G_DEFINE_TYPE_WITH_CODE (TpTestsRoomListChannel,
+    tp_tests_room_list_channel,
+    G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_DBUS_PROPERTIES,
+      tp_dbus_properties_mixin_iface_init);
+    G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_CHANNEL, channel_iface_init);
+    G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_CHANNEL_TYPE_ROOM_LIST,
+      room_list_iface_init);
+    G_IMPLEMENT_INTERFACE (TP_TYPE_CHANNEL_IFACE, NULL);
+    G_IMPLEMENT_INTERFACE (TP_TYPE_EXPORTABLE_CHANNEL, NULL))
+
+enum
+{
+  PROP_OBJECT_PATH = 1,
+  PROP_CHANNEL_TYPE,
+  PROP_HANDLE_TYPE,
+  PROP_HANDLE,
+  PROP_TARGET_ID,
+  PROP_REQUESTED,
+  PROP_INITIATOR_HANDLE,
+  PROP_INITIATOR_ID,
+  PROP_CONNECTION,
+  PROP_INTERFACES,
+  PROP_CHANNEL_DESTROYED,
+  PROP_CHANNEL_PROPERTIES,
+  PROP_ROOM_LIST_SERVER,
+  N_PROPS
+};
+
+typedef struct
+{
+  const gchar *id;
+  const gchar *name;
+  guint members;
+  gboolean password;
+  gboolean invite_only;
+} TpTestsRoomListRoom;
+
+/* Listed in batches of BATCH_SIZE, so that clients get several GotRooms signals */
+static const TpTestsRoomListRoom rooms[] = {
+    { "kitchen", "The Kitchen", 3, FALSE, FALSE },
+    { "garden", "Garden Party", 12, FALSE, FALSE },
+    { "library", "Quiet Library", 1, TRUE, FALSE },
+    { "lounge", "The Lounge", 7, FALSE, TRUE },
+    { "games", "Board Games", 4, FALSE, FALSE },
+};
+
+#define BATCH_SIZE 2
+
+struct _TpTestsRoomListChannelPrivate
+{
+  TpBaseConnection *conn;
+  gchar *object_path;
+
+  gchar *server;
+  gboolean listing;
+  guint next_room;
+  guint listing_id;
+
+  /* Room handle => name to list it with instead of the one in rooms[] */
+  GHashTable *renamed;
+
+  gboolean disposed;
+  gboolean closed;
+};
+
+static const gchar * tp_tests_room_list_channel_interfaces[] = {
+    NULL
+};
+
+static void
+tp_tests_room_list_channel_init (TpTestsRoomListChannel *self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      TP_TESTS_TYPE_ROOM_LIST_CHANNEL,
+      TpTestsRoomListChannelPrivate);
+
+  self->priv->renamed = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+}
+
+static void
+constructed (GObject *object)
+{
+  void (*chain_up) (GObject *) =
+      ((GObjectClass *) tp_tests_room_list_channel_parent_class)->constructed;
+  TpTestsRoomListChannel *self = TP_TESTS_ROOM_LIST_CHANNEL (object);
+  TpDBusDaemon *bus;
+
+  if (chain_up != NULL)
+    {
+      chain_up (object);
+    }
+
+  bus = tp_dbus_daemon_dup (NULL);
+  tp_dbus_daemon_register_object (bus, self->priv->object_path, object);
+  g_object_unref (bus);
+
+  self->priv->server = g_strdup ("conference.shakespeare.lit");
+}
+
+static void
+get_property (GObject *object,
+    guint property_id,
+    GValue *value,
+    GParamSpec *pspec)
+{
+  TpTestsRoomListChannel *self = TP_TESTS_ROOM_LIST_CHANNEL (object);
+
+  switch (property_id)
+    {
+    case PROP_OBJECT_PATH:
+      g_value_set_string (value, self->priv->object_path);
+      break;
+
+    case PROP_CHANNEL_TYPE:
+      g_value_set_static_string (value, TP_IFACE_CHANNEL_TYPE_ROOM_LIST);
+      break;
+
+    case PROP_HANDLE_TYPE:
+      g_value_set_uint (value, TP_HANDLE_TYPE_NONE);
+      break;
+
+    case PROP_HANDLE:
+      g_value_set_uint (value, 0);
+      break;
+
+    case PROP_TARGET_ID:
+      g_value_set_string (value, "");
+      break;
+
+    case PROP_REQUESTED:
+      g_value_set_boolean (value, TRUE);
+      break;
+
+    case PROP_INITIATOR_HANDLE:
+      g_value_set_uint (value, 0);
+      break;
+
+    case PROP_INITIATOR_ID:
+      g_value_set_string (value, "");
+      break;
+
+    case PROP_CONNECTION:
+      g_value_set_object (value, self->priv->conn);
+      break;
+
+    case PROP_INTERFACES:
+      g_value_set_boxed (value, tp_tests_room_list_channel_interfaces);
+      break;
+
+    case PROP_CHANNEL_DESTROYED:
+      g_value_set_boolean (value, self->priv->closed);
+      break;
+
+    case PROP_CHANNEL_PROPERTIES:
+      g_value_take_boxed (value,
+          tp_dbus_properties_mixin_make_properties_hash (object,
+              TP_IFACE_CHANNEL, "ChannelType",
+              TP_IFACE_CHANNEL, "TargetHandleType",
+              TP_IFACE_CHANNEL, "TargetHandle",
+              TP_IFACE_CHANNEL, "TargetID",
+              TP_IFACE_CHANNEL, "InitiatorHandle",
+              TP_IFACE_CHANNEL, "InitiatorID",
+              TP_IFACE_CHANNEL, "Requested",
+              TP_IFACE_CHANNEL, "Interfaces",
+              TP_IFACE_CHANNEL_TYPE_ROOM_LIST, "Server",
+              NULL));
+      break;
+
+    case PROP_ROOM_LIST_SERVER:
+      g_value_set_string (value, self->priv->server);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+set_property (GObject *object,
+    guint property_id,
+    const GValue *value,
+    GParamSpec *pspec)
+{
+  TpTestsRoomListChannel *self = TP_TESTS_ROOM_LIST_CHANNEL (object);
+
+  switch (property_id)
+    {
+    case PROP_OBJECT_PATH:
+      self->priv->object_path = g_value_dup_string (value);
+      break;
+
+    case PROP_CONNECTION:
+      self->priv->conn = g_value_get_object (value);
+      break;
+
+    case PROP_CHANNEL_TYPE:
+    case PROP_HANDLE:
+    case PROP_HANDLE_TYPE:
+    case PROP_TARGET_ID:
+    case PROP_REQUESTED:
+    case PROP_INITIATOR_HANDLE:
+    case PROP_INITIATOR_ID:
+      /* these properties are not actually meaningfully changeable on this
+       * channel, so we do nothing */
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+stop_listing (TpTestsRoomListChannel *self)
+{
+  if (self->priv->listing_id != 0)
+    {
+      g_source_remove (self->priv->listing_id);
+      self->priv->listing_id = 0;
+    }
+
+  if (self->priv->listing)
+    {
+      self->priv->listing = FALSE;
+      tp_svc_channel_type_room_list_emit_listing_rooms (self, FALSE);
+    }
+}
+
+static void
+dispose (GObject *object)
+{
+  TpTestsRoomListChannel *self = TP_TESTS_ROOM_LIST_CHANNEL (object);
+
+  if (self->priv->disposed)
+    {
+      return;
+    }
+
+  self->priv->disposed = TRUE;
+
+  if (self->priv->listing_id != 0)
+    {
+      g_source_remove (self->priv->listing_id);
+      self->priv->listing_id = 0;
+    }
+
+  g_free (self->priv->server);
+  self->priv->server = NULL;
+
+  if (!self->priv->closed)
+    {
+      self->priv->closed = TRUE;
+      tp_svc_channel_emit_closed (self);
+    }
+
+  ((GObjectClass *) tp_tests_room_list_channel_parent_class)->dispose (object);
+}
+
+static void
+finalize (GObject *object)
+{
+  TpTestsRoomListChannel *self = TP_TESTS_ROOM_LIST_CHANNEL (object);
+
+  g_free (self->priv->object_path);
+  g_hash_table_unref (self->priv->renamed);
+
+  ((GObjectClass *) tp_tests_room_list_channel_parent_class)->finalize (object);
+}
+
+static void
+tp_tests_room_list_channel_class_init (TpTestsRoomListChannelClass *klass)
+{
+  static TpDBusPropertiesMixinPropImpl channel_props[] = {
+      { "TargetHandleType", "handle-type", NULL },
+      { "TargetHandle", "handle", NULL },
+      { "ChannelType", "channel-type", NULL },
+      { "Interfaces", "interfaces", NULL },
+      { "TargetID", "target-id", NULL },
+      { "Requested", "requested", NULL },
+      { "InitiatorHandle", "initiator-handle", NULL },
+      { "InitiatorID", "initiator-id", NULL },
+      { NULL }
+  };
+  static TpDBusPropertiesMixinPropImpl room_list_props[] = {
+      { "Server", "server", NULL },
+      { NULL }
+  };
+  static TpDBusPropertiesMixinIfaceImpl prop_interfaces[] = {
+      { TP_IFACE_CHANNEL,
+        tp_dbus_properties_mixin_getter_gobject_properties,
+        NULL,
+        channel_props,
+      },
+      { TP_IFACE_CHANNEL_TYPE_ROOM_LIST,
+        tp_dbus_properties_mixin_getter_gobject_properties,
+        NULL,
+        room_list_props,
+      },
+      { NULL }
+  };
+  GObjectClass *object_class = (GObjectClass *) klass;
+  GParamSpec *param_spec;
+
+  g_type_class_add_private (klass,
+      sizeof (TpTestsRoomListChannelPrivate));
+
+  object_class->constructed = constructed;
+  object_class->set_property = set_property;
+  object_class->get_property = get_property;
+  object_class->dispose = dispose;
+  object_class->finalize = finalize;
+
+  g_object_class_override_property (object_class, PROP_OBJECT_PATH,
+      "object-path");
+  g_object_class_override_property (object_class, PROP_CHANNEL_TYPE,
+      "channel-type");
+  g_object_class_override_property (object_class, PROP_HANDLE_TYPE,
+      "handle-type");
+  g_object_class_override_property (object_class, PROP_HANDLE,
+      "handle");
+  g_object_class_override_property (object_class, PROP_CHANNEL_DESTROYED,
+      "channel-destroyed");
+  g_object_class_override_property (object_class, PROP_CHANNEL_PROPERTIES,
+      "channel-properties");
+
+  param_spec = g_param_spec_object ("connection", "TpBaseConnection object",
+      "Connection object that owns this channel",
+      TP_TYPE_BASE_CONNECTION,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_CONNECTION, param_spec);
+
+  param_spec = g_param_spec_boxed ("interfaces", "Extra D-Bus interfaces",
+      "Additional Channel.Interface.* interfaces",
+      G_TYPE_STRV,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_INTERFACES, param_spec);
+
+  param_spec = g_param_spec_string ("target-id", "Peer's ID",
+      "The string obtained by inspecting the target handle",
+      NULL,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_TARGET_ID, param_spec);
+
+  param_spec = g_param_spec_uint ("initiator-handle", "Initiator's handle",
+      "The contact who initiated the channel",
+      0, G_MAXUINT32, 0,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_INITIATOR_HANDLE,
+      param_spec);
+
+  param_spec = g_param_spec_string ("initiator-id", "Initiator's ID",
+      "The string obtained by inspecting the initiator-handle",
+      NULL,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_INITIATOR_ID,
+      param_spec);
+
+  param_spec = g_param_spec_boolean ("requested", "Requested?",
+      "True if this channel was requested by the local user",
+      FALSE,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_REQUESTED, param_spec);
+
+  param_spec = g_param_spec_string ("server", "Server",
+      "The server whose rooms are listed",
+      NULL,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_ROOM_LIST_SERVER,
+      param_spec);
+
+  klass->dbus_properties_class.interfaces = prop_interfaces;
+  tp_dbus_properties_mixin_class_init (object_class,
+      G_STRUCT_OFFSET (TpTestsRoomListChannelClass,
+        dbus_properties_class));
+}
+
+static void
+channel_close (TpSvcChannel *iface,
+    DBusGMethodInvocation *context)
+{
+  TpTestsRoomListChannel *self = TP_TESTS_ROOM_LIST_CHANNEL (iface);
+
+  if (!self->priv->closed)
+    {
+      self->priv->closed = TRUE;
+      tp_svc_channel_emit_closed (self);
+    }
+
+  tp_svc_channel_return_from_close (context);
+}
+
+static void
+channel_get_channel_type (TpSvcChannel *iface G_GNUC_UNUSED,
+    DBusGMethodInvocation *context)
+{
+  tp_svc_channel_return_from_get_channel_type (context,
+      TP_IFACE_CHANNEL_TYPE_ROOM_LIST);
+}
+
+static void
+channel_get_handle (TpSvcChannel *iface,
+    DBusGMethodInvocation *context)
+{
+  tp_svc_channel_return_from_get_handle (context, TP_HANDLE_TYPE_NONE, 0);
+}
+
+static void
+channel_get_interfaces (TpSvcChannel *iface G_GNUC_UNUSED,
+    DBusGMethodInvocation *context)
+{
+  tp_svc_channel_return_from_get_interfaces (context,
+      tp_tests_room_list_channel_interfaces);
+}
+
+static void
+channel_iface_init (gpointer iface,
+                    gpointer data)
+{
+  TpSvcChannelClass *klass = iface;
+
+#define IMPLEMENT(x) tp_svc_channel_implement_##x (klass, channel_##x)
+  IMPLEMENT (close);
+  IMPLEMENT (get_channel_type);
+  IMPLEMENT (get_handle);
+  IMPLEMENT (get_interfaces);
+#undef IMPLEMENT
+}
+
+static gboolean
+list_next_batch (gpointer data)
+{
+  TpTestsRoomListChannel *self = TP_TESTS_ROOM_LIST_CHANNEL (data);
+  GPtrArray *batch = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) g_value_array_free);
+  guint i;
+
+  for (i = 0; i < BATCH_SIZE && self->priv->next_room < G_N_ELEMENTS (rooms);
+      i++, self->priv->next_room++)
+    {
+      const TpTestsRoomListRoom *room = &rooms[self->priv->next_room];
+      const gchar *name = g_hash_table_lookup (self->priv->renamed,
+          GUINT_TO_POINTER (self->priv->next_room + 1));
+      GHashTable *info = tp_asv_new (
+          "handle-name", G_TYPE_STRING, room->id,
+          "name", G_TYPE_STRING, name != NULL ? name : room->name,
+          "members", G_TYPE_UINT, room->members,
+          "password", G_TYPE_BOOLEAN, room->password,
+          "invite-only", G_TYPE_BOOLEAN, room->invite_only,
+          NULL);
+
+      /* The handles don't need to be real for listing purposes */
+      g_ptr_array_add (batch, tp_value_array_build (3,
+          G_TYPE_UINT, self->priv->next_room + 1,
+          G_TYPE_STRING, TP_IFACE_CHANNEL_TYPE_TEXT,
+          TP_HASH_TYPE_STRING_VARIANT_MAP, info,
+          G_TYPE_INVALID));
+
+      g_hash_table_unref (info);
+    }
+
+  tp_svc_channel_type_room_list_emit_got_rooms (self, batch);
+  g_ptr_array_unref (batch);
+
+  if (self->priv->next_room < G_N_ELEMENTS (rooms))
+    {
+      return TRUE;
+    }
+
+  self->priv->listing_id = 0;
+  stop_listing (self);
+  return FALSE;
+}
+
+static void
+room_list_get_listing_rooms (TpSvcChannelTypeRoomList *iface,
+                             DBusGMethodInvocation *context)
+{
+  TpTestsRoomListChannel *self = TP_TESTS_ROOM_LIST_CHANNEL (iface);
+
+  tp_svc_channel_type_room_list_return_from_get_listing_rooms (context,
+      self->priv->listing);
+}
+
+static void
+room_list_list_rooms (TpSvcChannelTypeRoomList *iface,
+                      DBusGMethodInvocation *context)
+{
+  TpTestsRoomListChannel *self = TP_TESTS_ROOM_LIST_CHANNEL (iface);
+
+  if (!self->priv->listing)
+    {
+      self->priv->listing = TRUE;
+      self->priv->next_room = 0;
+      tp_svc_channel_type_room_list_emit_listing_rooms (self, TRUE);
+      self->priv->listing_id = g_idle_add (list_next_batch, self);
+    }
+
+  tp_svc_channel_type_room_list_return_from_list_rooms (context);
+}
+
+static void
+room_list_stop_listing (TpSvcChannelTypeRoomList *iface,
+                        DBusGMethodInvocation *context)
+{
+  TpTestsRoomListChannel *self = TP_TESTS_ROOM_LIST_CHANNEL (iface);
+
+  stop_listing (self);
+
+  tp_svc_channel_type_room_list_return_from_stop_listing (context);
+}
+
+static void
+room_list_iface_init (gpointer iface,
+                      gpointer data)
+{
+  TpSvcChannelTypeRoomListClass *klass = iface;
+
+#define IMPLEMENT(x) tp_svc_channel_type_room_list_implement_##x (klass, room_list_##x)
+  IMPLEMENT (get_listing_rooms);
+  IMPLEMENT (list_rooms);
+  IMPLEMENT (stop_listing);
+#undef IMPLEMENT
+}
+
+void
+tp_tests_room_list_channel_rename_room (TpTestsRoomListChannel *self,
+    guint handle,
+    const gchar *name)
+{
+  g_hash_table_insert (self->priv->renamed, GUINT_TO_POINTER (handle),
+      g_strdup (name));
+}
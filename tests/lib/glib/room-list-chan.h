@@ -0,0 +1,74 @@
+/*
+ * room-list-chan.h - header for a tp_tests room list channel
+ *
+ * Copyright © 2012 Collabora Ltd. <http://www.collabora.co.uk/>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef TP_TESTS_ROOM_LIST_CHANNEL_H
+#define TP_TESTS_ROOM_LIST_CHANNEL_H
+
+#include <glib-object.h>
+#include <telepathy-glib/base-connection.h>
+#include <telepathy-glib/dbus-properties-mixin.h>
+
+G_BEGIN_DECLS
+
+typedef struct _TpTestsRoomListChannel TpTestsRoomListChannel;
+typedef struct _TpTestsRoomListChannelPrivate TpTestsRoomListChannelPrivate;
+
+typedef struct _TpTestsRoomListChannelClass TpTestsRoomListChannelClass;
+typedef struct _TpTestsRoomListChannelClassPrivate TpTestsRoomListChannelClassPrivate;
+
+GType tp_tests_room_list_channel_get_type (void);
+
+#define TP_TESTS_TYPE_ROOM_LIST_CHANNEL \
+  (tp_tests_room_list_channel_get_type ())
+#define TP_TESTS_ROOM_LIST_CHANNEL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), TP_TESTS_TYPE_ROOM_LIST_CHANNEL, \
+                               TpTestsRoomListChannel))
+#define TP_TESTS_ROOM_LIST_CHANNEL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), TP_TESTS_TYPE_ROOM_LIST_CHANNEL, \
+                            TpTestsRoomListChannelClass))
+#define TP_TESTS_IS_ROOM_LIST_CHANNEL(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), TP_TESTS_TYPE_ROOM_LIST_CHANNEL))
+#define TP_TESTS_IS_ROOM_LIST_CHANNEL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), TP_TESTS_TYPE_ROOM_LIST_CHANNEL))
+#define TP_TESTS_ROOM_LIST_CHANNEL_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), TP_TESTS_TYPE_ROOM_LIST_CHANNEL, \
+                              TpTestsRoomListChannelClass))
+
+struct _TpTestsRoomListChannelClass {
+    GObjectClass parent_class;
+
+    TpDBusPropertiesMixinClass dbus_properties_class;
+
+    TpTestsRoomListChannelClassPrivate *priv;
+};
+
+struct _TpTestsRoomListChannel {
+    GObject parent;
+
+    TpTestsRoomListChannelPrivate *priv;
+};
+
+void tp_tests_room_list_channel_rename_room (TpTestsRoomListChannel *self,
+    guint handle,
+    const gchar *name);
+
+G_END_DECLS
+
+#endif
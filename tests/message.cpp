@@ -0,0 +1,127 @@
+#include <QtTest/QtTest>
+
+#include <QThread>
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/Debug>
+#include <TelepathyQt/Message>
+#include <TelepathyQt/Types>
+
+using namespace Tp;
+
+namespace
+{
+
+class MessageReader : public QThread
+{
+public:
+    MessageReader(const Message &message)
+        : mMessage(message), mMismatches(0)
+    {
+    }
+
+    int mismatches() const { return mMismatches; }
+
+protected:
+    void run()
+    {
+        for (int i = 0; i < 1000; ++i) {
+            Message copy(mMessage);
+            if (copy.text() != QLatin1String("Hello") ||
+                    copy.messageType() != ChannelTextMessageTypeAction ||
+                    copy.isTruncated() || copy.hasNonTextContent()) {
+                ++mMismatches;
+            }
+        }
+    }
+
+private:
+    Message mMessage;
+    int mMismatches;
+};
+
+}
+
+class TestMessage : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestMessage(QObject *parent = 0);
+
+private Q_SLOTS:
+    void testAccessors();
+    void testCopy();
+    void testConcurrentReads();
+};
+
+TestMessage::TestMessage(QObject *parent)
+    : QObject(parent)
+{
+    Tp::enableDebug(true);
+    Tp::enableWarnings(true);
+}
+
+void TestMessage::testAccessors()
+{
+    Message message(ChannelTextMessageTypeAction, QLatin1String("Hello"));
+
+    QCOMPARE(message.text(), QLatin1String("Hello"));
+    QCOMPARE(message.messageType(), ChannelTextMessageTypeAction);
+    QVERIFY(!message.sent().isValid());
+    QVERIFY(!message.isTruncated());
+    QVERIFY(!message.hasNonTextContent());
+    QCOMPARE(message.messageToken(), QString());
+    QVERIFY(!message.isSpecificToDBusInterface());
+    QCOMPARE(message.dbusInterface(), QString());
+
+    QCOMPARE(message.size(), 2);
+    QCOMPARE(message.header().value(QLatin1String("message-type")).variant().toUInt(),
+            static_cast<uint>(ChannelTextMessageTypeAction));
+    QCOMPARE(message.part(1).value(QLatin1String("content-type")).variant().toString(),
+            QLatin1String("text/plain"));
+    QCOMPARE(message.part(1).value(QLatin1String("content")).variant().toString(),
+            QLatin1String("Hello"));
+}
+
+void TestMessage::testCopy()
+{
+    Message message(ChannelTextMessageTypeNotice, QLatin1String("Hello"));
+
+    // the copy is made before anything is read from either of them
+    Message copy(message);
+    QCOMPARE(copy.text(), QLatin1String("Hello"));
+    QCOMPARE(copy.messageType(), ChannelTextMessageTypeNotice);
+    QCOMPARE(message.text(), QLatin1String("Hello"));
+    QCOMPARE(message.messageType(), ChannelTextMessageTypeNotice);
+    QVERIFY(copy == message);
+
+    Message other(ChannelTextMessageTypeNormal, QLatin1String("Bye"));
+    QCOMPARE(other.text(), QLatin1String("Bye"));
+    other = message;
+    QCOMPARE(other.text(), QLatin1String("Hello"));
+    QCOMPARE(other.messageType(), ChannelTextMessageTypeNotice);
+    QVERIFY(!other.hasNonTextContent());
+    QCOMPARE(other.size(), message.size());
+}
+
+void TestMessage::testConcurrentReads()
+{
+    // copies share the parsed header and body, so reading them from several threads at once
+    // must not race on them
+    Message message(ChannelTextMessageTypeAction, QLatin1String("Hello"));
+
+    MessageReader first(message);
+    MessageReader second(message);
+    first.start();
+    second.start();
+    QVERIFY(first.wait());
+    QVERIFY(second.wait());
+
+    QCOMPARE(first.mismatches(), 0);
+    QCOMPARE(second.mismatches(), 0);
+}
+
+QTEST_MAIN(TestMessage)
+
+#include "_gen/message.cpp.moc.hpp"
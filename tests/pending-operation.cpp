@@ -0,0 +1,354 @@
+#include <QtTest/QtTest>
+
+#include <TelepathyQt/PendingComposite>
+#include <TelepathyQt/PendingFailure>
+#include <TelepathyQt/PendingOperation>
+#include <TelepathyQt/PendingSuccess>
+
+#include <QPointer>
+
+#ifdef TP_QT_ENABLE_COROUTINES
+#include <exception>
+#endif
+
+using namespace Tp;
+
+class TestOperation : public PendingOperation
+{
+    Q_OBJECT
+
+public:
+    TestOperation()
+        : PendingOperation(SharedPtr<RefCounted>())
+    {
+    }
+
+    void finish()
+    {
+        setFinished();
+    }
+
+    void fail()
+    {
+        setFinishedWithError(QLatin1String("org.freedesktop.Telepathy.Error.NotAvailable"),
+                QLatin1String("Not available"));
+    }
+};
+
+#ifdef TP_QT_ENABLE_COROUTINES
+
+namespace
+{
+
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    explicit Task(std::coroutine_handle<promise_type> handle)
+        : handle(handle)
+    {
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        handle.destroy();
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+Task awaitOperation(PendingOperation *op, PendingOperation **result)
+{
+    *result = co_await awaitFinished(op);
+}
+
+}
+
+#endif
+
+class TestPendingOperation : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestPendingOperation(QObject *parent = 0);
+
+protected Q_SLOTS:
+    void onFinished(Tp::PendingOperation *op);
+
+private Q_SLOTS:
+    void init();
+
+    void testIsFinished();
+    void testError();
+    void testFinishedOrder();
+    void testImmediateCompletion();
+    void testComposite();
+    void testAwaitFinished();
+    void testAwaiterDestroyed();
+
+private:
+    void processFinished();
+
+    QList<PendingOperation *> mFinished;
+    QList<bool> mFinishedWasFinished;
+};
+
+TestPendingOperation::TestPendingOperation(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void TestPendingOperation::onFinished(Tp::PendingOperation *op)
+{
+    mFinished.append(op);
+    mFinishedWasFinished.append(op->isFinished());
+}
+
+void TestPendingOperation::processFinished()
+{
+    // finished() is posted, and the deleteLater() following it needs to be flushed explicitly as
+    // we are not running inside an event loop
+    QCoreApplication::processEvents();
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+}
+
+void TestPendingOperation::init()
+{
+    mFinished.clear();
+    mFinishedWasFinished.clear();
+}
+
+void TestPendingOperation::testIsFinished()
+{
+    TestOperation *op = new TestOperation;
+    QPointer<TestOperation> guard(op);
+    connect(op,
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(onFinished(Tp::PendingOperation*)));
+
+    QVERIFY(!op->isFinished());
+    QVERIFY(!op->isValid());
+    QVERIFY(!op->isError());
+
+    // isFinished() changes as soon as the operation finishes, finished() only once the event
+    // loop runs
+    op->finish();
+    QVERIFY(op->isFinished());
+    QVERIFY(op->isValid());
+    QVERIFY(!op->isError());
+    QVERIFY(mFinished.isEmpty());
+
+    processFinished();
+    QCOMPARE(mFinished.size(), 1);
+    QCOMPARE(mFinished.first(), static_cast<PendingOperation *>(op));
+    QCOMPARE(mFinishedWasFinished.first(), true);
+    QVERIFY(guard.isNull());
+}
+
+void TestPendingOperation::testError()
+{
+    TestOperation *op = new TestOperation;
+    connect(op,
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(onFinished(Tp::PendingOperation*)));
+
+    op->fail();
+    QVERIFY(op->isFinished());
+    QVERIFY(!op->isValid());
+    QVERIFY(op->isError());
+    QCOMPARE(op->errorName(), QLatin1String("org.freedesktop.Telepathy.Error.NotAvailable"));
+
+    // Finishing again must not change the outcome nor emit finished() twice
+    op->finish();
+    QVERIFY(op->isError());
+
+    processFinished();
+    QCOMPARE(mFinished.size(), 1);
+}
+
+void TestPendingOperation::testFinishedOrder()
+{
+    QList<TestOperation *> ops;
+    for (int i = 0; i < 3; ++i) {
+        TestOperation *op = new TestOperation;
+        connect(op,
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(onFinished(Tp::PendingOperation*)));
+        ops.append(op);
+    }
+
+    ops[2]->finish();
+    ops[0]->fail();
+    ops[1]->finish();
+    QVERIFY(mFinished.isEmpty());
+
+    // finished() is emitted in the order the operations finished in, not the order they were
+    // created in
+    processFinished();
+    QCOMPARE(mFinished.size(), 3);
+    QCOMPARE(mFinished[0], static_cast<PendingOperation *>(ops[2]));
+    QCOMPARE(mFinished[1], static_cast<PendingOperation *>(ops[0]));
+    QCOMPARE(mFinished[2], static_cast<PendingOperation *>(ops[1]));
+}
+
+void TestPendingOperation::testImmediateCompletion()
+{
+    // An operation which finished straight away can be picked up using isFinished(), and is still
+    // there once finished() has been emitted, even if nobody listens to it
+    PendingOperation *op = new PendingSuccess(SharedPtr<RefCounted>());
+    QPointer<PendingOperation> guard(op);
+    QVERIFY(op->isFinished());
+    QVERIFY(op->isValid());
+
+    QCoreApplication::processEvents();
+    QVERIFY(!guard.isNull());
+    QVERIFY(op->isValid());
+
+    // It only goes away once the event loop gets the chance to delete it
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+    QVERIFY(guard.isNull());
+
+    // The same goes for one that is listened to
+    op = new PendingSuccess(SharedPtr<RefCounted>());
+    guard = op;
+    connect(op,
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(onFinished(Tp::PendingOperation*)));
+
+    QCoreApplication::processEvents();
+    QCOMPARE(mFinished.size(), 1);
+    QVERIFY(!guard.isNull());
+
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+    QVERIFY(guard.isNull());
+}
+
+void TestPendingOperation::testComposite()
+{
+    // Operations which have already finished are picked up straight away
+    QList<PendingOperation *> ops;
+    ops << new PendingSuccess(SharedPtr<RefCounted>());
+    ops << new PendingSuccess(SharedPtr<RefCounted>());
+    PendingComposite *composite = new PendingComposite(ops, SharedPtr<RefCounted>());
+    QVERIFY(composite->isFinished());
+    QVERIFY(composite->isValid());
+    processFinished();
+
+    ops.clear();
+    ops << new PendingSuccess(SharedPtr<RefCounted>());
+    ops << new PendingFailure(QLatin1String("org.freedesktop.Telepathy.Error.NotAvailable"),
+            QLatin1String("Not available"), SharedPtr<RefCounted>());
+    composite = new PendingComposite(ops, SharedPtr<RefCounted>());
+    QVERIFY(composite->isError());
+    QCOMPARE(composite->errorName(),
+            QLatin1String("org.freedesktop.Telepathy.Error.NotAvailable"));
+    processFinished();
+
+    // Mixing finished and pending operations
+    TestOperation *pending = new TestOperation;
+    ops.clear();
+    ops << new PendingSuccess(SharedPtr<RefCounted>());
+    ops << pending;
+    composite = new PendingComposite(ops, SharedPtr<RefCounted>());
+    connect(composite,
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(onFinished(Tp::PendingOperation*)));
+    QVERIFY(!composite->isFinished());
+
+    processFinished();
+    QVERIFY(!composite->isFinished());
+
+    pending->finish();
+    processFinished();
+    QCOMPARE(mFinished.size(), 1);
+    QCOMPARE(mFinished.first(), static_cast<PendingOperation *>(composite));
+    QCOMPARE(mFinishedWasFinished.first(), true);
+}
+
+void TestPendingOperation::testAwaitFinished()
+{
+#ifdef TP_QT_ENABLE_COROUTINES
+    // Already finished: the coroutine carries on straight away
+    PendingOperation *result = 0;
+    PendingOperation *op = new PendingSuccess(SharedPtr<RefCounted>());
+    {
+        Task task = awaitOperation(op, &result);
+        QCOMPARE(result, op);
+    }
+    processFinished();
+
+    // Pending: the coroutine is resumed before finished() is emitted
+    result = 0;
+    TestOperation *pending = new TestOperation;
+    connect(pending,
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(onFinished(Tp::PendingOperation*)));
+    Task task = awaitOperation(pending, &result);
+    QVERIFY(result == 0);
+
+    pending->finish();
+    QVERIFY(result == 0);
+
+    QCoreApplication::processEvents();
+    QCOMPARE(result, static_cast<PendingOperation *>(pending));
+    QCOMPARE(mFinished.size(), 1);
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+#endif
+}
+
+void TestPendingOperation::testAwaiterDestroyed()
+{
+#ifdef TP_QT_ENABLE_COROUTINES
+    PendingOperation *result = 0;
+    TestOperation *op = new TestOperation;
+    QPointer<TestOperation> guard(op);
+    {
+        // Destroying the coroutine while it is waiting must not leave the operation with
+        // something to resume
+        Task task = awaitOperation(op, &result);
+    }
+
+    op->finish();
+    processFinished();
+    QVERIFY(result == 0);
+    QVERIFY(guard.isNull());
+
+    // The operation going away first must not upset the awaiter either
+    op = new TestOperation;
+    {
+        Task task = awaitOperation(op, &result);
+        delete op;
+    }
+    QVERIFY(result == 0);
+
+    // Nor does awaiting an operation which is already gone
+    op = new TestOperation;
+    guard = op;
+    PendingOperation *pending = op;
+    delete op;
+    {
+        Task task = awaitOperation(guard.data(), &pending);
+        QVERIFY(task.handle.done());
+    }
+    QVERIFY(pending == 0);
+#endif
+}
+
+QTEST_MAIN(TestPendingOperation)
+
+#include "_gen/pending-operation.cpp.moc.hpp"